@@ -0,0 +1,941 @@
+// redis-microbench: microbenchmarks for the hot components of the server.
+//
+// Each benchmark is calibrated until one batch runs for at least
+// --min-time-ms, then repeated --repetitions times; the median and fastest
+// repetition are reported. Inputs come from fixed seeds so two runs on the
+// same machine measure the same work, and results are written as JSON so
+// they can be diffed across commits.
+
+#include "redis/BloomFilter.h"
+#include "redis/Client.h"
+#include "redis/ClientRegistry.h"
+#include "redis/CommandHandler.h"
+#include "redis/Config.h"
+#include "redis/Crc64.h"
+#include "redis/HyperLogLog.h"
+#include "redis/Lzf.h"
+#include "redis/Metrics.h"
+#include "redis/PubSub.h"
+#include "redis/RDBParser.h"
+#include "redis/RDBWriter.h"
+#include "redis/RESPParser.h"
+#include "redis/Storage.h"
+#include "redis/Tracking.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from discarding a result that is otherwise unused.
+template <typename T> void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Options {
+  std::string filter;
+  std::string output;
+  int64_t minTimeMs = 100;
+  int repetitions = 5;
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations = 0;
+  double nsPerOp = 0;    // median repetition
+  double minNsPerOp = 0; // fastest repetition
+  double itemsPerOp = 1; // e.g. keys loaded per RDB parse
+};
+
+// A benchmark body runs the operation the given number of times. Setup that
+// shouldn't be measured belongs outside the returned callable.
+using Body = std::function<void(uint64_t iterations)>;
+
+class Suite {
+public:
+  explicit Suite(const Options &options) : options_(options) {}
+
+  bool enabled(const std::string_view name) const {
+    return options_.filter.empty() ||
+           name.find(options_.filter) != std::string_view::npos;
+  }
+
+  // Whether any benchmark under prefix can match, so that groups with
+  // expensive setup are skipped entirely when filtered out.
+  bool groupEnabled(const std::string_view prefix) const {
+    return enabled(prefix) ||
+           std::string_view(options_.filter).starts_with(prefix);
+  }
+
+  void run(const std::string &name, const Body &body, double itemsPerOp = 1) {
+    if (!enabled(name)) {
+      return;
+    }
+
+    const auto minTime = std::chrono::milliseconds(options_.minTimeMs);
+    uint64_t iterations = 1;
+    while (true) {
+      const auto elapsed = time(body, iterations);
+      if (elapsed >= minTime || iterations >= (uint64_t{1} << 40)) {
+        break;
+      }
+      // Aim slightly past the target so the loop converges in a few rounds.
+      const double scale = static_cast<double>(minTime.count()) * 1.2e6 /
+                           std::max<double>(elapsed.count(), 1.0);
+      iterations = std::max(iterations * 2,
+                            static_cast<uint64_t>(iterations * scale));
+    }
+
+    std::vector<double> samples;
+    for (int i = 0; i < options_.repetitions; i++) {
+      samples.push_back(static_cast<double>(time(body, iterations).count()) /
+                        static_cast<double>(iterations));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result{name, iterations, samples[samples.size() / 2], samples[0],
+                  itemsPerOp};
+    std::cerr << name << ": " << result.nsPerOp << " ns/op (" << iterations
+              << " iterations)" << std::endl;
+    results_.push_back(std::move(result));
+  }
+
+  std::string json() const {
+    std::ostringstream out;
+    out << "{\n  \"context\": {\n"
+        << "    \"compiler\": \"" << compiler() << "\",\n"
+        << "    \"min_time_ms\": " << options_.minTimeMs << ",\n"
+        << "    \"repetitions\": " << options_.repetitions << "\n  },\n"
+        << "  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results_.size(); i++) {
+      const auto &result = results_[i];
+      out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+          << "\", \"iterations\": " << result.iterations
+          << ", \"ns_per_op\": " << result.nsPerOp
+          << ", \"min_ns_per_op\": " << result.minNsPerOp
+          << ", \"items_per_second\": "
+          << result.itemsPerOp * 1e9 / result.nsPerOp << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+  }
+
+private:
+  const Options &options_;
+  std::vector<Result> results_;
+
+  static std::chrono::nanoseconds time(const Body &body,
+                                       const uint64_t iterations) {
+    const auto start = Clock::now();
+    body(iterations);
+    return Clock::now() - start;
+  }
+
+  static std::string compiler() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#else
+    return "unknown";
+#endif
+  }
+};
+
+std::string keyName(const std::size_t i) { return "key:" + std::to_string(i); }
+
+std::string encodeRequest(const std::vector<std::string> &args) {
+  return redis::RESPParser::encodeArray(args);
+}
+
+// Lookup keys for a table of the given size: hitRate of them exist.
+std::vector<std::string> lookupKeys(const std::size_t tableSize,
+                                    const double hitRate) {
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<std::size_t> pick(0, tableSize - 1);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+  std::vector<std::string> keys(4096);
+  for (auto &key : keys) {
+    key = unit(rng) < hitRate ? keyName(pick(rng))
+                              : "miss:" + std::to_string(pick(rng));
+  }
+  return keys;
+}
+
+void benchRespParser(Suite &suite) {
+  const std::string value16(16, 'v');
+  const std::string value1k(1024, 'v');
+  const std::string setFrame = encodeRequest({"SET", "key:123456", value16});
+  const std::string setFrame1k = encodeRequest({"SET", "key:123456", value1k});
+  std::vector<std::string> mgetArgs = {"MGET"};
+  for (int i = 0; i < 16; i++) {
+    mgetArgs.push_back(keyName(i));
+  }
+  const std::string mgetFrame = encodeRequest(mgetArgs);
+
+  std::string pipeline;
+  for (int i = 0; i < 32; i++) {
+    pipeline += encodeRequest({"GET", keyName(i)});
+  }
+
+  suite.run("resp/parseArray/set_16b", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::parseArray(setFrame));
+    }
+  });
+  suite.run("resp/parseArray/set_1kb", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::parseArray(setFrame1k));
+    }
+  });
+  suite.run("resp/parseArray/mget_16", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::parseArray(mgetFrame));
+    }
+  });
+  suite.run(
+      "resp/parseCommand/pipeline_32",
+      [&](const uint64_t n) {
+        std::vector<std::string> command;
+        for (uint64_t i = 0; i < n; i++) {
+          std::size_t pos = 0;
+          while (redis::RESPParser::parseCommand(pipeline, pos, command) ==
+                 redis::ParseResult::Ok) {
+            doNotOptimize(command);
+          }
+        }
+      },
+      32);
+
+  suite.run("resp/encodeSimpleString/ok", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::encodeSimpleString("OK"));
+    }
+  });
+  suite.run("resp/encodeBulkString/16b", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::encodeBulkString(value16));
+    }
+  });
+  suite.run("resp/encodeBulkString/1kb", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::encodeBulkString(value1k));
+    }
+  });
+  suite.run("resp/encodeArray/16x16b", [&](const uint64_t n) {
+    const std::vector<std::string> items(16, value16);
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::encodeArray(items));
+    }
+  });
+  suite.run("resp/encodeInteger", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::encodeInteger(
+          static_cast<int64_t>(i & 0xFFFFF)));
+    }
+  });
+  suite.run("resp/encodeError", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::RESPParser::encodeError("ERR syntax error"));
+    }
+  });
+}
+
+void benchStorage(Suite &suite) {
+  const std::string value(32, 'v');
+  for (const std::size_t size : {1000, 100000, 1000000}) {
+    const std::string prefix = "storage/" + std::to_string(size) + "/";
+    if (!suite.groupEnabled(prefix)) {
+      continue;
+    }
+
+    redis::Storage storage;
+    for (std::size_t i = 0; i < size; i++) {
+      storage.set(keyName(i), value);
+    }
+
+    for (const double hitRate : {1.0, 0.5, 0.0}) {
+      const auto keys = lookupKeys(size, hitRate);
+      suite.run(prefix + "get/hit_" +
+                    std::to_string(static_cast<int>(hitRate * 100)),
+                [&](const uint64_t n) {
+                  for (uint64_t i = 0; i < n; i++) {
+                    doNotOptimize(storage.get(keys[i & 4095]));
+                  }
+                });
+    }
+
+    // Overwrites of existing keys, so the table size stays fixed.
+    const auto keys = lookupKeys(size, 1.0);
+    suite.run(prefix + "set/overwrite", [&](const uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        storage.set(keys[i & 4095], value);
+      }
+    });
+    suite.run(prefix + "setWithExpiry/overwrite", [&](const uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        storage.setWithExpiry(keys[i & 4095], value, 60000);
+      }
+    });
+  }
+}
+
+// A JSON document of about the given size, repetitive the way API payloads
+// are.
+std::string jsonValue(const std::size_t size) {
+  std::mt19937_64 rng(7);
+  std::string json = "[";
+  for (std::size_t i = 0; json.size() < size; i++) {
+    json += R"({"id":)" + std::to_string(rng() % 1000000) +
+            R"(,"name":"user)" + std::to_string(i) +
+            R"(","email":"user)" + std::to_string(i) +
+            R"(@example.com","active":true,"score":)" +
+            std::to_string(rng() % 100) + "},";
+  }
+  json.back() = ']';
+  return json;
+}
+
+// GET latency with values stored LZF-compressed versus raw; the memory saved
+// is printed alongside.
+void benchCompression(Suite &suite) {
+  if (!suite.groupEnabled("compression/")) {
+    return;
+  }
+
+  constexpr std::size_t kKeys = 1000;
+  for (const std::size_t size : {4096, 32768}) {
+    const std::string value = jsonValue(size);
+    const std::string prefix = "compression/" + std::to_string(size / 1024) +
+                               "kb/";
+
+    std::string compressed(value.size(), '\0');
+    const std::size_t compressedSize =
+        redis::lzfCompress(value, compressed.data(), compressed.size());
+    suite.run(prefix + "lzf_compress", [&](const uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(
+            redis::lzfCompress(value, compressed.data(), compressed.size()));
+      }
+    });
+    std::string decompressed(value.size(), '\0');
+    suite.run(prefix + "lzf_decompress", [&](const uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(redis::lzfDecompress(
+            std::string_view(compressed.data(), compressedSize),
+            decompressed.data(), decompressed.size()));
+      }
+    });
+
+    for (const bool compress : {false, true}) {
+      redis::Storage storage;
+      storage.setValueCompression(compress ? 1024 : 0);
+      for (std::size_t i = 0; i < kKeys; i++) {
+        storage.set(keyName(i), value);
+      }
+      const auto keys = lookupKeys(kKeys, 1.0);
+      suite.run(prefix + (compress ? "get_lzf" : "get_raw"),
+                [&](const uint64_t n) {
+                  for (uint64_t i = 0; i < n; i++) {
+                    doNotOptimize(storage.get(keys[i & 4095]));
+                  }
+                });
+      if (compress && suite.enabled(prefix + "get_lzf")) {
+        const auto stats = storage.compressionStats();
+        std::cerr << prefix << "memory: " << stats.rawBytes << " bytes raw, "
+                  << stats.compressedBytes << " stored" << std::endl;
+      }
+    }
+  }
+}
+
+// PFADD into sparse and dense sketches, and PFCOUNT of one key (cached) and
+// of the union of several, which merges their registers on every call.
+void benchHyperLogLog(Suite &suite) {
+  if (!suite.groupEnabled("hll/")) {
+    return;
+  }
+
+  constexpr std::size_t kSparseMaxBytes = 3000;
+  redis::Storage storage;
+  std::vector<std::string> elements(4096);
+  for (std::size_t i = 0; i < elements.size(); i++) {
+    elements[i] = "user:" + std::to_string(i * 7919);
+  }
+
+  // Sketches are recreated every 200 elements so they stay sparse.
+  suite.run("hll/pfadd/sparse", [&](const uint64_t n) {
+    const std::string key = "sparse";
+    bool changed = false;
+    for (uint64_t i = 0; i < n; i++) {
+      if (i % 200 == 0) {
+        storage.remove(std::span(&key, 1));
+      }
+      storage.pfAdd(key, std::span(&elements[i & 4095], 1), kSparseMaxBytes,
+                    changed);
+    }
+  });
+
+  // Dense sketches of 100000 distinct elements each.
+  std::vector<std::string> keys;
+  for (std::size_t k = 0; k < 8; k++) {
+    keys.push_back("dense:" + std::to_string(k));
+    std::vector<std::string> batch;
+    for (std::size_t i = 0; i < 100000; i++) {
+      batch.push_back(std::to_string(k) + ":" + std::to_string(i));
+    }
+    bool changed = false;
+    storage.pfAdd(keys.back(), batch, kSparseMaxBytes, changed);
+  }
+  suite.run("hll/pfadd/dense", [&](const uint64_t n) {
+    bool changed = false;
+    for (uint64_t i = 0; i < n; i++) {
+      storage.pfAdd(keys[0], std::span(&elements[i & 4095], 1),
+                    kSparseMaxBytes, changed);
+    }
+  });
+
+  uint64_t count = 0;
+  storage.pfCount(std::span(keys.data(), 1), count);
+  suite.run("hll/pfcount/cached", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      storage.pfCount(std::span(keys.data(), 1), count);
+      doNotOptimize(count);
+    }
+  });
+  for (const std::size_t merged : {2, 8}) {
+    suite.run("hll/pfcount/merged_" + std::to_string(merged),
+              [&](const uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                  storage.pfCount(std::span(keys.data(), merged), count);
+                  doNotOptimize(count);
+                }
+              });
+  }
+
+  std::vector<std::string> sparseKeys;
+  for (std::size_t k = 0; k < 8; k++) {
+    sparseKeys.push_back("sparse:" + std::to_string(k));
+    bool changed = false;
+    storage.pfAdd(sparseKeys.back(),
+                  std::span(elements.data() + k * 200, 200), kSparseMaxBytes,
+                  changed);
+  }
+  suite.run("hll/pfcount/merged_8_sparse", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      storage.pfCount(sparseKeys, count);
+      doNotOptimize(count);
+    }
+  });
+
+  // The kernels behind a merged count: unpacking a dense sketch into the
+  // merged registers, and the estimate from those.
+  redis::HyperLogLog::Registers registers{};
+  for (std::size_t i = 0; i < registers.size(); i++) {
+    registers[i] = static_cast<uint8_t>((i * 2654435761u) % 12);
+  }
+  const std::string dense = redis::HyperLogLog::fromRegisters(registers);
+  suite.run("hll/merge_dense", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      redis::HyperLogLog::mergeInto(dense, registers);
+      doNotOptimize(registers);
+    }
+  });
+  suite.run("hll/estimate", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(redis::HyperLogLog::estimate(registers));
+    }
+  });
+}
+
+void benchHash(Suite &suite) {
+  if (!suite.groupEnabled("hash/")) {
+    return;
+  }
+
+  // The same 16-field object in each encoding: a listpack is scanned, a
+  // hash table is hashed into.
+  redis::Storage storage;
+  std::vector<std::string> fieldValues;
+  for (std::size_t i = 0; i < 16; i++) {
+    fieldValues.push_back("field:" + std::to_string(i));
+    fieldValues.push_back("value:" + std::to_string(i * 7919));
+  }
+  std::size_t added = 0;
+  storage.hset("listpack", fieldValues, added);
+  storage.setEncodingLimits({.hashMaxEntries = 0, .hashMaxValueBytes = 0});
+  storage.hset("hashtable", fieldValues, added);
+
+  for (const std::string key : {"listpack", "hashtable"}) {
+    suite.run("hash/hget/" + key + "_16", [&](const uint64_t n) {
+      std::optional<std::string> value;
+      for (uint64_t i = 0; i < n; i++) {
+        storage.hget(key, fieldValues[(i & 15) * 2], value);
+        doNotOptimize(value);
+      }
+    });
+    suite.run("hash/hset/" + key + "_16", [&](const uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        storage.hset(key, std::span(fieldValues).subspan((i & 15) * 2, 2),
+                     added);
+      }
+    });
+  }
+}
+
+void benchSet(Suite &suite) {
+  if (!suite.groupEnabled("set/")) {
+    return;
+  }
+
+  // Tag sets of 32-bit ids: two of similar size that share a third of
+  // their members, and a small one against a large one. Each pair is also
+  // stored as hash tables, as sets of arbitrary strings would be.
+  redis::Storage storage;
+  const auto fill = [&](const std::string &key, const std::size_t count,
+                        const uint64_t stride) {
+    std::vector<std::string> members;
+    for (std::size_t i = 0; i < count; i++) {
+      members.push_back(std::to_string(100000 + i * stride));
+    }
+    std::size_t added = 0;
+    storage.sadd(key, members, added);
+  };
+  for (const std::string encoding : {"intset", "table"}) {
+    const std::size_t maxIntsetEntries =
+        encoding == "intset" ? std::size_t{1} << 20 : 0;
+    storage.setEncodingLimits({.setMaxIntsetEntries = maxIntsetEntries});
+    fill(encoding + ":a", 10000, 3);
+    fill(encoding + ":b", 10000, 5);
+    fill(encoding + ":small", 100, 997);
+    fill(encoding + ":large", 100000, 1);
+  }
+
+  redis::SetMembers result;
+  for (const std::string encoding : {"intset", "table"}) {
+    for (const auto &[name, a, b] :
+         {std::tuple{"10k_10k", ":a", ":b"},
+          std::tuple{"100_100k", ":small", ":large"}}) {
+      const std::vector<std::string> keys = {encoding + a, encoding + b};
+      suite.run("set/sinter/" + encoding + "_" + name,
+                [&](const uint64_t n) {
+                  for (uint64_t i = 0; i < n; i++) {
+                    storage.sinter(keys, result);
+                    doNotOptimize(result);
+                  }
+                });
+    }
+    const std::string key = encoding + ":large";
+    suite.run("set/sismember/" + encoding, [&](const uint64_t n) {
+      bool found = false;
+      const std::string member = "150000";
+      for (uint64_t i = 0; i < n; i++) {
+        storage.sismember(key, member, found);
+        doNotOptimize(found);
+      }
+    });
+  }
+}
+
+struct HandlerFixture {
+  std::shared_ptr<redis::Config> config = std::make_shared<redis::Config>();
+  std::shared_ptr<redis::Storage> storage = std::make_shared<redis::Storage>();
+  std::shared_ptr<redis::PubSub> pubsub = std::make_shared<redis::PubSub>();
+  std::shared_ptr<redis::ClientRegistry> registry =
+      std::make_shared<redis::ClientRegistry>();
+  std::shared_ptr<redis::Tracking> tracking =
+      std::make_shared<redis::Tracking>(registry,
+                                        config->getTrackingTableMaxKeys());
+  std::shared_ptr<redis::Metrics> metrics =
+      std::make_shared<redis::Metrics>(*config);
+  redis::CommandHandler handler{config,   storage,  pubsub,
+                                registry, tracking, metrics};
+  redis::Client client{INVALID_SOCKET_VAL};
+
+  HandlerFixture() {
+    for (std::size_t i = 0; i < 100000; i++) {
+      storage->set(keyName(i), std::string(32, 'v'));
+    }
+  }
+
+  // Reused between calls, like a client's output buffer.
+  std::string reply;
+
+  const std::string &execute(std::vector<std::string> command) {
+    reply.clear();
+    handler.handleCommand(client, command, reply);
+    client.arena.reset();
+    return reply;
+  }
+};
+
+void benchBloom(Suite &suite) {
+  if (!suite.groupEnabled("bloom/")) {
+    return;
+  }
+
+  // An 8M-item filter at 1% takes about 12 MB, well past L2, so lookups
+  // are bound by their one cache miss each. Queries are half members, half
+  // not, and batched lookups overlap the misses by prefetching.
+  constexpr uint64_t kItems = 8'000'000;
+  constexpr std::size_t kBatch = 100;
+  redis::BloomFilter filter({.errorRate = 0.01, .capacity = kItems});
+  {
+    std::vector<std::string> items;
+    std::vector<redis::BloomFilter::AddResult> results;
+    for (uint64_t i = 0; i < kItems; i += kBatch) {
+      items.clear();
+      results.clear();
+      for (uint64_t j = i; j < i + kBatch; j++) {
+        items.push_back("id:" + std::to_string(j));
+      }
+      filter.add(items, results);
+    }
+  }
+
+  std::mt19937_64 rng(42);
+  std::vector<std::string> queries(1 << 16);
+  for (std::string &query : queries) {
+    query = "id:" + std::to_string(rng() % (2 * kItems));
+  }
+
+  std::vector<bool> found;
+  suite.run("bloom/exists/single", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      found.clear();
+      filter.contains(std::span(&queries[i % queries.size()], 1), found);
+      doNotOptimize(found);
+    }
+  });
+  suite.run(
+      "bloom/exists/batch_100",
+      [&](const uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+          found.clear();
+          const std::size_t start = i * kBatch % (queries.size() - kBatch);
+          filter.contains(std::span(queries).subspan(start, kBatch), found);
+          doNotOptimize(found);
+        }
+      },
+      kBatch);
+
+  // Adding what is already present is a lookup; new items also set bits,
+  // until the filter scales.
+  std::vector<redis::BloomFilter::AddResult> results;
+  suite.run(
+      "bloom/add/batch_100",
+      [&](const uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+          results.clear();
+          const std::size_t start = i * kBatch % (queries.size() - kBatch);
+          filter.add(std::span(queries).subspan(start, kBatch), results);
+          doNotOptimize(results);
+        }
+      },
+      kBatch);
+}
+
+void benchCommandHandler(Suite &suite) {
+  if (!suite.groupEnabled("handler/") &&
+      !suite.groupEnabled("instrumentation/")) {
+    return;
+  }
+
+  HandlerFixture fixture;
+  const auto keys = lookupKeys(100000, 1.0);
+  const std::string value(32, 'v');
+
+  const auto runCommand = [&](const std::string &name,
+                              const std::vector<std::string> &command) {
+    suite.run(name, [&](const uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(fixture.execute(command));
+      }
+    });
+  };
+
+  runCommand("handler/ping", {"PING"});
+  runCommand("handler/echo", {"ECHO", "hello"});
+  runCommand("handler/unknown", {"NOSUCHCOMMAND"});
+  suite.run("handler/get/hit", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(fixture.execute({"GET", keys[i & 4095]}));
+    }
+  });
+  suite.run("handler/get/miss", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(fixture.execute({"GET", "missing"}));
+    }
+  });
+  suite.run("handler/set", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(fixture.execute({"SET", keys[i & 4095], value}));
+    }
+  });
+
+  // A counter bump done natively versus read-modify-write from a client.
+  fixture.execute({"SET", "counter", "0"});
+  runCommand("handler/counter/incr", {"INCR", "counter"});
+  suite.run("handler/counter/get_set", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(fixture.execute({"GET", "counter"}));
+      doNotOptimize(fixture.execute({"SET", "counter", std::to_string(i)}));
+    }
+  });
+
+  // HGETALL encodes the reply straight from the stored hash.
+  std::vector<std::string> hset = {"HSET", "object"};
+  for (std::size_t i = 0; i < 16; i++) {
+    hset.push_back("field:" + std::to_string(i));
+    hset.push_back(value);
+  }
+  fixture.execute(hset);
+  runCommand("handler/hgetall/16", {"HGETALL", "object"});
+
+  // Cost of the per-command timing: the clock reads and the bookkeeping
+  // that follow every dispatch, and GET with the SLOWLOG and LATENCY
+  // monitor switched off for comparison with handler/get/hit.
+  suite.run("instrumentation/clock_now_pair", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(Clock::now());
+      doNotOptimize(Clock::now());
+    }
+  });
+  suite.run("instrumentation/record_command", [&](const uint64_t n) {
+    const auto start = Clock::now();
+    for (uint64_t i = 0; i < n; i++) {
+      fixture.metrics->recordCommand(3, start, start, false);
+    }
+  });
+  fixture.execute({"CONFIG", "SET", "slowlog-log-slower-than", "-1"});
+  fixture.execute({"CONFIG", "SET", "latency-monitor-threshold", "0"});
+  suite.run("instrumentation/get_hit_monitors_off", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(fixture.execute({"GET", keys[i & 4095]}));
+    }
+  });
+
+  // Hot-key sampling: the countdown every keyed command pays, the cost of a
+  // sample, and GET with every command sampled and with tracking off, for
+  // comparison with get_hit_monitors_off at the default rate.
+  redis::HotKeys &hotKeys = fixture.metrics->hotKeys();
+  suite.run("instrumentation/hotkeys_should_sample", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(hotKeys.shouldSample());
+    }
+  });
+  suite.run("instrumentation/hotkeys_record", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      hotKeys.record(keys[i & 4095]);
+    }
+  });
+  fixture.execute({"CONFIG", "SET", "hotkeys-sample-rate", "1"});
+  suite.run("instrumentation/get_hit_hotkeys_all", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(fixture.execute({"GET", keys[i & 4095]}));
+    }
+  });
+  fixture.execute({"CONFIG", "SET", "hotkeys-sample-rate", "0"});
+  suite.run("instrumentation/get_hit_hotkeys_off", [&](const uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      doNotOptimize(fixture.execute({"GET", keys[i & 4095]}));
+    }
+  });
+  suite.run("instrumentation/bigkeys_step", [&](const uint64_t n) {
+    redis::BigKeyScanner scanner(true);
+    for (uint64_t i = 0; i < n; i++) {
+      scanner.step(*fixture.storage);
+    }
+  });
+}
+
+void writeLength(std::ofstream &out, const std::size_t length) {
+  if (length < 64) {
+    out.put(static_cast<char>(length));
+  } else if (length < 16384) {
+    out.put(static_cast<char>(0x40 | (length >> 8)));
+    out.put(static_cast<char>(length & 0xFF));
+  } else {
+    out.put(static_cast<char>(0x80));
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      out.put(static_cast<char>((length >> shift) & 0xFF));
+    }
+  }
+}
+
+void writeString(std::ofstream &out, const std::string &value) {
+  writeLength(out, value.size());
+  out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+// Writes a snapshot of string keys, a quarter of them with a far-future
+// millisecond expiry, in the layout RDBParser reads.
+void writeSnapshot(const std::string &path, const std::size_t keys) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write("REDIS0011", 9);
+  out.put(static_cast<char>(0xFA));
+  writeString(out, "redis-ver");
+  writeString(out, "7.2.0");
+  out.put(static_cast<char>(0xFE));
+  out.put(0);
+  out.put(static_cast<char>(0xFB));
+  writeLength(out, keys);
+  writeLength(out, keys / 4);
+
+  const uint64_t expiry = 4102444800000; // 2100-01-01
+  const std::string value(32, 'v');
+  for (std::size_t i = 0; i < keys; i++) {
+    if (i % 4 == 0) {
+      out.put(static_cast<char>(0xFC));
+      out.write(reinterpret_cast<const char *>(&expiry), 8);
+    }
+    out.put(0);
+    writeString(out, keyName(i));
+    writeString(out, value);
+  }
+  out.put(static_cast<char>(0xFF));
+  const uint64_t checksum = 0;
+  out.write(reinterpret_cast<const char *>(&checksum), 8);
+}
+
+void benchRdbParser(Suite &suite) {
+  const auto directory = std::filesystem::temp_directory_path();
+  for (const std::size_t keys : {1000, 100000}) {
+    const std::string name = "rdb/parseFile/" + std::to_string(keys);
+    if (!suite.enabled(name)) {
+      continue;
+    }
+
+    const auto path =
+        (directory / ("redis-microbench-" + std::to_string(keys) + ".rdb"))
+            .string();
+    writeSnapshot(path, keys);
+    suite.run(
+        name,
+        [&](const uint64_t n) {
+          for (uint64_t i = 0; i < n; i++) {
+            redis::Storage storage;
+            redis::RDBParser parser;
+            doNotOptimize(parser.parseFile(path, storage));
+          }
+        },
+        static_cast<double>(keys));
+    std::filesystem::remove(path);
+  }
+
+  // Saving: a JSON value per key exercises the LZF path, and the checksum
+  // is computed over every byte written.
+  for (const bool compression : {false, true}) {
+    const std::string name = std::string("rdb/writeFile/100000") +
+                             (compression ? "_lzf" : "_raw");
+    if (!suite.enabled(name)) {
+      continue;
+    }
+
+    constexpr std::size_t kKeys = 100000;
+    redis::Storage storage;
+    const std::string value = jsonValue(256);
+    for (std::size_t i = 0; i < kKeys; i++) {
+      storage.set(keyName(i), value);
+    }
+    const auto path =
+        (directory / "redis-microbench-write.rdb").string();
+    suite.run(
+        name,
+        [&](const uint64_t n) {
+          for (uint64_t i = 0; i < n; i++) {
+            redis::RDBWriter writer(compression, true);
+            doNotOptimize(writer.writeFile(path, storage));
+          }
+        },
+        static_cast<double>(kKeys));
+    std::filesystem::remove(path);
+  }
+
+  const std::string block(1 << 20, 'x');
+  suite.run(
+      "rdb/crc64/1mb",
+      [&](const uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+          doNotOptimize(redis::crc64(0, block));
+        }
+      },
+      static_cast<double>(block.size()));
+}
+
+void usage() {
+  std::cerr << "Usage: redis-microbench [options]\n"
+               "  --filter <substring>   Only run benchmarks whose name "
+               "contains it\n"
+               "  --min-time-ms <ms>     Minimum time per repetition (100)\n"
+               "  --repetitions <n>      Repetitions per benchmark (5)\n"
+               "  --out <file>           Write JSON there instead of stdout\n";
+}
+
+bool parseArgs(const int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+      options.filter = argv[++i];
+    } else if (strcmp(argv[i], "--min-time-ms") == 0 && hasValue) {
+      options.minTimeMs = std::max<int64_t>(1, std::atoll(argv[++i]));
+    } else if (strcmp(argv[i], "--repetitions") == 0 && hasValue) {
+      options.repetitions = std::max(1, std::atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+      options.output = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(const int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  // The components log to stdout (RDB loading, for one); keep it for JSON.
+  std::ostringstream discarded;
+  auto *const stdoutBuffer = std::cout.rdbuf(discarded.rdbuf());
+
+  Suite suite(options);
+  benchRespParser(suite);
+  benchStorage(suite);
+  benchCompression(suite);
+  benchHyperLogLog(suite);
+  benchHash(suite);
+  benchSet(suite);
+  benchBloom(suite);
+  benchCommandHandler(suite);
+  benchRdbParser(suite);
+
+  std::cout.rdbuf(stdoutBuffer);
+  if (options.output.empty()) {
+    std::cout << suite.json();
+  } else {
+    std::ofstream(options.output) << suite.json();
+  }
+  return 0;
+}
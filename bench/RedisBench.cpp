@@ -0,0 +1,605 @@
+// redis-bench: end-to-end load generator for the server.
+//
+// Drives the server over many concurrent connections with a configurable
+// pipelining depth, key-space size, value-size range, GET/SET/INCR mix and
+// TTL share, then reports throughput and latency percentiles. Only loopback
+// addresses are accepted so the tool can't be pointed at someone else's box.
+
+#include "redis/LatencyHistogram.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Op { Get, Set, Incr, Count };
+
+constexpr std::array<const char *, static_cast<std::size_t>(Op::Count)>
+    kOpNames = {"GET", "SET", "INCR"};
+
+struct Options {
+  std::string host = "127.0.0.1";
+  std::string port = "6379";
+  int clients = 50;
+  int threads = 4;
+  int64_t requests = 100000;
+  int durationSeconds = 0; // overrides requests when set
+  int pipeline = 1;
+  int64_t keyspace = 100000;
+  std::size_t valueMin = 3;
+  std::size_t valueMax = 3;
+  double getRatio = 0.5;
+  double incrRatio = 0.0; // the rest of the mix is SET
+  double ttlRatio = 0.0;  // share of SETs sent with PX
+  int64_t ttlMs = 60000;
+  bool prefill = false;
+  uint64_t seed = 0;
+};
+
+void usage() {
+  std::cerr
+      << "Usage: redis-bench [options]\n"
+         "  -h <host>              Server host, loopback only (127.0.0.1)\n"
+         "  -p <port>              Server port (6379)\n"
+         "  -c <clients>           Concurrent connections (50)\n"
+         "  --threads <n>          Client threads (4)\n"
+         "  -n <requests>          Total requests (100000)\n"
+         "  -d <seconds>           Run for a fixed time instead of -n\n"
+         "  -P <depth>             Requests in flight per connection (1)\n"
+         "  -r <keys>              Key-space size (100000)\n"
+         "  -s <bytes|min:max>     Value size, fixed or uniform range (3)\n"
+         "  --get-ratio <0..1>     Share of GETs (0.5)\n"
+         "  --incr-ratio <0..1>    Share of INCRs on counter keys (0)\n"
+         "  --ttl-ratio <0..1>     Share of SETs sent with PX (0)\n"
+         "  --ttl-ms <ms>          Expiry used for TTL SETs (60000)\n"
+         "  --prefill              SET every key once before measuring\n"
+         "  --seed <n>             Random seed (0)\n";
+}
+
+bool parseArgs(const int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "-h") == 0 && hasValue) {
+      options.host = argv[++i];
+    } else if (strcmp(argv[i], "-p") == 0 && hasValue) {
+      options.port = argv[++i];
+    } else if (strcmp(argv[i], "-c") == 0 && hasValue) {
+      options.clients = std::max(1, std::atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+      options.threads = std::max(1, std::atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-n") == 0 && hasValue) {
+      options.requests = std::max<int64_t>(1, std::atoll(argv[++i]));
+    } else if (strcmp(argv[i], "-d") == 0 && hasValue) {
+      options.durationSeconds = std::max(0, std::atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-P") == 0 && hasValue) {
+      options.pipeline = std::max(1, std::atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-r") == 0 && hasValue) {
+      options.keyspace = std::max<int64_t>(1, std::atoll(argv[++i]));
+    } else if (strcmp(argv[i], "-s") == 0 && hasValue) {
+      const std::string_view spec = argv[++i];
+      const auto colon = spec.find(':');
+      options.valueMin = std::strtoull(argv[i], nullptr, 10);
+      options.valueMax = colon == std::string_view::npos
+                             ? options.valueMin
+                             : std::strtoull(argv[i] + colon + 1, nullptr, 10);
+      if (options.valueMax < options.valueMin) {
+        std::swap(options.valueMin, options.valueMax);
+      }
+    } else if (strcmp(argv[i], "--get-ratio") == 0 && hasValue) {
+      options.getRatio = std::atof(argv[++i]);
+    } else if (strcmp(argv[i], "--incr-ratio") == 0 && hasValue) {
+      options.incrRatio = std::atof(argv[++i]);
+    } else if (strcmp(argv[i], "--ttl-ratio") == 0 && hasValue) {
+      options.ttlRatio = std::atof(argv[++i]);
+    } else if (strcmp(argv[i], "--ttl-ms") == 0 && hasValue) {
+      options.ttlMs = std::max<int64_t>(1, std::atoll(argv[++i]));
+    } else if (strcmp(argv[i], "--prefill") == 0) {
+      options.prefill = true;
+    } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+      options.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      return false;
+    }
+  }
+
+  if (options.getRatio < 0 || options.incrRatio < 0 ||
+      options.getRatio + options.incrRatio > 1) {
+    std::cerr << "GET and INCR ratios must be non-negative and sum to <= 1"
+              << std::endl;
+    return false;
+  }
+  options.threads = std::min(options.threads, options.clients);
+  return true;
+}
+
+bool isLoopback(const addrinfo *info) {
+  if (info->ai_family == AF_INET) {
+    const auto *addr = reinterpret_cast<const sockaddr_in *>(info->ai_addr);
+    return (ntohl(addr->sin_addr.s_addr) >> 24) == 127;
+  }
+  if (info->ai_family == AF_INET6) {
+    const auto *addr = reinterpret_cast<const sockaddr_in6 *>(info->ai_addr);
+    return IN6_IS_ADDR_LOOPBACK(&addr->sin6_addr);
+  }
+  return false;
+}
+
+// Resolves host:port and refuses anything that isn't a loopback address.
+bool resolveLoopback(const Options &options, sockaddr_storage &target,
+                     socklen_t &targetLen) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo *results = nullptr;
+  if (const int rc = getaddrinfo(options.host.c_str(), options.port.c_str(),
+                                 &hints, &results);
+      rc != 0) {
+    std::cerr << "Cannot resolve " << options.host << ": " << gai_strerror(rc)
+              << std::endl;
+    return false;
+  }
+
+  bool found = false;
+  for (const addrinfo *info = results; info != nullptr; info = info->ai_next) {
+    if (!isLoopback(info)) {
+      std::cerr << "redis-bench only targets localhost; " << options.host
+                << " resolves to a non-loopback address" << std::endl;
+      found = false;
+      break;
+    }
+    if (!found) {
+      std::memcpy(&target, info->ai_addr, info->ai_addrlen);
+      targetLen = info->ai_addrlen;
+      found = true;
+    }
+  }
+  freeaddrinfo(results);
+  return found;
+}
+
+// Returns the byte length of the complete RESP reply starting at pos, or 0
+// if the buffer doesn't hold all of it yet.
+std::size_t replyLength(const std::string_view buffer, const std::size_t pos) {
+  if (pos >= buffer.size()) {
+    return 0;
+  }
+  const auto lineEnd = buffer.find("\r\n", pos);
+  if (lineEnd == std::string_view::npos) {
+    return 0;
+  }
+  const std::size_t headerLength = lineEnd + 2 - pos;
+
+  switch (buffer[pos]) {
+  case '$': {
+    const long long length = std::atoll(buffer.data() + pos + 1);
+    if (length < 0) {
+      return headerLength;
+    }
+    const std::size_t total = headerLength + length + 2;
+    return pos + total <= buffer.size() ? total : 0;
+  }
+  case '*': {
+    const long long count = std::atoll(buffer.data() + pos + 1);
+    std::size_t total = headerLength;
+    for (long long i = 0; i < count; i++) {
+      const std::size_t element = replyLength(buffer, pos + total);
+      if (element == 0) {
+        return 0;
+      }
+      total += element;
+    }
+    return total;
+  }
+  default: // +simple, -error, :integer
+    return headerLength;
+  }
+}
+
+void appendBulk(std::string &out, const std::string_view value) {
+  out += '$';
+  out += std::to_string(value.size());
+  out += "\r\n";
+  out += value;
+  out += "\r\n";
+}
+
+struct Connection {
+  int fd = -1;
+  std::string output;
+  std::size_t outputOffset = 0;
+  std::string input;
+  std::deque<std::pair<Op, Clock::time_point>> inFlight;
+};
+
+struct Result {
+  std::array<redis::LatencyHistogram, static_cast<std::size_t>(Op::Count)>
+      latency;
+  uint64_t errors = 0;
+  bool failed = false;
+};
+
+class Worker {
+public:
+  Worker(const Options &options, const sockaddr_storage &target,
+         const socklen_t targetLen, const int connections, const int index,
+         std::atomic<int64_t> &budget, const Clock::time_point deadline)
+      : options_(options), target_(target), targetLen_(targetLen),
+        connectionCount_(connections), budget_(budget), deadline_(deadline),
+        rng_(options.seed * 1000003 + index),
+        payload_(options.valueMax, 'x') {}
+
+  // Sequential keys for --prefill instead of the random mix.
+  void prefillFrom(const int64_t first) {
+    prefill_ = true;
+    nextPrefillKey_ = first;
+  }
+
+  void run() {
+    for (int i = 0; i < connectionCount_; i++) {
+      Connection connection;
+      if (!connect(connection)) {
+        result_.failed = true;
+        return;
+      }
+      connections_.push_back(std::move(connection));
+    }
+
+    std::vector<pollfd> fds(connections_.size());
+    while (true) {
+      bool busy = false;
+      for (auto &connection : connections_) {
+        fill(connection);
+        if (!flush(connection)) {
+          result_.failed = true;
+          return;
+        }
+        busy = busy || !connection.inFlight.empty();
+      }
+      if (!busy) {
+        break;
+      }
+
+      for (std::size_t i = 0; i < connections_.size(); i++) {
+        const auto &connection = connections_[i];
+        fds[i].fd = connection.fd;
+        fds[i].events = POLLIN;
+        if (connection.outputOffset < connection.output.size()) {
+          fds[i].events |= POLLOUT;
+        }
+        fds[i].revents = 0;
+      }
+      if (poll(fds.data(), fds.size(), 1000) < 0) {
+        continue;
+      }
+
+      for (std::size_t i = 0; i < connections_.size(); i++) {
+        if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0 &&
+            !readReplies(connections_[i])) {
+          result_.failed = true;
+          return;
+        }
+      }
+    }
+
+    for (const auto &connection : connections_) {
+      close(connection.fd);
+    }
+  }
+
+  const Result &result() const { return result_; }
+
+private:
+  const Options &options_;
+  const sockaddr_storage &target_;
+  const socklen_t targetLen_;
+  const int connectionCount_;
+  std::atomic<int64_t> &budget_;
+  const Clock::time_point deadline_;
+  std::mt19937_64 rng_;
+  const std::string payload_;
+  std::vector<Connection> connections_;
+  Result result_;
+  bool prefill_ = false;
+  int64_t nextPrefillKey_ = 0;
+
+  bool connect(Connection &connection) const {
+    connection.fd = socket(target_.ss_family, SOCK_STREAM, 0);
+    if (connection.fd < 0 ||
+        ::connect(connection.fd, reinterpret_cast<const sockaddr *>(&target_),
+                  targetLen_) < 0) {
+      std::cerr << "Failed to connect: " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    constexpr int enable = 1;
+    setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &enable,
+               sizeof(enable));
+    const int flags = fcntl(connection.fd, F_GETFL, 0);
+    fcntl(connection.fd, F_SETFL, flags | O_NONBLOCK);
+    return true;
+  }
+
+  bool takeBudget() const {
+    if (options_.durationSeconds > 0 && !prefill_) {
+      return Clock::now() < deadline_;
+    }
+    return budget_.fetch_sub(1, std::memory_order_relaxed) > 0;
+  }
+
+  void fill(Connection &connection) {
+    // Prefill isn't measured, so it always runs deeply pipelined.
+    const auto depth =
+        static_cast<std::size_t>(prefill_ ? 128 : options_.pipeline);
+    while (connection.inFlight.size() < depth && takeBudget()) {
+      const Op op = appendRequest(connection.output);
+      connection.inFlight.emplace_back(op, Clock::now());
+    }
+  }
+
+  Op appendRequest(std::string &out) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<int64_t> keys(0, options_.keyspace - 1);
+    std::uniform_int_distribution<std::size_t> sizes(options_.valueMin,
+                                                     options_.valueMax);
+
+    Op op = Op::Set;
+    int64_t key = 0;
+    if (prefill_) {
+      key = nextPrefillKey_++;
+    } else {
+      const double roll = unit(rng_);
+      if (roll < options_.getRatio) {
+        op = Op::Get;
+      } else if (roll < options_.getRatio + options_.incrRatio) {
+        op = Op::Incr;
+      }
+      key = keys(rng_);
+    }
+
+    switch (op) {
+    case Op::Get:
+      out += "*2\r\n$3\r\nGET\r\n";
+      appendBulk(out, "key:" + std::to_string(key));
+      break;
+    case Op::Incr:
+      out += "*2\r\n$4\r\nINCR\r\n";
+      appendBulk(out, "counter:" + std::to_string(key));
+      break;
+    default: {
+      const bool withTtl = !prefill_ && unit(rng_) < options_.ttlRatio;
+      out += withTtl ? "*5\r\n$3\r\nSET\r\n" : "*3\r\n$3\r\nSET\r\n";
+      appendBulk(out, "key:" + std::to_string(key));
+      appendBulk(out, std::string_view(payload_).substr(0, sizes(rng_)));
+      if (withTtl) {
+        out += "$2\r\nPX\r\n";
+        appendBulk(out, std::to_string(options_.ttlMs));
+      }
+      break;
+    }
+    }
+    return op;
+  }
+
+  static bool flush(Connection &connection) {
+    while (connection.outputOffset < connection.output.size()) {
+      const std::string_view pending =
+          std::string_view(connection.output).substr(connection.outputOffset);
+      const ssize_t sent =
+          send(connection.fd, pending.data(), pending.size(), MSG_NOSIGNAL);
+      if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return true;
+        }
+        std::cerr << "send failed: " << std::strerror(errno) << std::endl;
+        return false;
+      }
+      connection.outputOffset += static_cast<std::size_t>(sent);
+    }
+    connection.output.clear();
+    connection.outputOffset = 0;
+    return true;
+  }
+
+  bool readReplies(Connection &connection) {
+    char buffer[16384];
+    while (true) {
+      const ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+      if (received > 0) {
+        connection.input.append(buffer, static_cast<std::size_t>(received));
+        continue;
+      }
+      if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      }
+      std::cerr << "Connection closed by server" << std::endl;
+      return false;
+    }
+
+    const auto now = Clock::now();
+    std::size_t pos = 0;
+    while (!connection.inFlight.empty()) {
+      const std::size_t length = replyLength(connection.input, pos);
+      if (length == 0) {
+        break;
+      }
+      if (connection.input[pos] == '-') {
+        result_.errors++;
+      }
+      const auto [op, sentAt] = connection.inFlight.front();
+      connection.inFlight.pop_front();
+      result_.latency[static_cast<std::size_t>(op)].record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now - sentAt)
+              .count());
+      pos += length;
+    }
+    connection.input.erase(0, pos);
+    return true;
+  }
+};
+
+std::vector<std::unique_ptr<Worker>>
+startWorkers(const Options &options, const sockaddr_storage &target,
+             const socklen_t targetLen, std::atomic<int64_t> &budget,
+             const Clock::time_point deadline, const bool prefill) {
+  std::vector<std::unique_ptr<Worker>> workers;
+  const int threads = prefill ? 1 : options.threads;
+  for (int i = 0; i < threads; i++) {
+    // Spread connections as evenly as possible across threads.
+    const int connections = prefill ? 1
+                                    : options.clients / threads +
+                                          (i < options.clients % threads);
+    workers.push_back(std::make_unique<Worker>(
+        options, target, targetLen, connections, i, budget, deadline));
+    if (prefill) {
+      workers.back()->prefillFrom(0);
+    }
+  }
+  return workers;
+}
+
+bool runWorkers(const std::vector<std::unique_ptr<Worker>> &workers) {
+  std::vector<std::thread> threads;
+  for (const auto &worker : workers) {
+    threads.emplace_back([&worker] { worker->run(); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &worker : workers) {
+    if (worker->result().failed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void printLatency(const std::string_view label,
+                  const redis::LatencyHistogram &histogram) {
+  constexpr std::array<double, 6> kPercentiles = {0.5,   0.9,   0.99,
+                                                  0.999, 0.9999, 1.0};
+  std::cout << "  " << std::left << std::setw(8) << label << std::right
+            << std::setw(10) << histogram.count();
+  for (const double fraction : kPercentiles) {
+    std::cout << std::setw(10) << std::fixed << std::setprecision(1)
+              << static_cast<double>(histogram.percentile(fraction)) / 1000.0;
+  }
+  std::cout << "\n";
+}
+
+void report(const Options &options,
+            const std::vector<std::unique_ptr<Worker>> &workers,
+            const double seconds) {
+  Result total;
+  redis::LatencyHistogram all;
+  for (const auto &worker : workers) {
+    const auto &result = worker->result();
+    total.errors += result.errors;
+    for (std::size_t op = 0; op < result.latency.size(); op++) {
+      total.latency[op].merge(result.latency[op]);
+      all.merge(result.latency[op]);
+    }
+  }
+
+  const double setRatio = 1.0 - options.getRatio - options.incrRatio;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "====== redis-bench ======\n"
+            << "  " << options.clients << " connections on " << options.threads
+            << " threads, pipeline " << options.pipeline << ", keyspace "
+            << options.keyspace << ", values " << options.valueMin << "-"
+            << options.valueMax << " bytes\n"
+            << "  mix: GET " << options.getRatio * 100 << "%, SET "
+            << setRatio * 100 << "% (" << options.ttlRatio * 100
+            << "% with TTL), INCR " << options.incrRatio * 100 << "%\n\n"
+            << "  " << all.count() << " requests in " << seconds << " s, "
+            << total.errors << " errors\n"
+            << "  throughput: " << static_cast<double>(all.count()) / seconds
+            << " requests/s\n\n";
+
+  std::cout << "  latency (usec)    count       p50       p90       p99"
+               "     p99.9    p99.99       max\n";
+  for (std::size_t op = 0; op < total.latency.size(); op++) {
+    if (total.latency[op].count() > 0) {
+      printLatency(kOpNames[op], total.latency[op]);
+    }
+  }
+  printLatency("ALL", all);
+
+  // Coarse view: what share of requests finished within each bound.
+  constexpr std::array<double, 8> kBoundsMs = {0.1, 0.25, 0.5, 1,
+                                               2,   5,    10,  100};
+  std::cout << "\n  cumulative distribution\n";
+  for (const double boundMs : kBoundsMs) {
+    const auto within =
+        all.countAtOrBelow(static_cast<uint64_t>(boundMs * 1'000'000));
+    std::cout << "  <= " << std::setw(7) << std::setprecision(2) << boundMs
+              << " ms  " << std::setw(7)
+              << 100.0 * static_cast<double>(within) /
+                     static_cast<double>(std::max<uint64_t>(all.count(), 1))
+              << "%\n";
+  }
+}
+
+} // namespace
+
+int main(const int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  sockaddr_storage target{};
+  socklen_t targetLen = 0;
+  if (!resolveLoopback(options, target, targetLen)) {
+    return 1;
+  }
+
+  if (options.prefill) {
+    std::atomic<int64_t> budget = options.keyspace;
+    const auto workers = startWorkers(options, target, targetLen, budget,
+                                      Clock::time_point::max(), true);
+    if (!runWorkers(workers)) {
+      return 1;
+    }
+  }
+
+  std::atomic<int64_t> budget = options.requests;
+  const auto start = Clock::now();
+  const auto workers = startWorkers(
+      options, target, targetLen, budget,
+      start + std::chrono::seconds(options.durationSeconds), false);
+  if (!runWorkers(workers)) {
+    return 1;
+  }
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  report(options, workers, seconds);
+  return 0;
+}
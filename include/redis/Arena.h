@@ -0,0 +1,34 @@
+#ifndef REDIS_ARENA_H
+#define REDIS_ARENA_H
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+namespace redis {
+
+// Bump allocator for request-scoped temporaries, exposed as a
+// std::pmr::memory_resource. Allocations are carved out of an inline buffer
+// and only spill to the heap for unusually large requests; deallocation is a
+// no-op and reset() drops everything at once, so containers built on it must
+// not outlive the reset.
+template <std::size_t InlineBytes> class Arena {
+public:
+  Arena() : resource_(buffer_.data(), buffer_.size()) {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  std::pmr::memory_resource *resource() { return &resource_; }
+
+  // Rewinds to the start of the inline buffer, freeing any spilled blocks.
+  void reset() { resource_.release(); }
+
+private:
+  alignas(std::max_align_t) std::array<std::byte, InlineBytes> buffer_;
+  std::pmr::monotonic_buffer_resource resource_;
+};
+
+} // namespace redis
+
+#endif // REDIS_ARENA_H
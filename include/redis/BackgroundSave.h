@@ -0,0 +1,52 @@
+#ifndef REDIS_BACKGROUND_SAVE_H
+#define REDIS_BACKGROUND_SAVE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace redis {
+
+class Storage;
+
+// BGSAVE: writes the RDB file on a thread of its own from a point-in-time
+// snapshot of the keyspace (Storage::forEachInSnapshot), instead of a
+// forked child, while the event loop keeps serving writes. One save runs
+// at a time. Also keeps the outcome of the last save, foreground or not,
+// for INFO.
+class BackgroundSave {
+public:
+  BackgroundSave();
+  ~BackgroundSave();
+
+  BackgroundSave(const BackgroundSave &) = delete;
+  BackgroundSave &operator=(const BackgroundSave &) = delete;
+
+  // Starts saving storage to filepath; false if a save is in progress.
+  bool start(std::shared_ptr<Storage> storage, std::string filepath,
+             bool compression, bool checksum);
+
+  // Records the outcome of a save, as of now.
+  void finished(bool ok);
+
+  bool inProgress() const {
+    return inProgress_.load(std::memory_order_acquire);
+  }
+  bool lastOk() const { return lastOk_.load(std::memory_order_relaxed); }
+  // Unix time of the last successful save, or of startup before one.
+  int64_t lastSaveTime() const {
+    return lastSaveTime_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::thread thread_;
+  std::atomic<bool> inProgress_{false};
+  std::atomic<bool> lastOk_{true};
+  std::atomic<int64_t> lastSaveTime_;
+};
+
+} // namespace redis
+
+#endif // REDIS_BACKGROUND_SAVE_H
@@ -0,0 +1,46 @@
+#ifndef REDIS_BIG_KEYS_H
+#define REDIS_BIG_KEYS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "redis/HotKeys.h"
+
+namespace redis {
+
+class Storage;
+
+// Finds the largest keys by MEMORY USAGE without stopping the server: the
+// event loop calls step() periodically and each call walks a slice of the
+// keyspace. Results are those of the last complete pass.
+class BigKeyScanner {
+public:
+  static constexpr std::size_t kCapacity = 32;
+  // Hash buckets, so roughly keys, walked per step.
+  static constexpr std::size_t kBucketsPerStep = 1024;
+
+  explicit BigKeyScanner(bool enabled) : enabled_(enabled) {}
+
+  void step(Storage &storage);
+
+  // The largest keys with their sizes in bytes, largest first. Until the
+  // first pass completes, the keys seen so far.
+  std::vector<std::pair<std::string, uint64_t>> top(std::size_t count) const;
+
+  bool enabled() const { return enabled_; }
+  uint64_t passes() const { return passes_; }
+
+private:
+  bool enabled_;
+  TopKeys scanning_{kCapacity};
+  std::vector<std::pair<std::string, uint64_t>> last_;
+  std::size_t cursor_ = 0;
+  uint64_t passes_ = 0;
+};
+
+} // namespace redis
+
+#endif // REDIS_BIG_KEYS_H
@@ -0,0 +1,122 @@
+#ifndef REDIS_BLOOM_FILTER_H
+#define REDIS_BLOOM_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// A scalable Bloom filter, as in RedisBloom: a chain of sub-filters, each
+// added once the last one holds its capacity, with expansion times that
+// capacity and half its error rate, so the compound error rate stays below
+// twice the requested one however far the filter grows.
+//
+// Sub-filters are blocked: an item's k bits all lie in one 64-byte,
+// cache-line-aligned block, so a lookup costs one cache miss per sub-filter
+// instead of k. One 128-bit hash per item picks the block with one half and
+// derives the k bit positions within it from the other.
+class BloomFilter {
+public:
+  struct Options {
+    double errorRate = 0.01;
+    uint64_t capacity = 100;
+    unsigned expansion = 2; // 0 makes the filter non-scaling
+  };
+
+  enum class AddResult { Added, Exists, Full };
+
+  // Beyond 32 hashes, for rates under about 2^-32, extra bits per item still
+  // lower the rate, just less efficiently than more hashes would.
+  static constexpr unsigned kMaxHashes = 32;
+
+  // Bounds on what clients may ask for, so that one command cannot make the
+  // server allocate an arbitrary amount of memory. A sub-filter never holds
+  // more than kMaxCapacity items; growth past that adds more of that size.
+  static constexpr uint64_t kMaxCapacity = uint64_t{1} << 30;
+  static constexpr unsigned kMaxExpansion = 1U << 15;
+
+  // RDB files store filters as a module value (type 7) of this id: like
+  // Redis, a 9-character type name in 6 bits a character, then a 10-bit
+  // encoding version.
+  static constexpr uint64_t kRdbModuleId = [] {
+    constexpr std::string_view charset =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    uint64_t id = 0;
+    for (const char c : std::string_view("BFblocked")) {
+      id = (id << 6) | charset.find(c);
+    }
+    return (id << 10) | 1;
+  }();
+
+  struct alignas(64) Block {
+    uint64_t words[8];
+  };
+
+  struct Layer {
+    uint64_t capacity = 0;
+    uint64_t count = 0;
+    unsigned hashes = 0; // k
+    uint64_t blocks = 0;
+    std::unique_ptr<Block[]> bits;
+
+    std::string_view bytes() const {
+      return {reinterpret_cast<const char *>(bits.get()),
+              blocks * sizeof(Block)};
+    }
+  };
+
+  explicit BloomFilter(const Options &options);
+  // Rebuilds a filter from its saved layers (RDB loading).
+  BloomFilter(const Options &options, std::vector<Layer> layers);
+  // A deep copy, bits and all.
+  BloomFilter(const BloomFilter &other);
+
+  // Error rates must lie strictly between 0 and 1.
+  static bool validErrorRate(double errorRate) {
+    return errorRate > 0 && errorRate < 1;
+  }
+
+  static bool validCapacity(uint64_t capacity) {
+    return capacity > 0 && capacity <= kMaxCapacity;
+  }
+
+  // An empty sub-filter sized for capacity items at errorRate; capacity is
+  // clamped to [1, kMaxCapacity].
+  static Layer makeLayer(double errorRate, uint64_t capacity);
+
+  // Add or look up a batch of items. Every item is hashed first, and the
+  // block an item maps to in each sub-filter is prefetched a few items
+  // ahead of the one being probed. Results are appended, one per item.
+  void add(std::span<const std::string> items,
+           std::vector<AddResult> &results);
+  void contains(std::span<const std::string> items,
+                std::vector<bool> &results) const;
+
+  const Options &options() const { return options_; }
+  const std::vector<Layer> &layers() const { return layers_; }
+  uint64_t items() const;
+  uint64_t capacity() const;
+  std::size_t bytes() const;
+
+private:
+  struct Hash {
+    uint64_t block; // scaled to each sub-filter's block count
+    uint64_t bits;  // the source of the bit positions within the block
+  };
+
+  Options options_;
+  std::vector<Layer> layers_;
+
+  static Hash hash(std::string_view item);
+  bool containsHash(const Hash &hash) const;
+  void prefetch(const Hash &hash) const;
+};
+
+} // namespace redis
+
+#endif // REDIS_BLOOM_FILTER_H
@@ -0,0 +1,119 @@
+#ifndef REDIS_CLIENT_H
+#define REDIS_CLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "redis/Arena.h"
+#include "redis/Config.h"
+#include "redis/Socket.h"
+
+namespace redis {
+
+// Per-connection state. Owned by RedisServer and handed to CommandHandler so
+// that commands which span several requests (MULTI/EXEC, WATCH) can keep
+// their state between calls.
+struct Client {
+  socket_t fd;
+  uint64_t id = 0;         // assigned by ClientRegistry
+  int protocolVersion = 2; // switched to 3 by HELLO
+  std::string address;     // "ip:port" of the peer
+  std::string name;
+  std::string inputBuffer;
+  bool replica = false; // the connection sent PSYNC
+  bool asking = false;  // ASKING was sent; covers the next command only
+
+  // ServerClock::monotonicMs() at accept and at the last read, for CLIENT
+  // LIST and the idle timeout.
+  int64_t createdMs = 0;
+  int64_t lastInteractionMs = 0;
+  std::string_view lastCommand; // table name, for CLIENT LIST
+
+  // The request being executed. Kept between requests so that parsing into
+  // it reuses the argument strings' capacity instead of reallocating.
+  std::vector<std::string> argv;
+
+  // Scratch memory for request-scoped temporaries, reset once the replies
+  // of a batch of pipelined requests are queued.
+  Arena<4096> arena;
+
+  // Replies are encoded straight into outputBuffer, which keeps its capacity
+  // between requests so the common path never allocates. outputQueue holds
+  // shared chunks, such as a pub/sub message encoded once for many clients,
+  // and is written after the buffer; once anything is queued, later replies
+  // are queued behind it so the order on the wire is preserved.
+  std::string outputBuffer;
+  std::size_t outputBufferSent = 0;
+  std::deque<std::shared_ptr<const std::string>> outputQueue;
+  std::size_t outputOffset = 0; // bytes of the front chunk already written
+  std::size_t outputQueueBytes = 0;
+
+  // When the pending output went over the soft limit, 0 while under it.
+  int64_t softLimitSinceMs = 0;
+
+  // Disconnection is deferred to the end of the event-loop iteration, since
+  // the client may be referenced by the command being executed. closeAsap
+  // drops any pending output; closeAfterReply (CLIENT KILL on itself) waits
+  // until it has been written.
+  bool closeAsap = false;
+  bool closeAfterReply = false;
+
+  // Transaction state: while inMulti is set, commands are moved into
+  // queuedCommands instead of being executed.
+  bool inMulti = false;
+  bool multiError = false; // a command failed to queue; EXEC will abort
+  std::vector<std::vector<std::string>> queuedCommands;
+
+  // Keys passed to WATCH, mapped to the Storage version observed at the time.
+  std::unordered_map<std::string, uint64_t> watchedKeys;
+
+  // Pub/Sub subscriptions; the reverse index lives in PubSub.
+  std::unordered_set<std::string> channels;
+  std::unordered_set<std::string> patterns;
+
+  // CLIENT TRACKING state. In BCAST mode the client is registered under
+  // trackingPrefixes instead of having the keys it reads remembered.
+  bool tracking = false;
+  bool trackingBcast = false;
+  bool trackingNoLoop = false;
+  uint64_t trackingRedirect = 0;
+  std::vector<std::string> trackingPrefixes;
+
+  bool hasPendingOutput() const {
+    return outputBufferSent < outputBuffer.size() || !outputQueue.empty();
+  }
+
+  void queueOutput(std::shared_ptr<const std::string> chunk) {
+    outputQueueBytes += chunk->size();
+    outputQueue.push_back(std::move(chunk));
+  }
+
+  std::size_t pendingOutputBytes() const {
+    return outputBuffer.size() - outputBufferSent + outputQueueBytes -
+           outputOffset;
+  }
+
+  std::size_t subscriptionCount() const {
+    return channels.size() + patterns.size();
+  }
+
+  ClientClass clientClass() const {
+    if (replica) {
+      return ClientClass::Replica;
+    }
+    return subscriptionCount() > 0 ? ClientClass::PubSub : ClientClass::Normal;
+  }
+
+  explicit Client(const socket_t fd) : fd(fd) {}
+};
+
+} // namespace redis
+
+#endif // REDIS_CLIENT_H
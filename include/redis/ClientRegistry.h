@@ -0,0 +1,32 @@
+#ifndef REDIS_CLIENT_REGISTRY_H
+#define REDIS_CLIENT_REGISTRY_H
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace redis {
+
+struct Client;
+
+// Assigns client IDs and resolves them back to live connections, for
+// features that refer to other clients by ID (tracking redirection).
+class ClientRegistry {
+public:
+  ClientRegistry() = default;
+
+  void add(Client &client);
+  void remove(const Client &client);
+  Client *find(uint64_t id) const;
+
+  const std::unordered_map<uint64_t, Client *> &clients() const {
+    return clients_;
+  }
+
+private:
+  std::unordered_map<uint64_t, Client *> clients_;
+  uint64_t nextId_ = 1;
+};
+
+} // namespace redis
+
+#endif // REDIS_CLIENT_REGISTRY_H
@@ -0,0 +1,104 @@
+#ifndef REDIS_CLUSTER_H
+#define REDIS_CLUSTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+class Config;
+
+inline constexpr std::size_t kClusterSlots = 16384;
+
+struct ClusterNode {
+  std::string id; // 40 hex characters, as in Redis
+  std::string host;
+  int port = 0;
+};
+
+// A key and its value, serialized by RDBWriter::dumpValue, as sent by
+// MIGRATE; ttlMs is 0 for keys without one.
+struct MigrateEntry {
+  std::string key;
+  std::string value;
+  int64_t ttlMs = 0;
+};
+
+// Hash-slot sharding in the manner of Redis Cluster. Every key maps to one of
+// 16384 slots and each slot is served by one node; commands for keys this
+// node does not serve are answered with a MOVED (or, while a slot is being
+// migrated, ASK) redirect.
+//
+// There is no cluster bus: the topology is static, given at startup
+// (--cluster-slots, --cluster-node) or changed with CLUSTER ADDSLOTS, SETSLOT
+// and MEET, and every node has to be told the same thing. Node IDs are
+// derived from the announced address so that all nodes agree on them.
+class Cluster {
+public:
+  static constexpr int kNoNode = -1;
+
+  explicit Cluster(const Config &config);
+
+  // CRC16 (XMODEM) of the key, or of its hash tag: the part between the
+  // first '{' and the next '}', when that is not empty.
+  static uint16_t keySlot(std::string_view key);
+  static std::string nodeIdFor(std::string_view host, int port);
+
+  // Parses "0-5460 10923" (ranges or single slots, separated by spaces).
+  static bool parseSlots(std::string_view spec, std::vector<uint16_t> &slots);
+
+  // Nodes are addressed by index; 0 is this node.
+  const std::vector<ClusterNode> &nodes() const { return nodes_; }
+  const ClusterNode &node(const int index) const {
+    return nodes_[static_cast<std::size_t>(index)];
+  }
+  const ClusterNode &myself() const { return nodes_[0]; }
+  int findNode(std::string_view id) const;
+  // Adds the node at host:port, or returns it if already known.
+  int meet(const std::string &host, int port);
+
+  int owner(const uint16_t slot) const { return owner_[slot]; }
+  int migratingTo(const uint16_t slot) const { return migrating_[slot]; }
+  int importingFrom(const uint16_t slot) const { return importing_[slot]; }
+  bool servesSlot(const uint16_t slot) const { return owner_[slot] == 0; }
+
+  // Assigning a slot to this node completes an import; assigning it away
+  // completes a migration.
+  void assign(uint16_t slot, int node);
+  void setMigrating(uint16_t slot, int node);
+  void setImporting(uint16_t slot, int node);
+  void setStable(uint16_t slot);
+
+  std::size_t assignedSlots() const;
+  std::size_t slotsServedBy(int node) const;
+
+  // Maximal runs of consecutive slots with the same owner, in slot order.
+  struct SlotRange {
+    uint16_t first;
+    uint16_t last;
+    int node;
+  };
+  std::vector<SlotRange> slotRanges() const;
+
+  // Copies entries to host:port with RESTORE-ASKING, one pipelined request
+  // per key. Returns an empty string on success, otherwise the error to
+  // reply with; on error the target may hold some of the keys.
+  static std::string migrate(const std::string &host, int port,
+                             int64_t timeoutMs,
+                             std::span<const MigrateEntry> entries,
+                             bool replace);
+
+private:
+  std::vector<ClusterNode> nodes_;
+  std::vector<int> owner_;     // per slot
+  std::vector<int> migrating_; // per slot, target of a migration
+  std::vector<int> importing_; // per slot, source of an import
+};
+
+} // namespace redis
+
+#endif // REDIS_CLUSTER_H
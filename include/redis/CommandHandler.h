@@ -1,35 +1,171 @@
 #ifndef REDIS_COMMAND_HANDLER_H
 #define REDIS_COMMAND_HANDLER_H
 
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace redis {
 
+struct Client;
+struct CommandInfo;
+class BackgroundSave;
+class ClientRegistry;
+class Cluster;
 class Config;
+class Metrics;
+class PubSub;
 class Storage;
+class Tracking;
 
 class CommandHandler {
 public:
   CommandHandler(const std::shared_ptr<Config> &config,
-                 const std::shared_ptr<Storage> &storage);
+                 const std::shared_ptr<Storage> &storage,
+                 const std::shared_ptr<PubSub> &pubsub,
+                 const std::shared_ptr<ClientRegistry> &registry,
+                 const std::shared_ptr<Tracking> &tracking,
+                 const std::shared_ptr<Metrics> &metrics);
 
-  std::string handleCommand(const std::vector<std::string> &command) const;
+  // Executes a single request on behalf of client and appends the encoded
+  // reply to out, normally the client's output buffer. While the client is
+  // inside MULTI a copy of the command is queued instead.
+  void handleCommand(Client &client, std::span<const std::string> command,
+                     std::string &out) const;
+
+  // Releases the keys client has under WATCH; also called when the client
+  // disconnects.
+  void unwatchAll(Client &client) const;
 
 private:
   std::shared_ptr<Config> config_;
   std::shared_ptr<Storage> storage_;
+  std::shared_ptr<PubSub> pubsub_;
+  std::shared_ptr<ClientRegistry> registry_;
+  std::shared_ptr<Tracking> tracking_;
+  std::shared_ptr<Metrics> metrics_;
+  std::shared_ptr<Cluster> cluster_; // null unless cluster mode is enabled
+  std::shared_ptr<BackgroundSave> backgroundSave_;
+
+  // Dispatches on cmd, the table's lower-case name (empty when unknown);
+  // handlers receive the arguments as a view, without the command name.
+  void dispatch(Client &client, std::string_view cmd,
+                std::span<const std::string> command, std::string &out) const;
+  void trackKeys(Client &client, const CommandInfo &info,
+                 std::span<const std::string> command) const;
+  // In cluster mode, checks that this node serves the command's keys; if
+  // not, appends the redirect (or CROSSSLOT, TRYAGAIN...) error to out.
+  bool checkClusterSlot(Client &client, const CommandInfo &info,
+                        std::span<const std::string> command, bool asking,
+                        std::string &out) const;
+
+  // Hot-path handlers append their reply to out directly; the rest return
+  // it and dispatch appends it.
+  static void handlePing(const Client &client, std::string &out);
+  static void handleEcho(std::span<const std::string> args,
+                         std::string &out);
+  void handleSet(std::span<const std::string> args, std::string &out) const;
+  void handleGet(std::span<const std::string> args, std::string &out) const;
+  void handleMget(std::span<const std::string> args,
+                  std::string &out) const;
+  void handleMset(std::span<const std::string> args,
+                  std::string &out) const;
+  void handleDel(std::span<const std::string> args, std::string &out) const;
+  void handleUnlink(std::span<const std::string> args,
+                    std::string &out) const;
+  void handleExists(std::span<const std::string> args,
+                    std::string &out) const;
+  void handleIncr(std::span<const std::string> args,
+                  std::string &out) const;
+  void handleDecr(std::span<const std::string> args,
+                  std::string &out) const;
+  void handleIncrBy(std::span<const std::string> args,
+                    std::string &out) const;
+  void handleDecrBy(std::span<const std::string> args,
+                    std::string &out) const;
+  void incrementBy(const std::string &key, int64_t delta,
+                   std::string &out) const;
+  std::string handleIncrByFloat(std::span<const std::string> args) const;
+  std::string handlePfadd(std::span<const std::string> args) const;
+  std::string handlePfcount(std::span<const std::string> args) const;
+  std::string handlePfmerge(std::span<const std::string> args) const;
+  std::string handleHset(std::span<const std::string> args) const;
+  void handleHget(std::span<const std::string> args, std::string &out) const;
+  void handleHgetall(const Client &client, std::span<const std::string> args,
+                     std::string &out) const;
+  std::string handleHdel(std::span<const std::string> args) const;
+  std::string handleHlen(std::span<const std::string> args) const;
+  std::string handleSadd(std::span<const std::string> args) const;
+  std::string handleSrem(std::span<const std::string> args) const;
+  std::string handleSismember(std::span<const std::string> args) const;
+  std::string handleScard(std::span<const std::string> args) const;
+  void handleSmembers(const Client &client, std::span<const std::string> args,
+                      std::string &out) const;
+  void handleSetOperation(const Client &client, std::string_view cmd,
+                          std::span<const std::string> args,
+                          std::string &out) const;
+  std::string handleBfReserve(std::span<const std::string> args) const;
+  void handleBfAdd(std::string_view cmd, std::span<const std::string> args,
+                   std::string &out) const;
+  void handleBfExists(std::string_view cmd, std::span<const std::string> args,
+                      std::string &out) const;
+  void handleBfInfo(const Client &client, std::span<const std::string> args,
+                    std::string &out) const;
+  std::string handleType(std::span<const std::string> args) const;
+  std::string handleConfig(std::span<const std::string> args) const;
+  std::string handleFlush(const Client &client,
+                          std::span<const std::string> args) const;
+  std::string handleSave() const;
+  std::string handleBgsave() const;
+  std::string handleKeys(std::span<const std::string> args) const;
+  std::string handleInfo(std::span<const std::string> args) const;
+  std::string handleMetrics(std::span<const std::string> args) const;
+  std::string handleSlowlog(std::span<const std::string> args) const;
+  std::string handleLatency(std::span<const std::string> args) const;
+  std::string handleHotkeys(std::span<const std::string> args) const;
+  std::string handleBigkeys(std::span<const std::string> args) const;
+  std::string handleMemory(std::span<const std::string> args) const;
+  static std::string handleReplconf(std::span<const std::string> args);
+  static std::string handlePsync(std::span<const std::string> args);
+
+  static std::string handleMulti(Client &client);
+  void handleExec(Client &client, std::string &out) const;
+  std::string handleDiscard(Client &client) const;
+  std::string handleWatch(Client &client,
+                          std::span<const std::string> args) const;
+  std::string handleUnwatch(Client &client) const;
+
+  std::string handleSubscribe(Client &client,
+                              std::span<const std::string> args) const;
+  std::string handleUnsubscribe(Client &client,
+                                std::span<const std::string> args) const;
+  std::string handlePsubscribe(Client &client,
+                               std::span<const std::string> args) const;
+  std::string handlePunsubscribe(Client &client,
+                                 std::span<const std::string> args) const;
+  std::string handlePublish(std::span<const std::string> args) const;
+
+  std::string handleHello(Client &client,
+                          std::span<const std::string> args) const;
+  std::string handleClient(Client &client,
+                           std::span<const std::string> args) const;
+  std::string handleClientTracking(Client &client,
+                                   std::span<const std::string> args) const;
+  std::string handleClientList(std::span<const std::string> args) const;
+  std::string handleClientKill(Client &client,
+                               std::span<const std::string> args) const;
 
-  static std::string handlePing();
-  static std::string handleEcho(const std::vector<std::string> &args);
-  std::string handleSet(const std::vector<std::string> &args) const;
-  std::string handleGet(const std::vector<std::string> &args) const;
-  std::string handleConfig(const std::vector<std::string> &args) const;
-  std::string handleKeys(const std::vector<std::string> &args) const;
-  std::string handleInfo(const std::vector<std::string> &args) const;
-  static std::string handleReplconf(const std::vector<std::string> &args);
-  static std::string handlePsync(const std::vector<std::string> &args);
+  std::string handleCluster(std::span<const std::string> args) const;
+  std::string handleClusterSlots(std::span<const std::string> args,
+                                 bool add, bool ranges) const;
+  std::string handleClusterSetSlot(std::span<const std::string> args) const;
+  std::string handleAsking(Client &client) const;
+  std::string handleMigrate(Client &client,
+                            std::span<const std::string> args) const;
+  std::string handleRestoreAsking(std::span<const std::string> args) const;
 };
 
 } // namespace redis
@@ -0,0 +1,52 @@
+#ifndef REDIS_COMMAND_TABLE_H
+#define REDIS_COMMAND_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+enum CommandFlags : uint32_t {
+  kCmdWrite = 1 << 0,
+  kCmdReadOnly = 1 << 1,
+  kCmdAdmin = 1 << 2,
+  kCmdPubSub = 1 << 3,
+};
+
+// Static description of a command, in the spirit of Redis' command table.
+// Arity counts the command name; a negative arity means "at least -arity".
+// Keys are the arguments firstKey, firstKey + keyStep, ... lastKey, where a
+// negative lastKey counts from the end of the argument vector.
+struct CommandInfo {
+  std::string_view name;
+  int arity;
+  uint32_t flags;
+  int firstKey;
+  int lastKey;
+  int keyStep;
+  std::size_t id; // dense index, usable for per-command arrays
+};
+
+class CommandTable {
+public:
+  // Looks up a command by name, ignoring case; returns nullptr if unknown.
+  static const CommandInfo *lookup(std::string_view name);
+
+  static bool checkArity(const CommandInfo &info, std::size_t argc);
+
+  // Indices into the full argument vector (command name at 0) of every key,
+  // allocated from resource (typically the client's request arena).
+  static std::pmr::vector<std::size_t>
+  keyIndices(const CommandInfo &info, std::size_t argc,
+             std::pmr::memory_resource *resource =
+                 std::pmr::get_default_resource());
+
+  static const std::vector<CommandInfo> &all();
+};
+
+} // namespace redis
+
+#endif // REDIS_COMMAND_TABLE_H
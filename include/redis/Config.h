@@ -1,10 +1,26 @@
 #ifndef REDIS_CONFIG_H
 #define REDIS_CONFIG_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace redis {
 
+// Client classes with separate output buffer limits, as in Redis.
+enum class ClientClass : uint8_t { Normal, Replica, PubSub };
+
+// A client is disconnected once its pending output reaches hardBytes, or has
+// stayed at or above softBytes for more than softSeconds. Zero disables a
+// limit.
+struct OutputBufferLimit {
+  std::size_t hardBytes = 0;
+  std::size_t softBytes = 0;
+  int64_t softSeconds = 0;
+};
+
 class Config {
 public:
   Config();
@@ -15,16 +31,135 @@ public:
   const std::string &getDbFilename() const { return dbfilename_; }
   int getPort() const { return port_; }
 
+  // Listening sockets. An empty bind address listens on every IPv6 and IPv4
+  // interface; an empty unixSocket disables the Unix domain listener.
+  const std::string &getBindAddress() const { return bindAddress_; }
+  const std::string &getUnixSocket() const { return unixSocket_; }
+  unsigned getUnixSocketPerm() const { return unixSocketPerm_; }
+  int getTcpBacklog() const { return tcpBacklog_; }
+  bool getTcpNoDelay() const { return tcpNoDelay_; }
+  int getTcpKeepAlive() const { return tcpKeepAlive_; }
+  int getTcpRcvBuf() const { return tcpRcvBuf_; }
+
+  std::size_t getMaxClients() const { return maxClients_; }
+  int64_t getTimeout() const { return timeout_; }
+  const OutputBufferLimit &getOutputBufferLimit(ClientClass clientClass) const {
+    return outputBufferLimits_[static_cast<std::size_t>(clientClass)];
+  }
+
+  // Threads doing client I/O, counting the main thread; 1 disables threaded
+  // I/O. Reads and request parsing are offloaded only with ioThreadsDoReads.
+  std::size_t getIoThreads() const { return ioThreads_; }
+  bool getIoThreadsDoReads() const { return ioThreadsDoReads_; }
+
+  // Redis' lazyfree-* options: which deletions free large values on the
+  // background thread rather than inline.
+  bool getLazyfreeLazyExpire() const { return lazyfreeLazyExpire_; }
+  bool getLazyfreeLazyServerDel() const { return lazyfreeLazyServerDel_; }
+  bool getLazyfreeLazyUserDel() const { return lazyfreeLazyUserDel_; }
+  bool getLazyfreeLazyUserFlush() const { return lazyfreeLazyUserFlush_; }
+  std::size_t getLazyfreeThreshold() const { return lazyfreeThreshold_; }
+
+  // RDB saving: LZF-compress strings, and append a CRC64 checksum.
+  bool getRdbCompression() const { return rdbCompression_; }
+  bool getRdbChecksum() const { return rdbChecksum_; }
+
+  // Store string values of at least the threshold LZF-compressed.
+  bool getValueCompression() const { return valueCompression_; }
+  std::size_t getValueCompressionThreshold() const {
+    return valueCompressionThreshold_;
+  }
+
+  // Sparse HyperLogLogs go dense beyond this size.
+  std::size_t getHllSparseMaxBytes() const { return hllSparseMaxBytes_; }
+
+  // Hashes stay listpack-encoded up to this many fields, none of them or
+  // their values longer than the value limit.
+  std::size_t getHashMaxListpackEntries() const {
+    return hashMaxListpackEntries_;
+  }
+  std::size_t getHashMaxListpackValue() const {
+    return hashMaxListpackValue_;
+  }
+  // Sets of integers stay intsets up to this many members.
+  std::size_t getSetMaxIntsetEntries() const { return setMaxIntsetEntries_; }
+
+  // Bloom filters created by BF.ADD and BF.MADD, and BF.RESERVE without
+  // EXPANSION or NONSCALING, use these.
+  double getBfErrorRate() const { return bfErrorRate_; }
+  uint64_t getBfInitialSize() const { return bfInitialSize_; }
+  unsigned getBfExpansionFactor() const { return bfExpansionFactor_; }
+
+  // Cluster mode. The topology is static: the slots this node serves, and
+  // each peer as "host:port slots...", with slots as in CLUSTER ADDSLOTS
+  // ranges ("0-5460 5461").
+  bool getClusterEnabled() const { return clusterEnabled_; }
+  const std::string &getClusterSlots() const { return clusterSlots_; }
+  const std::vector<std::string> &getClusterNodes() const {
+    return clusterNodes_;
+  }
+  const std::string &getClusterAnnounceIp() const {
+    return clusterAnnounceIp_;
+  }
+
   bool isReplica() const { return !masterHost_.empty(); }
   const std::string &getMasterHost() const { return masterHost_; }
   int getMasterPort() const { return masterPort_; }
 
+  std::size_t getTrackingTableMaxKeys() const { return trackingTableMaxKeys_; }
+
+  int64_t getSlowlogLogSlowerThan() const { return slowlogLogSlowerThan_; }
+  std::size_t getSlowlogMaxLen() const { return slowlogMaxLen_; }
+  int64_t getLatencyMonitorThreshold() const {
+    return latencyMonitorThreshold_;
+  }
+  uint32_t getHotkeysSampleRate() const { return hotkeysSampleRate_; }
+  bool getBigkeysScan() const { return bigkeysScan_; }
+
 private:
   std::string dir_;
   std::string dbfilename_;
   int port_;
+  std::string bindAddress_;
+  std::string unixSocket_;
+  unsigned unixSocketPerm_; // 0 keeps the permissions from the umask
+  int tcpBacklog_;
+  bool tcpNoDelay_;
+  int tcpKeepAlive_; // seconds, 0 disables
+  int tcpRcvBuf_;    // bytes, 0 keeps the system default
+  std::size_t maxClients_;
+  int64_t timeout_; // seconds a client may stay idle, 0 disables
+  std::array<OutputBufferLimit, 3> outputBufferLimits_;
+  std::size_t ioThreads_;
+  bool ioThreadsDoReads_;
+  bool lazyfreeLazyExpire_;
+  bool lazyfreeLazyServerDel_; // overwrites
+  bool lazyfreeLazyUserDel_;   // DEL behaves like UNLINK
+  bool lazyfreeLazyUserFlush_; // FLUSHALL/FLUSHDB default to ASYNC
+  std::size_t lazyfreeThreshold_;
+  bool rdbCompression_;
+  bool rdbChecksum_;
+  bool valueCompression_;
+  std::size_t valueCompressionThreshold_;
+  std::size_t hllSparseMaxBytes_;
+  std::size_t hashMaxListpackEntries_;
+  std::size_t hashMaxListpackValue_;
+  std::size_t setMaxIntsetEntries_;
+  double bfErrorRate_;
+  uint64_t bfInitialSize_;
+  unsigned bfExpansionFactor_; // 0 makes new filters non-scaling
+  bool clusterEnabled_;
+  std::string clusterSlots_;
+  std::vector<std::string> clusterNodes_;
+  std::string clusterAnnounceIp_; // address given to clients in redirects
   std::string masterHost_;
   int masterPort_;
+  std::size_t trackingTableMaxKeys_;
+  int64_t slowlogLogSlowerThan_; // microseconds, negative disables
+  std::size_t slowlogMaxLen_;
+  int64_t latencyMonitorThreshold_; // milliseconds, 0 disables
+  uint32_t hotkeysSampleRate_;      // 1 in N keyed commands, 0 disables
+  bool bigkeysScan_;
 };
 
 } // namespace redis
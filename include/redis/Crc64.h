@@ -0,0 +1,16 @@
+#ifndef REDIS_CRC64_H
+#define REDIS_CRC64_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace redis {
+
+// CRC-64 with the Jones polynomial (reflected, no final xor), the checksum
+// Redis appends to RDB files. Extends crc, 0 for a fresh checksum, over
+// data; slicing-by-8 tables make it a table lookup per input byte.
+uint64_t crc64(uint64_t crc, std::string_view data);
+
+} // namespace redis
+
+#endif // REDIS_CRC64_H
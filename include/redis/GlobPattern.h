@@ -0,0 +1,40 @@
+#ifndef REDIS_GLOB_PATTERN_H
+#define REDIS_GLOB_PATTERN_H
+
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// A Redis-style glob (*, ?, [a-z], [^abc], \x) compiled once into a token
+// list so that repeated matches do not re-parse the pattern.
+class GlobPattern {
+public:
+  explicit GlobPattern(std::string_view pattern);
+
+  bool matches(std::string_view text) const;
+
+  // Characters every match must start with, up to the first wildcard.
+  const std::string &literalPrefix() const { return literalPrefix_; }
+
+private:
+  enum class TokenType { Literal, AnyChar, AnySequence, CharClass };
+
+  struct Token {
+    TokenType type;
+    std::string literal;
+    std::bitset<256> chars;
+  };
+
+  std::vector<Token> tokens_;
+  std::string literalPrefix_;
+
+  static bool consume(const Token &token, std::string_view text,
+                      std::size_t &pos);
+};
+
+} // namespace redis
+
+#endif // REDIS_GLOB_PATTERN_H
@@ -0,0 +1,98 @@
+#ifndef REDIS_HOT_KEYS_H
+#define REDIS_HOT_KEYS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace redis {
+
+// The capacity keys with the highest scores. Entries form a min-heap on the
+// score, so a candidate is compared against the weakest entry in O(1).
+class TopKeys {
+public:
+  explicit TopKeys(std::size_t capacity) : capacity_(capacity) {}
+
+  // Inserts key, or updates its score, when there is room or score beats
+  // the lowest one, which is then evicted. Scores are expected to grow: a
+  // present key offered at no more than the lowest score keeps its old one.
+  void offer(std::string_view key, uint64_t score);
+
+  // Highest score first.
+  std::vector<std::pair<std::string, uint64_t>> sorted() const;
+
+  // Halves every score, dropping the keys that reach zero.
+  void halve();
+  void clear() { heap_.clear(); }
+  bool empty() const { return heap_.empty(); }
+
+private:
+  struct Entry {
+    std::string key;
+    uint64_t score;
+  };
+
+  std::vector<Entry> heap_;
+  std::size_t capacity_;
+};
+
+// Sampling hot-key tracker. One in sampleRate keyed commands, on average,
+// has its keys counted in a count-min sketch; the keys with the highest
+// estimates are kept in a TopKeys. Counters halve every kDecayPeriodMs, so
+// the ranking follows current traffic rather than all-time totals.
+class HotKeys {
+public:
+  static constexpr std::size_t kCapacity = 32;
+  static constexpr int64_t kDecayPeriodMs = 10000;
+
+  // sampleRate 0 disables tracking.
+  explicit HotKeys(uint32_t sampleRate);
+
+  // The fast path for every keyed command: a countdown. The gap to the next
+  // sample is random, so periodic access patterns cannot hide a key.
+  bool shouldSample() {
+    if (sampleRate_ == 0 || --countdown_ > 0) {
+      return false;
+    }
+    countdown_ = nextGap();
+    return true;
+  }
+
+  void record(std::string_view key);
+
+  // Halves the counters once per decay period; called from the event loop.
+  void decay(int64_t nowMs);
+
+  // The hottest keys with their estimated accesses (samples scaled by the
+  // sample rate), hottest first.
+  std::vector<std::pair<std::string, uint64_t>> top(std::size_t count) const;
+
+  void reset();
+  uint64_t sampled() const { return sampled_; }
+  uint32_t sampleRate() const { return sampleRate_; }
+  void setSampleRate(uint32_t sampleRate);
+
+private:
+  // 4 rows of 4096 counters: 64 KiB, with an overestimate of at most
+  // e/4096 of the sampled traffic with probability 1 - e^-4.
+  static constexpr std::size_t kDepth = 4;
+  static constexpr std::size_t kWidth = 4096;
+
+  std::array<std::array<uint32_t, kWidth>, kDepth> sketch_{};
+  TopKeys top_{kCapacity};
+  uint32_t sampleRate_;
+  uint32_t countdown_ = 1;
+  uint64_t rng_ = 0x9e3779b97f4a7c15;
+  uint64_t sampled_ = 0;
+  int64_t nextDecayMs_ = 0;
+
+  uint32_t nextGap();
+};
+
+} // namespace redis
+
+#endif // REDIS_HOT_KEYS_H
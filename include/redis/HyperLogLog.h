@@ -0,0 +1,57 @@
+#ifndef REDIS_HYPER_LOG_LOG_H
+#define REDIS_HYPER_LOG_LOG_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+// HyperLogLog sketches kept in Redis' string format, so that GET, SET and
+// RDB files carry them unchanged: a 16 byte header ("HYLL", the encoding,
+// three unused bytes and the cached cardinality) followed by 2^14 registers.
+// The sparse encoding run-length codes the registers and serves small
+// cardinalities in a few hundred bytes; the dense one packs them in 6 bits
+// each, 12 KiB. Sparse sketches convert to dense as they fill up.
+class HyperLogLog {
+public:
+  static constexpr int kPrecision = 14;
+  static constexpr std::size_t kRegisters = std::size_t{1} << kPrecision;
+  static constexpr std::size_t kHeaderSize = 16;
+  static constexpr std::size_t kDenseSize = kHeaderSize + kRegisters * 6 / 8;
+
+  // One byte per register, the form sketches are merged and counted in.
+  using Registers = std::array<uint8_t, kRegisters>;
+
+  // An empty sparse sketch.
+  static std::string create();
+
+  // Whether str has the header and size of a sketch.
+  static bool isValid(std::string_view str);
+
+  // Adds element to hll, setting changed if a register grew. A sparse sketch
+  // goes dense once it outgrows sparseMaxBytes or needs a register value the
+  // sparse encoding cannot hold. Returns false if hll is corrupt.
+  static bool add(std::string &hll, std::string_view element,
+                  std::size_t sparseMaxBytes, bool &changed);
+
+  // The estimated cardinality. It is cached in the header until the next
+  // change, so counting an unchanged sketch again is a header read. Returns
+  // false if hll is corrupt.
+  static bool count(std::string &hll, uint64_t &result);
+
+  // Raises every register to at least its value in hll, 16 at a time with
+  // SSE2 for dense sketches. Returns false if hll is corrupt.
+  static bool mergeInto(std::string_view hll, Registers &registers);
+
+  static uint64_t estimate(const Registers &registers);
+
+  // A dense sketch holding registers.
+  static std::string fromRegisters(const Registers &registers);
+};
+
+} // namespace redis
+
+#endif // REDIS_HYPER_LOG_LOG_H
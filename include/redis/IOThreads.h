@@ -0,0 +1,65 @@
+#ifndef REDIS_IO_THREADS_H
+#define REDIS_IO_THREADS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace redis {
+
+// Pool for Redis-6-style threaded I/O. The event loop hands it one phase at
+// a time (reading and parsing requests, or writing replies, for a batch of
+// clients) and waits until the phase is complete, so I/O threads never run
+// concurrently with command execution and the keyspace stays
+// single-threaded. The calling thread takes part as one of the threads.
+class IOThreads {
+public:
+  // threads counts the calling thread, so IOThreads(4) starts three.
+  explicit IOThreads(std::size_t threads);
+  ~IOThreads();
+
+  IOThreads(const IOThreads &) = delete;
+  IOThreads &operator=(const IOThreads &) = delete;
+
+  std::size_t size() const { return workers_.size() + 1; }
+
+  // Calls job(i) for every i in [0, count), spread over the pool, and
+  // returns once all calls have completed. Each index is run exactly once.
+  template <typename Fn> void parallelFor(std::size_t count, Fn &&job) {
+    run(count, &job, [](const void *context, const std::size_t i) {
+      (*static_cast<const std::remove_reference_t<Fn> *>(context))(i);
+    });
+  }
+
+private:
+  using Trampoline = void (*)(const void *context, std::size_t i);
+
+  void run(std::size_t count, const void *context, Trampoline trampoline);
+  void workerLoop();
+  void runJobs();
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  uint64_t generation_ = 0; // bumped for every phase
+  std::size_t busy_ = 0;    // workers still inside the current phase
+  bool stopping_ = false;
+
+  // The current phase. Indices are claimed one at a time from next_, which
+  // balances clients with very different amounts of I/O.
+  const void *context_ = nullptr;
+  Trampoline trampoline_ = nullptr;
+  std::size_t count_ = 0;
+  std::atomic<std::size_t> next_{0};
+};
+
+} // namespace redis
+
+#endif // REDIS_IO_THREADS_H
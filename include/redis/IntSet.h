@@ -0,0 +1,47 @@
+#ifndef REDIS_INT_SET_H
+#define REDIS_INT_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// Sets of integers as a sorted array in one buffer, every member packed at
+// the narrowest width (2, 4 or 8 bytes) that holds all of them. Adding a
+// member that needs a wider encoding widens the whole array once; widths
+// never shrink. Membership is a binary search, and sorted arrays intersect
+// with a linear merge instead of a lookup per member.
+class IntSet {
+public:
+  // The width in bytes of the narrowest encoding that holds value.
+  static int widthFor(int64_t value);
+
+  static std::size_t size(std::string_view is, int width) {
+    return is.size() / static_cast<std::size_t>(width);
+  }
+  static int64_t get(std::string_view is, int width, std::size_t index);
+  static bool contains(std::string_view is, int width, int64_t value);
+
+  // Inserts value, widening the set first if needed. Returns whether it was
+  // added.
+  static bool add(std::string &is, int &width, int64_t value);
+  static bool remove(std::string &is, int width, int64_t value);
+
+  // Appends every member, in ascending order.
+  static void decode(std::string_view is, int width,
+                     std::vector<int64_t> &out);
+
+  // Keeps the members of sorted, a strictly ascending array, that are also
+  // members of is. When is is far larger, each member is found by galloping
+  // through it; otherwise the two are merged a vector of is at a time with
+  // SSE2 or NEON.
+  static void intersect(std::vector<int64_t> &sorted, std::string_view is,
+                        int width);
+};
+
+} // namespace redis
+
+#endif // REDIS_INT_SET_H
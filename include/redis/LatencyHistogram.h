@@ -0,0 +1,73 @@
+#ifndef REDIS_LATENCY_HISTOGRAM_H
+#define REDIS_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+
+// HDR-style histogram of nanosecond durations. Values are grouped by power of
+// two and each power is split into 16 linear sub-buckets, which bounds the
+// relative error of any reported percentile to about 6% while recording stays
+// a handful of integer instructions.
+class LatencyHistogram {
+public:
+  static constexpr int kSubBucketBits = 4;
+  static constexpr std::size_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kMaxExponent = 40; // ~18 minutes in nanoseconds
+  static constexpr std::size_t kBuckets =
+      (kMaxExponent - kSubBucketBits + 1) * kSubBuckets + kSubBuckets;
+
+  void record(uint64_t nanos) {
+    counts_[bucketFor(nanos)]++;
+    total_++;
+  }
+
+  uint64_t count() const { return total_; }
+
+  // Returns an upper bound (in nanoseconds) below which the given fraction
+  // of samples fall; 0 if nothing was recorded.
+  uint64_t percentile(double fraction) const;
+
+  // Cumulative count of samples at or below nanos.
+  uint64_t countAtOrBelow(uint64_t nanos) const;
+
+  void merge(const LatencyHistogram &other) {
+    for (std::size_t i = 0; i < kBuckets; i++) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+  }
+
+  void reset() {
+    counts_.fill(0);
+    total_ = 0;
+  }
+
+private:
+  std::array<uint64_t, kBuckets> counts_{};
+  uint64_t total_ = 0;
+
+  static std::size_t bucketFor(uint64_t nanos) {
+    if (nanos < kSubBuckets) {
+      return static_cast<std::size_t>(nanos);
+    }
+    int exponent = std::bit_width(nanos) - 1;
+    if (exponent > kMaxExponent) {
+      exponent = kMaxExponent;
+      nanos = (uint64_t{1} << (kMaxExponent + 1)) - 1;
+    }
+    const auto sub = (nanos >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return static_cast<std::size_t>(exponent - kSubBucketBits + 1) *
+               kSubBuckets +
+           static_cast<std::size_t>(sub);
+  }
+
+  static uint64_t bucketUpperBound(std::size_t bucket);
+};
+
+} // namespace redis
+
+#endif // REDIS_LATENCY_HISTOGRAM_H
@@ -0,0 +1,67 @@
+#ifndef REDIS_LATENCY_MONITOR_H
+#define REDIS_LATENCY_MONITOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace redis {
+
+// Classes of latency spikes, reported under their Redis event names. Only
+// work this server does has a class: there is no active expire cycle,
+// eviction, fork or fsync here.
+enum class LatencyEvent {
+  Command,
+  EventLoop,
+  RdbLoad,
+  Count,
+};
+
+// LATENCY monitor: keeps, per event class, the last kSamples spikes that
+// reached the threshold (milliseconds). All storage is fixed-size, so
+// recording never allocates.
+class LatencyMonitor {
+public:
+  static constexpr std::size_t kSamples = 160;
+
+  struct Sample {
+    int64_t time = 0; // unix time, seconds
+    uint32_t latencyMs = 0;
+  };
+
+  struct Series {
+    std::array<Sample, kSamples> samples{};
+    std::size_t next = 0;
+    uint32_t maxMs = 0;
+
+    bool empty() const { return samples[latestIndex()].time == 0; }
+    std::size_t latestIndex() const { return (next + kSamples - 1) % kSamples; }
+  };
+
+  explicit LatencyMonitor(int64_t thresholdMs);
+
+  // Cheap enough to call unconditionally: returns before touching the clock
+  // unless the monitor is enabled and the duration reaches the threshold.
+  void record(LatencyEvent event, uint64_t durationMs);
+
+  const Series &series(LatencyEvent event) const {
+    return series_[static_cast<std::size_t>(event)];
+  }
+  void reset(LatencyEvent event);
+
+  int64_t thresholdMs() const { return thresholdMs_; }
+  void setThresholdMs(const int64_t ms) { thresholdMs_ = ms; }
+
+  static std::string_view eventName(LatencyEvent event);
+  static std::optional<LatencyEvent> eventByName(std::string_view name);
+
+private:
+  std::array<Series, static_cast<std::size_t>(LatencyEvent::Count)> series_;
+  int64_t thresholdMs_;
+};
+
+} // namespace redis
+
+#endif // REDIS_LATENCY_MONITOR_H
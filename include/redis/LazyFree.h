@@ -0,0 +1,61 @@
+#ifndef REDIS_LAZY_FREE_H
+#define REDIS_LAZY_FREE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace redis {
+
+// Background destruction of large values and whole keyspaces (UNLINK,
+// FLUSHALL ASYNC and the lazyfree-* options), so that releasing their memory
+// does not stall the event loop. Objects are handed over through a lock-free
+// stack that the free thread empties in one exchange; the thread sleeps on
+// the pending counter while there is nothing to do.
+class LazyFree {
+public:
+  LazyFree();
+  ~LazyFree();
+
+  LazyFree(const LazyFree &) = delete;
+  LazyFree &operator=(const LazyFree &) = delete;
+
+  // Takes ownership of object and destroys it on the free thread.
+  template <typename T> void free(T &&object) {
+    push(new Holder<std::decay_t<T>>(std::forward<T>(object)));
+  }
+
+  // Objects handed over and not destroyed yet, and destroyed so far.
+  std::size_t pending() const {
+    return pending_.load(std::memory_order_relaxed);
+  }
+  uint64_t freed() const { return freed_.load(std::memory_order_relaxed); }
+
+private:
+  struct Job {
+    virtual ~Job() = default;
+    Job *next = nullptr;
+  };
+
+  template <typename T> struct Holder final : Job {
+    explicit Holder(T &&object) : object(std::move(object)) {}
+    explicit Holder(const T &object) : object(object) {}
+    T object;
+  };
+
+  void push(Job *job);
+  void run();
+
+  std::atomic<Job *> head_{nullptr};
+  std::atomic<std::size_t> pending_{0};
+  std::atomic<uint64_t> freed_{0};
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
+} // namespace redis
+
+#endif // REDIS_LAZY_FREE_H
@@ -0,0 +1,64 @@
+#ifndef REDIS_LISTPACK_H
+#define REDIS_LISTPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+// A sequence of strings packed into one buffer, each as its length (LEB128)
+// followed by its bytes. Small hashes keep their fields and values in one,
+// alternating, so they cost a single allocation with no per-entry pointers
+// or headers, and a lookup is a linear scan of contiguous memory. Unlike
+// Redis' listpack there is no backward length: elements are only walked
+// front to back.
+class Listpack {
+public:
+  // Calls fn(element) for every element in order; fn returns false to stop.
+  template <typename Fn> static void forEach(std::string_view lp, Fn &&fn) {
+    std::size_t pos = 0;
+    while (pos < lp.size()) {
+      const std::size_t length = readLength(lp, pos);
+      if (!fn(lp.substr(pos, length))) {
+        return;
+      }
+      pos += length;
+    }
+  }
+
+  static void append(std::string &lp, std::string_view element);
+
+  // Field/value pair operations. find returns the value stored after field,
+  // set replaces it or appends the pair and returns whether it was added,
+  // and erase returns whether the pair was present.
+  static std::optional<std::string_view> find(std::string_view lp,
+                                              std::string_view field);
+  static bool set(std::string &lp, std::string_view field,
+                  std::string_view value);
+  static bool erase(std::string &lp, std::string_view field);
+
+private:
+  static std::size_t readLength(std::string_view lp, std::size_t &pos) {
+    std::size_t length = 0;
+    for (int shift = 0; pos < lp.size(); shift += 7) {
+      const auto byte = static_cast<uint8_t>(lp[pos++]);
+      length |= static_cast<std::size_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    return length;
+  }
+
+  // Offset of the pair whose field equals field, or npos.
+  static std::size_t findPair(std::string_view lp, std::string_view field);
+  // Offset just past the element starting at pos.
+  static std::size_t skip(std::string_view lp, std::size_t pos);
+};
+
+} // namespace redis
+
+#endif // REDIS_LISTPACK_H
@@ -0,0 +1,23 @@
+#ifndef REDIS_LZF_H
+#define REDIS_LZF_H
+
+#include <cstddef>
+#include <string_view>
+
+namespace redis {
+
+// LZF, the byte-oriented LZ77 codec Redis uses for strings in RDB files:
+// fast to compress, faster to decompress, and format-compatible with liblzf.
+
+// Compresses input into out and returns the compressed size, or 0 if the
+// result would not fit in outLength bytes.
+std::size_t lzfCompress(std::string_view input, char *out,
+                        std::size_t outLength);
+
+// Decompresses input into out; fails unless it decodes to exactly outLength
+// bytes.
+bool lzfDecompress(std::string_view input, char *out, std::size_t outLength);
+
+} // namespace redis
+
+#endif // REDIS_LZF_H
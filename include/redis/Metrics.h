@@ -0,0 +1,101 @@
+#ifndef REDIS_METRICS_H
+#define REDIS_METRICS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "redis/BigKeys.h"
+#include "redis/HotKeys.h"
+#include "redis/LatencyHistogram.h"
+#include "redis/LatencyMonitor.h"
+#include "redis/SlowLog.h"
+
+namespace redis {
+
+class Config;
+
+struct CommandStats {
+  uint64_t calls = 0;
+  uint64_t nanos = 0;
+  uint64_t rejectedCalls = 0;
+  uint64_t failedCalls = 0;
+  LatencyHistogram latency;
+};
+
+// Server-wide counters behind INFO stats/commandstats/latencystats and the
+// Prometheus dump. Per-command stats are indexed by CommandInfo::id, so
+// recording a call is an array access plus a histogram increment. Also owns
+// the SLOWLOG, the LATENCY monitor and the hot-key and big-key trackers.
+class Metrics {
+public:
+  explicit Metrics(const Config &config);
+
+  void recordCommand(std::size_t commandId,
+                     std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end, bool failed);
+  void recordRejected(std::size_t commandId);
+  void recordConnection() {
+    totalConnections_++;
+    connectedClients_++;
+  }
+  void recordDisconnection() { connectedClients_--; }
+  void recordRejectedConnection() { rejectedConnections_++; }
+  void recordInputBytes(std::size_t bytes) { netInputBytes_ += bytes; }
+  void recordOutputBytes(std::size_t bytes) { netOutputBytes_ += bytes; }
+  void recordThreadedReads(std::size_t clients) { threadedReads_ += clients; }
+  void recordThreadedWrites(std::size_t clients) {
+    threadedWrites_ += clients;
+  }
+
+  void resetStats();
+
+  std::string statsInfo();
+  std::string commandStatsInfo() const;
+  std::string latencyStatsInfo() const;
+  std::string hotKeysInfo() const;
+  std::string prometheus();
+
+  SlowLog &slowLog() { return slowLog_; }
+  LatencyMonitor &latencyMonitor() { return latencyMonitor_; }
+  HotKeys &hotKeys() { return hotKeys_; }
+  BigKeyScanner &bigKeys() { return bigKeys_; }
+
+  int64_t uptimeSeconds() const;
+  uint64_t connectedClients() const { return connectedClients_; }
+
+private:
+  // Operations per second are averaged over the last kOpsSamples samples,
+  // each taken at least 100ms apart, like Redis' instantaneous metrics.
+  static constexpr std::size_t kOpsSamples = 16;
+
+  std::chrono::steady_clock::time_point startTime_;
+  std::vector<CommandStats> commands_;
+  SlowLog slowLog_;
+  LatencyMonitor latencyMonitor_;
+  HotKeys hotKeys_;
+  BigKeyScanner bigKeys_;
+  uint64_t totalCommands_ = 0;
+  uint64_t totalConnections_ = 0;
+  uint64_t connectedClients_ = 0;
+  uint64_t rejectedConnections_ = 0;
+  uint64_t netInputBytes_ = 0;
+  uint64_t netOutputBytes_ = 0;
+  uint64_t threadedReads_ = 0;
+  uint64_t threadedWrites_ = 0;
+
+  std::array<double, kOpsSamples> opsSamples_{};
+  std::size_t opsSampleIndex_ = 0;
+  std::chrono::steady_clock::time_point lastSampleTime_;
+  uint64_t lastSampleCommands_ = 0;
+
+  void sampleOps(std::chrono::steady_clock::time_point now);
+  double instantaneousOps() const;
+};
+
+} // namespace redis
+
+#endif // REDIS_METRICS_H
@@ -0,0 +1,58 @@
+#ifndef REDIS_PUBSUB_H
+#define REDIS_PUBSUB_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "redis/GlobPattern.h"
+
+namespace redis {
+
+struct Client;
+
+// Channel and pattern subscriptions. Published messages are encoded once and
+// the same reference-counted frame is queued on every receiving client.
+class PubSub {
+public:
+  PubSub() = default;
+
+  // Each call returns false if the client was already (un)subscribed.
+  bool subscribe(Client &client, const std::string &channel);
+  bool unsubscribe(Client &client, const std::string &channel);
+  bool psubscribe(Client &client, const std::string &pattern);
+  bool punsubscribe(Client &client, const std::string &pattern);
+  void unsubscribeAll(Client &client);
+
+  // Returns the number of clients the message was delivered to.
+  std::size_t publish(const std::string &channel, const std::string &message);
+
+  std::size_t numPatterns() const { return patterns_.size(); }
+
+private:
+  struct PatternSubscription {
+    std::string pattern;
+    GlobPattern glob;
+    std::vector<Client *> subscribers;
+  };
+
+  // Patterns are indexed in a trie by their literal prefix, so a publish only
+  // evaluates the patterns whose prefix matches the start of the channel.
+  struct PatternNode {
+    std::unordered_map<char, std::unique_ptr<PatternNode>> children;
+    std::vector<PatternSubscription *> patterns;
+  };
+
+  std::unordered_map<std::string, std::vector<Client *>> channels_;
+  std::unordered_map<std::string, std::unique_ptr<PatternSubscription>>
+      patterns_;
+  PatternNode patternRoot_;
+
+  void removePatternFromTrie(const PatternSubscription *subscription);
+};
+
+} // namespace redis
+
+#endif // REDIS_PUBSUB_H
@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace redis {
 
@@ -13,26 +15,67 @@ class RDBParser {
 public:
   RDBParser() = default;
 
+  // Loads the snapshot at filepath into storage. The CRC64 trailer, when the
+  // file has one, is checked as the file streams in; on a mismatch nothing
+  // loaded from the file is kept.
   bool parseFile(const std::string &filepath, Storage &storage);
 
+  // Checks the version and checksum footer of a RDBWriter::dumpValue
+  // payload.
+  static bool verifyDump(std::string_view payload);
+
+  // Stores a value serialized by RDBWriter::dumpValue under key, expiring
+  // in ttlMs, or never if it is 0. The key must not exist. Returns false,
+  // storing nothing, on a bad checksum, an unknown version or type, or
+  // data that does not decode.
+  bool restoreValue(std::string_view payload, const std::string &key,
+                    int64_t ttlMs, Storage &storage);
+
 private:
   std::ifstream file_;
+  int version_ = 0;
+
+  // The file is read in large chunks. The checksum covers every byte up to
+  // the EOF opcode and is folded in a chunk at a time: bytes before
+  // checksumFrom_ are already in checksum_.
+  std::vector<char> buffer_;
+  std::size_t pos_ = 0;
+  std::size_t end_ = 0;
+  std::size_t checksumFrom_ = 0;
+  uint64_t checksum_ = 0;
+  bool corrupt_ = false; // a short read or undecodable data
+  uint64_t fileSize_ = 0;
 
   bool readHeader();
   bool skipMetadata();
   bool readDatabase(Storage &storage);
+  // Reads the value of key, of the given RDB type, and stores it unless it
+  // has expired. Returns false on an unsupported type or a key that cannot
+  // be stored; a short read sets corrupt_.
+  bool readValue(Storage &storage, uint8_t type, const std::string &key,
+                 bool hasExpiry, uint64_t expiryTime);
+  // Reads a set (type 2) or hash (type 4).
+  bool readAggregate(Storage &storage, const std::string &key, uint8_t type,
+                     bool hasExpiry, uint64_t expiryTime);
+  // Reads a module value (type 7); only bloom filters are supported.
+  bool readBloom(Storage &storage, const std::string &key, bool hasExpiry,
+                 uint64_t expiryTime);
+  bool verifyChecksum();
 
+  bool fill();
+  void foldChecksum();
+  uint8_t peekByte();
   uint8_t readByte();
+  void readBytes(char *out, std::size_t count);
   uint32_t readUInt32LE();
   uint64_t readUInt64LE();
 
   uint64_t readLength();
   std::string readString();
 
-  bool skipBytes(size_t count);
   bool isEOF();
 };
 
 } // namespace redis
 
-#endif // REDIS_RDB_PARSER_H
\ No newline at end of file
+#endif // REDIS_RDB_PARSER_H
@@ -0,0 +1,65 @@
+#ifndef REDIS_RDB_WRITER_H
+#define REDIS_RDB_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+class BloomFilter;
+class Storage;
+struct ValueWithExpiry;
+
+// Writes the keyspace as an RDB file that RDBParser, and Redis, can load.
+class RDBWriter {
+public:
+  // The RDB version written, in the file header and in dumped values.
+  static constexpr uint16_t kRdbVersion = 11;
+
+  // compression: LZF-compress strings longer than 20 bytes when it helps,
+  // as Redis' rdbcompression does. checksum: append the CRC64 of the file,
+  // or zero to have loaders skip verification (rdbchecksum).
+  RDBWriter(bool compression, bool checksum);
+
+  // Writes to a temporary file in the same directory and renames it over
+  // filepath, so a failed save never destroys the previous snapshot. The
+  // keyspace is read through Storage::forEachInSnapshot, so other threads
+  // may keep writing while this runs; fails if another walk is under way.
+  bool writeFile(const std::string &filepath, Storage &storage);
+
+  // Serializes one value as Redis' DUMP does: its RDB type byte and
+  // encoding, then the RDB version (2 bytes) and a CRC64 of everything
+  // before it (8 bytes), both little-endian. RDBParser::restoreValue reads
+  // it back; MIGRATE uses it to move keys of any type.
+  std::string dumpValue(const ValueWithExpiry &entry);
+
+private:
+  bool compression_;
+  bool checksum_;
+
+  std::ofstream file_;
+  std::string buffer_;
+  std::string scratch_; // compression output
+  uint64_t crc_ = 0;
+
+  // expiryUnixMs is negative for keys without a TTL.
+  void writeEntry(const std::string &key, const ValueWithExpiry &entry,
+                  int64_t expiryUnixMs);
+  // The value of an entry after its type byte and key.
+  void writeValue(const ValueWithExpiry &entry);
+  void writeBloom(const BloomFilter &filter);
+  void writeByte(uint8_t byte);
+  void writeBytes(std::string_view bytes);
+  void writeLength(uint64_t length);
+  void writeString(std::string_view str);
+  bool writeIntegerString(std::string_view str);
+  void writeCompressedString(std::string_view compressed,
+                             std::size_t rawLength);
+  void flush();
+};
+
+} // namespace redis
+
+#endif // REDIS_RDB_WRITER_H
@@ -1,20 +1,45 @@
 #ifndef REDIS_RESP_PARSER_H
 #define REDIS_RESP_PARSER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace redis {
 
+enum class ParseResult { Ok, Incomplete, Error };
+
 class RESPParser {
 public:
+  // Parses one request (a RESP array of bulk strings, or an inline command)
+  // starting at pos. On Ok, pos is advanced past the request so that several
+  // pipelined requests can be consumed from one buffer. The strings already
+  // in command are overwritten in place so their capacity is reused.
+  static ParseResult parseCommand(std::string_view data, std::size_t &pos,
+                                  std::vector<std::string> &command);
   static std::vector<std::string> parseArray(const std::string &data);
   static std::string parseSimpleString(const std::string &data);
-  static std::string encodeSimpleString(const std::string &str);
-  static std::string encodeBulkString(const std::string &str);
+  static std::string encodeSimpleString(std::string_view str);
+  static std::string encodeBulkString(std::string_view str);
   static std::string encodeArray(const std::vector<std::string> &items);
-  static std::string encodeError(const std::string &error);
+  static std::string encodeError(std::string_view error);
+  static std::string encodeInteger(int64_t value);
   static std::string encodeNull();
+  static std::string encodeNullArray();
+
+  // Append-style encoders that write straight into out, normally a client's
+  // output buffer, without building a temporary string per reply. Headers
+  // for small lengths are preencoded; larger ones are formatted from a
+  // two-digit lookup table.
+  static void appendSimpleString(std::string &out, std::string_view str);
+  static void appendBulkString(std::string &out, std::string_view str);
+  static void appendArrayHeader(std::string &out, std::size_t count);
+  static void appendArray(std::string &out,
+                          const std::vector<std::string> &items);
+  static void appendError(std::string &out, std::string_view error);
+  static void appendInteger(std::string &out, int64_t value);
 };
 
 } // namespace redis
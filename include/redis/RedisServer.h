@@ -1,40 +1,27 @@
 #ifndef REDIS_SERVER_H
 #define REDIS_SERVER_H
 
+#include <cstdint>
+#include <map>
 #include <memory>
-#include <set>
+#include <vector>
 
-#ifdef _WIN32
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#else
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <sys/select.h>
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <unistd.h>
-#endif
+#include "redis/Socket.h"
+#include "redis/TimerWheel.h"
 
 namespace redis {
 
-#ifdef _WIN32
-using socket_t = SOCKET;
-#define INVALID_SOCKET_VAL INVALID_SOCKET
-#define SOCKET_ERROR_VAL SOCKET_ERROR
-#else
-using socket_t = int;
-#define INVALID_SOCKET_VAL -1
-#define SOCKET_ERROR_VAL -1
-#endif
-
+struct Client;
+struct ReadResult;
+class ClientRegistry;
 class Config;
+class Metrics;
+class PubSub;
 class Storage;
 class CommandHandler;
+class IOThreads;
 class RDBParser;
+class Tracking;
 
 class RedisServer {
 public:
@@ -47,16 +34,33 @@ private:
   bool loadRDBFile() const;
   std::shared_ptr<Config> config_;
   std::shared_ptr<Storage> storage_;
+  std::shared_ptr<PubSub> pubsub_;
+  std::shared_ptr<ClientRegistry> registry_;
+  std::shared_ptr<Tracking> tracking_;
+  std::shared_ptr<Metrics> metrics_;
   std::shared_ptr<CommandHandler> commandHandler_;
 
   socket_t serverFd_;
-  std::set<socket_t> clientFds_;
+  socket_t unixFd_;
+  std::map<socket_t, std::unique_ptr<Client>> clients_;
   socket_t masterFd_;
+  TimerWheel idleTimers_; // keyed by client ID
+  std::unique_ptr<IOThreads> ioThreads_; // null unless io-threads > 1
+  int64_t nextKeyspaceCronMs_ = 0;
 
   bool createServerSocket();
+  bool createUnixSocket();
   bool connectToMaster();
-  void handleNewConnection();
-  void handleClientData(socket_t clientFd);
+  void acceptConnections(socket_t listenFd);
+  void rejectConnection(socket_t clientFd);
+  void closeIdleClients();
+  void keyspaceCron();
+  bool outputLimitReached(Client &client) const;
+  bool useIoThreads(std::size_t clients) const;
+  void handleReadyClients(const std::vector<Client *> &clients);
+  void processInput(Client &client, const ReadResult &read);
+  void writeToClients(const std::vector<Client *> &clients);
+  bool flushOutput(Client &client);
   void closeClient(socket_t clientFd);
 };
 
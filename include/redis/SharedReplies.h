@@ -0,0 +1,33 @@
+#ifndef REDIS_SHARED_REPLIES_H
+#define REDIS_SHARED_REPLIES_H
+
+#include <string_view>
+
+// Preencoded replies that are sent often enough to be worth never building:
+// handlers append these to the output buffer as they are.
+namespace redis::shared {
+
+inline constexpr std::string_view kOk = "+OK\r\n";
+inline constexpr std::string_view kPong = "+PONG\r\n";
+inline constexpr std::string_view kQueued = "+QUEUED\r\n";
+inline constexpr std::string_view kNullBulk = "$-1\r\n";
+inline constexpr std::string_view kNullArray = "*-1\r\n";
+inline constexpr std::string_view kNull = "_\r\n"; // RESP3
+inline constexpr std::string_view kEmptyArray = "*0\r\n";
+inline constexpr std::string_view kZero = ":0\r\n";
+inline constexpr std::string_view kOne = ":1\r\n";
+
+inline constexpr std::string_view kSyntaxError = "-ERR syntax error\r\n";
+inline constexpr std::string_view kNotInteger =
+    "-ERR value is not an integer or out of range\r\n";
+inline constexpr std::string_view kIncrOverflow =
+    "-ERR increment or decrement would overflow\r\n";
+inline constexpr std::string_view kInvalidExpire =
+    "-ERR invalid expire time in 'set' command\r\n";
+inline constexpr std::string_view kProtocolError = "-ERR Protocol error\r\n";
+inline constexpr std::string_view kWrongType =
+    "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n";
+
+} // namespace redis::shared
+
+#endif // REDIS_SHARED_REPLIES_H
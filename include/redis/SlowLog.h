@@ -0,0 +1,61 @@
+#ifndef REDIS_SLOW_LOG_H
+#define REDIS_SLOW_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace redis {
+
+struct SlowLogEntry {
+  uint64_t id = 0;
+  int64_t timestamp = 0; // unix time, seconds
+  uint64_t durationUsec = 0;
+  std::vector<std::string> args;
+  std::string clientAddress;
+  std::string clientName;
+};
+
+// Ring buffer of commands that ran for at least slowerThanUsec. Slots are
+// overwritten in place, so once the ring has wrapped, logging an entry reuses
+// the buffers of the one it replaces instead of allocating.
+class SlowLog {
+public:
+  // Arguments beyond these limits are summarised, as in Redis.
+  static constexpr std::size_t kMaxArgs = 32;
+  static constexpr std::size_t kMaxArgLength = 128;
+
+  SlowLog(int64_t slowerThanUsec, std::size_t maxLen);
+
+  // The fast path for every command: a single comparison.
+  bool shouldLog(const uint64_t durationUsec) const {
+    return slowerThanUsec_ >= 0 &&
+           durationUsec >= static_cast<uint64_t>(slowerThanUsec_);
+  }
+
+  void record(std::span<const std::string> command, uint64_t durationUsec,
+              const std::string &clientAddress, const std::string &clientName);
+
+  // Most recent first; count < 0 returns every entry.
+  std::vector<const SlowLogEntry *> latest(int64_t count) const;
+  std::size_t size() const { return size_; }
+  void reset();
+
+  int64_t slowerThanUsec() const { return slowerThanUsec_; }
+  void setSlowerThanUsec(const int64_t usec) { slowerThanUsec_ = usec; }
+  std::size_t maxLen() const { return ring_.size(); }
+  void setMaxLen(std::size_t maxLen);
+
+private:
+  std::vector<SlowLogEntry> ring_;
+  std::size_t next_ = 0; // slot the next entry is written to
+  std::size_t size_ = 0;
+  uint64_t nextId_ = 0;
+  int64_t slowerThanUsec_;
+};
+
+} // namespace redis
+
+#endif // REDIS_SLOW_LOG_H
@@ -0,0 +1,38 @@
+#ifndef REDIS_SOCKET_H
+#define REDIS_SOCKET_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace redis {
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+#define INVALID_SOCKET_VAL INVALID_SOCKET
+#define SOCKET_ERROR_VAL SOCKET_ERROR
+#else
+using socket_t = int;
+#define INVALID_SOCKET_VAL -1
+#define SOCKET_ERROR_VAL -1
+#endif
+
+} // namespace redis
+
+#endif // REDIS_SOCKET_H
@@ -2,17 +2,69 @@
 #define REDIS_STORAGE_H
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "redis/BloomFilter.h"
+#include "redis/HyperLogLog.h"
 
 namespace redis {
 
+enum class ValueType { String, Hash, Set, Bloom };
+
+// Strings that are canonical int64s are kept as native integers so the
+// INCR family never has to parse or format them. With value compression on,
+// large strings that LZF shrinks enough are kept compressed. Hashes start
+// as a listpack in value and become a HashTable once they outgrow the
+// listpack limits; sets of integers are an IntSet in value until they grow
+// too large or gain a member that is not one, and a SetTable otherwise.
+// Bloom filters have an encoding of their own.
+enum class ValueEncoding {
+  Raw,
+  Int,
+  Lzf,
+  Listpack,
+  HashTable,
+  IntSet,
+  SetTable,
+  Bloom
+};
+
+using HashTable = std::unordered_map<std::string, std::string>;
+
+// Hashes std::string and std::string_view alike, so that set members can be
+// looked up without building a string.
+struct MemberHash {
+  using is_transparent = void;
+  std::size_t operator()(const std::string_view str) const {
+    return std::hash<std::string_view>{}(str);
+  }
+};
+using SetTable = std::unordered_set<std::string, MemberHash, std::equal_to<>>;
+
 struct ValueWithExpiry {
-  std::string value;
+  std::string value;    // valid when encoding == Raw, Listpack or IntSet,
+                        // compressed when Lzf
+  int64_t intValue = 0; // valid when encoding == Int, raw length when Lzf,
+                        // field count when Listpack, width when IntSet
+  std::unique_ptr<HashTable> hash;    // valid when encoding == HashTable
+  std::unique_ptr<SetTable> set;      // valid when encoding == SetTable
+  std::unique_ptr<BloomFilter> bloom; // valid when encoding == Bloom
+  ValueType type = ValueType::String;
+  ValueEncoding encoding = ValueEncoding::Raw;
   std::chrono::steady_clock::time_point expiryTime;
   bool hasExpiry;
+  // Bumped on every write; WATCH compares it to detect modified keys.
+  uint64_t version = 0;
 
   ValueWithExpiry() : hasExpiry(false) {}
   explicit ValueWithExpiry(const std::string &val)
@@ -22,6 +74,64 @@ struct ValueWithExpiry {
       : value(val), expiryTime(expiry), hasExpiry(true) {}
 };
 
+enum class IncrResult { Ok, NotInteger, NotFloat, Overflow, WrongType };
+
+// NotHll: the key holds a string that is not a HyperLogLog. Corrupt: it has
+// the header of one but its registers cannot be decoded.
+enum class HllResult { Ok, NotHll, Corrupt };
+
+class LazyFree;
+
+// Totals over the values currently stored compressed.
+struct CompressionStats {
+  std::size_t values = 0;
+  std::size_t rawBytes = 0;
+  std::size_t compressedBytes = 0;
+};
+
+// Hashes stay listpack-encoded while they have at most hashMaxEntries
+// fields and no field or value longer than hashMaxValueBytes; a scan of a
+// few dozen short entries is as fast as hashing, and far smaller. Sets of
+// integers stay intsets up to setMaxIntsetEntries members.
+struct EncodingLimits {
+  std::size_t hashMaxEntries = 128;
+  std::size_t hashMaxValueBytes = 64;
+  std::size_t setMaxIntsetEntries = 512;
+};
+
+// The members resulting from a set operation: integers, in ascending
+// order, when every set involved was an intset, and strings otherwise.
+struct SetMembers {
+  std::vector<int64_t> ints;
+  std::vector<std::string> strings;
+};
+
+// What BF.INFO reports about a filter.
+struct BloomInfo {
+  uint64_t capacity = 0;
+  std::size_t bytes = 0;
+  std::size_t filters = 0;
+  uint64_t items = 0;
+  unsigned expansion = 0;
+};
+
+// The memory held for the snapshot walk behind BGSAVE and SAVE: values
+// written or removed while it runs, kept as they were for the walk to reach.
+struct SnapshotStats {
+  bool active = false;
+  std::size_t bytes = 0;     // held by the walk in progress
+  std::size_t lastBytes = 0; // held by the last finished walk, at its end
+};
+
+// Which deletions hand values to the background free thread. Values smaller
+// than thresholdBytes are always freed inline: for them the hand-off costs
+// more than the free.
+struct LazyFreePolicy {
+  bool onExpire = false;    // keys removed because their TTL elapsed
+  bool onOverwrite = false; // values replaced by a write to the same key
+  std::size_t thresholdBytes = 64 * 1024;
+};
+
 class Storage {
 public:
   Storage() = default;
@@ -29,16 +139,260 @@ public:
   void set(const std::string &key, const std::string &value);
   void setWithExpiry(const std::string &key, const std::string &value,
                      int64_t expiryMs);
+  // Values of other types read as missing; the second form also reports
+  // them through wrongType.
   std::optional<std::string> get(const std::string &key);
+  std::optional<std::string> get(const std::string &key, bool &wrongType);
   std::vector<std::string> getAllKeys();
+  std::optional<ValueType> type(const std::string &key);
+
+  // Batched variants of get/set/delete/exists. getMany reads values of other
+  // types as missing, as MGET does. Each takes the lock once for
+  // the whole batch and looks keys up with their hashes computed up front,
+  // prefetching buckets a few keys ahead of the one being resolved.
+  std::vector<std::optional<std::string>>
+  getMany(std::span<const std::string> keys);
+  void setMany(std::span<const std::string> keyValues); // key, value, ...
+  std::size_t remove(std::span<const std::string> keys);
+  // Like remove, but large values are freed in the background (UNLINK).
+  std::size_t unlink(std::span<const std::string> keys);
+  std::size_t countExisting(std::span<const std::string> keys);
+
+  // Adds delta to the integer at key, creating it as 0 when missing. The TTL
+  // of an existing key is preserved.
+  IncrResult incrBy(const std::string &key, int64_t delta, int64_t &result);
+  IncrResult incrByFloat(const std::string &key, long double delta,
+                         std::string &result);
+
+  // HyperLogLog commands. Sketches are plain string values in Redis' format
+  // and are never integer-encoded or compressed. pfAdd creates the key when
+  // missing and sets changed if it was created or a register grew. pfCount
+  // of one key caches the estimate in the sketch; of several, it counts
+  // their union. pfMerge stores the union of destKey and sourceKeys in
+  // destKey, keeping its TTL.
+  HllResult pfAdd(const std::string &key,
+                  std::span<const std::string> elements,
+                  std::size_t sparseMaxBytes, bool &changed);
+  HllResult pfCount(std::span<const std::string> keys, uint64_t &count);
+  HllResult pfMerge(const std::string &destKey,
+                    std::span<const std::string> sourceKeys);
+
+  // Hash commands. They return false if key holds another type. hset
+  // creates the key when missing and counts the fields it added; fieldValues
+  // alternate field and value. hdel removes the key with its last field.
+  bool hset(const std::string &key, std::span<const std::string> fieldValues,
+            std::size_t &added);
+  bool hget(const std::string &key, const std::string &field,
+            std::optional<std::string> &value);
+  bool hdel(const std::string &key, std::span<const std::string> fields,
+            std::size_t &removed);
+  bool hlen(const std::string &key, std::size_t &length);
+  // Calls begin with the field count and then fn for every field and value,
+  // with the lock held, so a reply can be encoded straight from the stored
+  // hash; nothing is called for a missing key.
+  bool hgetall(const std::string &key,
+               const std::function<void(std::size_t fields)> &begin,
+               const std::function<void(std::string_view field,
+                                        std::string_view value)> &fn);
+
+  // The fields of a hash entry, in storage order.
+  static std::size_t hashLength(const ValueWithExpiry &entry);
+  static void forEachField(
+      const ValueWithExpiry &entry,
+      const std::function<void(std::string_view field,
+                               std::string_view value)> &fn);
+
+  // Set commands, which likewise return false if a key holds another type.
+  // sadd creates the key when missing and srem removes it with its last
+  // member. sinter, sunion and sdiff treat missing keys as empty sets;
+  // sinter starts from the smallest set.
+  bool sadd(const std::string &key, std::span<const std::string> members,
+            std::size_t &added);
+  bool srem(const std::string &key, std::span<const std::string> members,
+            std::size_t &removed);
+  bool sismember(const std::string &key, const std::string &member,
+                 bool &found);
+  bool scard(const std::string &key, std::size_t &length);
+  bool smembers(const std::string &key,
+                const std::function<void(std::size_t members)> &begin,
+                const std::function<void(std::string_view member)> &fn);
+  bool sinter(std::span<const std::string> keys, SetMembers &result);
+  bool sunion(std::span<const std::string> keys, SetMembers &result);
+  bool sdiff(std::span<const std::string> keys, SetMembers &result);
+
+  // The members of a set entry; intsets in ascending order.
+  static std::size_t setLength(const ValueWithExpiry &entry);
+  static void
+  forEachMember(const ValueWithExpiry &entry,
+                const std::function<void(std::string_view member)> &fn);
+
+  // Bloom filter commands, which likewise return false if key holds another
+  // type. bfReserve creates an empty filter, and returns false if key
+  // already exists; bfAdd creates one with options when key is missing.
+  // Results are appended, one per item; bfExists finds nothing in a missing
+  // key and bfInfo leaves info empty for one.
+  bool bfReserve(const std::string &key, const BloomFilter::Options &options);
+  bool bfAdd(const std::string &key, std::span<const std::string> items,
+             const BloomFilter::Options &options,
+             std::vector<BloomFilter::AddResult> &results);
+  bool bfExists(const std::string &key, std::span<const std::string> items,
+                std::vector<bool> &found);
+  bool bfInfo(const std::string &key, std::optional<BloomInfo> &info);
+  // Stores a filter rebuilt from an RDB file; false if key already exists.
+  bool restoreBloom(const std::string &key,
+                    std::unique_ptr<BloomFilter> filter);
+
+  // Calls fn with the live entry for key, with the lock held. Returns false,
+  // calling nothing, if the key does not exist.
+  bool withEntry(const std::string &key,
+                 const std::function<void(const ValueWithExpiry &entry)> &fn);
+
+  // Returns the version of the live entry for key. Versions are unique
+  // across the keyspace, so a key that is deleted and recreated never
+  // reports its old version. A missing key reports 0, or, while it is
+  // watched, a version taken when it was last deleted: deleting a watched
+  // key changes its version even if it was created after the WATCH.
+  uint64_t getVersion(const std::string &key);
+
+  // WATCH registers each key it observes and releases it on EXEC, DISCARD,
+  // UNWATCH or disconnection; watch returns getVersion(key).
+  uint64_t watch(const std::string &key);
+  void unwatch(const std::string &key);
+
+  // Milliseconds until key expires: -1 if it has no TTL, -2 if it does not
+  // exist.
+  int64_t pttl(const std::string &key);
+  // Sets key to expire in expiryMs, whatever its type. Returns false if the
+  // key does not exist.
+  bool pexpire(const std::string &key, int64_t expiryMs);
+
+  // Calls fn for every entry, expired ones included, with the lock held
+  // throughout, so the walk sees a consistent keyspace but blocks writers.
+  void forEach(const std::function<void(const std::string &key,
+                                        const ValueWithExpiry &entry)> &fn);
+
+  // Calls fn for every entry, expired ones included, as the keyspace stood
+  // when the call began, while other threads keep reading and writing it:
+  // a point-in-time snapshot without fork(). fn runs on the calling thread
+  // with the lock held a chunk of buckets at a time, and afterChunk between
+  // chunks without it. Writers keep the old contents of an entry the walk
+  // has yet to reach before changing or removing it, copying it if it is
+  // changed in place, so the snapshot costs memory only for what is written
+  // during it. Returns false, calling nothing, if a walk is in progress.
+  bool forEachInSnapshot(
+      const std::function<void(const std::string &key,
+                               const ValueWithExpiry &entry)> &fn,
+      const std::function<void()> &afterChunk);
+  SnapshotStats snapshotStats() const;
+
+  // Visits the live entries in up to buckets hash buckets starting at
+  // cursor, and returns the cursor to continue from, 0 once the walk is
+  // complete. The lock is only held for the one call; a rehash between
+  // calls can make a walk skip or revisit some keys.
+  std::size_t
+  scan(std::size_t cursor, std::size_t buckets,
+       const std::function<void(const std::string &key,
+                                const ValueWithExpiry &entry)> &fn);
+
+  // Estimated bytes used by key and its value, including the hash table
+  // node; nullopt if the key does not exist (MEMORY USAGE). Hash and set
+  // tables are sized from their first samples elements, or all of them if
+  // samples is 0.
+  static constexpr std::size_t kMemorySamples = 5;
+  std::optional<std::size_t> memoryUsage(const std::string &key,
+                                         std::size_t samples);
+  static std::size_t memoryUsage(const std::string &key,
+                                 const ValueWithExpiry &entry,
+                                 std::size_t samples);
+
+  // Removes every key. With async the old keyspace is swapped out and
+  // destroyed on the free thread, so the call takes constant time.
+  void clear(bool async);
+
+  // Without a LazyFree, asynchronous frees fall back to freeing inline.
+  void setLazyFree(std::shared_ptr<LazyFree> lazyFree, LazyFreePolicy policy);
+  const std::shared_ptr<LazyFree> &lazyFree() const { return lazyFree_; }
+
+  // Values of at least thresholdBytes are stored LZF-compressed when that
+  // saves space, and decompressed on every read. 0 disables compression.
+  // Only affects values written afterwards.
+  void setValueCompression(std::size_t thresholdBytes);
+  CompressionStats compressionStats() const;
+
+  void setEncodingLimits(EncodingLimits limits);
+
+  // Invoked (with the lock held) whenever a key is removed because its TTL
+  // elapsed, so that caches kept by clients can be invalidated.
+  void setKeyExpiredListener(std::function<void(const std::string &)> fn) {
+    keyExpiredListener_ = std::move(fn);
+  }
 
 private:
+  // The walk of forEachInSnapshot. Buckets below cursor have been visited,
+  // and the walk skips entries of a later version than the snapshot's, and
+  // the keys in preserved, whose contents as of the snapshot are there.
+  // Rehashing would move keys across the cursor, so the table's load factor
+  // is lifted for the duration, and a keyspace that FLUSHALL swaps out is
+  // kept in detached until the walk is done with it.
+  struct Snapshot {
+    uint64_t version = 0;
+    std::unordered_map<std::string, ValueWithExpiry> *keyspace = nullptr;
+    std::unique_ptr<std::unordered_map<std::string, ValueWithExpiry>>
+        detached;
+    std::size_t cursor = 0;
+    float maxLoadFactor = 1;
+    std::unordered_map<std::string, ValueWithExpiry> preserved;
+    std::size_t bytes = 0;
+  };
+
+  // Keys under WATCH: how many clients watch each, and the version stamped
+  // when it was last deleted while watched.
+  struct WatchedKey {
+    std::size_t watchers = 0;
+    uint64_t deletedVersion = 0;
+  };
+  std::unordered_map<std::string, WatchedKey> watched_;
+  void touchWatched(const std::string &key);
+
   std::unordered_map<std::string, ValueWithExpiry> data_;
+  uint64_t nextVersion_ = 0;
+  std::function<void(const std::string &)> keyExpiredListener_;
   mutable std::mutex mutex_;
+  std::shared_ptr<LazyFree> lazyFree_;
+  LazyFreePolicy lazyFreePolicy_;
+  std::size_t compressionThreshold_ = 0;
+  CompressionStats compressionStats_;
+  EncodingLimits encodingLimits_;
+  std::unique_ptr<Snapshot> snapshot_;
+  std::size_t lastSnapshotBytes_ = 0;
 
+  std::size_t removeKeys(std::span<const std::string> keys, bool async);
   void removeExpiredKey(const std::string &key);
+  void erase(std::unordered_map<std::string, ValueWithExpiry>::iterator it,
+             bool async);
+  void releaseValue(ValueWithExpiry &entry, bool async);
+  // For an entry about to be overwritten or erased: hands its value to the
+  // snapshot walk if that still needs it, and releases it otherwise.
+  void retireValue(const std::string &key, ValueWithExpiry &entry,
+                   bool async);
+  // For an entry about to be changed in place: copies it for the snapshot
+  // walk if that still needs it.
+  void preserveForSnapshot(const std::string &key,
+                           const ValueWithExpiry &entry);
+  bool snapshotNeeds(const std::string &key,
+                     const ValueWithExpiry &entry) const;
+  void notifyExpired(const std::string &key) const;
+  void encodeValue(ValueWithExpiry &entry);
+  void compressValue(ValueWithExpiry &entry);
+  void convertToHashTable(ValueWithExpiry &entry);
+  void convertToSetTable(ValueWithExpiry &entry);
+  bool lookupSets(std::span<const std::string> keys,
+                  std::vector<const ValueWithExpiry *> &sets);
+  bool loadHll(ValueWithExpiry &entry);
+  HllResult mergeHlls(std::span<const std::string> keys,
+                      HyperLogLog::Registers &registers);
 };
 
 } // namespace redis
 
-#endif // REDIS_STORAGE_H
\ No newline at end of file
+#endif // REDIS_STORAGE_H
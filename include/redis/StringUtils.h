@@ -0,0 +1,27 @@
+#ifndef REDIS_STRING_UTILS_H
+#define REDIS_STRING_UTILS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+// Parses a canonical base-10 int64 (no '+', whitespace or leading zeros), the
+// same form Redis accepts as an integer-encodable string.
+bool parseInt64(std::string_view str, int64_t &value);
+
+// Parses a finite long double as accepted by INCRBYFLOAT.
+bool parseLongDouble(std::string_view str, long double &value);
+
+// ASCII case-insensitive comparison, for command names and options.
+bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+// Formats value the way INCRBYFLOAT replies: fixed-point with 17 decimals,
+// trailing zeros dropped. Returns false if the result does not fit the
+// buffer.
+bool formatLongDouble(long double value, std::string &out);
+
+} // namespace redis
+
+#endif // REDIS_STRING_UTILS_H
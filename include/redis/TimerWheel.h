@@ -0,0 +1,66 @@
+#ifndef REDIS_TIMER_WHEEL_H
+#define REDIS_TIMER_WHEEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace redis {
+
+// Hashed timing wheel for coarse per-client timers such as the idle timeout.
+// Scheduling and expiring a timer are O(1), so nothing scans every
+// connection. Timers are never cancelled: whoever handles the expiry checks
+// whether it still applies and schedules it again if not, so activity on a
+// connection does not touch the wheel at all.
+class TimerWheel {
+public:
+  explicit TimerWheel(int64_t resolutionMs = 100, std::size_t slots = 512);
+
+  void schedule(uint64_t id, int64_t deadlineMs);
+
+  // Calls expire(id) for every timer due at nowMs. expire may schedule new
+  // timers, including for the same id.
+  template <typename Fn> void advance(int64_t nowMs, Fn &&expire);
+
+  std::size_t size() const { return size_; }
+
+private:
+  struct Timer {
+    uint64_t id;
+    int64_t deadlineMs;
+  };
+
+  std::vector<std::vector<Timer>> slots_;
+  std::vector<Timer> due_;
+  int64_t resolutionMs_;
+  int64_t nextTick_ = 0; // first tick whose slot has not been expired yet
+  std::size_t size_ = 0;
+};
+
+template <typename Fn>
+void TimerWheel::advance(const int64_t nowMs, Fn &&expire) {
+  const int64_t nowTick = nowMs / resolutionMs_;
+  // After a long gap visiting every slot once covers all of them.
+  nextTick_ = std::max(nextTick_,
+                       nowTick - static_cast<int64_t>(slots_.size()) + 1);
+
+  while (nextTick_ <= nowTick) {
+    due_.swap(slots_[static_cast<std::size_t>(nextTick_) % slots_.size()]);
+    nextTick_++;
+    for (const Timer &timer : due_) {
+      size_--;
+      if (timer.deadlineMs > nowMs) {
+        // Hashed into this slot, but due on a later turn of the wheel.
+        schedule(timer.id, timer.deadlineMs);
+      } else {
+        expire(timer.id);
+      }
+    }
+    due_.clear();
+  }
+}
+
+} // namespace redis
+
+#endif // REDIS_TIMER_WHEEL_H
@@ -0,0 +1,67 @@
+#ifndef REDIS_TRACKING_H
+#define REDIS_TRACKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace redis {
+
+struct Client;
+class ClientRegistry;
+
+// Server side of client-side caching (CLIENT TRACKING). In the default mode
+// the keys each client reads are remembered in a key -> client-ID table that
+// is bounded by maxKeys; in BCAST mode clients register key prefixes in a
+// trie and are told about every write under them.
+class Tracking {
+public:
+  Tracking(const std::shared_ptr<ClientRegistry> &registry,
+           std::size_t maxKeys);
+
+  void enable(Client &client, bool bcast, bool noLoop, uint64_t redirect,
+              std::vector<std::string> prefixes);
+  void disable(Client &client);
+
+  // Called after a read-only command: remember that client may cache keys.
+  void rememberKey(const Client &client, const std::string &key);
+
+  // Called after a key was modified (or expired). origin is the client that
+  // issued the write, used to honour NOLOOP; it may be null.
+  void invalidateKey(const std::string &key, const Client *origin);
+
+  // Called after the keyspace was flushed: every tracking client is told to
+  // drop its whole cache, with a null key as in Redis.
+  void invalidateAll(const Client *origin);
+
+  std::size_t trackedKeys() const { return table_.size(); }
+
+private:
+  struct PrefixNode {
+    std::unordered_map<char, std::unique_ptr<PrefixNode>> children;
+    std::vector<uint64_t> clients;
+  };
+
+  std::shared_ptr<ClientRegistry> registry_;
+  std::size_t maxKeys_;
+  std::unordered_map<std::string, std::vector<uint64_t>> table_;
+  PrefixNode prefixRoot_;
+
+  // The invalidation frames for one key, built lazily and shared between
+  // every client that needs them.
+  struct Frames {
+    const std::string &key;
+    std::shared_ptr<const std::string> push;    // RESP3 push
+    std::shared_ptr<const std::string> message; // RESP2 pub/sub redirect
+  };
+
+  void notify(Client &client, Frames &frames, const Client *origin) const;
+  void removePrefix(uint64_t clientId, const std::string &prefix);
+};
+
+} // namespace redis
+
+#endif // REDIS_TRACKING_H
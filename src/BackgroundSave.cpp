@@ -0,0 +1,49 @@
+#include "redis/BackgroundSave.h"
+
+#include "redis/RDBWriter.h"
+#include "redis/ServerClock.h"
+#include "redis/Storage.h"
+
+#include <utility>
+
+namespace redis {
+
+BackgroundSave::BackgroundSave() : lastSaveTime_(ServerClock::unixTime()) {}
+
+BackgroundSave::~BackgroundSave() {
+  // A save under way is finished rather than left half-written.
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool BackgroundSave::start(std::shared_ptr<Storage> storage,
+                           std::string filepath, const bool compression,
+                           const bool checksum) {
+  if (inProgress()) {
+    return false;
+  }
+  // The previous save is done; only its thread is left to reap.
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  inProgress_.store(true, std::memory_order_release);
+  thread_ = std::thread([this, storage = std::move(storage),
+                         filepath = std::move(filepath), compression,
+                         checksum] {
+    RDBWriter writer(compression, checksum);
+    finished(writer.writeFile(filepath, *storage));
+    inProgress_.store(false, std::memory_order_release);
+  });
+  return true;
+}
+
+void BackgroundSave::finished(const bool ok) {
+  lastOk_.store(ok, std::memory_order_relaxed);
+  if (ok) {
+    lastSaveTime_.store(ServerClock::unixTime(), std::memory_order_relaxed);
+  }
+}
+
+} // namespace redis
@@ -0,0 +1,34 @@
+#include "redis/BigKeys.h"
+
+#include "redis/Storage.h"
+
+namespace redis {
+
+void BigKeyScanner::step(Storage &storage) {
+  if (!enabled_) {
+    return;
+  }
+
+  cursor_ = storage.scan(
+      cursor_, kBucketsPerStep,
+      [this](const std::string &key, const ValueWithExpiry &entry) {
+        scanning_.offer(
+            key, Storage::memoryUsage(key, entry, Storage::kMemorySamples));
+      });
+  if (cursor_ == 0) {
+    last_ = scanning_.sorted();
+    scanning_.clear();
+    passes_++;
+  }
+}
+
+std::vector<std::pair<std::string, uint64_t>>
+BigKeyScanner::top(const std::size_t count) const {
+  auto entries = passes_ > 0 ? last_ : scanning_.sorted();
+  if (entries.size() > count) {
+    entries.resize(count);
+  }
+  return entries;
+}
+
+} // namespace redis
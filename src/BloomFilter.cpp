@@ -0,0 +1,337 @@
+#include "redis/BloomFilter.h"
+
+#include "redis/Arena.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+namespace redis {
+
+namespace {
+
+using Block = BloomFilter::Block;
+using Layer = BloomFilter::Layer;
+
+constexpr std::size_t kBlockBits = sizeof(Block) * 8;
+constexpr std::size_t kBlockWords = std::size(Block{}.words);
+constexpr unsigned kMaxHashes = BloomFilter::kMaxHashes;
+
+// Each sub-filter after the first gets half its predecessor's error rate.
+constexpr double kErrorTightening = 0.5;
+
+// The step by which sizing grows the bits per item to absorb the cost of
+// blocking.
+constexpr double kBitsGrowth = 1.01;
+
+// How many items ahead of the current one to prefetch blocks for.
+constexpr std::size_t kPrefetchDistance = 8;
+
+// Odd multipliers (splitmix64 outputs) for deriving bit positions: bit i of
+// an item in its block is the top nine bits of its hash times salt i.
+constexpr std::array<uint64_t, kMaxHashes> kSalts = [] {
+  std::array<uint64_t, kMaxHashes> salts{};
+  uint64_t state = 0;
+  for (auto &salt : salts) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    salt = (z ^ (z >> 31)) | 1;
+  }
+  return salts;
+}();
+
+using Mask = std::array<uint64_t, kBlockWords>;
+
+Mask probeMask(const uint64_t bits, const unsigned hashes) {
+  Mask mask{};
+  for (unsigned i = 0; i < hashes; i++) {
+    const uint64_t bit = (bits * kSalts[i]) >> 55;
+    mask[bit / 64] |= uint64_t{1} << (bit % 64);
+  }
+  return mask;
+}
+
+// The false positive rate of blocks that each hold itemsPerBlock items on
+// average. A block is a classic filter of kBlockBits bits, and the items
+// that land in it are Poisson distributed; the unlucky, fuller blocks make
+// the rate higher than that of one large filter with the same bits.
+double blockedErrorRate(const double itemsPerBlock, const unsigned hashes) {
+  const double unsetByItem = std::pow(1 - 1.0 / kBlockBits, hashes);
+  const double lastItems = itemsPerBlock + 12 * std::sqrt(itemsPerBlock) + 12;
+  double rate = 0;
+  double probability = std::exp(-itemsPerBlock); // of holding items items
+  double unset = 1; // the chance that a bit is still clear
+  for (double items = 0; items <= lastItems; items++) {
+    rate += probability * std::pow(1 - unset, hashes);
+    probability *= itemsPerBlock / (items + 1);
+    unset *= unsetByItem;
+  }
+  return rate;
+}
+
+// Maps hash uniformly onto [0, blocks) with a multiply instead of a
+// division.
+uint64_t blockIndex(const uint64_t hash, const uint64_t blocks) {
+#if defined(__SIZEOF_INT128__)
+  return static_cast<uint64_t>(
+      (static_cast<unsigned __int128>(hash) * blocks) >> 64);
+#else
+  return hash % blocks;
+#endif
+}
+
+void prefetch(const void *addr) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(addr);
+#else
+  (void)addr;
+#endif
+}
+
+uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccd;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53;
+  k ^= k >> 33;
+  return k;
+}
+
+// MurmurHash3, x64 128-bit version.
+std::pair<uint64_t, uint64_t> murmurHash3(const std::string_view data,
+                                          const uint64_t seed) {
+  constexpr uint64_t c1 = 0x87c37b91114253d5;
+  constexpr uint64_t c2 = 0x4cf5ad432745937f;
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+
+  const char *p = data.data();
+  const char *end = p + (data.size() & ~std::size_t{15});
+  for (; p != end; p += 16) {
+    uint64_t k1;
+    uint64_t k2;
+    std::memcpy(&k1, p, 8); // Assuming little-endian system
+    std::memcpy(&k2, p + 8, 8);
+
+    k1 *= c1;
+    k1 = std::rotl(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+    h1 = std::rotl(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2;
+    k2 = std::rotl(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+    h2 = std::rotl(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const auto *tail = reinterpret_cast<const uint8_t *>(p);
+  const std::size_t rest = data.size() & 15;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  for (std::size_t i = 0; i < rest; i++) {
+    if (i < 8) {
+      k1 |= uint64_t{tail[i]} << (8 * i);
+    } else {
+      k2 |= uint64_t{tail[i]} << (8 * (i - 8));
+    }
+  }
+  if (rest > 8) {
+    k2 *= c2;
+    k2 = std::rotl(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+  }
+  if (rest > 0) {
+    k1 *= c1;
+    k1 = std::rotl(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+
+  h1 ^= data.size();
+  h2 ^= data.size();
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+  return {h1, h2};
+}
+
+} // namespace
+
+BloomFilter::BloomFilter(const Options &options) : options_(options) {
+  layers_.push_back(makeLayer(options.errorRate, options.capacity));
+}
+
+BloomFilter::BloomFilter(const Options &options, std::vector<Layer> layers)
+    : options_(options), layers_(std::move(layers)) {}
+
+BloomFilter::BloomFilter(const BloomFilter &other) : options_(other.options_) {
+  layers_.reserve(other.layers_.size());
+  for (const Layer &layer : other.layers_) {
+    Layer &copy = layers_.emplace_back();
+    copy.capacity = layer.capacity;
+    copy.count = layer.count;
+    copy.hashes = layer.hashes;
+    copy.blocks = layer.blocks;
+    copy.bits = std::make_unique_for_overwrite<Block[]>(layer.blocks);
+    std::memcpy(copy.bits.get(), layer.bits.get(),
+                layer.blocks * sizeof(Block));
+  }
+}
+
+Layer BloomFilter::makeLayer(const double errorRate, const uint64_t capacity) {
+  Layer layer;
+  // Sub-filters grow from their predecessor's capacity, so it must not be 0.
+  layer.capacity = std::clamp<uint64_t>(capacity, 1, kMaxCapacity);
+  layer.hashes = std::clamp(
+      static_cast<unsigned>(std::ceil(-std::log2(errorRate))), 1U, kMaxHashes);
+
+  // Start from the -ln(p) / ln(2)^2 bits per item of a classic filter and
+  // add bits until blocking no longer pushes the rate over the target.
+  const double ln2 = std::numbers::ln2;
+  double bitsPerItem = -std::log(errorRate) / (ln2 * ln2);
+  while (blockedErrorRate(kBlockBits / bitsPerItem, layer.hashes) >
+         errorRate) {
+    bitsPerItem *= kBitsGrowth;
+  }
+  const double bits = static_cast<double>(layer.capacity) * bitsPerItem;
+  layer.blocks = std::max<uint64_t>(
+      static_cast<uint64_t>(std::ceil(bits / kBlockBits)), 1);
+  layer.bits = std::make_unique<Block[]>(layer.blocks);
+  return layer;
+}
+
+BloomFilter::Hash BloomFilter::hash(const std::string_view item) {
+  const auto [h1, h2] = murmurHash3(item, 0xc6a4a7935bd1e995);
+  return {h1, h2};
+}
+
+bool BloomFilter::containsHash(const Hash &hash) const {
+  // The newest sub-filter is the largest and holds the most items.
+  for (auto layer = layers_.rbegin(); layer != layers_.rend(); ++layer) {
+    const Block &block = layer->bits[blockIndex(hash.block, layer->blocks)];
+    const Mask mask = probeMask(hash.bits, layer->hashes);
+    uint64_t missing = 0;
+    for (std::size_t w = 0; w < kBlockWords; w++) {
+      missing |= mask[w] & ~block.words[w];
+    }
+    if (missing == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BloomFilter::prefetch(const Hash &hash) const {
+  for (const Layer &layer : layers_) {
+    redis::prefetch(&layer.bits[blockIndex(hash.block, layer.blocks)]);
+  }
+}
+
+void BloomFilter::add(const std::span<const std::string> items,
+                      std::vector<AddResult> &results) {
+  Arena<1024> scratch;
+  std::pmr::vector<Hash> hashes(items.size(), scratch.resource());
+  for (std::size_t i = 0; i < items.size(); i++) {
+    hashes[i] = hash(items[i]);
+  }
+  for (std::size_t i = 0; i < std::min(kPrefetchDistance, items.size());
+       i++) {
+    prefetch(hashes[i]);
+  }
+
+  for (std::size_t i = 0; i < items.size(); i++) {
+    if (i + kPrefetchDistance < items.size()) {
+      prefetch(hashes[i + kPrefetchDistance]);
+    }
+    if (containsHash(hashes[i])) {
+      results.push_back(AddResult::Exists);
+      continue;
+    }
+
+    if (layers_.back().count >= layers_.back().capacity) {
+      if (options_.expansion == 0) {
+        results.push_back(AddResult::Full);
+        continue;
+      }
+      const double errorRate =
+          options_.errorRate *
+          std::pow(kErrorTightening, static_cast<double>(layers_.size()));
+      // Saturates at kMaxCapacity rather than wrapping or asking for more.
+      uint64_t capacity = 0;
+      if (__builtin_mul_overflow(layers_.back().capacity, options_.expansion,
+                                 &capacity)) {
+        capacity = kMaxCapacity;
+      }
+      layers_.push_back(makeLayer(errorRate, capacity));
+    }
+
+    Layer &layer = layers_.back();
+    Block &block = layer.bits[blockIndex(hashes[i].block, layer.blocks)];
+    const Mask mask = probeMask(hashes[i].bits, layer.hashes);
+    for (std::size_t w = 0; w < kBlockWords; w++) {
+      block.words[w] |= mask[w];
+    }
+    layer.count++;
+    results.push_back(AddResult::Added);
+  }
+}
+
+void BloomFilter::contains(const std::span<const std::string> items,
+                           std::vector<bool> &results) const {
+  Arena<1024> scratch;
+  std::pmr::vector<Hash> hashes(items.size(), scratch.resource());
+  for (std::size_t i = 0; i < items.size(); i++) {
+    hashes[i] = hash(items[i]);
+  }
+  for (std::size_t i = 0; i < std::min(kPrefetchDistance, items.size());
+       i++) {
+    prefetch(hashes[i]);
+  }
+
+  for (std::size_t i = 0; i < items.size(); i++) {
+    if (i + kPrefetchDistance < items.size()) {
+      prefetch(hashes[i + kPrefetchDistance]);
+    }
+    results.push_back(containsHash(hashes[i]));
+  }
+}
+
+uint64_t BloomFilter::items() const {
+  uint64_t items = 0;
+  for (const Layer &layer : layers_) {
+    items += layer.count;
+  }
+  return items;
+}
+
+uint64_t BloomFilter::capacity() const {
+  uint64_t capacity = 0;
+  for (const Layer &layer : layers_) {
+    capacity += layer.capacity;
+  }
+  return capacity;
+}
+
+std::size_t BloomFilter::bytes() const {
+  std::size_t bytes = sizeof(BloomFilter) + layers_.capacity() * sizeof(Layer);
+  for (const Layer &layer : layers_) {
+    bytes += layer.blocks * sizeof(Block);
+  }
+  return bytes;
+}
+
+} // namespace redis
@@ -0,0 +1,19 @@
+#include "redis/ClientRegistry.h"
+
+#include "redis/Client.h"
+
+namespace redis {
+
+void ClientRegistry::add(Client &client) {
+  client.id = nextId_++;
+  clients_[client.id] = &client;
+}
+
+void ClientRegistry::remove(const Client &client) { clients_.erase(client.id); }
+
+Client *ClientRegistry::find(const uint64_t id) const {
+  const auto it = clients_.find(id);
+  return it == clients_.end() ? nullptr : it->second;
+}
+
+} // namespace redis
@@ -0,0 +1,345 @@
+#include "redis/Cluster.h"
+
+#include "redis/Config.h"
+#include "redis/RESPParser.h"
+#include "redis/Socket.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define CLOSE_SOCKET(s) closesocket(s)
+#else
+#define CLOSE_SOCKET(s) close(s)
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+namespace redis {
+
+namespace {
+
+// CRC16-CCITT (XMODEM): polynomial 0x1021, initial value 0, no reflection,
+// the variant Redis Cluster specifies for key slots.
+constexpr std::array<uint16_t, 256> kCrc16Table = [] {
+  std::array<uint16_t, 256> table{};
+  for (uint16_t i = 0; i < 256; i++) {
+    uint16_t crc = static_cast<uint16_t>(i << 8);
+    for (int bit = 0; bit < 8; bit++) {
+      crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x1021
+                                                 : crc << 1);
+    }
+    table[i] = crc;
+  }
+  return table;
+}();
+
+uint16_t crc16(const std::string_view data) {
+  uint16_t crc = 0;
+  for (const char c : data) {
+    crc = static_cast<uint16_t>(
+        (crc << 8) ^
+        kCrc16Table[((crc >> 8) ^ static_cast<unsigned char>(c)) & 0xff]);
+  }
+  return crc;
+}
+
+bool parseSlot(const std::string_view text, uint16_t &slot) {
+  unsigned value = 0;
+  const auto [end, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (ec != std::errc() || end != text.data() + text.size() ||
+      value >= kClusterSlots) {
+    return false;
+  }
+  slot = static_cast<uint16_t>(value);
+  return true;
+}
+
+void setTimeout(const socket_t fd, const int64_t timeoutMs) {
+#ifdef _WIN32
+  const DWORD timeout = static_cast<DWORD>(timeoutMs);
+#else
+  timeval timeout{};
+  timeout.tv_sec = static_cast<time_t>(timeoutMs / 1000);
+  timeout.tv_usec = static_cast<suseconds_t>(timeoutMs % 1000 * 1000);
+#endif
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO,
+             reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,
+             reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+}
+
+// Opens a blocking connection whose connect, sends and receives all give up
+// after timeoutMs.
+socket_t connectTo(const std::string &host, const int port,
+                   const int64_t timeoutMs) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &result) != 0) {
+    return INVALID_SOCKET_VAL;
+  }
+
+  socket_t fd = INVALID_SOCKET_VAL;
+  for (const addrinfo *ai = result; ai != nullptr; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd == INVALID_SOCKET_VAL) {
+      continue;
+    }
+    setTimeout(fd, timeoutMs);
+    if (connect(fd, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) == 0) {
+      break;
+    }
+    CLOSE_SOCKET(fd);
+    fd = INVALID_SOCKET_VAL;
+  }
+  freeaddrinfo(result);
+  return fd;
+}
+
+} // namespace
+
+Cluster::Cluster(const Config &config)
+    : owner_(kClusterSlots, kNoNode), migrating_(kClusterSlots, kNoNode),
+      importing_(kClusterSlots, kNoNode) {
+  const std::string &host = config.getClusterAnnounceIp();
+  nodes_.push_back({nodeIdFor(host, config.getPort()), host, config.getPort()});
+
+  std::vector<uint16_t> slots;
+  if (!parseSlots(config.getClusterSlots(), slots)) {
+    std::cerr << "Invalid --cluster-slots: " << config.getClusterSlots()
+              << "\n";
+  }
+  for (const uint16_t slot : slots) {
+    owner_[slot] = 0;
+  }
+
+  // Each peer is "host:port slots...".
+  for (const std::string &spec : config.getClusterNodes()) {
+    std::istringstream iss(spec);
+    std::string address;
+    iss >> address;
+    const std::size_t colon = address.rfind(':');
+    int port = 0;
+    if (colon == std::string::npos ||
+        std::from_chars(address.data() + colon + 1,
+                        address.data() + address.size(), port)
+                .ec != std::errc()) {
+      std::cerr << "Invalid --cluster-node: " << spec << "\n";
+      continue;
+    }
+
+    const int node = meet(address.substr(0, colon), port);
+    std::string ranges;
+    std::getline(iss, ranges);
+    slots.clear();
+    if (!parseSlots(ranges, slots)) {
+      std::cerr << "Invalid --cluster-node slots: " << spec << "\n";
+    }
+    for (const uint16_t slot : slots) {
+      owner_[slot] = node;
+    }
+  }
+}
+
+uint16_t Cluster::keySlot(const std::string_view key) {
+  if (const std::size_t open = key.find('{'); open != std::string_view::npos) {
+    if (const std::size_t close = key.find('}', open + 1);
+        close != std::string_view::npos && close != open + 1) {
+      return crc16(key.substr(open + 1, close - open - 1)) &
+             (kClusterSlots - 1);
+    }
+  }
+  return crc16(key) & (kClusterSlots - 1);
+}
+
+std::string Cluster::nodeIdFor(const std::string_view host, const int port) {
+  const std::string address = std::string(host) + ":" + std::to_string(port);
+
+  // Three differently seeded FNV-1a hashes give 48 hex digits; IDs are 40.
+  std::string id;
+  for (uint64_t seed = 0; id.size() < 40; seed++) {
+    uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (const char c : address) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ULL;
+    }
+    constexpr char digits[] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4) {
+      id += digits[(hash >> shift) & 0xf];
+    }
+  }
+  id.resize(40);
+  return id;
+}
+
+bool Cluster::parseSlots(const std::string_view spec,
+                         std::vector<uint16_t> &slots) {
+  std::size_t pos = 0;
+  while (pos < spec.size()) {
+    if (spec[pos] == ' ') {
+      pos++;
+      continue;
+    }
+    std::size_t end = spec.find(' ', pos);
+    if (end == std::string_view::npos) {
+      end = spec.size();
+    }
+    const std::string_view token = spec.substr(pos, end - pos);
+    pos = end;
+
+    uint16_t first = 0;
+    uint16_t last = 0;
+    if (const std::size_t dash = token.find('-');
+        dash == std::string_view::npos) {
+      if (!parseSlot(token, first)) {
+        return false;
+      }
+      last = first;
+    } else if (!parseSlot(token.substr(0, dash), first) ||
+               !parseSlot(token.substr(dash + 1), last) || first > last) {
+      return false;
+    }
+    for (unsigned slot = first; slot <= last; slot++) {
+      slots.push_back(static_cast<uint16_t>(slot));
+    }
+  }
+  return true;
+}
+
+int Cluster::findNode(const std::string_view id) const {
+  for (std::size_t i = 0; i < nodes_.size(); i++) {
+    if (nodes_[i].id == id) {
+      return static_cast<int>(i);
+    }
+  }
+  return kNoNode;
+}
+
+int Cluster::meet(const std::string &host, const int port) {
+  const std::string id = nodeIdFor(host, port);
+  if (const int node = findNode(id); node != kNoNode) {
+    return node;
+  }
+  nodes_.push_back({id, host, port});
+  return static_cast<int>(nodes_.size() - 1);
+}
+
+void Cluster::assign(const uint16_t slot, const int node) {
+  owner_[slot] = node;
+  if (node == 0) {
+    importing_[slot] = kNoNode;
+  } else {
+    migrating_[slot] = kNoNode;
+  }
+}
+
+void Cluster::setMigrating(const uint16_t slot, const int node) {
+  migrating_[slot] = node;
+}
+
+void Cluster::setImporting(const uint16_t slot, const int node) {
+  importing_[slot] = node;
+}
+
+void Cluster::setStable(const uint16_t slot) {
+  migrating_[slot] = kNoNode;
+  importing_[slot] = kNoNode;
+}
+
+std::size_t Cluster::assignedSlots() const {
+  return kClusterSlots - static_cast<std::size_t>(std::ranges::count(
+                             owner_, kNoNode));
+}
+
+std::size_t Cluster::slotsServedBy(const int node) const {
+  return static_cast<std::size_t>(std::ranges::count(owner_, node));
+}
+
+std::vector<Cluster::SlotRange> Cluster::slotRanges() const {
+  std::vector<SlotRange> ranges;
+  for (std::size_t slot = 0; slot < kClusterSlots; slot++) {
+    const int node = owner_[slot];
+    if (node == kNoNode) {
+      continue;
+    }
+    if (!ranges.empty() && ranges.back().node == node &&
+        ranges.back().last + 1U == slot) {
+      ranges.back().last = static_cast<uint16_t>(slot);
+    } else {
+      ranges.push_back(
+          {static_cast<uint16_t>(slot), static_cast<uint16_t>(slot), node});
+    }
+  }
+  return ranges;
+}
+
+std::string Cluster::migrate(const std::string &host, const int port,
+                             const int64_t timeoutMs,
+                             const std::span<const MigrateEntry> entries,
+                             const bool replace) {
+  const socket_t fd = connectTo(host, port, timeoutMs);
+  if (fd == INVALID_SOCKET_VAL) {
+    return "IOERR error or timeout connecting to the client";
+  }
+
+  std::string request;
+  for (const MigrateEntry &entry : entries) {
+    RESPParser::appendArrayHeader(request, replace ? 5 : 4);
+    RESPParser::appendBulkString(request, "RESTORE-ASKING");
+    RESPParser::appendBulkString(request, entry.key);
+    RESPParser::appendBulkString(request, std::to_string(entry.ttlMs));
+    RESPParser::appendBulkString(request, entry.value);
+    if (replace) {
+      RESPParser::appendBulkString(request, "REPLACE");
+    }
+  }
+
+  for (std::size_t sent = 0; sent < request.size();) {
+    const auto n = send(fd, request.data() + sent,
+                        static_cast<int>(request.size() - sent), SEND_FLAGS);
+    if (n <= 0) {
+      CLOSE_SOCKET(fd);
+      return "IOERR error or timeout writing to target instance";
+    }
+    sent += static_cast<std::size_t>(n);
+  }
+
+  // Every reply is a single status or error line.
+  std::string replies;
+  std::size_t lines = 0;
+  std::string error;
+  while (lines < entries.size()) {
+    char buffer[4096];
+    const auto n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      CLOSE_SOCKET(fd);
+      return "IOERR error or timeout reading to target instance";
+    }
+    replies.append(buffer, static_cast<std::size_t>(n));
+
+    std::size_t lineEnd = 0;
+    while ((lineEnd = replies.find("\r\n")) != std::string::npos) {
+      if (replies[0] == '-' && error.empty()) {
+        error = replies.substr(1, lineEnd - 1);
+      }
+      replies.erase(0, lineEnd + 2);
+      lines++;
+    }
+  }
+
+  CLOSE_SOCKET(fd);
+  return error.empty() ? error : "Target instance replied with error: " + error;
+}
+
+} // namespace redis
@@ -1,206 +1,2604 @@
 #include "redis/CommandHandler.h"
 
+#include "redis/BackgroundSave.h"
+#include "redis/Client.h"
+#include "redis/ClientRegistry.h"
+#include "redis/Cluster.h"
+#include "redis/CommandTable.h"
 #include "redis/Config.h"
+#include "redis/LazyFree.h"
+#include "redis/Metrics.h"
+#include "redis/PubSub.h"
+#include "redis/RDBParser.h"
+#include "redis/RDBWriter.h"
 #include "redis/RESPParser.h"
+#include "redis/ServerClock.h"
+#include "redis/SharedReplies.h"
 #include "redis/Storage.h"
+#include "redis/StringUtils.h"
+#include "redis/Tracking.h"
 
 #include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <unordered_set>
+#include <utility>
 
 namespace redis {
 
-CommandHandler::CommandHandler(const std::shared_ptr<Config> &config,
-                               const std::shared_ptr<Storage> &storage)
-    : config_(config), storage_(storage) {}
+namespace {
+
+// Builds one [kind, name, count] confirmation as sent by (P)(UN)SUBSCRIBE.
+// RESP3 clients receive it as a push, like the messages that follow.
+std::string encodeSubscription(const Client &client, const std::string &kind,
+                               const std::string *name) {
+  std::string reply = client.protocolVersion >= 3 ? ">3\r\n" : "*3\r\n";
+  reply += RESPParser::encodeBulkString(kind);
+  reply +=
+      name ? RESPParser::encodeBulkString(*name) : RESPParser::encodeNull();
+  reply += RESPParser::encodeInteger(
+      static_cast<int64_t>(client.subscriptionCount()));
+  return reply;
+}
+
+void appendArityError(std::string &out, const std::string_view name) {
+  out += "-ERR wrong number of arguments for '";
+  out += name;
+  out += "' command\r\n";
+}
+
+// Parses a CLIENT LIST/KILL TYPE argument.
+bool parseClientClass(std::string name, ClientClass &clientClass) {
+  std::ranges::transform(name, name.begin(), ::tolower);
+  if (name == "normal") {
+    clientClass = ClientClass::Normal;
+  } else if (name == "replica" || name == "slave") {
+    clientClass = ClientClass::Replica;
+  } else if (name == "pubsub") {
+    clientClass = ClientClass::PubSub;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Formats one line of CLIENT LIST, with the fields Redis reports that apply
+// here.
+std::string describeClient(const Client &client, const int64_t nowMs) {
+  std::string flags;
+  if (client.replica) {
+    flags += 'S';
+  }
+  if (client.subscriptionCount() > 0) {
+    flags += 'P';
+  }
+  if (client.inMulti) {
+    flags += 'x';
+  }
+  if (client.tracking) {
+    flags += 't';
+  }
+  if (client.closeAsap) {
+    flags += 'A';
+  }
+  if (client.closeAfterReply) {
+    flags += 'c';
+  }
+  if (flags.empty()) {
+    flags = "N";
+  }
+
+  const std::string_view cmd =
+      client.lastCommand.empty() ? "NULL" : client.lastCommand;
+  const auto multi = client.inMulti
+                         ? static_cast<int64_t>(client.queuedCommands.size())
+                         : -1;
+  return "id=" + std::to_string(client.id) + " addr=" + client.address +
+         " fd=" + std::to_string(client.fd) + " name=" + client.name +
+         " age=" + std::to_string((nowMs - client.createdMs) / 1000) +
+         " idle=" + std::to_string((nowMs - client.lastInteractionMs) / 1000) +
+         " flags=" + flags + " db=0" +
+         " sub=" + std::to_string(client.channels.size()) +
+         " psub=" + std::to_string(client.patterns.size()) +
+         " multi=" + std::to_string(multi) +
+         " qbuf=" + std::to_string(client.inputBuffer.size()) +
+         " obl=" +
+         std::to_string(client.outputBuffer.size() - client.outputBufferSent) +
+         " oll=" + std::to_string(client.outputQueue.size()) +
+         " omem=" + std::to_string(client.outputQueueBytes) +
+         " cmd=" + std::string(cmd) +
+         " resp=" + std::to_string(client.protocolVersion) + "\n";
+}
+
+// Formats one line of CLUSTER NODES. Without a cluster bus every node is
+// reported as a connected master at epoch 0.
+std::string describeNode(const Cluster &cluster, const int node) {
+  const ClusterNode &info = cluster.node(node);
+  std::string line = info.id + " " + info.host + ":" +
+                     std::to_string(info.port) + "@" +
+                     std::to_string(info.port + 10000) +
+                     (node == 0 ? " myself,master" : " master") +
+                     " - 0 0 0 connected";
+  for (const auto &range : cluster.slotRanges()) {
+    if (range.node != node) {
+      continue;
+    }
+    line += " " + std::to_string(range.first);
+    if (range.last != range.first) {
+      line += "-" + std::to_string(range.last);
+    }
+  }
+  // Open migrations are listed by the node serving the slot's keys.
+  if (node == 0) {
+    for (std::size_t slot = 0; slot < kClusterSlots; slot++) {
+      const auto s = static_cast<uint16_t>(slot);
+      if (const int to = cluster.migratingTo(s); to != Cluster::kNoNode) {
+        line += " [" + std::to_string(slot) + "->-" + cluster.node(to).id + "]";
+      }
+      if (const int from = cluster.importingFrom(s);
+          from != Cluster::kNoNode) {
+        line +=
+            " [" + std::to_string(slot) + "-<-" + cluster.node(from).id + "]";
+      }
+    }
+  }
+  return line + "\n";
+}
+
+std::string encodeHllError(const HllResult result) {
+  return RESPParser::encodeError(
+      result == HllResult::NotHll
+          ? "WRONGTYPE Key is not a valid HyperLogLog string value."
+          : "INVALIDOBJ Corrupted HLL object detected");
+}
+
+// RESP3 clients get set replies as sets; RESP2 ones as arrays.
+void appendSetHeader(const Client &client, const std::size_t count,
+                     std::string &out) {
+  if (client.protocolVersion >= 3) {
+    out += '~';
+    out += std::to_string(count);
+    out += "\r\n";
+  } else {
+    RESPParser::appendArrayHeader(out, count);
+  }
+}
+
+BloomFilter::Options defaultBloomOptions(const Config &config) {
+  return {.errorRate = config.getBfErrorRate(),
+          .capacity = std::clamp<uint64_t>(config.getBfInitialSize(), 1,
+                                           BloomFilter::kMaxCapacity),
+          .expansion = std::min(config.getBfExpansionFactor(),
+                                BloomFilter::kMaxExpansion)};
+}
+
+// Parses the optional COUNT argument of HOTKEYS and BIGKEYS.
+bool parseTopCount(const std::span<const std::string> args,
+                   std::size_t &count) {
+  count = 10;
+  if (args.empty()) {
+    return true;
+  }
+  std::string option = args[0];
+  std::ranges::transform(option, option.begin(), ::toupper);
+  int64_t value = 0;
+  if (args.size() != 2 || option != "COUNT" || !parseInt64(args[1], value) ||
+      value < 1) {
+    return false;
+  }
+  count = static_cast<std::size_t>(value);
+  return true;
+}
 
+// Replies with [key, score] pairs, highest first.
 std::string
-CommandHandler::handleCommand(const std::vector<std::string> &command) const {
+encodeKeyScores(const std::vector<std::pair<std::string, uint64_t>> &entries) {
+  std::string reply = "*" + std::to_string(entries.size()) + "\r\n";
+  for (const auto &[key, score] : entries) {
+    reply += "*2\r\n";
+    reply += RESPParser::encodeBulkString(key);
+    reply += RESPParser::encodeInteger(static_cast<int64_t>(score));
+  }
+  return reply;
+}
+
+bool isAllowedWhileSubscribed(const std::string_view cmd) {
+  return cmd == "subscribe" || cmd == "unsubscribe" || cmd == "psubscribe" ||
+         cmd == "punsubscribe" || cmd == "ping" || cmd == "quit" ||
+         cmd == "reset";
+}
+
+} // namespace
+
+CommandHandler::CommandHandler(const std::shared_ptr<Config> &config,
+                               const std::shared_ptr<Storage> &storage,
+                               const std::shared_ptr<PubSub> &pubsub,
+                               const std::shared_ptr<ClientRegistry> &registry,
+                               const std::shared_ptr<Tracking> &tracking,
+                               const std::shared_ptr<Metrics> &metrics)
+    : config_(config), storage_(storage), pubsub_(pubsub), registry_(registry),
+      tracking_(tracking), metrics_(metrics),
+      cluster_(config->getClusterEnabled() ? std::make_shared<Cluster>(*config)
+                                           : nullptr),
+      backgroundSave_(std::make_shared<BackgroundSave>()) {}
+
+void CommandHandler::handleCommand(Client &client,
+                                   const std::span<const std::string> command,
+                                   std::string &out) const {
   if (command.empty()) {
-    return RESPParser::encodeError("ERR empty command");
-  }
-
-  std::string cmd = command[0];
-  std::ranges::transform(cmd, cmd.begin(), ::toupper);
-
-  if (cmd == "PING") {
-    return handlePing();
-  } else if (cmd == "ECHO") {
-    return handleEcho(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "SET") {
-    return handleSet(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "GET") {
-    return handleGet(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "CONFIG") {
-    return handleConfig(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "KEYS") {
-    return handleKeys(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "INFO") {
-    return handleInfo(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "REPLCONF") {
-    return handleReplconf(
-        std::vector<std::string>(command.begin() + 1, command.end()));
-  } else if (cmd == "PSYNC") {
-    return handlePsync(
-        std::vector<std::string>(command.begin() + 1, command.end()));
+    RESPParser::appendError(out, "ERR empty command");
+    return;
+  }
+
+  const CommandInfo *info = CommandTable::lookup(command[0]);
+  const std::string_view cmd = info != nullptr ? info->name : "";
+
+  if (client.subscriptionCount() > 0 && !isAllowedWhileSubscribed(cmd)) {
+    std::string name = command[0];
+    std::ranges::transform(name, name.begin(), ::tolower);
+    RESPParser::appendError(
+        out, "ERR Can't execute '" + name +
+                 "': only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING / QUIT / "
+                 "RESET are allowed in this context");
+    return;
+  }
+
+  // ASKING only covers the command right after it, whatever that is.
+  const bool asking = std::exchange(client.asking, false);
+  if (cluster_ && info != nullptr &&
+      CommandTable::checkArity(*info, command.size()) &&
+      !checkClusterSlot(client, *info, command,
+                        asking || cmd == "restore-asking", out)) {
+    // Like any command that cannot be queued, a redirect inside MULTI aborts
+    // the transaction.
+    if (client.inMulti) {
+      client.multiError = true;
+    }
+    return;
+  }
+
+  if (client.inMulti && cmd != "exec" && cmd != "discard" && cmd != "multi" &&
+      cmd != "watch") {
+    // Commands that could never run abort the whole transaction at EXEC.
+    if (info == nullptr) {
+      client.multiError = true;
+      RESPParser::appendError(out, "ERR unknown command '" + command[0] + "'");
+      return;
+    }
+    if (!CommandTable::checkArity(*info, command.size())) {
+      client.multiError = true;
+      metrics_->recordRejected(info->id);
+      appendArityError(out, info->name);
+      return;
+    }
+    client.queuedCommands.emplace_back(command.begin(), command.end());
+    out += shared::kQueued;
+    return;
+  }
+
+  if (info != nullptr) {
+    client.lastCommand = info->name;
+  }
+
+  const std::size_t replyStart = out.size();
+  // Expiry checks use the clock cached for this event-loop iteration, but
+  // once earlier work in the iteration has left it a millisecond behind it
+  // is refreshed, so a command never judges expiry against stale time. The
+  // check reuses the monotonic read that starts the latency sample.
+  const auto start = std::chrono::steady_clock::now();
+  if (start - ServerClock::now() >= std::chrono::milliseconds(1)) {
+    ServerClock::update();
+  }
+  dispatch(client, cmd, command, out);
+  const auto end = std::chrono::steady_clock::now();
+
+  const auto usec = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count());
+  if (metrics_->slowLog().shouldLog(usec)) {
+    metrics_->slowLog().record(command, usec, client.address, client.name);
+  }
+  metrics_->latencyMonitor().record(LatencyEvent::Command, usec / 1000);
+
+  if (info != nullptr) {
+    const bool failed = out.size() > replyStart && out[replyStart] == '-';
+    metrics_->recordCommand(info->id, start, end, failed);
+    if (info->firstKey > 0 && metrics_->hotKeys().shouldSample()) {
+      for (const std::size_t i : CommandTable::keyIndices(
+               *info, command.size(), client.arena.resource())) {
+        metrics_->hotKeys().record(command[i]);
+      }
+    }
+    if (!failed) {
+      trackKeys(client, *info, command);
+    }
+  }
+}
+
+void CommandHandler::dispatch(Client &client, const std::string_view cmd,
+                              const std::span<const std::string> command,
+                              std::string &out) const {
+  const auto args = command.subspan(1);
+
+  if (cmd == "multi") {
+    out += handleMulti(client);
+  } else if (cmd == "exec") {
+    handleExec(client, out);
+  } else if (cmd == "discard") {
+    out += handleDiscard(client);
+  } else if (cmd == "watch") {
+    out += handleWatch(client, args);
+  } else if (cmd == "unwatch") {
+    out += handleUnwatch(client);
+  } else if (cmd == "subscribe") {
+    out += handleSubscribe(client, args);
+  } else if (cmd == "unsubscribe") {
+    out += handleUnsubscribe(client, args);
+  } else if (cmd == "psubscribe") {
+    out += handlePsubscribe(client, args);
+  } else if (cmd == "punsubscribe") {
+    out += handlePunsubscribe(client, args);
+  } else if (cmd == "publish") {
+    out += handlePublish(args);
+  } else if (cmd == "hello") {
+    out += handleHello(client, args);
+  } else if (cmd == "client") {
+    out += handleClient(client, args);
+  } else if (cmd == "cluster") {
+    out += handleCluster(args);
+  } else if (cmd == "asking") {
+    out += handleAsking(client);
+  } else if (cmd == "migrate") {
+    out += handleMigrate(client, args);
+  } else if (cmd == "restore-asking") {
+    out += handleRestoreAsking(args);
+  } else if (cmd == "ping") {
+    handlePing(client, out);
+  } else if (cmd == "echo") {
+    handleEcho(args, out);
+  } else if (cmd == "set") {
+    handleSet(args, out);
+  } else if (cmd == "get") {
+    handleGet(args, out);
+  } else if (cmd == "mget") {
+    handleMget(args, out);
+  } else if (cmd == "mset") {
+    handleMset(args, out);
+  } else if (cmd == "del") {
+    handleDel(args, out);
+  } else if (cmd == "unlink") {
+    handleUnlink(args, out);
+  } else if (cmd == "exists") {
+    handleExists(args, out);
+  } else if (cmd == "incr") {
+    handleIncr(args, out);
+  } else if (cmd == "decr") {
+    handleDecr(args, out);
+  } else if (cmd == "incrby") {
+    handleIncrBy(args, out);
+  } else if (cmd == "decrby") {
+    handleDecrBy(args, out);
+  } else if (cmd == "incrbyfloat") {
+    out += handleIncrByFloat(args);
+  } else if (cmd == "pfadd") {
+    out += handlePfadd(args);
+  } else if (cmd == "pfcount") {
+    out += handlePfcount(args);
+  } else if (cmd == "pfmerge") {
+    out += handlePfmerge(args);
+  } else if (cmd == "hset") {
+    out += handleHset(args);
+  } else if (cmd == "hget") {
+    handleHget(args, out);
+  } else if (cmd == "hgetall") {
+    handleHgetall(client, args, out);
+  } else if (cmd == "hdel") {
+    out += handleHdel(args);
+  } else if (cmd == "hlen") {
+    out += handleHlen(args);
+  } else if (cmd == "sadd") {
+    out += handleSadd(args);
+  } else if (cmd == "srem") {
+    out += handleSrem(args);
+  } else if (cmd == "sismember") {
+    out += handleSismember(args);
+  } else if (cmd == "scard") {
+    out += handleScard(args);
+  } else if (cmd == "smembers") {
+    handleSmembers(client, args, out);
+  } else if (cmd == "sinter" || cmd == "sunion" || cmd == "sdiff") {
+    handleSetOperation(client, cmd, args, out);
+  } else if (cmd == "bf.reserve") {
+    out += handleBfReserve(args);
+  } else if (cmd == "bf.add" || cmd == "bf.madd") {
+    handleBfAdd(cmd, args, out);
+  } else if (cmd == "bf.exists" || cmd == "bf.mexists") {
+    handleBfExists(cmd, args, out);
+  } else if (cmd == "bf.info") {
+    handleBfInfo(client, args, out);
+  } else if (cmd == "type") {
+    out += handleType(args);
+  } else if (cmd == "config") {
+    out += handleConfig(args);
+  } else if (cmd == "flushall" || cmd == "flushdb") {
+    // There is a single database, so both flush the whole keyspace.
+    out += handleFlush(client, args);
+  } else if (cmd == "save") {
+    out += handleSave();
+  } else if (cmd == "bgsave") {
+    out += handleBgsave();
+  } else if (cmd == "keys") {
+    out += handleKeys(args);
+  } else if (cmd == "info") {
+    out += handleInfo(args);
+  } else if (cmd == "slowlog") {
+    out += handleSlowlog(args);
+  } else if (cmd == "latency") {
+    out += handleLatency(args);
+  } else if (cmd == "hotkeys") {
+    out += handleHotkeys(args);
+  } else if (cmd == "bigkeys") {
+    out += handleBigkeys(args);
+  } else if (cmd == "memory") {
+    out += handleMemory(args);
+  } else if (cmd == "metrics") {
+    out += handleMetrics(args);
+  } else if (cmd == "replconf") {
+    out += handleReplconf(args);
+  } else if (cmd == "psync") {
+    const std::size_t replyStart = out.size();
+    out += handlePsync(args);
+    // From here on the connection is a replica's replication link.
+    if (out[replyStart] != '-') {
+      client.replica = true;
+    }
   } else {
-    return RESPParser::encodeError("ERR unknown command '" + command[0] + "'");
+    RESPParser::appendError(out, "ERR unknown command '" + command[0] + "'");
+  }
+}
+
+void CommandHandler::trackKeys(
+    Client &client, const CommandInfo &info,
+    const std::span<const std::string> command) const {
+  const bool write = (info.flags & kCmdWrite) != 0;
+  if (!write && !((info.flags & kCmdReadOnly) && client.tracking)) {
+    return;
+  }
+
+  const auto keys = CommandTable::keyIndices(info, command.size(),
+                                             client.arena.resource());
+  for (const std::size_t i : keys) {
+    if (write) {
+      tracking_->invalidateKey(command[i], &client);
+    } else {
+      tracking_->rememberKey(client, command[i]);
+    }
+  }
+}
+
+bool CommandHandler::checkClusterSlot(
+    Client &client, const CommandInfo &info,
+    const std::span<const std::string> command, const bool asking,
+    std::string &out) const {
+  const auto keys = CommandTable::keyIndices(info, command.size(),
+                                             client.arena.resource());
+  if (keys.empty()) {
+    return true;
+  }
+
+  const uint16_t slot = Cluster::keySlot(command[keys[0]]);
+  for (const std::size_t i : keys) {
+    if (Cluster::keySlot(command[i]) != slot) {
+      RESPParser::appendError(
+          out, "CROSSSLOT Keys in request don't hash to the same slot");
+      return false;
+    }
+  }
+
+  const auto redirect = [&](const std::string_view kind, const int node) {
+    const ClusterNode &target = cluster_->node(node);
+    RESPParser::appendError(out, std::string(kind) + " " +
+                                     std::to_string(slot) + " " +
+                                     target.host + ":" +
+                                     std::to_string(target.port));
+    return false;
+  };
+
+  if (cluster_->servesSlot(slot)) {
+    const int target = cluster_->migratingTo(slot);
+    if (target == Cluster::kNoNode) {
+      return true;
+    }
+    // Mid-migration, keys still here are served here and the client is sent
+    // to the target for the rest. A request needing both has to wait until
+    // they are all on the same side.
+    std::size_t present = 0;
+    for (const std::size_t i : keys) {
+      present += storage_->countExisting(command.subspan(i, 1));
+    }
+    if (present == keys.size()) {
+      return true;
+    }
+    if (present > 0) {
+      RESPParser::appendError(
+          out, "TRYAGAIN Multiple keys request during rehashing of slot");
+      return false;
+    }
+    return redirect("ASK", target);
+  }
+
+  if (asking && cluster_->importingFrom(slot) != Cluster::kNoNode) {
+    return true;
+  }
+  if (const int owner = cluster_->owner(slot); owner != Cluster::kNoNode) {
+    return redirect("MOVED", owner);
   }
+  RESPParser::appendError(out, "CLUSTERDOWN Hash slot not served");
+  return false;
 }
 
-std::string CommandHandler::handlePing() {
-  return RESPParser::encodeSimpleString("PONG");
+void CommandHandler::handlePing(const Client &client, std::string &out) {
+  // Subscribed clients only understand push-style arrays.
+  if (client.subscriptionCount() > 0) {
+    RESPParser::appendArray(out, {"pong", ""});
+    return;
+  }
+  out += shared::kPong;
 }
 
-std::string CommandHandler::handleEcho(const std::vector<std::string> &args) {
+void CommandHandler::handleEcho(const std::span<const std::string> args,
+                                std::string &out) {
   if (args.empty()) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'echo' command");
+    appendArityError(out, "echo");
+    return;
   }
-  return RESPParser::encodeBulkString(args[0]);
+  RESPParser::appendBulkString(out, args[0]);
 }
 
-std::string
-CommandHandler::handleSet(const std::vector<std::string> &args) const {
+void CommandHandler::handleSet(const std::span<const std::string> args,
+                               std::string &out) const {
   if (args.size() < 2) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'set' command");
+    appendArityError(out, "set");
+    return;
   }
 
   const std::string &key = args[0];
   const std::string &value = args[1];
 
   if (args.size() >= 4) {
-    std::string option = args[2];
-    std::ranges::transform(option, option.begin(), ::toupper);
-
-    if (option == "PX") {
+    if (equalsIgnoreCase(args[2], "PX")) {
       try {
         const int expiryMs = std::stoi(args[3]);
         storage_->setWithExpiry(key, value, expiryMs);
-        return RESPParser::encodeSimpleString("OK");
+        out += shared::kOk;
       } catch ([[maybe_unused]] const std::exception &e) {
-        return RESPParser::encodeError(
-            "ERR invalid expire time in 'set' command");
+        out += shared::kInvalidExpire;
       }
+      return;
     }
   }
 
   storage_->set(key, value);
-  return RESPParser::encodeSimpleString("OK");
+  out += shared::kOk;
 }
 
-std::string
-CommandHandler::handleGet(const std::vector<std::string> &args) const {
+void CommandHandler::handleGet(const std::span<const std::string> args,
+                               std::string &out) const {
   if (args.empty()) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'get' command");
+    appendArityError(out, "get");
+    return;
   }
 
-  if (const auto value = storage_->get(args[0]); value.has_value()) {
-    return RESPParser::encodeBulkString(value.value());
+  bool wrongType = false;
+  if (const auto value = storage_->get(args[0], wrongType);
+      value.has_value()) {
+    RESPParser::appendBulkString(out, *value);
+  } else if (wrongType) {
+    out += shared::kWrongType;
   } else {
-    return RESPParser::encodeNull();
+    out += shared::kNullBulk;
   }
 }
 
-std::string
-CommandHandler::handleConfig(const std::vector<std::string> &args) const {
-  if (args.size() < 2) {
-    return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'config' command");
+void CommandHandler::handleMget(const std::span<const std::string> args,
+                                std::string &out) const {
+  if (args.empty()) {
+    appendArityError(out, "mget");
+    return;
   }
 
-  std::string subcmd = args[0];
-  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+  const auto values = storage_->getMany(args);
 
-  if (subcmd == "GET") {
-    std::string param = args[1];
-    std::ranges::transform(param, param.begin(), ::tolower);
+  // Grow the buffer once and encode every element straight into it.
+  std::size_t replySize = out.size() + 16;
+  for (const auto &value : values) {
+    replySize += value ? value->size() + 32 : 5;
+  }
+  out.reserve(replySize);
 
-    std::string value;
-    if (param == "dir") {
-      value = config_->getDir();
-    } else if (param == "dbfilename") {
-      value = config_->getDbFilename();
+  RESPParser::appendArrayHeader(out, values.size());
+  for (const auto &value : values) {
+    if (value) {
+      RESPParser::appendBulkString(out, *value);
     } else {
-      return RESPParser::encodeArray({});
+      out += shared::kNullBulk;
     }
+  }
+}
 
-    return RESPParser::encodeArray({param, value});
-  } else {
-    return RESPParser::encodeError("ERR Unknown CONFIG subcommand");
+void CommandHandler::handleMset(const std::span<const std::string> args,
+                                std::string &out) const {
+  if (args.empty() || args.size() % 2 != 0) {
+    appendArityError(out, "mset");
+    return;
   }
+
+  storage_->setMany(args);
+  out += shared::kOk;
 }
 
-std::string
-CommandHandler::handleKeys(const std::vector<std::string> &args) const {
+void CommandHandler::handleDel(const std::span<const std::string> args,
+                               std::string &out) const {
+  if (args.empty()) {
+    appendArityError(out, "del");
+    return;
+  }
+  const std::size_t removed = config_->getLazyfreeLazyUserDel()
+                                  ? storage_->unlink(args)
+                                  : storage_->remove(args);
+  RESPParser::appendInteger(out, static_cast<int64_t>(removed));
+}
+
+void CommandHandler::handleUnlink(const std::span<const std::string> args,
+                                  std::string &out) const {
+  if (args.empty()) {
+    appendArityError(out, "unlink");
+    return;
+  }
+  RESPParser::appendInteger(out, static_cast<int64_t>(storage_->unlink(args)));
+}
+
+std::string CommandHandler::handleFlush(
+    const Client &client, const std::span<const std::string> args) const {
+  bool async = config_->getLazyfreeLazyUserFlush();
+  if (args.size() == 1 && equalsIgnoreCase(args[0], "ASYNC")) {
+    async = true;
+  } else if (args.size() == 1 && equalsIgnoreCase(args[0], "SYNC")) {
+    async = false;
+  } else if (!args.empty()) {
+    return RESPParser::encodeError("ERR syntax error");
+  }
+
+  storage_->clear(async);
+  tracking_->invalidateAll(&client);
+  return RESPParser::encodeSimpleString("OK");
+}
+
+void CommandHandler::handleExists(const std::span<const std::string> args,
+                                  std::string &out) const {
   if (args.empty()) {
+    appendArityError(out, "exists");
+    return;
+  }
+  RESPParser::appendInteger(
+      out, static_cast<int64_t>(storage_->countExisting(args)));
+}
+
+void CommandHandler::incrementBy(const std::string &key, const int64_t delta,
+                                 std::string &out) const {
+  int64_t result = 0;
+  switch (storage_->incrBy(key, delta, result)) {
+  case IncrResult::Ok:
+    RESPParser::appendInteger(out, result);
+    break;
+  case IncrResult::Overflow:
+    out += shared::kIncrOverflow;
+    break;
+  case IncrResult::WrongType:
+    out += shared::kWrongType;
+    break;
+  default:
+    out += shared::kNotInteger;
+    break;
+  }
+}
+
+void CommandHandler::handleIncr(const std::span<const std::string> args,
+                                std::string &out) const {
+  if (args.size() != 1) {
+    appendArityError(out, "incr");
+    return;
+  }
+  incrementBy(args[0], 1, out);
+}
+
+void CommandHandler::handleDecr(const std::span<const std::string> args,
+                                std::string &out) const {
+  if (args.size() != 1) {
+    appendArityError(out, "decr");
+    return;
+  }
+  incrementBy(args[0], -1, out);
+}
+
+void CommandHandler::handleIncrBy(const std::span<const std::string> args,
+                                  std::string &out) const {
+  if (args.size() != 2) {
+    appendArityError(out, "incrby");
+    return;
+  }
+
+  int64_t delta = 0;
+  if (!parseInt64(args[1], delta)) {
+    out += shared::kNotInteger;
+    return;
+  }
+  incrementBy(args[0], delta, out);
+}
+
+void CommandHandler::handleDecrBy(const std::span<const std::string> args,
+                                  std::string &out) const {
+  if (args.size() != 2) {
+    appendArityError(out, "decrby");
+    return;
+  }
+
+  int64_t delta = 0;
+  if (!parseInt64(args[1], delta)) {
+    out += shared::kNotInteger;
+    return;
+  }
+  if (delta == INT64_MIN) {
+    RESPParser::appendError(out, "ERR decrement would overflow");
+    return;
+  }
+  incrementBy(args[0], -delta, out);
+}
+
+std::string CommandHandler::handleIncrByFloat(
+    const std::span<const std::string> args) const {
+  if (args.size() != 2) {
     return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'keys' command");
+        "ERR wrong number of arguments for 'incrbyfloat' command");
   }
 
-  // For now, only support the "*" pattern
-  if (args[0] != "*") {
-    return RESPParser::encodeError("ERR pattern not supported");
+  long double delta = 0;
+  if (!parseLongDouble(args[1], delta)) {
+    return RESPParser::encodeError("ERR value is not a valid float");
   }
 
-  const auto keys = storage_->getAllKeys();
-  return RESPParser::encodeArray(keys);
+  std::string result;
+  switch (storage_->incrByFloat(args[0], delta, result)) {
+  case IncrResult::Ok:
+    return RESPParser::encodeBulkString(result);
+  case IncrResult::Overflow:
+    return RESPParser::encodeError(
+        "ERR increment would produce NaN or Infinity");
+  case IncrResult::WrongType:
+    return std::string(shared::kWrongType);
+  default:
+    return RESPParser::encodeError("ERR value is not a valid float");
+  }
 }
 
 std::string
-CommandHandler::handleInfo(const std::vector<std::string> &args) const {
-  // Check if the command has arguments and if it's "replication"
-  if (!args.empty()) {
-    std::string section = args[0];
-    std::ranges::transform(section, section.begin(), ::tolower);
-
-    if (section == "replication") {
-      // Return replication info as a bulk string
-      const std::string role = config_->isReplica() ? "slave" : "master";
-      std::string info = "role:" + role + "\r\n";
+CommandHandler::handlePfadd(const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'pfadd' command");
+  }
 
-      // Add master_replid and master_repl_offset for master nodes
-      if (!config_->isReplica()) {
-        info += "master_replid:8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb\r\n";
-        info += "master_repl_offset:0";
-      }
+  bool changed = false;
+  if (const HllResult result = storage_->pfAdd(
+          args[0], args.subspan(1), config_->getHllSparseMaxBytes(), changed);
+      result != HllResult::Ok) {
+    return encodeHllError(result);
+  }
+  return RESPParser::encodeInteger(changed ? 1 : 0);
+}
 
-      return RESPParser::encodeBulkString(info);
-    }
+std::string
+CommandHandler::handlePfcount(const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'pfcount' command");
   }
 
-  // For now, only support the replication section
-  return RESPParser::encodeError("ERR wrong section for 'info' command");
+  uint64_t count = 0;
+  if (const HllResult result = storage_->pfCount(args, count);
+      result != HllResult::Ok) {
+    return encodeHllError(result);
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(count));
 }
 
 std::string
-CommandHandler::handleReplconf(const std::vector<std::string> &args) {
-  // For this challenge, we ignore the arguments
-  // and just respond with +OK\r\n
+CommandHandler::handlePfmerge(const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'pfmerge' command");
+  }
+
+  if (const HllResult result = storage_->pfMerge(args[0], args.subspan(1));
+      result != HllResult::Ok) {
+    return encodeHllError(result);
+  }
   return RESPParser::encodeSimpleString("OK");
 }
 
-std::string CommandHandler::handlePsync(const std::vector<std::string> &args) {
-  // PSYNC expects 2 arguments: replication_id and offset
+std::string
+CommandHandler::handleHset(const std::span<const std::string> args) const {
+  if (args.size() < 3 || args.size() % 2 == 0) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'hset' command");
+  }
+
+  std::size_t added = 0;
+  if (!storage_->hset(args[0], args.subspan(1), added)) {
+    return std::string(shared::kWrongType);
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(added));
+}
+
+void CommandHandler::handleHget(const std::span<const std::string> args,
+                                std::string &out) const {
   if (args.size() != 2) {
+    appendArityError(out, "hget");
+    return;
+  }
+
+  std::optional<std::string> value;
+  if (!storage_->hget(args[0], args[1], value)) {
+    out += shared::kWrongType;
+  } else if (value) {
+    RESPParser::appendBulkString(out, *value);
+  } else {
+    out += shared::kNullBulk;
+  }
+}
+
+void CommandHandler::handleHgetall(const Client &client,
+                                   const std::span<const std::string> args,
+                                   std::string &out) const {
+  if (args.size() != 1) {
+    appendArityError(out, "hgetall");
+    return;
+  }
+
+  // The reply is encoded straight from the stored hash, with no copy of
+  // its fields in between. RESP3 clients get a map.
+  bool found = false;
+  const bool ok = storage_->hgetall(
+      args[0],
+      [&](const std::size_t fields) {
+        found = true;
+        if (client.protocolVersion >= 3) {
+          out += '%';
+          out += std::to_string(fields);
+          out += "\r\n";
+        } else {
+          RESPParser::appendArrayHeader(out, fields * 2);
+        }
+      },
+      [&](const std::string_view field, const std::string_view value) {
+        RESPParser::appendBulkString(out, field);
+        RESPParser::appendBulkString(out, value);
+      });
+  if (!ok) {
+    out += shared::kWrongType;
+  } else if (!found) {
+    out += client.protocolVersion >= 3 ? "%0\r\n" : shared::kEmptyArray;
+  }
+}
+
+std::string
+CommandHandler::handleHdel(const std::span<const std::string> args) const {
+  if (args.size() < 2) {
     return RESPParser::encodeError(
-        "ERR wrong number of arguments for 'psync' command");
+        "ERR wrong number of arguments for 'hdel' command");
   }
 
-  // For full resynchronization, we respond with:
-  // +FULLRESYNC <REPL_ID> 0\r\n
-  const std::string replId = "8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb";
-  const std::string offset = "0";
-  const std::string response = "FULLRESYNC " + replId + " " + offset;
+  std::size_t removed = 0;
+  if (!storage_->hdel(args[0], args.subspan(1), removed)) {
+    return std::string(shared::kWrongType);
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(removed));
+}
 
-  return RESPParser::encodeSimpleString(response);
+std::string
+CommandHandler::handleHlen(const std::span<const std::string> args) const {
+  if (args.size() != 1) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'hlen' command");
+  }
+
+  std::size_t length = 0;
+  if (!storage_->hlen(args[0], length)) {
+    return std::string(shared::kWrongType);
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(length));
+}
+
+std::string
+CommandHandler::handleBfReserve(const std::span<const std::string> args) const {
+  if (args.size() < 3) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'bf.reserve' command");
+  }
+
+  BloomFilter::Options options = defaultBloomOptions(*config_);
+  long double errorRate = 0;
+  if (!parseLongDouble(args[1], errorRate) ||
+      !BloomFilter::validErrorRate(static_cast<double>(errorRate))) {
+    return RESPParser::encodeError("ERR bad error rate");
+  }
+  options.errorRate = static_cast<double>(errorRate);
+  int64_t capacity = 0;
+  if (!parseInt64(args[2], capacity)) {
+    return RESPParser::encodeError("ERR bad capacity");
+  }
+  if (capacity <= 0) {
+    return RESPParser::encodeError("ERR (capacity should be larger than 0)");
+  }
+  if (!BloomFilter::validCapacity(static_cast<uint64_t>(capacity))) {
+    return RESPParser::encodeError("ERR (capacity is too large)");
+  }
+  options.capacity = static_cast<uint64_t>(capacity);
+
+  bool expansionGiven = false;
+  bool nonScaling = false;
+  for (std::size_t i = 3; i < args.size(); i++) {
+    if (equalsIgnoreCase(args[i], "NONSCALING")) {
+      nonScaling = true;
+    } else if (equalsIgnoreCase(args[i], "EXPANSION") &&
+               i + 1 < args.size()) {
+      int64_t expansion = 0;
+      if (!parseInt64(args[++i], expansion) || expansion < 1) {
+        return RESPParser::encodeError(
+            "ERR expansion should be greater or equal to 1");
+      }
+      if (expansion > BloomFilter::kMaxExpansion) {
+        return RESPParser::encodeError("ERR (expansion is too large)");
+      }
+      options.expansion = static_cast<unsigned>(expansion);
+      expansionGiven = true;
+    } else {
+      return std::string(shared::kSyntaxError);
+    }
+  }
+  if (nonScaling) {
+    if (expansionGiven) {
+      return RESPParser::encodeError("ERR Nonscaling filters cannot expand");
+    }
+    options.expansion = 0;
+  }
+
+  if (!storage_->bfReserve(args[0], options)) {
+    return RESPParser::encodeError("ERR item exists");
+  }
+  return std::string(shared::kOk);
+}
+
+void CommandHandler::handleBfAdd(const std::string_view cmd,
+                                 const std::span<const std::string> args,
+                                 std::string &out) const {
+  const bool multi = cmd == "bf.madd";
+  if (multi ? args.size() < 2 : args.size() != 2) {
+    appendArityError(out, cmd);
+    return;
+  }
+
+  std::vector<BloomFilter::AddResult> results;
+  results.reserve(args.size() - 1);
+  if (!storage_->bfAdd(args[0], args.subspan(1), defaultBloomOptions(*config_),
+                       results)) {
+    out += shared::kWrongType;
+    return;
+  }
+
+  // BF.MADD reports a full filter per item, BF.ADD as its reply.
+  if (multi) {
+    RESPParser::appendArrayHeader(out, results.size());
+  }
+  for (const BloomFilter::AddResult result : results) {
+    switch (result) {
+    case BloomFilter::AddResult::Added:
+      out += shared::kOne;
+      break;
+    case BloomFilter::AddResult::Exists:
+      out += shared::kZero;
+      break;
+    case BloomFilter::AddResult::Full:
+      RESPParser::appendError(out, "ERR non scaling filter is full");
+      break;
+    }
+  }
+}
+
+void CommandHandler::handleBfExists(const std::string_view cmd,
+                                    const std::span<const std::string> args,
+                                    std::string &out) const {
+  const bool multi = cmd == "bf.mexists";
+  if (multi ? args.size() < 2 : args.size() != 2) {
+    appendArityError(out, cmd);
+    return;
+  }
+
+  std::vector<bool> found;
+  found.reserve(args.size() - 1);
+  if (!storage_->bfExists(args[0], args.subspan(1), found)) {
+    out += shared::kWrongType;
+    return;
+  }
+
+  if (multi) {
+    RESPParser::appendArrayHeader(out, found.size());
+  }
+  for (const bool present : found) {
+    out += present ? shared::kOne : shared::kZero;
+  }
+}
+
+void CommandHandler::handleBfInfo(const Client &client,
+                                  const std::span<const std::string> args,
+                                  std::string &out) const {
+  if (args.empty() || args.size() > 2) {
+    appendArityError(out, "bf.info");
+    return;
+  }
+
+  std::optional<BloomInfo> info;
+  if (!storage_->bfInfo(args[0], info)) {
+    out += shared::kWrongType;
+    return;
+  }
+  if (!info) {
+    RESPParser::appendError(out, "ERR not found");
+    return;
+  }
+
+  const std::pair<std::string_view, uint64_t> fields[] = {
+      {"Capacity", info->capacity},
+      {"Size", info->bytes},
+      {"Number of filters", info->filters},
+      {"Number of items inserted", info->items},
+      {"Expansion rate", info->expansion},
+  };
+  // Non-scaling filters have no expansion rate.
+  const auto appendValue = [&](const std::string_view name,
+                               const uint64_t value) {
+    if (name == "Expansion rate" && value == 0) {
+      out += shared::kNullBulk;
+    } else {
+      RESPParser::appendInteger(out, static_cast<int64_t>(value));
+    }
+  };
+
+  if (args.size() == 2) {
+    // A single field, named as in RedisBloom, comes back as a one-element
+    // array.
+    constexpr std::string_view names[] = {"CAPACITY", "SIZE", "FILTERS",
+                                          "ITEMS", "EXPANSION"};
+    for (std::size_t i = 0; i < std::size(names); i++) {
+      if (equalsIgnoreCase(args[1], names[i])) {
+        RESPParser::appendArrayHeader(out, 1);
+        appendValue(fields[i].first, fields[i].second);
+        return;
+      }
+    }
+    RESPParser::appendError(out, "ERR Invalid information value");
+    return;
+  }
+
+  if (client.protocolVersion >= 3) {
+    out += '%';
+    out += std::to_string(std::size(fields));
+    out += "\r\n";
+  } else {
+    RESPParser::appendArrayHeader(out, std::size(fields) * 2);
+  }
+  for (const auto &[name, value] : fields) {
+    RESPParser::appendSimpleString(out, name);
+    appendValue(name, value);
+  }
+}
+
+std::string
+CommandHandler::handleType(const std::span<const std::string> args) const {
+  if (args.size() != 1) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'type' command");
+  }
+
+  const auto type = storage_->type(args[0]);
+  if (!type) {
+    return RESPParser::encodeSimpleString("none");
+  }
+  switch (*type) {
+  case ValueType::Hash:
+    return RESPParser::encodeSimpleString("hash");
+  case ValueType::Set:
+    return RESPParser::encodeSimpleString("set");
+  case ValueType::Bloom:
+    // The name RedisBloom registers its type under.
+    return RESPParser::encodeSimpleString("MBbloom--");
+  default:
+    return RESPParser::encodeSimpleString("string");
+  }
+}
+
+std::string
+CommandHandler::handleSadd(const std::span<const std::string> args) const {
+  if (args.size() < 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'sadd' command");
+  }
+
+  std::size_t added = 0;
+  if (!storage_->sadd(args[0], args.subspan(1), added)) {
+    return std::string(shared::kWrongType);
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(added));
+}
+
+std::string
+CommandHandler::handleSrem(const std::span<const std::string> args) const {
+  if (args.size() < 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'srem' command");
+  }
+
+  std::size_t removed = 0;
+  if (!storage_->srem(args[0], args.subspan(1), removed)) {
+    return std::string(shared::kWrongType);
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(removed));
+}
+
+std::string
+CommandHandler::handleSismember(const std::span<const std::string> args) const {
+  if (args.size() != 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'sismember' command");
+  }
+
+  bool found = false;
+  if (!storage_->sismember(args[0], args[1], found)) {
+    return std::string(shared::kWrongType);
+  }
+  return std::string(found ? shared::kOne : shared::kZero);
+}
+
+std::string
+CommandHandler::handleScard(const std::span<const std::string> args) const {
+  if (args.size() != 1) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'scard' command");
+  }
+
+  std::size_t length = 0;
+  if (!storage_->scard(args[0], length)) {
+    return std::string(shared::kWrongType);
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(length));
+}
+
+void CommandHandler::handleSmembers(const Client &client,
+                                    const std::span<const std::string> args,
+                                    std::string &out) const {
+  if (args.size() != 1) {
+    appendArityError(out, "smembers");
+    return;
+  }
+
+  bool found = false;
+  const bool ok = storage_->smembers(
+      args[0],
+      [&](const std::size_t members) {
+        found = true;
+        appendSetHeader(client, members, out);
+      },
+      [&](const std::string_view member) {
+        RESPParser::appendBulkString(out, member);
+      });
+  if (!ok) {
+    out += shared::kWrongType;
+  } else if (!found) {
+    appendSetHeader(client, 0, out);
+  }
+}
+
+void CommandHandler::handleSetOperation(const Client &client,
+                                        const std::string_view cmd,
+                                        const std::span<const std::string> args,
+                                        std::string &out) const {
+  if (args.empty()) {
+    appendArityError(out, cmd);
+    return;
+  }
+
+  SetMembers result;
+  const bool ok = cmd == "sinter"   ? storage_->sinter(args, result)
+                  : cmd == "sunion" ? storage_->sunion(args, result)
+                                    : storage_->sdiff(args, result);
+  if (!ok) {
+    out += shared::kWrongType;
+    return;
+  }
+
+  appendSetHeader(client, result.ints.size() + result.strings.size(), out);
+  char buffer[20];
+  for (const int64_t value : result.ints) {
+    const auto [end, ec] =
+        std::to_chars(buffer, buffer + sizeof(buffer), value);
+    RESPParser::appendBulkString(out, std::string_view(buffer, end));
+  }
+  for (const std::string &member : result.strings) {
+    RESPParser::appendBulkString(out, member);
+  }
+}
+
+std::string
+CommandHandler::handleConfig(const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'config' command");
+  }
+
+  std::string subcmd = args[0];
+  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+
+  if (subcmd == "RESETSTAT") {
+    metrics_->resetStats();
+    return RESPParser::encodeSimpleString("OK");
+  }
+  if (args.size() < 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'config' command");
+  }
+
+  if (subcmd == "GET") {
+    std::string param = args[1];
+    std::ranges::transform(param, param.begin(), ::tolower);
+
+    std::string value;
+    if (param == "dir") {
+      value = config_->getDir();
+    } else if (param == "dbfilename") {
+      value = config_->getDbFilename();
+    } else if (param == "bind") {
+      value = config_->getBindAddress();
+    } else if (param == "unixsocket") {
+      value = config_->getUnixSocket();
+    } else if (param == "tcp-backlog") {
+      value = std::to_string(config_->getTcpBacklog());
+    } else if (param == "tcp-keepalive") {
+      value = std::to_string(config_->getTcpKeepAlive());
+    } else if (param == "rdbcompression") {
+      value = config_->getRdbCompression() ? "yes" : "no";
+    } else if (param == "rdbchecksum") {
+      value = config_->getRdbChecksum() ? "yes" : "no";
+    } else if (param == "value-compression") {
+      value = config_->getValueCompression() ? "yes" : "no";
+    } else if (param == "value-compression-threshold") {
+      value = std::to_string(config_->getValueCompressionThreshold());
+    } else if (param == "hll-sparse-max-bytes") {
+      value = std::to_string(config_->getHllSparseMaxBytes());
+    } else if (param == "hash-max-listpack-entries") {
+      value = std::to_string(config_->getHashMaxListpackEntries());
+    } else if (param == "hash-max-listpack-value") {
+      value = std::to_string(config_->getHashMaxListpackValue());
+    } else if (param == "set-max-intset-entries") {
+      value = std::to_string(config_->getSetMaxIntsetEntries());
+    } else if (param == "bf-error-rate") {
+      formatLongDouble(config_->getBfErrorRate(), value);
+    } else if (param == "bf-initial-size") {
+      value = std::to_string(config_->getBfInitialSize());
+    } else if (param == "bf-expansion-factor") {
+      value = std::to_string(config_->getBfExpansionFactor());
+    } else if (param == "cluster-enabled") {
+      value = config_->getClusterEnabled() ? "yes" : "no";
+    } else if (param == "cluster-announce-ip") {
+      value = config_->getClusterAnnounceIp();
+    } else if (param == "io-threads") {
+      value = std::to_string(config_->getIoThreads());
+    } else if (param == "maxclients") {
+      value = std::to_string(config_->getMaxClients());
+    } else if (param == "timeout") {
+      value = std::to_string(config_->getTimeout());
+    } else if (param == "client-output-buffer-limit") {
+      constexpr const char *names[] = {"normal", "replica", "pubsub"};
+      for (std::size_t i = 0; i < std::size(names); i++) {
+        const OutputBufferLimit &limit =
+            config_->getOutputBufferLimit(static_cast<ClientClass>(i));
+        value += std::string(i == 0 ? "" : " ") + names[i] + " " +
+                 std::to_string(limit.hardBytes) + " " +
+                 std::to_string(limit.softBytes) + " " +
+                 std::to_string(limit.softSeconds);
+      }
+    } else if (param == "slowlog-log-slower-than") {
+      value = std::to_string(metrics_->slowLog().slowerThanUsec());
+    } else if (param == "slowlog-max-len") {
+      value = std::to_string(metrics_->slowLog().maxLen());
+    } else if (param == "latency-monitor-threshold") {
+      value = std::to_string(metrics_->latencyMonitor().thresholdMs());
+    } else if (param == "hotkeys-sample-rate") {
+      value = std::to_string(metrics_->hotKeys().sampleRate());
+    } else if (param == "bigkeys-scan") {
+      value = metrics_->bigKeys().enabled() ? "yes" : "no";
+    } else {
+      return RESPParser::encodeArray({});
+    }
+
+    return RESPParser::encodeArray({param, value});
+  } else if (subcmd == "SET") {
+    if (args.size() != 3) {
+      return RESPParser::encodeError(
+          "ERR wrong number of arguments for 'config|set' command");
+    }
+
+    std::string param = args[1];
+    std::ranges::transform(param, param.begin(), ::tolower);
+
+    int64_t value = 0;
+    if (!parseInt64(args[2], value)) {
+      return RESPParser::encodeError("ERR CONFIG SET failed (possibly related "
+                                     "to argument '" +
+                                     param + "') - argument must be a number");
+    }
+
+    if (param == "slowlog-log-slower-than") {
+      metrics_->slowLog().setSlowerThanUsec(value);
+    } else if (param == "slowlog-max-len" && value >= 0) {
+      metrics_->slowLog().setMaxLen(static_cast<std::size_t>(value));
+    } else if (param == "latency-monitor-threshold" && value >= 0) {
+      metrics_->latencyMonitor().setThresholdMs(value);
+    } else if (param == "hotkeys-sample-rate" && value >= 0 &&
+               value <= UINT32_MAX) {
+      metrics_->hotKeys().setSampleRate(static_cast<uint32_t>(value));
+    } else {
+      return RESPParser::encodeError("ERR Unknown option or number of "
+                                     "arguments for CONFIG SET - '" +
+                                     param + "'");
+    }
+    return RESPParser::encodeSimpleString("OK");
+  } else {
+    return RESPParser::encodeError("ERR Unknown CONFIG subcommand");
+  }
+}
+
+std::string CommandHandler::handleSave() const {
+  // Both would write the same temporary file.
+  if (backgroundSave_->inProgress()) {
+    return RESPParser::encodeError("ERR Background save already in progress");
+  }
+  RDBWriter writer(config_->getRdbCompression(), config_->getRdbChecksum());
+  const bool ok = writer.writeFile(
+      config_->getDir() + "/" + config_->getDbFilename(), *storage_);
+  backgroundSave_->finished(ok);
+  if (!ok) {
+    return RESPParser::encodeError("ERR");
+  }
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string CommandHandler::handleBgsave() const {
+  if (!backgroundSave_->start(
+          storage_, config_->getDir() + "/" + config_->getDbFilename(),
+          config_->getRdbCompression(), config_->getRdbChecksum())) {
+    return RESPParser::encodeError("ERR Background save already in progress");
+  }
+  return RESPParser::encodeSimpleString("Background saving started");
+}
+
+std::string
+CommandHandler::handleKeys(const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'keys' command");
+  }
+
+  // For now, only support the "*" pattern
+  if (args[0] != "*") {
+    return RESPParser::encodeError("ERR pattern not supported");
+  }
+
+  const auto keys = storage_->getAllKeys();
+  return RESPParser::encodeArray(keys);
+}
+
+std::string
+CommandHandler::handleInfo(const std::span<const std::string> args) const {
+  std::unordered_set<std::string> sections;
+  for (const auto &arg : args) {
+    std::string section = arg;
+    std::ranges::transform(section, section.begin(), ::tolower);
+    sections.insert(std::move(section));
+  }
+  if (sections.empty()) {
+    sections.insert("default");
+  }
+
+  const bool all = sections.contains("all") || sections.contains("everything");
+  const bool defaults = all || sections.contains("default");
+  const auto wants = [&](const std::string &name, const bool isDefault) {
+    return sections.contains(name) || (isDefault && defaults) || all;
+  };
+
+  std::string info;
+  const auto append = [&info](const std::string &section) {
+    if (!info.empty()) {
+      info += "\r\n";
+    }
+    info += section;
+  };
+
+  if (wants("server", true)) {
+    append("# Server\r\nredis_version:7.2.0\r\ntcp_port:" +
+           std::to_string(config_->getPort()) + "\r\nuptime_in_seconds:" +
+           std::to_string(metrics_->uptimeSeconds()) + "\r\n");
+  }
+  if (wants("clients", true)) {
+    append("# Clients\r\nconnected_clients:" +
+           std::to_string(metrics_->connectedClients()) +
+           "\r\nmaxclients:" + std::to_string(config_->getMaxClients()) +
+           "\r\n");
+  }
+  if (wants("memory", true)) {
+    const auto &lazyFree = storage_->lazyFree();
+    const CompressionStats compression = storage_->compressionStats();
+    // Raw bytes per stored byte over the compressed values.
+    char ratio[32];
+    std::snprintf(ratio, sizeof(ratio), "%.2f",
+                  compression.compressedBytes == 0
+                      ? 1.0
+                      : static_cast<double>(compression.rawBytes) /
+                            static_cast<double>(compression.compressedBytes));
+    append("# Memory\r\nlazyfree_pending_objects:" +
+           std::to_string(lazyFree ? lazyFree->pending() : 0) +
+           "\r\nlazyfreed_objects:" +
+           std::to_string(lazyFree ? lazyFree->freed() : 0) +
+           "\r\ncompressed_values:" + std::to_string(compression.values) +
+           "\r\ncompressed_values_raw_bytes:" +
+           std::to_string(compression.rawBytes) +
+           "\r\ncompressed_values_bytes:" +
+           std::to_string(compression.compressedBytes) +
+           "\r\nvalue_compression_ratio:" + ratio + "\r\n");
+  }
+  if (wants("persistence", true)) {
+    // Snapshots are taken in-process, so the copy-on-write cost is the
+    // values kept for the walk rather than pages copied by a fork.
+    const SnapshotStats snapshot = storage_->snapshotStats();
+    append("# Persistence\r\nrdb_bgsave_in_progress:" +
+           std::string(backgroundSave_->inProgress() ? "1" : "0") +
+           "\r\nrdb_last_save_time:" +
+           std::to_string(backgroundSave_->lastSaveTime()) +
+           "\r\nrdb_last_bgsave_status:" +
+           (backgroundSave_->lastOk() ? "ok" : "err") +
+           "\r\ncurrent_cow_size:" + std::to_string(snapshot.bytes) +
+           "\r\nrdb_last_cow_size:" + std::to_string(snapshot.lastBytes) +
+           "\r\n");
+  }
+  if (wants("stats", true)) {
+    append(metrics_->statsInfo());
+  }
+  if (wants("replication", true)) {
+    const std::string role = config_->isReplica() ? "slave" : "master";
+    std::string replication = "# Replication\r\nrole:" + role + "\r\n";
+
+    // Add master_replid and master_repl_offset for master nodes
+    if (!config_->isReplica()) {
+      replication +=
+          "master_replid:8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb\r\n";
+      replication += "master_repl_offset:0\r\n";
+    }
+    append(replication);
+  }
+  if (wants("cluster", true)) {
+    append("# Cluster\r\ncluster_enabled:" +
+           std::string(cluster_ ? "1" : "0") + "\r\n");
+  }
+  if (wants("commandstats", false)) {
+    append(metrics_->commandStatsInfo());
+  }
+  if (wants("latencystats", false)) {
+    append(metrics_->latencyStatsInfo());
+  }
+  if (wants("hotkeys", false)) {
+    append(metrics_->hotKeysInfo());
+  }
+
+  return RESPParser::encodeBulkString(info);
+}
+
+std::string
+CommandHandler::handleSlowlog(const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'slowlog' command");
+  }
+
+  std::string subcmd = args[0];
+  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+  SlowLog &slowLog = metrics_->slowLog();
+
+  if (subcmd == "LEN") {
+    return RESPParser::encodeInteger(static_cast<int64_t>(slowLog.size()));
+  } else if (subcmd == "RESET") {
+    slowLog.reset();
+    return RESPParser::encodeSimpleString("OK");
+  } else if (subcmd == "GET") {
+    int64_t count = 10;
+    if (args.size() > 1 && (!parseInt64(args[1], count) || count < -1)) {
+      return RESPParser::encodeError(
+          "ERR count should be greater than or equal to -1");
+    }
+
+    const auto entries = slowLog.latest(count);
+    std::string reply = "*" + std::to_string(entries.size()) + "\r\n";
+    for (const SlowLogEntry *entry : entries) {
+      reply += "*6\r\n";
+      reply += RESPParser::encodeInteger(static_cast<int64_t>(entry->id));
+      reply += RESPParser::encodeInteger(entry->timestamp);
+      reply +=
+          RESPParser::encodeInteger(static_cast<int64_t>(entry->durationUsec));
+      reply += RESPParser::encodeArray(entry->args);
+      reply += RESPParser::encodeBulkString(entry->clientAddress);
+      reply += RESPParser::encodeBulkString(entry->clientName);
+    }
+    return reply;
+  } else {
+    return RESPParser::encodeError("ERR unknown subcommand '" + args[0] +
+                                   "'. Try SLOWLOG HELP.");
+  }
+}
+
+std::string
+CommandHandler::handleLatency(const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'latency' command");
+  }
+
+  std::string subcmd = args[0];
+  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+  LatencyMonitor &monitor = metrics_->latencyMonitor();
+
+  if (subcmd == "LATEST") {
+    std::string body;
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < static_cast<std::size_t>(LatencyEvent::Count);
+         i++) {
+      const auto event = static_cast<LatencyEvent>(i);
+      const auto &series = monitor.series(event);
+      if (series.empty()) {
+        continue;
+      }
+
+      const auto &latest = series.samples[series.latestIndex()];
+      body += "*4\r\n";
+      body += RESPParser::encodeBulkString(
+          std::string(LatencyMonitor::eventName(event)));
+      body += RESPParser::encodeInteger(latest.time);
+      body += RESPParser::encodeInteger(latest.latencyMs);
+      body += RESPParser::encodeInteger(series.maxMs);
+      count++;
+    }
+    return "*" + std::to_string(count) + "\r\n" + body;
+  } else if (subcmd == "HISTORY") {
+    if (args.size() != 2) {
+      return RESPParser::encodeError(
+          "ERR wrong number of arguments for 'latency|history' command");
+    }
+
+    const auto event = LatencyMonitor::eventByName(args[1]);
+    if (!event) {
+      return RESPParser::encodeArray({});
+    }
+
+    const auto &series = monitor.series(*event);
+    std::string body;
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < LatencyMonitor::kSamples; i++) {
+      const auto &sample =
+          series.samples[(series.next + i) % LatencyMonitor::kSamples];
+      if (sample.time == 0) {
+        continue;
+      }
+      body += "*2\r\n";
+      body += RESPParser::encodeInteger(sample.time);
+      body += RESPParser::encodeInteger(sample.latencyMs);
+      count++;
+    }
+    return "*" + std::to_string(count) + "\r\n" + body;
+  } else if (subcmd == "RESET") {
+    int64_t reset = 0;
+    for (std::size_t i = 0; i < static_cast<std::size_t>(LatencyEvent::Count);
+         i++) {
+      const auto event = static_cast<LatencyEvent>(i);
+      const bool selected =
+          args.size() == 1 ||
+          std::ranges::find(args.begin() + 1, args.end(),
+                            LatencyMonitor::eventName(event)) != args.end();
+      if (selected && !monitor.series(event).empty()) {
+        monitor.reset(event);
+        reset++;
+      }
+    }
+    return RESPParser::encodeInteger(reset);
+  } else if (subcmd == "DOCTOR") {
+    std::string report;
+    if (monitor.thresholdMs() <= 0) {
+      report = "The latency monitor is disabled. Enable it with CONFIG SET "
+               "latency-monitor-threshold <milliseconds>.\n";
+    } else {
+      for (std::size_t i = 0;
+           i < static_cast<std::size_t>(LatencyEvent::Count); i++) {
+        const auto event = static_cast<LatencyEvent>(i);
+        if (const auto &series = monitor.series(event); !series.empty()) {
+          report += std::string(LatencyMonitor::eventName(event)) +
+                    ": worst latency " + std::to_string(series.maxMs) +
+                    " ms, latest " +
+                    std::to_string(
+                        series.samples[series.latestIndex()].latencyMs) +
+                    " ms.\n";
+        }
+      }
+      if (report.empty()) {
+        report = "No latency spikes were observed above the threshold.\n";
+      }
+    }
+    return RESPParser::encodeBulkString(report);
+  } else {
+    return RESPParser::encodeError("ERR unknown subcommand '" + args[0] +
+                                   "'. Try LATENCY HELP.");
+  }
+}
+
+std::string
+CommandHandler::handleHotkeys(const std::span<const std::string> args) const {
+  HotKeys &hotKeys = metrics_->hotKeys();
+  std::string subcmd = args.empty() ? "" : args[0];
+  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+  if (subcmd == "RESET" && args.size() == 1) {
+    hotKeys.reset();
+    return RESPParser::encodeSimpleString("OK");
+  }
+
+  std::size_t count = 0;
+  if (!parseTopCount(args, count)) {
+    return RESPParser::encodeError("ERR syntax error");
+  }
+  if (hotKeys.sampleRate() == 0) {
+    return RESPParser::encodeError(
+        "ERR hot key tracking is disabled, see hotkeys-sample-rate");
+  }
+  return encodeKeyScores(hotKeys.top(count));
+}
+
+std::string
+CommandHandler::handleBigkeys(const std::span<const std::string> args) const {
+  std::size_t count = 0;
+  if (!parseTopCount(args, count)) {
+    return RESPParser::encodeError("ERR syntax error");
+  }
+  if (!metrics_->bigKeys().enabled()) {
+    return RESPParser::encodeError(
+        "ERR the big key scan is disabled, see bigkeys-scan");
+  }
+  return encodeKeyScores(metrics_->bigKeys().top(count));
+}
+
+std::string
+CommandHandler::handleMemory(const std::span<const std::string> args) const {
+  std::string subcmd = args.empty() ? "" : args[0];
+  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+  if (subcmd != "USAGE") {
+    return RESPParser::encodeError("ERR unknown subcommand '" +
+                                   (args.empty() ? "" : args[0]) +
+                                   "'. Try MEMORY HELP.");
+  }
+  if (args.size() < 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'memory|usage' command");
+  }
+
+  // SAMPLES bounds how many fields of a hash table are looked at; 0 sizes
+  // every one. Strings and listpacks are sized exactly.
+  int64_t samples = Storage::kMemorySamples;
+  if (args.size() > 2) {
+    std::string option = args[2];
+    std::ranges::transform(option, option.begin(), ::toupper);
+    if (args.size() != 4 || option != "SAMPLES" ||
+        !parseInt64(args[3], samples) || samples < 0) {
+      return RESPParser::encodeError("ERR syntax error");
+    }
+  }
+
+  const auto bytes =
+      storage_->memoryUsage(args[1], static_cast<std::size_t>(samples));
+  if (!bytes) {
+    return RESPParser::encodeNull();
+  }
+  return RESPParser::encodeInteger(static_cast<int64_t>(*bytes));
+}
+
+std::string
+CommandHandler::handleMetrics(const std::span<const std::string> args) const {
+  if (!args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'metrics' command");
+  }
+  return RESPParser::encodeBulkString(metrics_->prometheus());
+}
+
+std::string
+CommandHandler::handleReplconf(const std::span<const std::string> args) {
+  // For this challenge, we ignore the arguments
+  // and just respond with +OK\r\n
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string
+CommandHandler::handlePsync(const std::span<const std::string> args) {
+  // PSYNC expects 2 arguments: replication_id and offset
+  if (args.size() != 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'psync' command");
+  }
+
+  // For full resynchronization, we respond with:
+  // +FULLRESYNC <REPL_ID> 0\r\n
+  const std::string replId = "8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb";
+  const std::string offset = "0";
+  const std::string response = "FULLRESYNC " + replId + " " + offset;
+
+  return RESPParser::encodeSimpleString(response);
+}
+
+std::string CommandHandler::handleMulti(Client &client) {
+  if (client.inMulti) {
+    return RESPParser::encodeError("ERR MULTI calls can not be nested");
+  }
+
+  client.inMulti = true;
+  return RESPParser::encodeSimpleString("OK");
+}
+
+void CommandHandler::handleExec(Client &client, std::string &out) const {
+  if (!client.inMulti) {
+    RESPParser::appendError(out, "ERR EXEC without MULTI");
+    return;
+  }
+
+  // WATCH is optimistic: nothing was locked, so the transaction only runs if
+  // every watched key still carries the version observed when it was watched.
+  bool dirty = false;
+  for (const auto &[key, version] : client.watchedKeys) {
+    if (storage_->getVersion(key) != version) {
+      dirty = true;
+      break;
+    }
+  }
+
+  const bool aborted = client.multiError;
+  auto queued = std::move(client.queuedCommands);
+  client.queuedCommands.clear();
+  client.inMulti = false;
+  client.multiError = false;
+  unwatchAll(client);
+
+  if (aborted) {
+    RESPParser::appendError(
+        out, "EXECABORT Transaction discarded because of previous errors.");
+    return;
+  }
+  if (dirty) {
+    out += client.protocolVersion >= 3 ? shared::kNull : shared::kNullArray;
+    return;
+  }
+
+  // Run the queued batch back-to-back, each reply going straight into the
+  // array, so the client receives the whole result in a single write.
+  RESPParser::appendArrayHeader(out, queued.size());
+  for (const auto &command : queued) {
+    handleCommand(client, command, out);
+  }
+}
+
+std::string CommandHandler::handleDiscard(Client &client) const {
+  if (!client.inMulti) {
+    return RESPParser::encodeError("ERR DISCARD without MULTI");
+  }
+
+  client.queuedCommands.clear();
+  client.inMulti = false;
+  client.multiError = false;
+  unwatchAll(client);
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string
+CommandHandler::handleWatch(Client &client,
+                            const std::span<const std::string> args) const {
+  if (client.inMulti) {
+    return RESPParser::encodeError("ERR WATCH inside MULTI is not allowed");
+  }
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'watch' command");
+  }
+
+  for (const auto &key : args) {
+    // Keep the first observed version if a key is watched twice.
+    if (!client.watchedKeys.contains(key)) {
+      client.watchedKeys.emplace(key, storage_->watch(key));
+    }
+  }
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string CommandHandler::handleUnwatch(Client &client) const {
+  unwatchAll(client);
+  return RESPParser::encodeSimpleString("OK");
+}
+
+void CommandHandler::unwatchAll(Client &client) const {
+  for (const auto &[key, version] : client.watchedKeys) {
+    storage_->unwatch(key);
+  }
+  client.watchedKeys.clear();
+}
+
+std::string
+CommandHandler::handleSubscribe(Client &client,
+                                const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'subscribe' command");
+  }
+
+  std::string reply;
+  for (const auto &channel : args) {
+    pubsub_->subscribe(client, channel);
+    reply += encodeSubscription(client, "subscribe", &channel);
+  }
+  return reply;
+}
+
+std::string CommandHandler::handleUnsubscribe(
+    Client &client, const std::span<const std::string> args) const {
+  const std::vector<std::string> channels =
+      args.empty() ? std::vector<std::string>(client.channels.begin(),
+                                              client.channels.end())
+                   : std::vector<std::string>(args.begin(), args.end());
+  if (channels.empty()) {
+    return encodeSubscription(client, "unsubscribe", nullptr);
+  }
+
+  std::string reply;
+  for (const auto &channel : channels) {
+    pubsub_->unsubscribe(client, channel);
+    reply += encodeSubscription(client, "unsubscribe", &channel);
+  }
+  return reply;
+}
+
+std::string CommandHandler::handlePsubscribe(
+    Client &client, const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'psubscribe' command");
+  }
+
+  std::string reply;
+  for (const auto &pattern : args) {
+    pubsub_->psubscribe(client, pattern);
+    reply += encodeSubscription(client, "psubscribe", &pattern);
+  }
+  return reply;
+}
+
+std::string CommandHandler::handlePunsubscribe(
+    Client &client, const std::span<const std::string> args) const {
+  const std::vector<std::string> patterns =
+      args.empty() ? std::vector<std::string>(client.patterns.begin(),
+                                              client.patterns.end())
+                   : std::vector<std::string>(args.begin(), args.end());
+  if (patterns.empty()) {
+    return encodeSubscription(client, "punsubscribe", nullptr);
+  }
+
+  std::string reply;
+  for (const auto &pattern : patterns) {
+    pubsub_->punsubscribe(client, pattern);
+    reply += encodeSubscription(client, "punsubscribe", &pattern);
+  }
+  return reply;
+}
+
+std::string
+CommandHandler::handlePublish(const std::span<const std::string> args) const {
+  if (args.size() != 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'publish' command");
+  }
+
+  const std::size_t receivers = pubsub_->publish(args[0], args[1]);
+  return RESPParser::encodeInteger(static_cast<int64_t>(receivers));
+}
+
+std::string
+CommandHandler::handleHello(Client &client,
+                            const std::span<const std::string> args) const {
+  int protocol = client.protocolVersion;
+  if (!args.empty()) {
+    if (args[0] == "2") {
+      protocol = 2;
+    } else if (args[0] == "3") {
+      protocol = 3;
+    } else {
+      return RESPParser::encodeError("NOPROTO unsupported protocol version");
+    }
+  }
+  client.protocolVersion = protocol;
+
+  const std::string role = config_->isReplica() ? "slave" : "master";
+  const std::vector<std::pair<std::string, std::string>> fields = {
+      {"server", RESPParser::encodeBulkString("redis")},
+      {"version", RESPParser::encodeBulkString("7.2.0")},
+      {"proto", RESPParser::encodeInteger(protocol)},
+      {"id", RESPParser::encodeInteger(static_cast<int64_t>(client.id))},
+      {"mode", RESPParser::encodeBulkString("standalone")},
+      {"role", RESPParser::encodeBulkString(role)},
+      {"modules", RESPParser::encodeArray({})},
+  };
+
+  // RESP3 replies with a map; RESP2 flattens it into key/value pairs.
+  std::string reply = protocol >= 3
+                          ? "%" + std::to_string(fields.size()) + "\r\n"
+                          : "*" + std::to_string(fields.size() * 2) + "\r\n";
+  for (const auto &[name, value] : fields) {
+    reply += RESPParser::encodeBulkString(name);
+    reply += value;
+  }
+  return reply;
+}
+
+std::string
+CommandHandler::handleClient(Client &client,
+                             const std::span<const std::string> args) const {
+  std::string subcmd = args.empty() ? "" : args[0];
+  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+
+  if (subcmd == "ID") {
+    return RESPParser::encodeInteger(static_cast<int64_t>(client.id));
+  } else if (subcmd == "TRACKING") {
+    return handleClientTracking(
+        client, std::vector<std::string>(args.begin() + 1, args.end()));
+  } else if (subcmd == "LIST") {
+    return handleClientList(args.subspan(1));
+  } else if (subcmd == "KILL") {
+    return handleClientKill(client, args.subspan(1));
+  } else if (subcmd == "SETNAME") {
+    if (args.size() != 2) {
+      return RESPParser::encodeError(
+          "ERR wrong number of arguments for 'client|setname' command");
+    }
+    const bool valid = std::ranges::all_of(
+        args[1], [](const char c) { return c > ' ' && c <= '~'; });
+    if (!valid) {
+      return RESPParser::encodeError(
+          "ERR Client names cannot contain spaces, newlines or special "
+          "characters.");
+    }
+    client.name = args[1];
+    return RESPParser::encodeSimpleString("OK");
+  } else if (subcmd == "GETNAME") {
+    return client.name.empty() ? RESPParser::encodeNull()
+                               : RESPParser::encodeBulkString(client.name);
+  } else {
+    return RESPParser::encodeError("ERR unknown subcommand '" +
+                                   (args.empty() ? "" : args[0]) +
+                                   "'. Try CLIENT HELP.");
+  }
+}
+
+std::string CommandHandler::handleClientList(
+    const std::span<const std::string> args) const {
+  bool filterClass = false;
+  ClientClass clientClass = ClientClass::Normal;
+  std::unordered_set<uint64_t> ids;
+
+  if (args.size() == 2 && equalsIgnoreCase(args[0], "TYPE")) {
+    if (!parseClientClass(args[1], clientClass)) {
+      return RESPParser::encodeError("ERR Unknown client type '" + args[1] +
+                                     "'");
+    }
+    filterClass = true;
+  } else if (args.size() >= 2 && equalsIgnoreCase(args[0], "ID")) {
+    for (const std::string &arg : args.subspan(1)) {
+      int64_t id = 0;
+      if (!parseInt64(arg, id) || id <= 0) {
+        return RESPParser::encodeError("ERR Invalid client ID");
+      }
+      ids.insert(static_cast<uint64_t>(id));
+    }
+  } else if (!args.empty()) {
+    return RESPParser::encodeError("ERR syntax error");
+  }
+
+  // Listed in connection order, as Redis does.
+  std::vector<const Client *> clients;
+  for (const auto &[id, client] : registry_->clients()) {
+    if ((!filterClass || client->clientClass() == clientClass) &&
+        (ids.empty() || ids.contains(id))) {
+      clients.push_back(client);
+    }
+  }
+  std::ranges::sort(clients, {}, &Client::id);
+
+  const int64_t now = ServerClock::monotonicMs();
+  std::string list;
+  for (const Client *client : clients) {
+    list += describeClient(*client, now);
+  }
+  return RESPParser::encodeBulkString(list);
+}
+
+std::string CommandHandler::handleClientKill(
+    Client &client, const std::span<const std::string> args) const {
+  // The connection is closed by the event loop at the end of the current
+  // iteration; killing the caller lets it receive this reply first.
+  const auto kill = [&](Client &target) {
+    if (&target == &client) {
+      target.closeAfterReply = true;
+    } else {
+      target.closeAsap = true;
+    }
+  };
+
+  // Old form: CLIENT KILL addr:port
+  if (args.size() == 1) {
+    for (const auto &[id, target] : registry_->clients()) {
+      if (target->address == args[0] && !target->closeAsap) {
+        kill(*target);
+        return RESPParser::encodeSimpleString("OK");
+      }
+    }
+    return RESPParser::encodeError("ERR No such client");
+  }
+
+  if (args.empty() || args.size() % 2 != 0) {
+    return RESPParser::encodeError("ERR syntax error");
+  }
+
+  uint64_t id = 0;
+  const std::string *address = nullptr;
+  bool filterClass = false;
+  ClientClass clientClass = ClientClass::Normal;
+  bool skipMe = true;
+
+  for (std::size_t i = 0; i < args.size(); i += 2) {
+    const std::string &value = args[i + 1];
+    if (equalsIgnoreCase(args[i], "ID")) {
+      int64_t parsed = 0;
+      if (!parseInt64(value, parsed) || parsed <= 0) {
+        return RESPParser::encodeError(
+            "ERR client-id should be greater than 0");
+      }
+      id = static_cast<uint64_t>(parsed);
+    } else if (equalsIgnoreCase(args[i], "ADDR")) {
+      address = &value;
+    } else if (equalsIgnoreCase(args[i], "TYPE")) {
+      if (!parseClientClass(value, clientClass)) {
+        return RESPParser::encodeError("ERR Unknown client type '" + value +
+                                       "'");
+      }
+      filterClass = true;
+    } else if (equalsIgnoreCase(args[i], "SKIPME")) {
+      if (equalsIgnoreCase(value, "yes")) {
+        skipMe = true;
+      } else if (equalsIgnoreCase(value, "no")) {
+        skipMe = false;
+      } else {
+        return RESPParser::encodeError("ERR syntax error");
+      }
+    } else {
+      return RESPParser::encodeError("ERR syntax error");
+    }
+  }
+
+  int64_t killed = 0;
+  for (const auto &[targetId, target] : registry_->clients()) {
+    if ((id != 0 && targetId != id) ||
+        (address != nullptr && target->address != *address) ||
+        (filterClass && target->clientClass() != clientClass) ||
+        (skipMe && target == &client) || target->closeAsap) {
+      continue;
+    }
+    kill(*target);
+    killed++;
+  }
+  return RESPParser::encodeInteger(killed);
+}
+
+std::string CommandHandler::handleClientTracking(
+    Client &client, const std::span<const std::string> args) const {
+  if (args.empty()) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'client|tracking' command");
+  }
+
+  std::string mode = args[0];
+  std::ranges::transform(mode, mode.begin(), ::toupper);
+
+  if (mode == "OFF") {
+    tracking_->disable(client);
+    return RESPParser::encodeSimpleString("OK");
+  }
+  if (mode != "ON") {
+    return RESPParser::encodeError("ERR syntax error");
+  }
+
+  bool bcast = false;
+  bool noLoop = false;
+  uint64_t redirect = 0;
+  std::vector<std::string> prefixes;
+
+  for (std::size_t i = 1; i < args.size(); i++) {
+    std::string option = args[i];
+    std::ranges::transform(option, option.begin(), ::toupper);
+
+    if (option == "BCAST") {
+      bcast = true;
+    } else if (option == "NOLOOP") {
+      noLoop = true;
+    } else if (option == "PREFIX" && i + 1 < args.size()) {
+      prefixes.push_back(args[++i]);
+    } else if (option == "REDIRECT" && i + 1 < args.size()) {
+      int64_t id = 0;
+      if (!parseInt64(args[++i], id) || id <= 0) {
+        return RESPParser::encodeError(
+            "ERR value is not an integer or out of range");
+      }
+      redirect = static_cast<uint64_t>(id);
+    } else {
+      return RESPParser::encodeError("ERR syntax error");
+    }
+  }
+
+  if (!prefixes.empty() && !bcast) {
+    return RESPParser::encodeError(
+        "ERR PREFIX option requires BCAST mode to be enabled");
+  }
+  for (std::size_t i = 0; i < prefixes.size(); i++) {
+    for (std::size_t j = 0; j < prefixes.size(); j++) {
+      if (i != j && prefixes[j].starts_with(prefixes[i])) {
+        return RESPParser::encodeError("ERR Prefix '" + prefixes[i] +
+                                       "' overlaps with another provided "
+                                       "prefix '" +
+                                       prefixes[j] +
+                                       "'. Prefixes for a single client must "
+                                       "not overlap.");
+      }
+    }
+  }
+
+  tracking_->enable(client, bcast, noLoop, redirect, std::move(prefixes));
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string
+CommandHandler::handleCluster(const std::span<const std::string> args) const {
+  if (!cluster_) {
+    return RESPParser::encodeError(
+        "ERR This instance has cluster support disabled");
+  }
+
+  std::string subcmd = args.empty() ? "" : args[0];
+  std::ranges::transform(subcmd, subcmd.begin(), ::toupper);
+  const auto arityError = [&] {
+    std::string name = subcmd;
+    std::ranges::transform(name, name.begin(), ::tolower);
+    return RESPParser::encodeError("ERR wrong number of arguments for "
+                                   "'cluster|" +
+                                   name + "' command");
+  };
+
+  if (subcmd == "MYID") {
+    return RESPParser::encodeBulkString(cluster_->myself().id);
+  } else if (subcmd == "KEYSLOT") {
+    if (args.size() != 2) {
+      return arityError();
+    }
+    return RESPParser::encodeInteger(Cluster::keySlot(args[1]));
+  } else if (subcmd == "COUNTKEYSINSLOT" || subcmd == "GETKEYSINSLOT") {
+    const bool get = subcmd == "GETKEYSINSLOT";
+    if (args.size() != (get ? 3 : 2)) {
+      return arityError();
+    }
+    int64_t slot = 0;
+    if (!parseInt64(args[1], slot) || slot < 0 ||
+        slot >= static_cast<int64_t>(kClusterSlots)) {
+      return RESPParser::encodeError("ERR Invalid slot");
+    }
+    int64_t count = 0;
+    if (get && (!parseInt64(args[2], count) || count < 0)) {
+      return RESPParser::encodeError("ERR Invalid number of keys");
+    }
+
+    // There is no per-slot index, so both walk the whole keyspace.
+    std::vector<std::string> keys;
+    int64_t found = 0;
+    for (auto &key : storage_->getAllKeys()) {
+      if (Cluster::keySlot(key) != slot) {
+        continue;
+      }
+      found++;
+      if (get && static_cast<int64_t>(keys.size()) < count) {
+        keys.push_back(std::move(key));
+      }
+    }
+    return get ? RESPParser::encodeArray(keys)
+               : RESPParser::encodeInteger(found);
+  } else if (subcmd == "ADDSLOTS" || subcmd == "ADDSLOTSRANGE" ||
+             subcmd == "DELSLOTS" || subcmd == "DELSLOTSRANGE") {
+    return handleClusterSlots(args, subcmd.starts_with("ADD"),
+                              subcmd.ends_with("RANGE"));
+  } else if (subcmd == "SETSLOT") {
+    return handleClusterSetSlot(args.subspan(1));
+  } else if (subcmd == "MEET") {
+    if (args.size() < 3) {
+      return arityError();
+    }
+    int64_t port = 0;
+    if (!parseInt64(args[2], port) || port <= 0 || port > 65535) {
+      return RESPParser::encodeError("ERR Invalid base port specified: " +
+                                     args[2]);
+    }
+    cluster_->meet(args[1], static_cast<int>(port));
+    return RESPParser::encodeSimpleString("OK");
+  } else if (subcmd == "INFO") {
+    const bool ok = cluster_->assignedSlots() == kClusterSlots;
+    std::size_t size = 0;
+    for (std::size_t node = 0; node < cluster_->nodes().size(); node++) {
+      if (cluster_->slotsServedBy(static_cast<int>(node)) > 0) {
+        size++;
+      }
+    }
+    return RESPParser::encodeBulkString(
+        "cluster_enabled:1\r\ncluster_state:" +
+        std::string(ok ? "ok" : "fail") + "\r\ncluster_slots_assigned:" +
+        std::to_string(cluster_->assignedSlots()) +
+        "\r\ncluster_slots_ok:" + std::to_string(cluster_->assignedSlots()) +
+        "\r\ncluster_slots_pfail:0\r\ncluster_slots_fail:0"
+        "\r\ncluster_known_nodes:" +
+        std::to_string(cluster_->nodes().size()) +
+        "\r\ncluster_size:" + std::to_string(size) +
+        "\r\ncluster_current_epoch:0\r\ncluster_my_epoch:0\r\n");
+  } else if (subcmd == "NODES") {
+    std::string nodes;
+    for (std::size_t node = 0; node < cluster_->nodes().size(); node++) {
+      nodes += describeNode(*cluster_, static_cast<int>(node));
+    }
+    return RESPParser::encodeBulkString(nodes);
+  } else if (subcmd == "SLOTS") {
+    const auto ranges = cluster_->slotRanges();
+    std::string reply;
+    RESPParser::appendArrayHeader(reply, ranges.size());
+    for (const auto &range : ranges) {
+      const ClusterNode &node = cluster_->node(range.node);
+      RESPParser::appendArrayHeader(reply, 3);
+      RESPParser::appendInteger(reply, range.first);
+      RESPParser::appendInteger(reply, range.last);
+      RESPParser::appendArrayHeader(reply, 3);
+      RESPParser::appendBulkString(reply, node.host);
+      RESPParser::appendInteger(reply, node.port);
+      RESPParser::appendBulkString(reply, node.id);
+    }
+    return reply;
+  } else if (subcmd == "SHARDS") {
+    // Every node is its own single-master shard.
+    const auto ranges = cluster_->slotRanges();
+    std::string reply;
+    RESPParser::appendArrayHeader(reply, cluster_->nodes().size());
+    for (std::size_t i = 0; i < cluster_->nodes().size(); i++) {
+      const auto node = static_cast<int>(i);
+      const ClusterNode &info = cluster_->node(node);
+      std::string slots;
+      std::size_t bounds = 0;
+      for (const auto &range : ranges) {
+        if (range.node == node) {
+          RESPParser::appendInteger(slots, range.first);
+          RESPParser::appendInteger(slots, range.last);
+          bounds += 2;
+        }
+      }
+
+      RESPParser::appendArrayHeader(reply, 4);
+      RESPParser::appendBulkString(reply, "slots");
+      RESPParser::appendArrayHeader(reply, bounds);
+      reply += slots;
+      RESPParser::appendBulkString(reply, "nodes");
+      RESPParser::appendArrayHeader(reply, 1);
+      RESPParser::appendArrayHeader(reply, 14);
+      RESPParser::appendBulkString(reply, "id");
+      RESPParser::appendBulkString(reply, info.id);
+      RESPParser::appendBulkString(reply, "port");
+      RESPParser::appendInteger(reply, info.port);
+      RESPParser::appendBulkString(reply, "ip");
+      RESPParser::appendBulkString(reply, info.host);
+      RESPParser::appendBulkString(reply, "endpoint");
+      RESPParser::appendBulkString(reply, info.host);
+      RESPParser::appendBulkString(reply, "role");
+      RESPParser::appendBulkString(reply, "master");
+      RESPParser::appendBulkString(reply, "replication-offset");
+      RESPParser::appendInteger(reply, 0);
+      RESPParser::appendBulkString(reply, "health");
+      RESPParser::appendBulkString(reply, "online");
+    }
+    return reply;
+  } else {
+    return RESPParser::encodeError("ERR unknown subcommand '" +
+                                   (args.empty() ? "" : args[0]) +
+                                   "'. Try CLUSTER HELP.");
+  }
+}
+
+std::string
+CommandHandler::handleClusterSlots(const std::span<const std::string> args,
+                                   const bool add,
+                                   const bool ranges) const {
+  // ADDSLOTS/DELSLOTS take slots, the -RANGE forms pairs of bounds.
+  if (args.size() < 2 || (ranges && args.size() % 2 == 0)) {
+    std::string name = args[0];
+    std::ranges::transform(name, name.begin(), ::tolower);
+    return RESPParser::encodeError("ERR wrong number of arguments for "
+                                   "'cluster|" +
+                                   name + "' command");
+  }
+
+  std::vector<uint16_t> slots;
+  for (std::size_t i = 1; i < args.size(); i += ranges ? 2 : 1) {
+    int64_t first = 0;
+    int64_t last = 0;
+    if (!parseInt64(args[i], first) || first < 0 ||
+        first >= static_cast<int64_t>(kClusterSlots) ||
+        (ranges && (!parseInt64(args[i + 1], last) || last < 0 ||
+                    last >= static_cast<int64_t>(kClusterSlots)))) {
+      return RESPParser::encodeError("ERR Invalid or out of range slot");
+    }
+    if (!ranges) {
+      last = first;
+    } else if (first > last) {
+      return RESPParser::encodeError(
+          "ERR start slot number " + args[i] +
+          " is greater than end slot number " + args[i + 1]);
+    }
+    for (int64_t slot = first; slot <= last; slot++) {
+      slots.push_back(static_cast<uint16_t>(slot));
+    }
+  }
+
+  // Validate every slot before touching any, so a bad request changes
+  // nothing.
+  for (const uint16_t slot : slots) {
+    const bool assigned = cluster_->owner(slot) != Cluster::kNoNode;
+    if (add && assigned) {
+      return RESPParser::encodeError("ERR Slot " + std::to_string(slot) +
+                                     " is already busy");
+    }
+    if (!add && !assigned) {
+      return RESPParser::encodeError("ERR Slot " + std::to_string(slot) +
+                                     " is already unassigned");
+    }
+  }
+  for (const uint16_t slot : slots) {
+    cluster_->assign(slot, add ? 0 : Cluster::kNoNode);
+    if (!add) {
+      cluster_->setStable(slot);
+    }
+  }
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string CommandHandler::handleClusterSetSlot(
+    const std::span<const std::string> args) const {
+  if (args.size() < 2) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'cluster|setslot' command");
+  }
+
+  int64_t value = 0;
+  if (!parseInt64(args[0], value) || value < 0 ||
+      value >= static_cast<int64_t>(kClusterSlots)) {
+    return RESPParser::encodeError("ERR Invalid or out of range slot");
+  }
+  const auto slot = static_cast<uint16_t>(value);
+
+  std::string action = args[1];
+  std::ranges::transform(action, action.begin(), ::toupper);
+  if (action == "STABLE") {
+    cluster_->setStable(slot);
+    return RESPParser::encodeSimpleString("OK");
+  }
+  if (args.size() != 3 ||
+      (action != "MIGRATING" && action != "IMPORTING" && action != "NODE")) {
+    return RESPParser::encodeError(
+        "ERR Invalid CLUSTER SETSLOT action or number of arguments. Try "
+        "CLUSTER HELP");
+  }
+
+  const int node = cluster_->findNode(args[2]);
+  if (node == Cluster::kNoNode) {
+    return RESPParser::encodeError("ERR I don't know about node " + args[2]);
+  }
+
+  if (action == "MIGRATING") {
+    if (!cluster_->servesSlot(slot)) {
+      return RESPParser::encodeError("ERR I'm not the owner of hash slot " +
+                                     std::to_string(slot));
+    }
+    if (node == 0) {
+      return RESPParser::encodeError(
+          "ERR I can't migrate a slot to myself");
+    }
+    cluster_->setMigrating(slot, node);
+  } else if (action == "IMPORTING") {
+    if (cluster_->servesSlot(slot)) {
+      return RESPParser::encodeError(
+          "ERR I'm already the owner of hash slot " + std::to_string(slot));
+    }
+    if (node == 0) {
+      return RESPParser::encodeError(
+          "ERR I can't import a slot from myself");
+    }
+    cluster_->setImporting(slot, node);
+  } else {
+    cluster_->assign(slot, node);
+  }
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string CommandHandler::handleAsking(Client &client) const {
+  if (!cluster_) {
+    return RESPParser::encodeError(
+        "ERR This instance has cluster support disabled");
+  }
+  client.asking = true;
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string
+CommandHandler::handleMigrate(Client &client,
+                              const std::span<const std::string> args) const {
+  // host port key|"" destination-db timeout [COPY] [REPLACE] [KEYS key...]
+  if (args.size() < 5) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'migrate' command");
+  }
+  int64_t port = 0;
+  if (!parseInt64(args[1], port) || port <= 0 || port > 65535) {
+    return RESPParser::encodeError("ERR Invalid port");
+  }
+  int64_t db = 0;
+  int64_t timeoutMs = 0;
+  if (!parseInt64(args[3], db) || !parseInt64(args[4], timeoutMs)) {
+    return RESPParser::encodeError(
+        "ERR value is not an integer or out of range");
+  }
+  if (db != 0) {
+    return RESPParser::encodeError("ERR DB index is out of range");
+  }
+  if (timeoutMs <= 0) {
+    timeoutMs = 1000;
+  }
+
+  bool copy = false;
+  bool replace = false;
+  std::span<const std::string> keys = args.subspan(2, 1);
+  for (std::size_t i = 5; i < args.size(); i++) {
+    if (equalsIgnoreCase(args[i], "COPY")) {
+      copy = true;
+    } else if (equalsIgnoreCase(args[i], "REPLACE")) {
+      replace = true;
+    } else if (equalsIgnoreCase(args[i], "KEYS")) {
+      if (!args[2].empty()) {
+        return RESPParser::encodeError(
+            "ERR When using MIGRATE KEYS option, the key argument must be "
+            "set to the empty string");
+      }
+      keys = args.subspan(i + 1);
+      break;
+    } else {
+      return RESPParser::encodeError("ERR syntax error");
+    }
+  }
+
+  // Values travel in the DUMP format, so keys of every type move.
+  RDBWriter writer(config_->getRdbCompression(), false);
+  std::vector<MigrateEntry> entries;
+  for (const std::string &key : keys) {
+    MigrateEntry entry{key, {}, 0};
+    if (!storage_->withEntry(key, [&](const ValueWithExpiry &value) {
+          entry.value = writer.dumpValue(value);
+          if (value.hasExpiry) {
+            // A key about to expire still carries a TTL: 0 would mean none.
+            entry.ttlMs = std::max<int64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    value.expiryTime - ServerClock::now())
+                    .count(),
+                1);
+          }
+        })) {
+      continue;
+    }
+    entries.push_back(std::move(entry));
+  }
+  if (entries.empty()) {
+    return RESPParser::encodeSimpleString("NOKEY");
+  }
+
+  if (const std::string error = Cluster::migrate(
+          args[0], static_cast<int>(port), timeoutMs, entries, replace);
+      !error.empty()) {
+    return RESPParser::encodeError(error);
+  }
+
+  if (!copy) {
+    std::vector<std::string> moved;
+    moved.reserve(entries.size());
+    for (auto &entry : entries) {
+      moved.push_back(std::move(entry.key));
+    }
+    storage_->remove(moved);
+    for (const std::string &key : moved) {
+      tracking_->invalidateKey(key, &client);
+    }
+  }
+  return RESPParser::encodeSimpleString("OK");
+}
+
+std::string CommandHandler::handleRestoreAsking(
+    const std::span<const std::string> args) const {
+  // key ttl payload [REPLACE]; the payload is a value in the DUMP format.
+  if (args.size() < 3) {
+    return RESPParser::encodeError(
+        "ERR wrong number of arguments for 'restore-asking' command");
+  }
+  const std::string &key = args[0];
+  int64_t ttlMs = 0;
+  if (!parseInt64(args[1], ttlMs) || ttlMs < 0) {
+    return RESPParser::encodeError("ERR Invalid TTL value, must be >= 0");
+  }
+
+  bool replace = false;
+  for (std::size_t i = 3; i < args.size(); i++) {
+    if (!equalsIgnoreCase(args[i], "REPLACE")) {
+      return RESPParser::encodeError("ERR syntax error");
+    }
+    replace = true;
+  }
+  if (!replace && storage_->countExisting(args.subspan(0, 1)) > 0) {
+    return RESPParser::encodeError("BUSYKEY Target key name already exists.");
+  }
+  if (!RDBParser::verifyDump(args[2])) {
+    return RESPParser::encodeError(
+        "ERR DUMP payload version or checksum are wrong");
+  }
+
+  if (replace) {
+    storage_->remove(args.subspan(0, 1));
+  }
+  RDBParser parser;
+  if (!parser.restoreValue(args[2], key, ttlMs, *storage_)) {
+    return RESPParser::encodeError("ERR Bad data format");
+  }
+  return RESPParser::encodeSimpleString("OK");
 }
 
-} // namespace redis
\ No newline at end of file
+} // namespace redis
@@ -0,0 +1,170 @@
+#include "redis/CommandTable.h"
+
+#include "redis/StringUtils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+
+namespace redis {
+
+namespace {
+
+std::vector<CommandInfo> buildCommands() {
+  std::vector<CommandInfo> commands = {
+      {"ping", -1, 0, 0, 0, 0, 0},
+      {"echo", 2, 0, 0, 0, 0, 0},
+      {"set", -3, kCmdWrite, 1, 1, 1, 0},
+      {"get", 2, kCmdReadOnly, 1, 1, 1, 0},
+      {"mget", -2, kCmdReadOnly, 1, -1, 1, 0},
+      {"mset", -3, kCmdWrite, 1, -1, 2, 0},
+      {"del", -2, kCmdWrite, 1, -1, 1, 0},
+      {"unlink", -2, kCmdWrite, 1, -1, 1, 0},
+      {"exists", -2, kCmdReadOnly, 1, -1, 1, 0},
+      {"incr", 2, kCmdWrite, 1, 1, 1, 0},
+      {"decr", 2, kCmdWrite, 1, 1, 1, 0},
+      {"incrby", 3, kCmdWrite, 1, 1, 1, 0},
+      {"decrby", 3, kCmdWrite, 1, 1, 1, 0},
+      {"incrbyfloat", 3, kCmdWrite, 1, 1, 1, 0},
+      {"pfadd", -2, kCmdWrite, 1, 1, 1, 0},
+      // PFCOUNT caches the estimate in the sketch, which is not a change
+      // to its contents.
+      {"pfcount", -2, kCmdReadOnly, 1, -1, 1, 0},
+      {"pfmerge", -2, kCmdWrite, 1, -1, 1, 0},
+      {"hset", -4, kCmdWrite, 1, 1, 1, 0},
+      {"hget", 3, kCmdReadOnly, 1, 1, 1, 0},
+      {"hgetall", 2, kCmdReadOnly, 1, 1, 1, 0},
+      {"hdel", -3, kCmdWrite, 1, 1, 1, 0},
+      {"hlen", 2, kCmdReadOnly, 1, 1, 1, 0},
+      {"sadd", -3, kCmdWrite, 1, 1, 1, 0},
+      {"srem", -3, kCmdWrite, 1, 1, 1, 0},
+      {"sismember", 3, kCmdReadOnly, 1, 1, 1, 0},
+      {"scard", 2, kCmdReadOnly, 1, 1, 1, 0},
+      {"smembers", 2, kCmdReadOnly, 1, 1, 1, 0},
+      {"sinter", -2, kCmdReadOnly, 1, -1, 1, 0},
+      {"sunion", -2, kCmdReadOnly, 1, -1, 1, 0},
+      {"sdiff", -2, kCmdReadOnly, 1, -1, 1, 0},
+      {"bf.reserve", -4, kCmdWrite, 1, 1, 1, 0},
+      {"bf.add", 3, kCmdWrite, 1, 1, 1, 0},
+      {"bf.madd", -3, kCmdWrite, 1, 1, 1, 0},
+      {"bf.exists", 3, kCmdReadOnly, 1, 1, 1, 0},
+      {"bf.mexists", -3, kCmdReadOnly, 1, 1, 1, 0},
+      {"bf.info", -2, kCmdReadOnly, 1, 1, 1, 0},
+      {"type", 2, kCmdReadOnly, 1, 1, 1, 0},
+      {"config", -2, kCmdAdmin, 0, 0, 0, 0},
+      {"keys", 2, kCmdReadOnly, 0, 0, 0, 0},
+      {"flushall", -1, kCmdWrite, 0, 0, 0, 0},
+      {"flushdb", -1, kCmdWrite, 0, 0, 0, 0},
+      {"save", 1, kCmdAdmin, 0, 0, 0, 0},
+      {"bgsave", 1, kCmdAdmin, 0, 0, 0, 0},
+      {"info", -1, 0, 0, 0, 0, 0},
+      {"metrics", 1, 0, 0, 0, 0, 0},
+      {"slowlog", -2, kCmdAdmin, 0, 0, 0, 0},
+      {"latency", -2, kCmdAdmin, 0, 0, 0, 0},
+      {"hotkeys", -1, kCmdAdmin, 0, 0, 0, 0},
+      {"bigkeys", -1, kCmdAdmin, 0, 0, 0, 0},
+      {"memory", -3, kCmdReadOnly, 2, 2, 1, 0}, // MEMORY USAGE key
+      {"replconf", -1, kCmdAdmin, 0, 0, 0, 0},
+      {"psync", -3, kCmdAdmin, 0, 0, 0, 0},
+      {"multi", 1, 0, 0, 0, 0, 0},
+      {"exec", 1, 0, 0, 0, 0, 0},
+      {"discard", 1, 0, 0, 0, 0, 0},
+      {"watch", -2, 0, 1, -1, 1, 0},
+      {"unwatch", 1, 0, 0, 0, 0, 0},
+      {"subscribe", -2, kCmdPubSub, 0, 0, 0, 0},
+      {"unsubscribe", -1, kCmdPubSub, 0, 0, 0, 0},
+      {"psubscribe", -2, kCmdPubSub, 0, 0, 0, 0},
+      {"punsubscribe", -1, kCmdPubSub, 0, 0, 0, 0},
+      {"publish", 3, kCmdPubSub, 0, 0, 0, 0},
+      {"hello", -1, 0, 0, 0, 0, 0},
+      {"client", -2, kCmdAdmin, 0, 0, 0, 0},
+      {"cluster", -2, kCmdAdmin, 0, 0, 0, 0},
+      {"asking", 1, 0, 0, 0, 0, 0},
+      // MIGRATE's keys are either argument 3 or follow KEYS; the handler
+      // finds them itself.
+      {"migrate", -6, kCmdWrite, 0, 0, 0, 0},
+      {"restore-asking", -4, kCmdWrite, 1, 1, 1, 0},
+  };
+
+  for (std::size_t i = 0; i < commands.size(); i++) {
+    commands[i].id = i;
+  }
+  return commands;
+}
+
+// Transparent, case-insensitive hash and equality so that a command name can
+// be looked up as sent by the client, without allocating an upper-cased copy.
+struct NameHash {
+  using is_transparent = void;
+  std::size_t operator()(const std::string_view name) const {
+    // FNV-1a over the lower-cased bytes.
+    std::size_t hash = 14695981039346656037ULL;
+    for (const char c : name) {
+      hash ^= static_cast<unsigned char>(
+          std::tolower(static_cast<unsigned char>(c)));
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+};
+
+struct NameEqual {
+  using is_transparent = void;
+  bool operator()(const std::string_view a, const std::string_view b) const {
+    return equalsIgnoreCase(a, b);
+  }
+};
+
+using CommandIndex =
+    std::unordered_map<std::string, const CommandInfo *, NameHash, NameEqual>;
+
+const CommandIndex &commandIndex() {
+  static const auto index = [] {
+    CommandIndex result;
+    for (const auto &info : CommandTable::all()) {
+      result.emplace(std::string(info.name), &info);
+    }
+    return result;
+  }();
+  return index;
+}
+
+} // namespace
+
+const std::vector<CommandInfo> &CommandTable::all() {
+  static const std::vector<CommandInfo> commands = buildCommands();
+  return commands;
+}
+
+const CommandInfo *CommandTable::lookup(const std::string_view name) {
+  const auto &index = commandIndex();
+  const auto it = index.find(name);
+  return it == index.end() ? nullptr : it->second;
+}
+
+bool CommandTable::checkArity(const CommandInfo &info, const std::size_t argc) {
+  if (info.arity >= 0) {
+    return argc == static_cast<std::size_t>(info.arity);
+  }
+  return argc >= static_cast<std::size_t>(-info.arity);
+}
+
+std::pmr::vector<std::size_t>
+CommandTable::keyIndices(const CommandInfo &info, const std::size_t argc,
+                         std::pmr::memory_resource *resource) {
+  std::pmr::vector<std::size_t> indices(resource);
+  if (info.firstKey <= 0 || argc <= static_cast<std::size_t>(info.firstKey)) {
+    return indices;
+  }
+
+  const auto last = info.lastKey < 0
+                        ? static_cast<int>(argc) + info.lastKey
+                        : std::min(info.lastKey, static_cast<int>(argc) - 1);
+  for (int i = info.firstKey; i <= last; i += info.keyStep) {
+    indices.push_back(static_cast<std::size_t>(i));
+  }
+  return indices;
+}
+
+} // namespace redis
@@ -1,12 +1,63 @@
 #include "redis/Config.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cstring>
 #include <sstream>
 
 namespace redis {
 
+namespace {
+
+// Parses a byte count with an optional unit, as Redis does: k, m and g are
+// powers of 1000, kb, mb and gb powers of 1024.
+std::size_t parseMemory(const std::string &value) {
+  std::size_t unitPos = 0;
+  const std::size_t number = std::stoull(value, &unitPos);
+  std::string unit = value.substr(unitPos);
+  for (char &c : unit) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+
+  if (unit == "k") {
+    return number * 1000;
+  } else if (unit == "kb") {
+    return number * 1024;
+  } else if (unit == "m") {
+    return number * 1000 * 1000;
+  } else if (unit == "mb") {
+    return number * 1024 * 1024;
+  } else if (unit == "g") {
+    return number * 1000 * 1000 * 1000;
+  } else if (unit == "gb") {
+    return number * 1024 * 1024 * 1024;
+  }
+  return number;
+}
+
+} // namespace
+
 Config::Config()
-    : dir_("."), dbfilename_("dump.rdb"), port_(6379), masterPort_(0) {}
+    : dir_("."), dbfilename_("dump.rdb"), port_(6379), unixSocketPerm_(0),
+      tcpBacklog_(511), tcpNoDelay_(true), tcpKeepAlive_(300), tcpRcvBuf_(0),
+      maxClients_(10000), timeout_(0),
+      outputBufferLimits_{{
+          {0, 0, 0},                                 // normal
+          {256 * 1024 * 1024, 64 * 1024 * 1024, 60}, // replica
+          {32 * 1024 * 1024, 8 * 1024 * 1024, 60},   // pubsub
+      }},
+      ioThreads_(1), ioThreadsDoReads_(true), lazyfreeLazyExpire_(false),
+      lazyfreeLazyServerDel_(false), lazyfreeLazyUserDel_(false),
+      lazyfreeLazyUserFlush_(false), lazyfreeThreshold_(64 * 1024),
+      rdbCompression_(true), rdbChecksum_(true), valueCompression_(false),
+      valueCompressionThreshold_(1024), hllSparseMaxBytes_(3000),
+      hashMaxListpackEntries_(128), hashMaxListpackValue_(64),
+      setMaxIntsetEntries_(512), bfErrorRate_(0.01), bfInitialSize_(100),
+      bfExpansionFactor_(2), clusterEnabled_(false),
+      clusterAnnounceIp_("127.0.0.1"), masterPort_(0),
+      trackingTableMaxKeys_(1000000), slowlogLogSlowerThan_(10000),
+      slowlogMaxLen_(128), latencyMonitorThreshold_(0), hotkeysSampleRate_(16),
+      bigkeysScan_(true) {}
 
 void Config::parseArgs(const int argc, char **argv) {
   for (int i = 1; i < argc; i++) {
@@ -16,11 +67,128 @@ void Config::parseArgs(const int argc, char **argv) {
       dbfilename_ = argv[++i];
     } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
       port_ = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+      bindAddress_ = argv[++i];
+    } else if (std::strcmp(argv[i], "--unixsocket") == 0 && i + 1 < argc) {
+      unixSocket_ = argv[++i];
+    } else if (std::strcmp(argv[i], "--unixsocketperm") == 0 && i + 1 < argc) {
+      unixSocketPerm_ = std::stoul(argv[++i], nullptr, 8);
+    } else if (std::strcmp(argv[i], "--tcp-backlog") == 0 && i + 1 < argc) {
+      tcpBacklog_ = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--tcp-nodelay") == 0 && i + 1 < argc) {
+      tcpNoDelay_ = std::strcmp(argv[++i], "no") != 0;
+    } else if (std::strcmp(argv[i], "--tcp-keepalive") == 0 && i + 1 < argc) {
+      tcpKeepAlive_ = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--tcp-rcvbuf") == 0 && i + 1 < argc) {
+      tcpRcvBuf_ = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--maxclients") == 0 && i + 1 < argc) {
+      maxClients_ = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+      timeout_ = std::stoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--client-output-buffer-limit") == 0 &&
+               i + 1 < argc) {
+      // Parse "<class> <hard> <soft> <soft seconds>" from the next argument
+      std::istringstream iss(argv[++i]);
+      std::string clientClass, hard, soft;
+      int64_t softSeconds = 0;
+      if (!(iss >> clientClass >> hard >> soft >> softSeconds)) {
+        continue;
+      }
+      OutputBufferLimit limit{parseMemory(hard), parseMemory(soft),
+                              softSeconds};
+      if (clientClass == "normal") {
+        outputBufferLimits_[static_cast<std::size_t>(ClientClass::Normal)] =
+            limit;
+      } else if (clientClass == "replica" || clientClass == "slave") {
+        outputBufferLimits_[static_cast<std::size_t>(ClientClass::Replica)] =
+            limit;
+      } else if (clientClass == "pubsub") {
+        outputBufferLimits_[static_cast<std::size_t>(ClientClass::PubSub)] =
+            limit;
+      }
+    } else if (std::strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) {
+      // Redis caps io-threads at 128.
+      ioThreads_ = std::clamp<std::size_t>(std::stoull(argv[++i]), 1, 128);
+    } else if (std::strcmp(argv[i], "--io-threads-do-reads") == 0 &&
+               i + 1 < argc) {
+      ioThreadsDoReads_ = std::strcmp(argv[++i], "no") != 0;
+    } else if (std::strcmp(argv[i], "--lazyfree-lazy-expire") == 0 &&
+               i + 1 < argc) {
+      lazyfreeLazyExpire_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--lazyfree-lazy-server-del") == 0 &&
+               i + 1 < argc) {
+      lazyfreeLazyServerDel_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--lazyfree-lazy-user-del") == 0 &&
+               i + 1 < argc) {
+      lazyfreeLazyUserDel_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--lazyfree-lazy-user-flush") == 0 &&
+               i + 1 < argc) {
+      lazyfreeLazyUserFlush_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--lazyfree-threshold") == 0 &&
+               i + 1 < argc) {
+      lazyfreeThreshold_ = parseMemory(argv[++i]);
+    } else if (std::strcmp(argv[i], "--rdbcompression") == 0 &&
+               i + 1 < argc) {
+      rdbCompression_ = std::strcmp(argv[++i], "no") != 0;
+    } else if (std::strcmp(argv[i], "--rdbchecksum") == 0 && i + 1 < argc) {
+      rdbChecksum_ = std::strcmp(argv[++i], "no") != 0;
+    } else if (std::strcmp(argv[i], "--value-compression") == 0 &&
+               i + 1 < argc) {
+      valueCompression_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--value-compression-threshold") == 0 &&
+               i + 1 < argc) {
+      valueCompressionThreshold_ = parseMemory(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hll-sparse-max-bytes") == 0 &&
+               i + 1 < argc) {
+      hllSparseMaxBytes_ = parseMemory(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hash-max-listpack-entries") == 0 &&
+               i + 1 < argc) {
+      hashMaxListpackEntries_ = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hash-max-listpack-value") == 0 &&
+               i + 1 < argc) {
+      hashMaxListpackValue_ = parseMemory(argv[++i]);
+    } else if (std::strcmp(argv[i], "--set-max-intset-entries") == 0 &&
+               i + 1 < argc) {
+      setMaxIntsetEntries_ = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--bf-error-rate") == 0 && i + 1 < argc) {
+      bfErrorRate_ = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--bf-initial-size") == 0 &&
+               i + 1 < argc) {
+      bfInitialSize_ = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--bf-expansion-factor") == 0 &&
+               i + 1 < argc) {
+      bfExpansionFactor_ = static_cast<unsigned>(std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--cluster-enabled") == 0 &&
+               i + 1 < argc) {
+      clusterEnabled_ = std::strcmp(argv[++i], "yes") == 0;
+    } else if (std::strcmp(argv[i], "--cluster-slots") == 0 && i + 1 < argc) {
+      clusterSlots_ = argv[++i];
+    } else if (std::strcmp(argv[i], "--cluster-node") == 0 && i + 1 < argc) {
+      clusterNodes_.emplace_back(argv[++i]);
+    } else if (std::strcmp(argv[i], "--cluster-announce-ip") == 0 &&
+               i + 1 < argc) {
+      clusterAnnounceIp_ = argv[++i];
     } else if (std::strcmp(argv[i], "--replicaof") == 0 && i + 1 < argc) {
       // Parse "host port" from the next argument
       std::string replicaof = argv[++i];
       std::istringstream iss(replicaof);
       iss >> masterHost_ >> masterPort_;
+    } else if (std::strcmp(argv[i], "--tracking-table-max-keys") == 0 &&
+               i + 1 < argc) {
+      trackingTableMaxKeys_ = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--slowlog-log-slower-than") == 0 &&
+               i + 1 < argc) {
+      slowlogLogSlowerThan_ = std::stoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--slowlog-max-len") == 0 && i + 1 < argc) {
+      slowlogMaxLen_ = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--latency-monitor-threshold") == 0 &&
+               i + 1 < argc) {
+      latencyMonitorThreshold_ = std::stoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hotkeys-sample-rate") == 0 &&
+               i + 1 < argc) {
+      hotkeysSampleRate_ = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--bigkeys-scan") == 0 && i + 1 < argc) {
+      bigkeysScan_ = std::strcmp(argv[++i], "yes") == 0;
     }
   }
 }
@@ -0,0 +1,68 @@
+#include "redis/Crc64.h"
+
+#include <array>
+#include <cstddef>
+
+namespace redis {
+
+namespace {
+
+// 0xad93d23594c935a9 bit-reversed, for the reflected (LSB-first) form.
+constexpr uint64_t kPolynomial = 0x95ac9329ac4bc9b5ULL;
+
+using Tables = std::array<std::array<uint64_t, 256>, 8>;
+
+// tables[0] is the classic byte-at-a-time table; tables[k][b] is the CRC of
+// byte b followed by k zero bytes, so eight bytes can be folded with eight
+// independent lookups instead of a serial chain of them.
+const Tables &tables() {
+  static const Tables instance = [] {
+    Tables t{};
+    for (uint64_t i = 0; i < 256; i++) {
+      uint64_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ kPolynomial : crc >> 1;
+      }
+      t[0][i] = crc;
+    }
+    for (std::size_t k = 1; k < 8; k++) {
+      for (std::size_t i = 0; i < 256; i++) {
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+      }
+    }
+    return t;
+  }();
+  return instance;
+}
+
+uint64_t loadLE64(const unsigned char *p) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+} // namespace
+
+uint64_t crc64(uint64_t crc, const std::string_view data) {
+  const Tables &t = tables();
+  const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+  std::size_t length = data.size();
+
+  while (length >= 8) {
+    crc ^= loadLE64(p);
+    crc = t[7][crc & 0xFF] ^ t[6][(crc >> 8) & 0xFF] ^
+          t[5][(crc >> 16) & 0xFF] ^ t[4][(crc >> 24) & 0xFF] ^
+          t[3][(crc >> 32) & 0xFF] ^ t[2][(crc >> 40) & 0xFF] ^
+          t[1][(crc >> 48) & 0xFF] ^ t[0][crc >> 56];
+    p += 8;
+    length -= 8;
+  }
+  while (length-- > 0) {
+    crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+} // namespace redis
@@ -0,0 +1,128 @@
+#include "redis/GlobPattern.h"
+
+#include <utility>
+
+namespace redis {
+
+GlobPattern::GlobPattern(const std::string_view pattern) {
+  auto appendLiteral = [this](const char c) {
+    if (tokens_.empty() || tokens_.back().type != TokenType::Literal) {
+      tokens_.push_back({TokenType::Literal, {}, {}});
+    }
+    tokens_.back().literal += c;
+  };
+
+  for (std::size_t i = 0; i < pattern.size(); i++) {
+    const char c = pattern[i];
+
+    if (c == '*') {
+      // Consecutive stars behave like a single one.
+      if (tokens_.empty() || tokens_.back().type != TokenType::AnySequence) {
+        tokens_.push_back({TokenType::AnySequence, {}, {}});
+      }
+    } else if (c == '?') {
+      tokens_.push_back({TokenType::AnyChar, {}, {}});
+    } else if (c == '\\' && i + 1 < pattern.size()) {
+      appendLiteral(pattern[++i]);
+    } else if (c == '[') {
+      Token token{TokenType::CharClass, {}, {}};
+      bool negate = false;
+      i++;
+      if (i < pattern.size() && pattern[i] == '^') {
+        negate = true;
+        i++;
+      }
+      for (; i < pattern.size() && pattern[i] != ']'; i++) {
+        if (pattern[i] == '\\' && i + 1 < pattern.size()) {
+          token.chars.set(static_cast<unsigned char>(pattern[++i]));
+        } else if (i + 2 < pattern.size() && pattern[i + 1] == '-' &&
+                   pattern[i + 2] != ']') {
+          auto from = static_cast<unsigned char>(pattern[i]);
+          auto to = static_cast<unsigned char>(pattern[i + 2]);
+          if (from > to) {
+            std::swap(from, to);
+          }
+          for (unsigned v = from; v <= to; v++) {
+            token.chars.set(v);
+          }
+          i += 2;
+        } else {
+          token.chars.set(static_cast<unsigned char>(pattern[i]));
+        }
+      }
+      if (negate) {
+        token.chars.flip();
+      }
+      tokens_.push_back(std::move(token));
+    } else {
+      appendLiteral(c);
+    }
+  }
+
+  if (!tokens_.empty() && tokens_.front().type == TokenType::Literal) {
+    literalPrefix_ = tokens_.front().literal;
+  }
+}
+
+bool GlobPattern::consume(const Token &token, const std::string_view text,
+                          std::size_t &pos) {
+  switch (token.type) {
+  case TokenType::Literal:
+    if (text.substr(pos, token.literal.size()) != token.literal) {
+      return false;
+    }
+    pos += token.literal.size();
+    return true;
+  case TokenType::AnyChar:
+    if (pos >= text.size()) {
+      return false;
+    }
+    pos++;
+    return true;
+  case TokenType::CharClass:
+    if (pos >= text.size() ||
+        !token.chars.test(static_cast<unsigned char>(text[pos]))) {
+      return false;
+    }
+    pos++;
+    return true;
+  case TokenType::AnySequence:
+    break;
+  }
+  return false;
+}
+
+bool GlobPattern::matches(const std::string_view text) const {
+  // Every token other than '*' consumes a fixed number of characters, so
+  // backtracking to the most recent star is enough to find a match.
+  std::size_t tokenIdx = 0;
+  std::size_t pos = 0;
+  std::size_t starToken = tokens_.size();
+  std::size_t starPos = 0;
+
+  while (pos < text.size() || tokenIdx < tokens_.size()) {
+    if (tokenIdx < tokens_.size()) {
+      const Token &token = tokens_[tokenIdx];
+      if (token.type == TokenType::AnySequence) {
+        starToken = tokenIdx++;
+        starPos = pos;
+        continue;
+      }
+      if (std::size_t next = pos; consume(token, text, next)) {
+        pos = next;
+        tokenIdx++;
+        continue;
+      }
+    }
+    if (starToken < tokens_.size() && starPos < text.size()) {
+      tokenIdx = starToken + 1;
+      pos = ++starPos;
+      continue;
+    }
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace redis
@@ -0,0 +1,133 @@
+#include "redis/HotKeys.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace redis {
+
+namespace {
+
+// Orders heap entries so that the lowest score is at the front.
+constexpr auto kHigherScore = [](const auto &a, const auto &b) {
+  return a.score > b.score;
+};
+
+} // namespace
+
+void TopKeys::offer(const std::string_view key, const uint64_t score) {
+  // Most candidates lose to the weakest entry; reject them before the
+  // linear search for the key.
+  if (capacity_ == 0 ||
+      (heap_.size() == capacity_ && score <= heap_.front().score)) {
+    return;
+  }
+
+  if (const auto it = std::ranges::find(heap_, key, &Entry::key);
+      it != heap_.end()) {
+    it->score = score;
+    std::ranges::make_heap(heap_, kHigherScore);
+  } else if (heap_.size() < capacity_) {
+    heap_.push_back({std::string(key), score});
+    std::ranges::push_heap(heap_, kHigherScore);
+  } else {
+    std::ranges::pop_heap(heap_, kHigherScore);
+    heap_.back() = {std::string(key), score};
+    std::ranges::push_heap(heap_, kHigherScore);
+  }
+}
+
+std::vector<std::pair<std::string, uint64_t>> TopKeys::sorted() const {
+  std::vector<std::pair<std::string, uint64_t>> entries;
+  entries.reserve(heap_.size());
+  for (const Entry &entry : heap_) {
+    entries.emplace_back(entry.key, entry.score);
+  }
+  std::ranges::sort(entries, std::ranges::greater{},
+                    &std::pair<std::string, uint64_t>::second);
+  return entries;
+}
+
+void TopKeys::halve() {
+  for (Entry &entry : heap_) {
+    entry.score /= 2;
+  }
+  std::erase_if(heap_, [](const Entry &entry) { return entry.score == 0; });
+  std::ranges::make_heap(heap_, kHigherScore);
+}
+
+HotKeys::HotKeys(const uint32_t sampleRate) : sampleRate_(sampleRate) {}
+
+uint32_t HotKeys::nextGap() {
+  // xorshift64: a sample is rare, but it should not cost a std::mt19937.
+  rng_ ^= rng_ << 13;
+  rng_ ^= rng_ >> 7;
+  rng_ ^= rng_ << 17;
+  // Uniform over [1, 2 * sampleRate - 1], so the mean gap is sampleRate.
+  return 1 + static_cast<uint32_t>(rng_ % (2 * uint64_t{sampleRate_} - 1));
+}
+
+void HotKeys::record(const std::string_view key) {
+  sampled_++;
+
+  // Each row indexes with h1 + i * h2 (Kirsch-Mitzenmacher), so one hash
+  // serves every row.
+  const uint64_t hash = std::hash<std::string_view>{}(key);
+  const auto h1 = static_cast<uint32_t>(hash);
+  const auto h2 = static_cast<uint32_t>(hash >> 32) | 1;
+  std::array<uint32_t *, kDepth> counters;
+  uint32_t estimate = UINT32_MAX;
+  for (std::size_t i = 0; i < kDepth; i++) {
+    counters[i] = &sketch_[i][(h1 + i * h2) % kWidth];
+    estimate = std::min(estimate, *counters[i]);
+  }
+
+  // Conservative update: only the counters at the minimum grow, which keeps
+  // collisions from inflating the estimates of cold keys.
+  if (estimate == UINT32_MAX) {
+    return;
+  }
+  for (uint32_t *counter : counters) {
+    if (*counter == estimate) {
+      ++*counter;
+    }
+  }
+  top_.offer(key, estimate + 1);
+}
+
+void HotKeys::decay(const int64_t nowMs) {
+  if (nowMs < nextDecayMs_) {
+    return;
+  }
+  nextDecayMs_ = nowMs + kDecayPeriodMs;
+  for (auto &row : sketch_) {
+    for (uint32_t &counter : row) {
+      counter /= 2;
+    }
+  }
+  top_.halve();
+}
+
+std::vector<std::pair<std::string, uint64_t>>
+HotKeys::top(const std::size_t count) const {
+  auto entries = top_.sorted();
+  if (entries.size() > count) {
+    entries.resize(count);
+  }
+  for (auto &[key, score] : entries) {
+    score *= std::max<uint32_t>(sampleRate_, 1);
+  }
+  return entries;
+}
+
+void HotKeys::reset() {
+  sketch_ = {};
+  top_.clear();
+  sampled_ = 0;
+}
+
+void HotKeys::setSampleRate(const uint32_t sampleRate) {
+  sampleRate_ = sampleRate;
+  countdown_ = 1;
+}
+
+} // namespace redis
@@ -0,0 +1,520 @@
+#include "redis/HyperLogLog.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace redis {
+
+namespace {
+
+using Registers = HyperLogLog::Registers;
+
+constexpr std::size_t kRegisters = HyperLogLog::kRegisters;
+constexpr std::size_t kHeaderSize = HyperLogLog::kHeaderSize;
+
+// Hash bits left after the register index; ranks go up to kQ + 1.
+constexpr int kQ = 64 - HyperLogLog::kPrecision;
+
+constexpr uint8_t kDense = 0;
+constexpr uint8_t kSparse = 1;
+
+// Sparse opcodes: ZERO (00xxxxxx) is a run of up to 64 zero registers,
+// XZERO (01xxxxxx yyyyyyyy) one of up to 16384, and VAL (1vvvvvxx) a run of
+// up to 4 registers holding 1 to 32.
+constexpr std::size_t kMaxZeroRun = 64;
+constexpr std::size_t kMaxXzeroRun = 16384;
+constexpr std::size_t kMaxValRun = 4;
+constexpr uint8_t kMaxSparseValue = 32;
+
+// The cached cardinality is little-endian in the last 8 header bytes; the
+// top bit of the last byte marks it stale.
+constexpr std::size_t kCardinalityOffset = 8;
+constexpr uint8_t kStaleCardinality = 0x80;
+
+struct Run {
+  uint8_t value;
+  uint16_t length;
+};
+
+// MurmurHash2, 64-bit version, as Redis hashes HyperLogLog elements.
+uint64_t murmurHash64A(const std::string_view data, const uint64_t seed) {
+  constexpr uint64_t m = 0xc6a4a7935bd1e995;
+  constexpr int r = 47;
+  uint64_t h = seed ^ (data.size() * m);
+
+  const char *p = data.data();
+  const char *end = p + (data.size() & ~std::size_t{7});
+  for (; p != end; p += 8) {
+    uint64_t k;
+    std::memcpy(&k, p, 8); // Assuming little-endian system
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  const auto *tail = reinterpret_cast<const uint8_t *>(p);
+  switch (data.size() & 7) {
+  case 7:
+    h ^= uint64_t{tail[6]} << 48;
+    [[fallthrough]];
+  case 6:
+    h ^= uint64_t{tail[5]} << 40;
+    [[fallthrough]];
+  case 5:
+    h ^= uint64_t{tail[4]} << 32;
+    [[fallthrough]];
+  case 4:
+    h ^= uint64_t{tail[3]} << 24;
+    [[fallthrough]];
+  case 3:
+    h ^= uint64_t{tail[2]} << 16;
+    [[fallthrough]];
+  case 2:
+    h ^= uint64_t{tail[1]} << 8;
+    [[fallthrough]];
+  case 1:
+    h ^= uint64_t{tail[0]};
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+// The register element maps to and the rank it would set: one plus the
+// number of trailing zeros in the rest of the hash.
+std::pair<std::size_t, uint8_t> hashElement(const std::string_view element) {
+  uint64_t hash = murmurHash64A(element, 0xadc83b19);
+  const std::size_t index = hash & (kRegisters - 1);
+  hash >>= HyperLogLog::kPrecision;
+  hash |= uint64_t{1} << kQ;
+  return {index, static_cast<uint8_t>(std::countr_zero(hash) + 1)};
+}
+
+const uint8_t *registerBytes(const std::string_view hll) {
+  return reinterpret_cast<const uint8_t *>(hll.data() + kHeaderSize);
+}
+
+uint8_t *registerBytes(std::string &hll) {
+  return reinterpret_cast<uint8_t *>(hll.data() + kHeaderSize);
+}
+
+std::string header(const uint8_t encoding) {
+  std::string hll("HYLL", 4);
+  hll.resize(kHeaderSize, '\0');
+  hll[4] = static_cast<char>(encoding);
+  return hll;
+}
+
+void invalidateCache(std::string &hll) {
+  hll[kCardinalityOffset + 7] = static_cast<char>(
+      static_cast<uint8_t>(hll[kCardinalityOffset + 7]) | kStaleCardinality);
+}
+
+// Dense registers are packed 6 bits each, least significant bits first, so
+// a register straddles two bytes when it starts past bit 2.
+uint8_t getDense(const uint8_t *bytes, const std::size_t index) {
+  const std::size_t byte = index * 6 / 8;
+  const unsigned shift = index * 6 % 8;
+  unsigned value = bytes[byte] >> shift;
+  if (shift > 2) {
+    value |= unsigned{bytes[byte + 1]} << (8 - shift);
+  }
+  return static_cast<uint8_t>(value & 63);
+}
+
+void setDense(uint8_t *bytes, const std::size_t index, const uint8_t value) {
+  const std::size_t byte = index * 6 / 8;
+  const unsigned shift = index * 6 % 8;
+  bytes[byte] = static_cast<uint8_t>((bytes[byte] & ~(63u << shift)) |
+                                     (unsigned{value} << shift));
+  if (shift > 2) {
+    bytes[byte + 1] =
+        static_cast<uint8_t>((bytes[byte + 1] & ~(63u >> (8 - shift))) |
+                             (unsigned{value} >> (8 - shift)));
+  }
+}
+
+// Unpacks the registers, four from every three bytes, or with kMerge raises
+// each register to at least the unpacked value. Eight registers at a time
+// are spread from 48 bits to 64 in three halving steps (24-bit, 12-bit and
+// then 6-bit fields); SSE2 does two such groups per instruction.
+template <bool kMerge>
+void unpackDense(const uint8_t *bytes, Registers &registers) {
+  constexpr uint64_t kLow24 = 0x0000000000FFFFFF;
+  constexpr uint64_t kHigh24 = 0x0000FFFFFF000000;
+  constexpr uint64_t kLow12 = 0x00000FFF00000FFF;
+  constexpr uint64_t kHigh12 = 0x00FFF00000FFF000;
+  constexpr uint64_t kLow6 = 0x003F003F003F003F;
+  constexpr uint64_t kHigh6 = 0x0FC00FC00FC00FC0;
+
+  std::size_t i = 0;
+  // The loops stop a group early: an 8-byte load there would read past the
+  // end of the sketch.
+#if defined(__SSE2__)
+  const auto spread = [](const __m128i x, const uint64_t low,
+                         const uint64_t high, const int shift) {
+    return _mm_or_si128(
+        _mm_and_si128(x, _mm_set1_epi64x(static_cast<int64_t>(low))),
+        _mm_slli_epi64(
+            _mm_and_si128(x, _mm_set1_epi64x(static_cast<int64_t>(high))),
+            shift));
+  };
+  for (; i + 16 < kRegisters; i += 16, bytes += 12) {
+    __m128i x = _mm_unpacklo_epi64(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(bytes)),
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(bytes + 6)));
+    x = spread(x, kLow24, kHigh24, 8);
+    x = spread(x, kLow12, kHigh12, 4);
+    x = spread(x, kLow6, kHigh6, 2);
+    auto *out = reinterpret_cast<__m128i *>(registers.data() + i);
+    if constexpr (kMerge) {
+      x = _mm_max_epu8(x, _mm_loadu_si128(out));
+    }
+    _mm_storeu_si128(out, x);
+  }
+#else
+  for (; i + 8 < kRegisters; i += 8, bytes += 6) {
+    uint64_t x;
+    std::memcpy(&x, bytes, 8); // Assuming little-endian system
+    x = (x & kLow24) | ((x & kHigh24) << 8);
+    x = (x & kLow12) | ((x & kHigh12) << 4);
+    x = (x & kLow6) | ((x & kHigh6) << 2);
+    uint8_t unpacked[8];
+    std::memcpy(unpacked, &x, 8);
+    for (std::size_t j = 0; j < 8; j++) {
+      registers[i + j] =
+          kMerge ? std::max(registers[i + j], unpacked[j]) : unpacked[j];
+    }
+  }
+#endif
+
+  for (; i < kRegisters; i += 4, bytes += 3) {
+    const uint8_t unpacked[4] = {
+        static_cast<uint8_t>(bytes[0] & 63),
+        static_cast<uint8_t>(((bytes[0] >> 6) | (bytes[1] << 2)) & 63),
+        static_cast<uint8_t>(((bytes[1] >> 4) | (bytes[2] << 4)) & 63),
+        static_cast<uint8_t>(bytes[2] >> 2),
+    };
+    for (std::size_t j = 0; j < 4; j++) {
+      registers[i + j] =
+          kMerge ? std::max(registers[i + j], unpacked[j]) : unpacked[j];
+    }
+  }
+}
+
+void packDense(const Registers &registers, uint8_t *bytes) {
+  for (std::size_t i = 0; i < kRegisters; i += 4, bytes += 3) {
+    bytes[0] = static_cast<uint8_t>(registers[i] | (registers[i + 1] << 6));
+    bytes[1] =
+        static_cast<uint8_t>((registers[i + 1] >> 2) | (registers[i + 2] << 4));
+    bytes[2] =
+        static_cast<uint8_t>((registers[i + 2] >> 4) | (registers[i + 3] << 2));
+  }
+}
+
+// Calls fn(value, first, length) for every run of a sparse sketch. Returns
+// false if the opcodes are truncated or do not cover exactly kRegisters.
+template <typename Fn> bool forEachRun(const std::string_view hll, Fn &&fn) {
+  const uint8_t *p = registerBytes(hll);
+  const uint8_t *end = p + (hll.size() - kHeaderSize);
+  std::size_t first = 0;
+  while (p < end) {
+    uint8_t value = 0;
+    std::size_t length;
+    if ((*p & 0xC0) == 0x00) {
+      length = (*p & 0x3F) + 1u;
+      p++;
+    } else if ((*p & 0xC0) == 0x40) {
+      if (p + 1 == end) {
+        return false;
+      }
+      length = (((*p & 0x3Fu) << 8) | p[1]) + 1;
+      p += 2;
+    } else {
+      value = static_cast<uint8_t>(((*p >> 2) & 0x1F) + 1);
+      length = (*p & 0x03) + 1u;
+      p++;
+    }
+    if (first + length > kRegisters) {
+      return false;
+    }
+    fn(value, first, length);
+    first += length;
+  }
+  return first == kRegisters;
+}
+
+// Encodes runs as sparse opcodes, joining neighbours that hold the same
+// value so each change leaves the shortest encoding.
+void encodeSparse(const std::vector<Run> &runs, std::string &out) {
+  for (std::size_t i = 0; i < runs.size();) {
+    const uint8_t value = runs[i].value;
+    std::size_t length = 0;
+    for (; i < runs.size() && runs[i].value == value; i++) {
+      length += runs[i].length;
+    }
+
+    while (length > 0) {
+      if (value == 0) {
+        const std::size_t n = std::min(length, kMaxXzeroRun);
+        if (n <= kMaxZeroRun) {
+          out.push_back(static_cast<char>(n - 1));
+        } else {
+          out.push_back(static_cast<char>(0x40 | ((n - 1) >> 8)));
+          out.push_back(static_cast<char>((n - 1) & 0xFF));
+        }
+        length -= n;
+      } else {
+        const std::size_t n = std::min(length, kMaxValRun);
+        out.push_back(static_cast<char>(0x80 | ((value - 1) << 2) | (n - 1)));
+        length -= n;
+      }
+    }
+  }
+}
+
+// Overwrites registers with those of hll.
+bool loadRegisters(const std::string_view hll, Registers &registers) {
+  if (hll[4] == kDense) {
+    unpackDense<false>(registerBytes(hll), registers);
+    return true;
+  }
+  return forEachRun(hll, [&](const uint8_t value, const std::size_t first,
+                             const std::size_t length) {
+    std::memset(registers.data() + first, value, length);
+  });
+}
+
+void toDense(std::string &hll) {
+  Registers registers;
+  loadRegisters(hll, registers);
+  hll = HyperLogLog::fromRegisters(registers);
+}
+
+// Ertl's improved estimator ("New cardinality estimation algorithms for
+// HyperLogLog sketches", 2017), as Redis uses it.
+double sigma(double x) {
+  if (x == 1.0) {
+    return INFINITY;
+  }
+  double zPrime;
+  double y = 1;
+  double z = x;
+  do {
+    x *= x;
+    zPrime = z;
+    z += x * y;
+    y += y;
+  } while (zPrime != z);
+  return z;
+}
+
+double tau(double x) {
+  if (x == 0.0 || x == 1.0) {
+    return 0.0;
+  }
+  double zPrime;
+  double y = 1.0;
+  double z = 1 - x;
+  do {
+    x = std::sqrt(x);
+    zPrime = z;
+    y *= 0.5;
+    z -= (1 - x) * (1 - x) * y;
+  } while (zPrime != z);
+  return z / 3;
+}
+
+// Counts 16 registers into four interleaved histograms, so that runs of
+// equal values do not serialize on one counter.
+void countBlock(const uint8_t *registers,
+                std::array<std::array<uint32_t, 64>, 4> &histograms) {
+  for (std::size_t j = 0; j < 16; j += 4) {
+    histograms[0][registers[j] & 63]++;
+    histograms[1][registers[j + 1] & 63]++;
+    histograms[2][registers[j + 2] & 63]++;
+    histograms[3][registers[j + 3] & 63]++;
+  }
+}
+
+} // namespace
+
+std::string HyperLogLog::create() {
+  std::string hll = header(kSparse);
+  // A single XZERO covering every register.
+  hll.push_back(static_cast<char>(0x40 | ((kMaxXzeroRun - 1) >> 8)));
+  hll.push_back(static_cast<char>((kMaxXzeroRun - 1) & 0xFF));
+  return hll;
+}
+
+bool HyperLogLog::isValid(const std::string_view str) {
+  if (str.size() < kHeaderSize || str.compare(0, 4, "HYLL") != 0) {
+    return false;
+  }
+  const auto encoding = static_cast<uint8_t>(str[4]);
+  return encoding == kSparse ||
+         (encoding == kDense && str.size() == kDenseSize);
+}
+
+bool HyperLogLog::add(std::string &hll, const std::string_view element,
+                      const std::size_t sparseMaxBytes, bool &changed) {
+  const auto [index, rank] = hashElement(element);
+
+  if (hll[4] == kDense) {
+    uint8_t *bytes = registerBytes(hll);
+    if (getDense(bytes, index) < rank) {
+      setDense(bytes, index, rank);
+      invalidateCache(hll);
+      changed = true;
+    }
+    return true;
+  }
+
+  uint8_t current = 0;
+  if (!forEachRun(hll, [&](const uint8_t value, const std::size_t first,
+                           const std::size_t length) {
+        if (index >= first && index < first + length) {
+          current = value;
+        }
+      })) {
+    return false;
+  }
+  if (rank <= current) {
+    return true;
+  }
+  changed = true;
+
+  if (rank > kMaxSparseValue) {
+    toDense(hll);
+    setDense(registerBytes(hll), index, rank);
+    return true;
+  }
+
+  // Split the run holding the register around it and re-encode.
+  thread_local std::vector<Run> runs;
+  thread_local std::string opcodes;
+  runs.clear();
+  forEachRun(hll, [&](const uint8_t value, const std::size_t first,
+                      const std::size_t length) {
+    if (index < first || index >= first + length) {
+      runs.push_back({value, static_cast<uint16_t>(length)});
+      return;
+    }
+    if (index > first) {
+      runs.push_back({value, static_cast<uint16_t>(index - first)});
+    }
+    runs.push_back({rank, 1});
+    if (index + 1 < first + length) {
+      runs.push_back(
+          {value, static_cast<uint16_t>(first + length - index - 1)});
+    }
+  });
+  opcodes.clear();
+  encodeSparse(runs, opcodes);
+  hll.replace(kHeaderSize, std::string::npos, opcodes);
+  invalidateCache(hll);
+
+  if (hll.size() > sparseMaxBytes) {
+    toDense(hll);
+  }
+  return true;
+}
+
+bool HyperLogLog::count(std::string &hll, uint64_t &result) {
+  auto *cardinality =
+      reinterpret_cast<uint8_t *>(hll.data() + kCardinalityOffset);
+  if ((cardinality[7] & kStaleCardinality) == 0) {
+    std::memcpy(&result, cardinality, 8); // Assuming little-endian system
+    return true;
+  }
+
+  Registers registers;
+  if (!loadRegisters(hll, registers)) {
+    return false;
+  }
+  result = estimate(registers);
+  std::memcpy(cardinality, &result, 8);
+  return true;
+}
+
+bool HyperLogLog::mergeInto(const std::string_view hll,
+                            Registers &registers) {
+  if (hll[4] == kDense) {
+    unpackDense<true>(registerBytes(hll), registers);
+    return true;
+  }
+
+  // Sparse sketches are mostly zero runs, which cannot raise anything.
+  return forEachRun(hll, [&](const uint8_t value, const std::size_t first,
+                             const std::size_t length) {
+    for (std::size_t i = first; value > 0 && i < first + length; i++) {
+      registers[i] = std::max(registers[i], value);
+    }
+  });
+}
+
+uint64_t HyperLogLog::estimate(const Registers &registers) {
+  std::array<std::array<uint32_t, 64>, 4> histograms{};
+  const uint8_t *p = registers.data();
+
+  // Below a few hundred thousand elements most registers are still zero;
+  // whole blocks of them are counted with one vector compare.
+  for (std::size_t i = 0; i < kRegisters; i += 16, p += 16) {
+#if defined(__SSE2__)
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128())) ==
+        0xFFFF) {
+      histograms[0][0] += 16;
+      continue;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (vmaxvq_u8(vld1q_u8(p)) == 0) {
+      histograms[0][0] += 16;
+      continue;
+    }
+#endif
+    countBlock(p, histograms);
+  }
+
+  std::array<uint32_t, 64> histogram{};
+  for (const auto &partial : histograms) {
+    for (std::size_t j = 0; j < histogram.size(); j++) {
+      histogram[j] += partial[j];
+    }
+  }
+
+  const auto m = static_cast<double>(kRegisters);
+  double z = m * tau((m - histogram[kQ + 1]) / m);
+  for (int j = kQ; j >= 1; j--) {
+    z += histogram[j];
+    z *= 0.5;
+  }
+  z += m * sigma(histogram[0] / m);
+  constexpr double kAlphaInf = 0.721347520444481703680; // 1 / (2 ln 2)
+  return static_cast<uint64_t>(std::llround(kAlphaInf * m * m / z));
+}
+
+std::string HyperLogLog::fromRegisters(const Registers &registers) {
+  std::string hll = header(kDense);
+  invalidateCache(hll);
+  hll.resize(kDenseSize);
+  packDense(registers, registerBytes(hll));
+  return hll;
+}
+
+} // namespace redis
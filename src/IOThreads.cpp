@@ -0,0 +1,69 @@
+#include "redis/IOThreads.h"
+
+namespace redis {
+
+IOThreads::IOThreads(const std::size_t threads) {
+  for (std::size_t i = 1; i < threads; i++) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+}
+
+IOThreads::~IOThreads() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void IOThreads::run(const std::size_t count, const void *context,
+                    const Trampoline trampoline) {
+  {
+    std::lock_guard lock(mutex_);
+    context_ = context;
+    trampoline_ = trampoline;
+    count_ = count;
+    next_.store(0, std::memory_order_relaxed);
+    busy_ = workers_.size();
+    generation_++;
+  }
+  start_.notify_all();
+
+  runJobs();
+
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+}
+
+void IOThreads::workerLoop() {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      start_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+    }
+
+    runJobs();
+
+    std::lock_guard lock(mutex_);
+    if (--busy_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void IOThreads::runJobs() {
+  for (std::size_t i = next_.fetch_add(1, std::memory_order_relaxed);
+       i < count_; i = next_.fetch_add(1, std::memory_order_relaxed)) {
+    trampoline_(context_, i);
+  }
+}
+
+} // namespace redis
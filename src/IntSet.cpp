@@ -0,0 +1,290 @@
+#include "redis/IntSet.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace redis {
+
+namespace {
+
+// Intersections gallop through the larger array once it has this many
+// times more members than the smaller one; below that a merge is cheaper.
+constexpr std::size_t kGallopRatio = 32;
+
+template <typename T> T load(const char *data, const std::size_t index) {
+  T value;
+  std::memcpy(&value, data + index * sizeof(T), sizeof(T));
+  return value;
+}
+
+template <typename T>
+void store(char *data, const std::size_t index, const T value) {
+  std::memcpy(data + index * sizeof(T), &value, sizeof(T));
+}
+
+template <typename T> bool fits(const int64_t value) {
+  return value >= std::numeric_limits<T>::min() &&
+         value <= std::numeric_limits<T>::max();
+}
+
+// Calls fn with a value of the member type for width.
+template <typename Fn> decltype(auto) visitWidth(const int width, Fn &&fn) {
+  switch (width) {
+  case 2:
+    return fn(int16_t{});
+  case 4:
+    return fn(int32_t{});
+  default:
+    return fn(int64_t{});
+  }
+}
+
+// The first index in [low, high) whose member is not less than value, or
+// high.
+template <typename T>
+std::size_t lowerBound(const char *data, std::size_t low, std::size_t high,
+                       const T value) {
+  while (low < high) {
+    const std::size_t mid = low + (high - low) / 2;
+    if (load<T>(data, mid) < value) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// The kernels below intersect the ascending values in a, all within the
+// range of T, with the members of b, writing the matches to out, which may
+// alias a. Returns the number of matches.
+
+// Each member of a is looked for by doubling the stride through b from
+// the previous match, then binary searching the last stride: O(na log nb)
+// comparisons, which beats touching all of b when it is much larger.
+template <typename T>
+std::size_t gallopIntersect(const int64_t *a, const std::size_t na,
+                            const char *b, const std::size_t nb,
+                            int64_t *out) {
+  std::size_t count = 0;
+  std::size_t j = 0;
+  for (std::size_t i = 0; i < na && j < nb; i++) {
+    const auto value = static_cast<T>(a[i]);
+    std::size_t high = j;
+    for (std::size_t step = 1; high < nb && load<T>(b, high) < value;
+         step *= 2) {
+      j = high + 1;
+      high += step;
+    }
+    j = lowerBound<T>(b, j, std::min(high, nb), value);
+    if (j < nb && load<T>(b, j) == value) {
+      out[count++] = value;
+      j++;
+    }
+  }
+  return count;
+}
+
+// Whether any lane of the 16 bytes at data equals value.
+template <typename T> bool blockContains(const char *data, const T value) {
+#if defined(__SSE2__)
+  const __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+  __m128i equal;
+  if constexpr (sizeof(T) == 2) {
+    equal = _mm_cmpeq_epi16(block, _mm_set1_epi16(value));
+  } else if constexpr (sizeof(T) == 4) {
+    equal = _mm_cmpeq_epi32(block, _mm_set1_epi32(value));
+  } else {
+    // SSE2 has no 64-bit compare: both halves of a lane must match.
+    equal = _mm_cmpeq_epi32(block, _mm_set1_epi64x(value));
+    equal = _mm_and_si128(equal,
+                          _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+  return _mm_movemask_epi8(equal) != 0;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  if constexpr (sizeof(T) == 2) {
+    return vmaxvq_u16(vceqq_s16(vld1q_s16(reinterpret_cast<const int16_t *>(
+                                    data)),
+                                vdupq_n_s16(value))) != 0;
+  } else if constexpr (sizeof(T) == 4) {
+    return vmaxvq_u32(vceqq_s32(vld1q_s32(reinterpret_cast<const int32_t *>(
+                                    data)),
+                                vdupq_n_s32(value))) != 0;
+  } else {
+    return vmaxvq_u32(vreinterpretq_u32_u64(vceqq_s64(
+               vld1q_s64(reinterpret_cast<const int64_t *>(data)),
+               vdupq_n_s64(value)))) != 0;
+  }
+#else
+  for (std::size_t i = 0; i < 16 / sizeof(T); i++) {
+    if (load<T>(data, i) == value) {
+      return true;
+    }
+  }
+  return false;
+#endif
+}
+
+// A merge that steps through b a 16-byte vector at a time: a vector whose
+// last member is below the current member of a is skipped whole, and
+// otherwise one compare against every lane settles that member.
+template <typename T>
+std::size_t mergeIntersect(const int64_t *a, const std::size_t na,
+                           const char *b, const std::size_t nb,
+                           int64_t *out) {
+  constexpr std::size_t kLanes = 16 / sizeof(T);
+  std::size_t count = 0;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < na && j + kLanes <= nb) {
+    const auto value = static_cast<T>(a[i]);
+    if (load<T>(b, j + kLanes - 1) < value) {
+      j += kLanes;
+      continue;
+    }
+    if (blockContains(b + j * sizeof(T), value)) {
+      out[count++] = value;
+    }
+    i++;
+  }
+
+  while (i < na && j < nb) {
+    const T member = load<T>(b, j);
+    if (member < a[i]) {
+      j++;
+    } else {
+      if (member == a[i]) {
+        out[count++] = a[i];
+      }
+      i++;
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+int IntSet::widthFor(const int64_t value) {
+  if (fits<int16_t>(value)) {
+    return 2;
+  }
+  return fits<int32_t>(value) ? 4 : 8;
+}
+
+int64_t IntSet::get(const std::string_view is, const int width,
+                    const std::size_t index) {
+  return visitWidth(width, [&](auto tag) -> int64_t {
+    return load<decltype(tag)>(is.data(), index);
+  });
+}
+
+bool IntSet::contains(const std::string_view is, const int width,
+                      const int64_t value) {
+  return visitWidth(width, [&](auto tag) {
+    using T = decltype(tag);
+    if (!fits<T>(value)) {
+      return false;
+    }
+    const std::size_t n = size(is, width);
+    const std::size_t index =
+        lowerBound<T>(is.data(), 0, n, static_cast<T>(value));
+    return index < n && load<T>(is.data(), index) == value;
+  });
+}
+
+bool IntSet::add(std::string &is, int &width, const int64_t value) {
+  if (const int needed = widthFor(value); needed > width) {
+    // Too wide for every current member, so value is either below or above
+    // all of them.
+    std::vector<int64_t> members;
+    decode(is, width, members);
+    if (value < 0) {
+      members.insert(members.begin(), value);
+    } else {
+      members.push_back(value);
+    }
+    width = needed;
+    is.assign(members.size() * static_cast<std::size_t>(width), '\0');
+    visitWidth(width, [&](auto tag) {
+      for (std::size_t i = 0; i < members.size(); i++) {
+        store(is.data(), i, static_cast<decltype(tag)>(members[i]));
+      }
+    });
+    return true;
+  }
+
+  return visitWidth(width, [&](auto tag) {
+    using T = decltype(tag);
+    const std::size_t n = size(is, width);
+    const std::size_t index =
+        lowerBound<T>(is.data(), 0, n, static_cast<T>(value));
+    if (index < n && load<T>(is.data(), index) == value) {
+      return false;
+    }
+    is.insert(index * sizeof(T), sizeof(T), '\0');
+    store(is.data(), index, static_cast<T>(value));
+    return true;
+  });
+}
+
+bool IntSet::remove(std::string &is, const int width, const int64_t value) {
+  return visitWidth(width, [&](auto tag) {
+    using T = decltype(tag);
+    if (!fits<T>(value)) {
+      return false;
+    }
+    const std::size_t n = size(is, width);
+    const std::size_t index =
+        lowerBound<T>(is.data(), 0, n, static_cast<T>(value));
+    if (index == n || load<T>(is.data(), index) != value) {
+      return false;
+    }
+    is.erase(index * sizeof(T), sizeof(T));
+    return true;
+  });
+}
+
+void IntSet::decode(const std::string_view is, const int width,
+                    std::vector<int64_t> &out) {
+  visitWidth(width, [&](auto tag) {
+    const std::size_t n = size(is, width);
+    const std::size_t start = out.size();
+    out.resize(start + n);
+    for (std::size_t i = 0; i < n; i++) {
+      out[start + i] = load<decltype(tag)>(is.data(), i);
+    }
+  });
+}
+
+void IntSet::intersect(std::vector<int64_t> &sorted,
+                       const std::string_view is, const int width) {
+  visitWidth(width, [&](auto tag) {
+    using T = decltype(tag);
+    // Only candidates within the range of the set's width can be members;
+    // being sorted, they form one run.
+    const auto first = std::ranges::lower_bound(
+        sorted, int64_t{std::numeric_limits<T>::min()});
+    const auto last = std::upper_bound(first, sorted.end(),
+                                       int64_t{std::numeric_limits<T>::max()});
+    const int64_t *candidates = sorted.data() + (first - sorted.begin());
+    const auto na = static_cast<std::size_t>(last - first);
+
+    // Matches are written over the candidates already consumed.
+    const std::size_t n = size(is, width);
+    const std::size_t count =
+        n / kGallopRatio > na
+            ? gallopIntersect<T>(candidates, na, is.data(), n, sorted.data())
+            : mergeIntersect<T>(candidates, na, is.data(), n, sorted.data());
+    sorted.resize(count);
+  });
+}
+
+} // namespace redis
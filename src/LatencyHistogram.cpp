@@ -0,0 +1,43 @@
+#include "redis/LatencyHistogram.h"
+
+#include <cmath>
+
+namespace redis {
+
+uint64_t LatencyHistogram::bucketUpperBound(const std::size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  const int exponent =
+      static_cast<int>(bucket / kSubBuckets) + kSubBucketBits - 1;
+  const uint64_t sub = bucket % kSubBuckets;
+  const int shift = exponent - kSubBucketBits;
+  return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::percentile(const double fraction) const {
+  if (total_ == 0) {
+    return 0;
+  }
+
+  const auto target = static_cast<uint64_t>(
+      std::ceil(fraction * static_cast<double>(total_)));
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; i++) {
+    seen += counts_[i];
+    if (seen >= target && seen > 0) {
+      return bucketUpperBound(i);
+    }
+  }
+  return bucketUpperBound(kBuckets - 1);
+}
+
+uint64_t LatencyHistogram::countAtOrBelow(const uint64_t nanos) const {
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets && bucketUpperBound(i) <= nanos; i++) {
+    seen += counts_[i];
+  }
+  return seen;
+}
+
+} // namespace redis
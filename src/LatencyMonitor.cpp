@@ -0,0 +1,62 @@
+#include "redis/LatencyMonitor.h"
+
+#include "redis/ServerClock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace redis {
+
+namespace {
+
+constexpr std::array<std::string_view,
+                     static_cast<std::size_t>(LatencyEvent::Count)>
+    kEventNames = {"command", "event-loop", "rdb-load"};
+
+} // namespace
+
+LatencyMonitor::LatencyMonitor(const int64_t thresholdMs)
+    : thresholdMs_(thresholdMs) {}
+
+void LatencyMonitor::record(const LatencyEvent event,
+                            const uint64_t durationMs) {
+  if (thresholdMs_ <= 0 || durationMs < static_cast<uint64_t>(thresholdMs_)) {
+    return;
+  }
+
+  const auto now = ServerClock::unixTime();
+  const auto latency = static_cast<uint32_t>(
+      std::min<uint64_t>(durationMs, std::numeric_limits<uint32_t>::max()));
+
+  Series &series = series_[static_cast<std::size_t>(event)];
+  series.maxMs = std::max(series.maxMs, latency);
+
+  // Spikes within the same second are merged, keeping the worst one.
+  if (Sample &last = series.samples[series.latestIndex()]; last.time == now) {
+    last.latencyMs = std::max(last.latencyMs, latency);
+    return;
+  }
+  series.samples[series.next] = {now, latency};
+  series.next = (series.next + 1) % kSamples;
+}
+
+void LatencyMonitor::reset(const LatencyEvent event) {
+  series_[static_cast<std::size_t>(event)] = Series{};
+}
+
+std::string_view LatencyMonitor::eventName(const LatencyEvent event) {
+  return kEventNames[static_cast<std::size_t>(event)];
+}
+
+std::optional<LatencyEvent>
+LatencyMonitor::eventByName(const std::string_view name) {
+  for (std::size_t i = 0; i < kEventNames.size(); i++) {
+    if (kEventNames[i] == name) {
+      return static_cast<LatencyEvent>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace redis
@@ -0,0 +1,52 @@
+#include "redis/LazyFree.h"
+
+namespace redis {
+
+LazyFree::LazyFree() : thread_([this] { run(); }) {}
+
+LazyFree::~LazyFree() {
+  stopping_.store(true, std::memory_order_relaxed);
+  // Wake the thread even when the queue is empty; it drains what is left
+  // before exiting.
+  pending_.fetch_add(1, std::memory_order_release);
+  pending_.notify_one();
+  thread_.join();
+}
+
+void LazyFree::push(Job *job) {
+  // Counted before it is visible, so the free thread never takes the count
+  // below zero.
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  job->next = head_.load(std::memory_order_relaxed);
+  while (!head_.compare_exchange_weak(job->next, job,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed)) {
+  }
+  pending_.notify_one();
+}
+
+void LazyFree::run() {
+  while (true) {
+    pending_.wait(0, std::memory_order_acquire);
+
+    Job *job = head_.exchange(nullptr, std::memory_order_acquire);
+    if (job == nullptr) {
+      if (stopping_.load(std::memory_order_relaxed)) {
+        return;
+      }
+      // Counted but not pushed yet; the producer is mid-push.
+      std::this_thread::yield();
+      continue;
+    }
+
+    while (job != nullptr) {
+      Job *next = job->next;
+      delete job;
+      freed_.fetch_add(1, std::memory_order_relaxed);
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      job = next;
+    }
+  }
+}
+
+} // namespace redis
@@ -0,0 +1,94 @@
+#include "redis/Listpack.h"
+
+#include <cstring>
+
+namespace redis {
+
+namespace {
+
+// Encodes length into buffer, returning the number of bytes used.
+std::size_t encodeLength(std::size_t length, char (&buffer)[10]) {
+  std::size_t size = 0;
+  do {
+    auto byte = static_cast<uint8_t>(length & 0x7F);
+    length >>= 7;
+    if (length != 0) {
+      byte |= 0x80;
+    }
+    buffer[size++] = static_cast<char>(byte);
+  } while (length != 0);
+  return size;
+}
+
+} // namespace
+
+void Listpack::append(std::string &lp, const std::string_view element) {
+  char header[10];
+  lp.append(header, encodeLength(element.size(), header));
+  lp.append(element);
+}
+
+std::size_t Listpack::skip(const std::string_view lp, std::size_t pos) {
+  const std::size_t length = readLength(lp, pos);
+  return pos + length;
+}
+
+std::size_t Listpack::findPair(const std::string_view lp,
+                               const std::string_view field) {
+  std::size_t pos = 0;
+  while (pos < lp.size()) {
+    const std::size_t start = pos;
+    const std::size_t length = readLength(lp, pos);
+    // Compare lengths first: most fields are rejected without a memcmp.
+    if (length == field.size() && pos + length <= lp.size() &&
+        std::memcmp(lp.data() + pos, field.data(), length) == 0) {
+      return start;
+    }
+    pos = skip(lp, pos + length);
+  }
+  return std::string_view::npos;
+}
+
+std::optional<std::string_view> Listpack::find(const std::string_view lp,
+                                               const std::string_view field) {
+  const std::size_t start = findPair(lp, field);
+  if (start == std::string_view::npos) {
+    return std::nullopt;
+  }
+  std::size_t pos = skip(lp, start);
+  const std::size_t length = readLength(lp, pos);
+  return lp.substr(pos, length);
+}
+
+bool Listpack::set(std::string &lp, const std::string_view field,
+                   const std::string_view value) {
+  const std::size_t start = findPair(lp, field);
+  if (start == std::string_view::npos) {
+    append(lp, field);
+    append(lp, value);
+    return true;
+  }
+
+  // Splice the new value, header included, over the old one.
+  const std::size_t valueStart = skip(lp, start);
+  const std::size_t valueEnd = skip(lp, valueStart);
+  char header[10];
+  const std::size_t headerSize = encodeLength(value.size(), header);
+  lp.replace(valueStart, valueEnd - valueStart, headerSize + value.size(),
+             '\0');
+  std::memcpy(lp.data() + valueStart, header, headerSize);
+  std::memcpy(lp.data() + valueStart + headerSize, value.data(),
+              value.size());
+  return false;
+}
+
+bool Listpack::erase(std::string &lp, const std::string_view field) {
+  const std::size_t start = findPair(lp, field);
+  if (start == std::string_view::npos) {
+    return false;
+  }
+  lp.erase(start, skip(lp, skip(lp, start)) - start);
+  return true;
+}
+
+} // namespace redis
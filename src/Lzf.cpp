@@ -0,0 +1,207 @@
+#include "redis/Lzf.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace redis {
+
+namespace {
+
+// A back reference reaches at most 8 KiB back and copies 3 to 264 bytes.
+constexpr std::size_t kMaxOffset = std::size_t{1} << 13;
+constexpr std::size_t kMaxMatch = (1 << 8) + (1 << 3);
+constexpr std::size_t kMaxLiteralRun = 1 << 5;
+
+constexpr int kHashLog = 13;
+
+// Maps the hash of three bytes to the last input position they were seen at,
+// biased by base. Bumping base past every stored entry invalidates the whole
+// table at once, so it is only cleared when base wraps rather than per call.
+struct HashTable {
+  std::array<uint32_t, std::size_t{1} << kHashLog> positions{};
+  uint32_t base = 1;
+};
+
+// Copies length bytes in 8-byte steps, possibly writing up to 7 bytes past
+// dst + length; the caller guarantees the room. Safe for overlapping ranges
+// as long as src is at least 8 bytes behind dst.
+void wildCopy(uint8_t *dst, const uint8_t *src, const std::size_t length) {
+  for (std::size_t i = 0; i < length; i += 8) {
+    std::memcpy(dst + i, src + i, 8);
+  }
+}
+
+uint32_t hash3(const uint8_t *p) {
+  const uint32_t v = (uint32_t{p[0]} << 16) | (uint32_t{p[1]} << 8) | p[2];
+  return (v * 2654435761U) >> (32 - kHashLog);
+}
+
+} // namespace
+
+std::size_t lzfCompress(const std::string_view input, char *out,
+                        const std::size_t outLength) {
+  if (input.empty() ||
+      input.size() >= std::numeric_limits<uint32_t>::max() / 2) {
+    return 0;
+  }
+
+  thread_local HashTable table;
+  if (table.base > std::numeric_limits<uint32_t>::max() - input.size() - 1) {
+    table.positions.fill(0);
+    table.base = 1;
+  }
+  const uint32_t base = table.base;
+  table.base += static_cast<uint32_t>(input.size()) + 1;
+
+  const auto *const in = reinterpret_cast<const uint8_t *>(input.data());
+  const uint8_t *const inEnd = in + input.size();
+  auto *op = reinterpret_cast<uint8_t *>(out);
+  const uint8_t *const outEnd = op + outLength;
+  const uint8_t *ip = in;
+
+  // Literals are written as they are found, after a control byte reserved
+  // at op[-literals - 1] and filled in when the run ends.
+  std::size_t literals = 0;
+  op++;
+  const auto appendLiteral = [&] {
+    if (op >= outEnd) {
+      return false;
+    }
+    *op++ = *ip++;
+    if (++literals == kMaxLiteralRun) {
+      op[-static_cast<std::ptrdiff_t>(literals) - 1] =
+          static_cast<uint8_t>(literals - 1);
+      literals = 0;
+      op++;
+    }
+    return true;
+  };
+
+  while (ip + 2 < inEnd) {
+    const uint32_t h = hash3(ip);
+    const uint32_t entry = table.positions[h];
+    table.positions[h] = base + static_cast<uint32_t>(ip - in);
+
+    const uint8_t *ref = entry >= base ? in + (entry - base) : nullptr;
+    if (ref == nullptr || static_cast<std::size_t>(ip - ref) > kMaxOffset ||
+        std::memcmp(ref, ip, 3) != 0) {
+      if (!appendLiteral()) {
+        return 0;
+      }
+      continue;
+    }
+
+    const std::size_t maxLength =
+        std::min(kMaxMatch, static_cast<std::size_t>(inEnd - ip));
+    std::size_t length = 3;
+    while (length < maxLength && ref[length] == ip[length]) {
+      length++;
+    }
+
+    // Close the pending literal run, dropping its control byte if empty.
+    if (literals == 0) {
+      op--;
+    } else {
+      op[-static_cast<std::ptrdiff_t>(literals) - 1] =
+          static_cast<uint8_t>(literals - 1);
+    }
+    if (outEnd - op < 3) {
+      return 0;
+    }
+
+    const std::size_t offset = static_cast<std::size_t>(ip - ref) - 1;
+    const std::size_t encoded = length - 2;
+    if (encoded < 7) {
+      *op++ = static_cast<uint8_t>((offset >> 8) + (encoded << 5));
+    } else {
+      *op++ = static_cast<uint8_t>((offset >> 8) + (7 << 5));
+      *op++ = static_cast<uint8_t>(encoded - 7);
+    }
+    *op++ = static_cast<uint8_t>(offset & 0xFF);
+
+    literals = 0;
+    op++;
+    ip += length;
+  }
+
+  while (ip < inEnd) {
+    if (!appendLiteral()) {
+      return 0;
+    }
+  }
+
+  if (literals == 0) {
+    op--;
+  } else {
+    op[-static_cast<std::ptrdiff_t>(literals) - 1] =
+        static_cast<uint8_t>(literals - 1);
+  }
+  return static_cast<std::size_t>(op - reinterpret_cast<uint8_t *>(out));
+}
+
+bool lzfDecompress(const std::string_view input, char *out,
+                   const std::size_t outLength) {
+  const auto *ip = reinterpret_cast<const uint8_t *>(input.data());
+  const uint8_t *const inEnd = ip + input.size();
+  auto *op = reinterpret_cast<uint8_t *>(out);
+  const uint8_t *const outStart = op;
+  const uint8_t *const outEnd = op + outLength;
+
+  while (ip < inEnd) {
+    const uint8_t control = *ip++;
+
+    if (control < kMaxLiteralRun) {
+      const std::size_t length = control + 1U;
+      if (static_cast<std::size_t>(inEnd - ip) < length ||
+          static_cast<std::size_t>(outEnd - op) < length) {
+        return false;
+      }
+      if (static_cast<std::size_t>(outEnd - op) >= length + 8 &&
+          static_cast<std::size_t>(inEnd - ip) >= length + 8) {
+        wildCopy(op, ip, length);
+      } else {
+        std::memcpy(op, ip, length);
+      }
+      op += length;
+      ip += length;
+      continue;
+    }
+
+    std::size_t length = control >> 5;
+    if (length == 7) {
+      if (ip == inEnd) {
+        return false;
+      }
+      length += *ip++;
+    }
+    length += 2;
+    if (ip == inEnd) {
+      return false;
+    }
+    const std::size_t offset = ((control & 0x1FU) << 8 | *ip++) + 1;
+    if (static_cast<std::size_t>(op - outStart) < offset ||
+        static_cast<std::size_t>(outEnd - op) < length) {
+      return false;
+    }
+
+    const uint8_t *ref = op - offset;
+    if (offset >= 8 && static_cast<std::size_t>(outEnd - op) >= length + 8) {
+      wildCopy(op, ref, length);
+      op += length;
+    } else if (offset >= length) {
+      std::memcpy(op, ref, length);
+      op += length;
+    } else {
+      // Overlapping copy: the reference repeats bytes it is producing.
+      for (std::size_t i = 0; i < length; i++) {
+        *op++ = *ref++;
+      }
+    }
+  }
+  return op == outEnd;
+}
+
+} // namespace redis
@@ -0,0 +1,246 @@
+#include "redis/Metrics.h"
+
+#include "redis/CommandTable.h"
+#include "redis/Config.h"
+
+#include <cstdio>
+#include <numeric>
+#include <utility>
+
+namespace redis {
+
+namespace {
+
+// Formats nanos as microseconds with three decimals, as INFO reports them.
+std::string formatMicros(const uint64_t nanos) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f",
+                static_cast<double>(nanos) / 1000.0);
+  return buffer;
+}
+
+std::string formatSeconds(const uint64_t nanos) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.9f",
+                static_cast<double>(nanos) / 1e9);
+  return buffer;
+}
+
+} // namespace
+
+Metrics::Metrics(const Config &config)
+    : startTime_(std::chrono::steady_clock::now()),
+      commands_(CommandTable::all().size()),
+      slowLog_(config.getSlowlogLogSlowerThan(), config.getSlowlogMaxLen()),
+      latencyMonitor_(config.getLatencyMonitorThreshold()),
+      hotKeys_(config.getHotkeysSampleRate()),
+      bigKeys_(config.getBigkeysScan()),
+      lastSampleTime_(startTime_) {}
+
+void Metrics::recordCommand(const std::size_t commandId,
+                            const std::chrono::steady_clock::time_point start,
+                            const std::chrono::steady_clock::time_point end,
+                            const bool failed) {
+  const auto nanos = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+
+  CommandStats &stats = commands_[commandId];
+  stats.calls++;
+  stats.nanos += nanos;
+  stats.latency.record(nanos);
+  if (failed) {
+    stats.failedCalls++;
+  }
+  totalCommands_++;
+  sampleOps(end);
+}
+
+void Metrics::recordRejected(const std::size_t commandId) {
+  commands_[commandId].rejectedCalls++;
+}
+
+void Metrics::resetStats() {
+  for (auto &stats : commands_) {
+    stats = CommandStats{};
+  }
+  totalCommands_ = 0;
+  totalConnections_ = 0;
+  rejectedConnections_ = 0;
+  netInputBytes_ = 0;
+  netOutputBytes_ = 0;
+  threadedReads_ = 0;
+  threadedWrites_ = 0;
+  opsSamples_.fill(0);
+  lastSampleCommands_ = 0;
+}
+
+int64_t Metrics::uptimeSeconds() const {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::steady_clock::now() - startTime_)
+      .count();
+}
+
+void Metrics::sampleOps(const std::chrono::steady_clock::time_point now) {
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           now - lastSampleTime_)
+                           .count();
+  if (elapsed < 100) {
+    return;
+  }
+
+  const auto ops = totalCommands_ - lastSampleCommands_;
+  opsSamples_[opsSampleIndex_] =
+      static_cast<double>(ops) * 1000.0 / static_cast<double>(elapsed);
+  opsSampleIndex_ = (opsSampleIndex_ + 1) % kOpsSamples;
+  lastSampleTime_ = now;
+  lastSampleCommands_ = totalCommands_;
+}
+
+double Metrics::instantaneousOps() const {
+  return std::accumulate(opsSamples_.begin(), opsSamples_.end(), 0.0) /
+         static_cast<double>(kOpsSamples);
+}
+
+std::string Metrics::statsInfo() {
+  sampleOps(std::chrono::steady_clock::now());
+
+  std::string info = "# Stats\r\n";
+  info += "total_connections_received:" + std::to_string(totalConnections_) +
+          "\r\n";
+  info += "total_commands_processed:" + std::to_string(totalCommands_) + "\r\n";
+  info += "instantaneous_ops_per_sec:" +
+          std::to_string(static_cast<uint64_t>(instantaneousOps())) + "\r\n";
+  info += "total_net_input_bytes:" + std::to_string(netInputBytes_) + "\r\n";
+  info += "total_net_output_bytes:" + std::to_string(netOutputBytes_) + "\r\n";
+  info += "rejected_connections:" + std::to_string(rejectedConnections_) +
+          "\r\n";
+  info += "io_threaded_reads_processed:" + std::to_string(threadedReads_) +
+          "\r\n";
+  info += "io_threaded_writes_processed:" + std::to_string(threadedWrites_) +
+          "\r\n";
+  return info;
+}
+
+std::string Metrics::commandStatsInfo() const {
+  std::string info = "# Commandstats\r\n";
+  for (const auto &command : CommandTable::all()) {
+    const CommandStats &stats = commands_[command.id];
+    if (stats.calls == 0 && stats.rejectedCalls == 0) {
+      continue;
+    }
+
+    const uint64_t usec = stats.nanos / 1000;
+    char perCall[32];
+    std::snprintf(perCall, sizeof(perCall), "%.2f",
+                  stats.calls == 0 ? 0.0
+                                   : static_cast<double>(stats.nanos) /
+                                         1000.0 /
+                                         static_cast<double>(stats.calls));
+    info += "cmdstat_" + std::string(command.name) +
+            ":calls=" + std::to_string(stats.calls) +
+            ",usec=" + std::to_string(usec) + ",usec_per_call=" + perCall +
+            ",rejected_calls=" + std::to_string(stats.rejectedCalls) +
+            ",failed_calls=" + std::to_string(stats.failedCalls) + "\r\n";
+  }
+  return info;
+}
+
+std::string Metrics::latencyStatsInfo() const {
+  std::string info = "# Latencystats\r\n";
+  for (const auto &command : CommandTable::all()) {
+    const LatencyHistogram &latency = commands_[command.id].latency;
+    if (latency.count() == 0) {
+      continue;
+    }
+
+    info += "latency_percentiles_usec_" + std::string(command.name) +
+            ":p50=" + formatMicros(latency.percentile(0.5)) +
+            ",p99=" + formatMicros(latency.percentile(0.99)) +
+            ",p99.9=" + formatMicros(latency.percentile(0.999)) + "\r\n";
+  }
+  return info;
+}
+
+std::string Metrics::hotKeysInfo() const {
+  // INFO lists the ten hottest and biggest; HOTKEYS and BIGKEYS have more.
+  constexpr std::size_t kListed = 10;
+
+  std::string info = "# Hotkeys\r\nhotkeys_sample_rate:" +
+                     std::to_string(hotKeys_.sampleRate()) +
+                     "\r\nhotkeys_sampled_keys:" +
+                     std::to_string(hotKeys_.sampled()) +
+                     "\r\nbigkeys_scan_enabled:" +
+                     (bigKeys_.enabled() ? "1" : "0") +
+                     "\r\nbigkeys_scan_passes:" +
+                     std::to_string(bigKeys_.passes()) + "\r\n";
+  const auto hot = hotKeys_.top(kListed);
+  for (std::size_t i = 0; i < hot.size(); i++) {
+    info += "hotkey_" + std::to_string(i) + ":key=" + hot[i].first +
+            ",accesses=" + std::to_string(hot[i].second) + "\r\n";
+  }
+  const auto big = bigKeys_.top(kListed);
+  for (std::size_t i = 0; i < big.size(); i++) {
+    info += "bigkey_" + std::to_string(i) + ":key=" + big[i].first +
+            ",bytes=" + std::to_string(big[i].second) + "\r\n";
+  }
+  return info;
+}
+
+std::string Metrics::prometheus() {
+  sampleOps(std::chrono::steady_clock::now());
+
+  std::string out;
+  out += "# TYPE redis_uptime_seconds gauge\n";
+  out += "redis_uptime_seconds " + std::to_string(uptimeSeconds()) + "\n";
+  out += "# TYPE redis_connected_clients gauge\n";
+  out += "redis_connected_clients " + std::to_string(connectedClients_) + "\n";
+  out += "# TYPE redis_connections_received_total counter\n";
+  out += "redis_connections_received_total " +
+         std::to_string(totalConnections_) + "\n";
+  out += "# TYPE redis_commands_processed_total counter\n";
+  out += "redis_commands_processed_total " + std::to_string(totalCommands_) +
+         "\n";
+  out += "# TYPE redis_instantaneous_ops_per_sec gauge\n";
+  out += "redis_instantaneous_ops_per_sec " +
+         std::to_string(static_cast<uint64_t>(instantaneousOps())) + "\n";
+  out += "# TYPE redis_net_input_bytes_total counter\n";
+  out += "redis_net_input_bytes_total " + std::to_string(netInputBytes_) + "\n";
+  out += "# TYPE redis_net_output_bytes_total counter\n";
+  out +=
+      "redis_net_output_bytes_total " + std::to_string(netOutputBytes_) + "\n";
+
+  std::string calls = "# TYPE redis_commands_total counter\n";
+  std::string failed = "# TYPE redis_commands_failed_total counter\n";
+  std::string duration =
+      "# TYPE redis_commands_duration_seconds_total counter\n";
+  std::string latency = "# TYPE redis_command_latency_seconds summary\n";
+  for (const auto &command : CommandTable::all()) {
+    const CommandStats &stats = commands_[command.id];
+    if (stats.calls == 0) {
+      continue;
+    }
+
+    const std::string label = "{cmd=\"" + std::string(command.name) + "\"";
+    calls += "redis_commands_total" + label + "} " +
+             std::to_string(stats.calls) + "\n";
+    failed += "redis_commands_failed_total" + label + "} " +
+              std::to_string(stats.failedCalls) + "\n";
+    duration += "redis_commands_duration_seconds_total" + label + "} " +
+                formatSeconds(stats.nanos) + "\n";
+    for (const auto &[quantile, fraction] :
+         {std::pair{"0.5", 0.5}, {"0.99", 0.99}, {"0.999", 0.999}}) {
+      latency += "redis_command_latency_seconds" + label + ",quantile=\"" +
+                 quantile + "\"} " +
+                 formatSeconds(stats.latency.percentile(fraction)) + "\n";
+    }
+    latency += "redis_command_latency_seconds_sum" + label + "} " +
+               formatSeconds(stats.nanos) + "\n";
+    latency += "redis_command_latency_seconds_count" + label + "} " +
+               std::to_string(stats.calls) + "\n";
+  }
+
+  return out + calls + failed + duration + latency;
+}
+
+} // namespace redis
@@ -0,0 +1,178 @@
+#include "redis/PubSub.h"
+
+#include "redis/Client.h"
+#include "redis/RESPParser.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace redis {
+
+namespace {
+
+void removeSubscriber(std::vector<Client *> &subscribers,
+                      const Client *client) {
+  if (const auto it = std::ranges::find(subscribers, client);
+      it != subscribers.end()) {
+    *it = subscribers.back();
+    subscribers.pop_back();
+  }
+}
+
+// A message encoded once per protocol: RESP2 clients get an array, RESP3
+// clients the same elements as an out-of-band push.
+class MessageFrame {
+public:
+  explicit MessageFrame(std::string array) : array_(std::move(array)) {}
+
+  void queueOn(Client &client) {
+    const bool push = client.protocolVersion >= 3;
+    auto &frame = push ? pushFrame_ : arrayFrame_;
+    if (!frame) {
+      frame = std::make_shared<const std::string>(
+          push ? ">" + array_.substr(1) : array_);
+    }
+    client.queueOutput(frame);
+  }
+
+private:
+  std::string array_;
+  std::shared_ptr<const std::string> arrayFrame_;
+  std::shared_ptr<const std::string> pushFrame_;
+};
+
+} // namespace
+
+bool PubSub::subscribe(Client &client, const std::string &channel) {
+  if (!client.channels.insert(channel).second) {
+    return false;
+  }
+  channels_[channel].push_back(&client);
+  return true;
+}
+
+bool PubSub::unsubscribe(Client &client, const std::string &channel) {
+  if (client.channels.erase(channel) == 0) {
+    return false;
+  }
+
+  if (const auto it = channels_.find(channel); it != channels_.end()) {
+    removeSubscriber(it->second, &client);
+    if (it->second.empty()) {
+      channels_.erase(it);
+    }
+  }
+  return true;
+}
+
+bool PubSub::psubscribe(Client &client, const std::string &pattern) {
+  if (!client.patterns.insert(pattern).second) {
+    return false;
+  }
+
+  auto &subscription = patterns_[pattern];
+  if (!subscription) {
+    subscription = std::make_unique<PatternSubscription>(
+        PatternSubscription{pattern, GlobPattern(pattern), {}});
+
+    PatternNode *node = &patternRoot_;
+    for (const char c : subscription->glob.literalPrefix()) {
+      auto &child = node->children[c];
+      if (!child) {
+        child = std::make_unique<PatternNode>();
+      }
+      node = child.get();
+    }
+    node->patterns.push_back(subscription.get());
+  }
+  subscription->subscribers.push_back(&client);
+  return true;
+}
+
+bool PubSub::punsubscribe(Client &client, const std::string &pattern) {
+  if (client.patterns.erase(pattern) == 0) {
+    return false;
+  }
+
+  if (const auto it = patterns_.find(pattern); it != patterns_.end()) {
+    removeSubscriber(it->second->subscribers, &client);
+    if (it->second->subscribers.empty()) {
+      removePatternFromTrie(it->second.get());
+      patterns_.erase(it);
+    }
+  }
+  return true;
+}
+
+void PubSub::unsubscribeAll(Client &client) {
+  for (const auto channels = client.channels; const auto &channel : channels) {
+    unsubscribe(client, channel);
+  }
+  for (const auto patterns = client.patterns; const auto &pattern : patterns) {
+    punsubscribe(client, pattern);
+  }
+}
+
+std::size_t PubSub::publish(const std::string &channel,
+                            const std::string &message) {
+  std::size_t receivers = 0;
+
+  if (const auto it = channels_.find(channel); it != channels_.end()) {
+    MessageFrame frame(RESPParser::encodeArray({"message", channel, message}));
+    for (Client *client : it->second) {
+      frame.queueOn(*client);
+    }
+    receivers += it->second.size();
+  }
+
+  // Walk the trie along the channel name; only patterns stored on that path
+  // can match, and their compiled globs check the remainder.
+  const PatternNode *node = &patternRoot_;
+  for (std::size_t depth = 0; node != nullptr; depth++) {
+    for (const PatternSubscription *subscription : node->patterns) {
+      if (!subscription->glob.matches(channel)) {
+        continue;
+      }
+      MessageFrame frame(RESPParser::encodeArray(
+          {"pmessage", subscription->pattern, channel, message}));
+      for (Client *client : subscription->subscribers) {
+        frame.queueOn(*client);
+      }
+      receivers += subscription->subscribers.size();
+    }
+
+    if (depth == channel.size()) {
+      break;
+    }
+    const auto child = node->children.find(channel[depth]);
+    node = child == node->children.end() ? nullptr : child->second.get();
+  }
+
+  return receivers;
+}
+
+void PubSub::removePatternFromTrie(const PatternSubscription *subscription) {
+  const std::string &prefix = subscription->glob.literalPrefix();
+
+  std::vector<PatternNode *> path{&patternRoot_};
+  for (const char c : prefix) {
+    const auto it = path.back()->children.find(c);
+    if (it == path.back()->children.end()) {
+      return;
+    }
+    path.push_back(it->second.get());
+  }
+
+  std::erase(path.back()->patterns, subscription);
+
+  // Prune nodes left without patterns or children.
+  for (std::size_t depth = prefix.size(); depth > 0; depth--) {
+    const PatternNode *node = path[depth];
+    if (!node->patterns.empty() || !node->children.empty()) {
+      break;
+    }
+    path[depth - 1]->children.erase(prefix[depth - 1]);
+  }
+}
+
+} // namespace redis
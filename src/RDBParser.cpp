@@ -1,14 +1,47 @@
 #include "redis/RDBParser.h"
 
+#include "redis/Crc64.h"
+#include "redis/Lzf.h"
+#include "redis/RDBWriter.h"
+#include "redis/ServerClock.h"
 #include "redis/Storage.h"
 
-#include <chrono>
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 
 namespace redis {
 
+namespace {
+
+// Keys loaded between refreshes of the cached clock.
+constexpr std::size_t kClockRefreshInterval = 1024;
+
+constexpr std::size_t kReadChunk = 1 << 20;
+
+// The first RDB version with a checksum trailer.
+constexpr int kFirstChecksummedVersion = 5;
+
+// Module value field types, as RDBWriter writes them.
+constexpr uint8_t kModuleEof = 0;
+constexpr uint8_t kModuleUint = 2;
+constexpr uint8_t kModuleDouble = 4;
+constexpr uint8_t kModuleString = 5;
+
+// The most LZF output per input byte: a 3-byte back reference copies up to
+// 264 bytes.
+constexpr uint64_t kMaxLzfExpansion = 88;
+
+// A dumped value ends in the RDB version (2 bytes) and a CRC64 (8 bytes).
+constexpr std::size_t kDumpFooter = 10;
+
+// More sub-filters than this would take over 2^64 items at any expansion.
+constexpr uint64_t kMaxBloomLayers = 64;
+
+} // namespace
+
 bool RDBParser::parseFile(const std::string &filepath, Storage &storage) {
   if (!std::filesystem::exists(filepath)) {
     std::cout << "RDB file not found: " << filepath << std::endl;
@@ -21,39 +54,88 @@ bool RDBParser::parseFile(const std::string &filepath, Storage &storage) {
     return false;
   }
 
+  fileSize_ = std::filesystem::file_size(filepath);
+  // Small files, the common case in tests, need no more than their size.
+  buffer_.resize(
+      static_cast<std::size_t>(std::min<uint64_t>(kReadChunk, fileSize_ + 1)));
   bool success = false;
 
   if (readHeader() && skipMetadata() && readDatabase(storage)) {
-    success = true;
+    success = !corrupt_;
+    if (corrupt_) {
+      std::cerr << "Short read or corrupt data in RDB file" << std::endl;
+    }
   }
 
   file_.close();
+  if (!success) {
+    // Loading happens at startup, into an empty keyspace: drop whatever the
+    // damaged file got to rather than run on part of it.
+    storage.clear(false);
+  }
   return success;
 }
 
+bool RDBParser::verifyDump(const std::string_view payload) {
+  if (payload.size() <= kDumpFooter) {
+    return false;
+  }
+  const std::size_t body = payload.size() - kDumpFooter;
+  uint16_t version;
+  uint64_t expected;
+  std::memcpy(&version, payload.data() + body, 2); // Assuming little-endian
+  std::memcpy(&expected, payload.data() + body + 2, 8);
+  return version <= RDBWriter::kRdbVersion &&
+         crc64(0, payload.substr(0, body + 2)) == expected;
+}
+
+bool RDBParser::restoreValue(const std::string_view payload,
+                             const std::string &key, const int64_t ttlMs,
+                             Storage &storage) {
+  if (!verifyDump(payload)) {
+    return false;
+  }
+
+  // The parser reads the value as if it were the whole file.
+  const std::size_t body = payload.size() - kDumpFooter;
+  buffer_.assign(payload.begin(), payload.begin() + body);
+  pos_ = 0;
+  end_ = body;
+  checksumFrom_ = 0;
+  fileSize_ = body;
+  version_ = RDBWriter::kRdbVersion;
+  corrupt_ = false;
+
+  const uint8_t type = readByte();
+  const bool hasExpiry = ttlMs > 0;
+  const uint64_t expiryTime =
+      hasExpiry ? static_cast<uint64_t>(ServerClock::unixTimeMs() + ttlMs) : 0;
+  return readValue(storage, type, key, hasExpiry, expiryTime) && !corrupt_ &&
+         pos_ == end_;
+}
+
 bool RDBParser::readHeader() {
   char header[9];
-  file_.read(header, 9);
+  readBytes(header, 9);
 
-  if (!file_ || std::string(header, 5) != "REDIS") {
+  if (corrupt_ || std::string(header, 5) != "REDIS") {
     std::cerr << "Invalid RDB file header" << std::endl;
     return false;
   }
 
+  version_ = std::atoi(std::string(header + 5, 4).c_str());
   return true;
 }
 
 bool RDBParser::skipMetadata() {
   while (!isEOF()) {
-    uint8_t type = readByte();
-
-    if (type == 0xFA) {
+    if (const uint8_t type = peekByte(); type == 0xFA) {
       // Metadata subsection
+      readByte();
       readString(); // metadata name
       readString(); // metadata value
     } else if (type == 0xFE || type == 0xFF) {
       // Database subsection starts or End of a file
-      file_.seekg(-1, std::ios::cur); // Go back one byte
       return true;
     } else {
       // Unknown type in the metadata section
@@ -69,22 +151,28 @@ bool RDBParser::skipMetadata() {
 bool RDBParser::readDatabase(Storage &storage) {
   while (!isEOF()) {
     if (const uint8_t type = readByte(); type == 0xFE) {
+      readLength(); // database index
+
       // Check for hash table size info
-      if (const uint8_t nextByte = readByte(); nextByte == 0xFB) {
+      if (!isEOF() && peekByte() == 0xFB) {
+        readByte();
         readLength(); // hash table size
         readLength(); // expire hash table size
-      } else {
-        file_.seekg(-1, std::ios::cur);
       }
 
       // Read key-value pairs
-      while (!isEOF()) {
-        uint8_t marker = readByte();
+      std::size_t keysRead = 0;
+      while (!isEOF() && !corrupt_) {
+        // Large files take a while to load; refresh the cached clock now and
+        // then so that expiry times are not judged against a stale "now".
+        if (keysRead++ % kClockRefreshInterval == 0) {
+          ServerClock::update();
+        }
 
-        if (marker == 0xFE || marker == 0xFF) {
-          file_.seekg(-1, std::ios::cur);
+        if (const uint8_t next = peekByte(); next == 0xFE || next == 0xFF) {
           break;
         }
+        uint8_t marker = readByte();
 
         // Check for expiry
         bool hasExpiry = false;
@@ -102,37 +190,14 @@ bool RDBParser::readDatabase(Storage &storage) {
           marker = readByte(); // Read value type
         }
 
-        // For now, we only support string values (type 0)
-        if (marker != 0x00) {
-          std::cerr << "Unsupported value type: " << static_cast<int>(marker)
-                    << std::endl;
+        const std::string key = readString();
+        if (!readValue(storage, marker, key, hasExpiry, expiryTime)) {
           return false;
         }
-
-        std::string key = readString();
-        std::string value = readString();
-
-        if (hasExpiry) {
-          // Convert Unix timestamp to duration from now
-          auto now = std::chrono::system_clock::now();
-          const auto nowMs =
-              std::chrono::duration_cast<std::chrono::milliseconds>(
-                  now.time_since_epoch())
-                  .count();
-
-          if (expiryTime > static_cast<uint64_t>(nowMs)) {
-            const int64_t durationMs = expiryTime - nowMs;
-            storage.setWithExpiry(key, value, durationMs);
-          }
-          // If expired, don't add to storage
-        } else {
-          storage.set(key, value);
-        }
       }
     } else if (type == 0xFF) {
       // End of file marker
-      skipBytes(8); // Skip checksum
-      return true;
+      return verifyChecksum();
     } else {
       std::cerr << "Unexpected byte in database section: "
                 << static_cast<int>(type) << std::endl;
@@ -143,21 +208,224 @@ bool RDBParser::readDatabase(Storage &storage) {
   return true;
 }
 
+bool RDBParser::readValue(Storage &storage, const uint8_t type,
+                          const std::string &key, const bool hasExpiry,
+                          const uint64_t expiryTime) {
+  // Strings (type 0), sets (type 2), hashes (type 4) and bloom filters
+  // (module type 7) are supported.
+  if (type == 0x02 || type == 0x04) {
+    return readAggregate(storage, key, type, hasExpiry, expiryTime);
+  }
+  if (type == 0x07) {
+    return readBloom(storage, key, hasExpiry, expiryTime);
+  }
+  if (type != 0x00) {
+    std::cerr << "Unsupported value type: " << static_cast<int>(type)
+              << std::endl;
+    return false;
+  }
+
+  const std::string value = readString();
+  if (corrupt_) {
+    return true;
+  }
+  if (hasExpiry) {
+    // Convert Unix timestamp to duration from now
+    const auto nowMs = ServerClock::unixTimeMs();
+
+    if (expiryTime > static_cast<uint64_t>(nowMs)) {
+      const int64_t durationMs = expiryTime - nowMs;
+      storage.setWithExpiry(key, value, durationMs);
+    }
+    // If expired, don't add to storage
+  } else {
+    storage.set(key, value);
+  }
+  return true;
+}
+
+bool RDBParser::readAggregate(Storage &storage, const std::string &key,
+                              const uint8_t type, const bool hasExpiry,
+                              const uint64_t expiryTime) {
+  // A hash's length counts fields, each followed by its value.
+  const uint64_t length = readLength();
+  const uint64_t elements = type == 0x04 ? length * 2 : length;
+  // Every element takes at least a byte.
+  if (length == 0 || elements > fileSize_) {
+    corrupt_ = true;
+    return true;
+  }
+
+  std::vector<std::string> values;
+  values.reserve(static_cast<std::size_t>(elements));
+  for (uint64_t i = 0; i < elements && !corrupt_; i++) {
+    values.push_back(readString());
+  }
+  if (corrupt_) {
+    return true;
+  }
+
+  const int64_t nowMs = ServerClock::unixTimeMs();
+  if (hasExpiry && expiryTime <= static_cast<uint64_t>(nowMs)) {
+    return true; // expired, don't add to storage
+  }
+  std::size_t added = 0;
+  if (type == 0x04 ? !storage.hset(key, values, added)
+                   : !storage.sadd(key, values, added)) {
+    std::cerr << "Duplicate key in RDB file: " << key << std::endl;
+    return false;
+  }
+  if (hasExpiry) {
+    storage.pexpire(key, static_cast<int64_t>(expiryTime) - nowMs);
+  }
+  return true;
+}
+
+bool RDBParser::readBloom(Storage &storage, const std::string &key,
+                          const bool hasExpiry, const uint64_t expiryTime) {
+  if (const uint64_t id = readLength(); id != BloomFilter::kRdbModuleId) {
+    if (!corrupt_) {
+      std::cerr << "Unsupported module value, id: " << std::hex << id
+                << std::dec << std::endl;
+    }
+    return corrupt_;
+  }
+
+  const auto expect = [this](const uint8_t opcode) {
+    if (readByte() != opcode) {
+      corrupt_ = true;
+    }
+  };
+  const auto readUnsigned = [&] {
+    expect(kModuleUint);
+    return readLength();
+  };
+
+  BloomFilter::Options options;
+  expect(kModuleDouble);
+  readBytes(reinterpret_cast<char *>(&options.errorRate), 8);
+  options.capacity = readUnsigned();
+  options.expansion = static_cast<unsigned>(readUnsigned());
+  const uint64_t layerCount = readUnsigned();
+  if (!BloomFilter::validErrorRate(options.errorRate) || layerCount == 0 ||
+      layerCount > kMaxBloomLayers) {
+    corrupt_ = true;
+    return true;
+  }
+
+  std::vector<BloomFilter::Layer> layers;
+  for (uint64_t i = 0; i < layerCount && !corrupt_; i++) {
+    BloomFilter::Layer &layer = layers.emplace_back();
+    layer.capacity = readUnsigned();
+    layer.count = readUnsigned();
+    layer.hashes = static_cast<unsigned>(readUnsigned());
+    expect(kModuleString);
+    const std::string bits = readString();
+    if (layer.capacity == 0 || layer.hashes == 0 ||
+        layer.hashes > BloomFilter::kMaxHashes ||
+        bits.empty() || bits.size() % sizeof(BloomFilter::Block) != 0) {
+      corrupt_ = true;
+      break;
+    }
+    layer.blocks = bits.size() / sizeof(BloomFilter::Block);
+    layer.bits = std::make_unique<BloomFilter::Block[]>(layer.blocks);
+    std::memcpy(layer.bits.get(), bits.data(), bits.size());
+  }
+  expect(kModuleEof);
+  if (corrupt_) {
+    return true;
+  }
+
+  const int64_t nowMs = ServerClock::unixTimeMs();
+  if (hasExpiry && expiryTime <= static_cast<uint64_t>(nowMs)) {
+    return true; // expired, don't add to storage
+  }
+  if (!storage.restoreBloom(
+          key, std::make_unique<BloomFilter>(options, std::move(layers)))) {
+    std::cerr << "Duplicate key in RDB file: " << key << std::endl;
+    return false;
+  }
+  if (hasExpiry) {
+    storage.pexpire(key, static_cast<int64_t>(expiryTime) - nowMs);
+  }
+  return true;
+}
+
+bool RDBParser::verifyChecksum() {
+  foldChecksum();
+  if (version_ < kFirstChecksummedVersion) {
+    return true;
+  }
+
+  const uint64_t expected = readUInt64LE();
+  if (corrupt_) {
+    std::cerr << "RDB file is missing its checksum" << std::endl;
+    return false;
+  }
+  // Files saved with rdbchecksum off carry a zero checksum.
+  if (expected != 0 && expected != checksum_) {
+    std::cerr << "Wrong RDB checksum expected: " << std::hex << expected
+              << " got: " << checksum_ << std::dec << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool RDBParser::fill() {
+  foldChecksum();
+  file_.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  pos_ = 0;
+  end_ = static_cast<std::size_t>(file_.gcount());
+  checksumFrom_ = 0;
+  return end_ > 0;
+}
+
+void RDBParser::foldChecksum() {
+  checksum_ = crc64(checksum_, std::string_view(buffer_.data() + checksumFrom_,
+                                                pos_ - checksumFrom_));
+  checksumFrom_ = pos_;
+}
+
+uint8_t RDBParser::peekByte() {
+  if (pos_ == end_ && !fill()) {
+    corrupt_ = true;
+    return 0;
+  }
+  return static_cast<uint8_t>(buffer_[pos_]);
+}
+
 uint8_t RDBParser::readByte() {
-  uint8_t byte;
-  file_.read(reinterpret_cast<char *>(&byte), 1);
+  const uint8_t byte = peekByte();
+  if (pos_ < end_) {
+    pos_++;
+  }
   return byte;
 }
 
+void RDBParser::readBytes(char *out, std::size_t count) {
+  while (count > 0) {
+    if (pos_ == end_ && !fill()) {
+      corrupt_ = true;
+      std::memset(out, 0, count);
+      return;
+    }
+    const std::size_t n = std::min(count, end_ - pos_);
+    std::memcpy(out, buffer_.data() + pos_, n);
+    pos_ += n;
+    out += n;
+    count -= n;
+  }
+}
+
 uint32_t RDBParser::readUInt32LE() {
   uint32_t value;
-  file_.read(reinterpret_cast<char *>(&value), 4);
+  readBytes(reinterpret_cast<char *>(&value), 4);
   return value; // Assuming little-endian system
 }
 
 uint64_t RDBParser::readUInt64LE() {
   uint64_t value;
-  file_.read(reinterpret_cast<char *>(&value), 8);
+  readBytes(reinterpret_cast<char *>(&value), 8);
   return value; // Assuming little-endian system
 }
 
@@ -173,9 +441,10 @@ uint64_t RDBParser::readLength() {
     uint8_t secondByte = readByte();
     return ((firstByte & 0x3F) << 8) | secondByte;
   } else if (type == 2) {
-    // Size is in the next 4 bytes (big-endian)
-    uint32_t size = 0;
-    for (int i = 0; i < 4; i++) {
+    // Size is in the next 4 (0x80) or 8 (0x81) bytes, big-endian
+    const int bytes = firstByte == 0x81 ? 8 : 4;
+    uint64_t size = 0;
+    for (int i = 0; i < bytes; i++) {
       size = (size << 8) | readByte();
     }
     return size;
@@ -188,12 +457,12 @@ uint64_t RDBParser::readLength() {
     } else if (format == 1) {
       // 16-bit integer
       uint16_t value;
-      file_.read(reinterpret_cast<char *>(&value), 2);
+      readBytes(reinterpret_cast<char *>(&value), 2);
       return value;
     } else if (format == 2) {
       // 32-bit integer
       uint32_t value;
-      file_.read(reinterpret_cast<char *>(&value), 4);
+      readBytes(reinterpret_cast<char *>(&value), 4);
       return value;
     }
   }
@@ -202,43 +471,57 @@ uint64_t RDBParser::readLength() {
 }
 
 std::string RDBParser::readString() {
-  uint8_t firstByte = readByte();
-  file_.seekg(-1, std::ios::cur); // Go back to re-read with readLength
+  const uint8_t firstByte = peekByte();
 
   if ((firstByte & 0xC0) == 0xC0) {
     // Special encoding
     readByte(); // Skip the encoding byte
     uint8_t format = firstByte & 0x3F;
 
+    // Integers are stored signed, little-endian.
     if (format == 0) {
       // 8-bit integer
-      uint8_t value = readByte();
-      return std::to_string(value);
+      return std::to_string(static_cast<int8_t>(readByte()));
     } else if (format == 1) {
       // 16-bit integer
-      uint16_t value;
-      file_.read(reinterpret_cast<char *>(&value), 2);
+      int16_t value;
+      readBytes(reinterpret_cast<char *>(&value), 2);
       return std::to_string(value);
     } else if (format == 2) {
       // 32-bit integer
-      uint32_t value;
-      file_.read(reinterpret_cast<char *>(&value), 4);
+      int32_t value;
+      readBytes(reinterpret_cast<char *>(&value), 4);
       return std::to_string(value);
+    } else if (format == 3) {
+      // LZF-compressed string: compressed length, original length, data
+      const uint64_t compressedLength = readLength();
+      const uint64_t length = readLength();
+      if (compressedLength > fileSize_ ||
+          length > compressedLength * kMaxLzfExpansion) {
+        corrupt_ = true;
+        return {};
+      }
+      std::string compressed(compressedLength, '\0');
+      readBytes(compressed.data(), compressed.size());
+      std::string str(length, '\0');
+      if (!corrupt_ && !lzfDecompress(compressed, str.data(), str.size())) {
+        corrupt_ = true;
+      }
+      return str;
     }
   }
 
   // Regular string encoding
   uint64_t length = readLength();
+  if (length > fileSize_) {
+    corrupt_ = true;
+    return {};
+  }
   std::string str(length, '\0');
-  file_.read(&str[0], length);
+  readBytes(str.data(), length);
   return str;
 }
 
-bool RDBParser::skipBytes(size_t count) {
-  file_.seekg(count, std::ios::cur);
-  return file_.good();
-}
-
-bool RDBParser::isEOF() { return file_.eof() || file_.peek() == EOF; }
+bool RDBParser::isEOF() { return pos_ == end_ && !fill(); }
 
 } // namespace redis
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "redis/RDBWriter.h"
+
+#include "redis/Crc64.h"
+#include "redis/Lzf.h"
+#include "redis/ServerClock.h"
+#include "redis/Storage.h"
+#include "redis/StringUtils.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace redis {
+
+namespace {
+
+constexpr std::size_t kFlushThreshold = 1 << 20;
+
+// Strings this short rarely compress, as in Redis.
+constexpr std::size_t kMinCompressLength = 20;
+
+// Module values are a series of typed fields ending in kModuleEof.
+constexpr uint8_t kModuleEof = 0;
+constexpr uint8_t kModuleUint = 2;
+constexpr uint8_t kModuleDouble = 4;
+constexpr uint8_t kModuleString = 5;
+
+// The RDB object type of an entry: string, set, hash or module value.
+uint8_t valueType(const ValueWithExpiry &entry) {
+  switch (entry.type) {
+  case ValueType::Set:
+    return 0x02;
+  case ValueType::Hash:
+    return 0x04;
+  case ValueType::Bloom:
+    return 0x07;
+  default:
+    return 0x00;
+  }
+}
+
+} // namespace
+
+RDBWriter::RDBWriter(const bool compression, const bool checksum)
+    : compression_(compression), checksum_(checksum) {}
+
+bool RDBWriter::writeFile(const std::string &filepath, Storage &storage) {
+  const std::filesystem::path path(filepath);
+  const std::filesystem::path tempPath =
+      path.parent_path() / ("temp-" + path.filename().string());
+
+  file_.open(tempPath, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    std::cerr << "Failed opening the temp RDB file " << tempPath.string()
+              << std::endl;
+    return false;
+  }
+  buffer_.clear();
+  crc_ = 0;
+
+  writeBytes("REDIS0011");
+  const std::pair<std::string_view, std::string> aux[] = {
+      {"redis-ver", "7.2.0"},
+      {"redis-bits", std::to_string(sizeof(void *) * 8)},
+      {"ctime", std::to_string(ServerClock::unixTime())},
+  };
+  for (const auto &[name, value] : aux) {
+    writeByte(0xFA);
+    writeString(name);
+    writeString(value);
+  }
+
+  writeByte(0xFE);
+  writeLength(0); // database index
+
+  // BGSAVE runs this off the event loop, which owns refreshing the clock;
+  // keys are judged expired as of the time the save began.
+  const auto now = ServerClock::now();
+  const int64_t nowUnixMs = ServerClock::unixTimeMs();
+  // Entries are encoded into the buffer with the storage lock held, and
+  // the buffer is only written out between chunks, without it.
+  const bool walked = storage.forEachInSnapshot(
+      [&](const std::string &key, const ValueWithExpiry &entry) {
+        if (!entry.hasExpiry) {
+          writeEntry(key, entry, -1);
+        } else if (entry.expiryTime > now) {
+          writeEntry(
+              key, entry,
+              nowUnixMs + std::chrono::duration_cast<std::chrono::milliseconds>(
+                              entry.expiryTime - now)
+                              .count());
+        }
+      },
+      [this] {
+        if (buffer_.size() >= kFlushThreshold) {
+          flush();
+        }
+      });
+  std::error_code error;
+  if (!walked) {
+    std::cerr << "Background save already in progress" << std::endl;
+    file_.close();
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+
+  writeByte(0xFF);
+  flush();
+  // The checksum covers everything up to and including the EOF opcode.
+  const uint64_t checksum = checksum_ ? crc_ : 0;
+  file_.write(reinterpret_cast<const char *>(&checksum), 8);
+  file_.close();
+
+  if (file_.fail()) {
+    std::cerr << "Write error saving DB on disk" << std::endl;
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::cerr << "Error moving temp DB file on the final destination: "
+              << error.message() << std::endl;
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+
+std::string RDBWriter::dumpValue(const ValueWithExpiry &entry) {
+  buffer_.clear();
+  writeByte(valueType(entry));
+  writeValue(entry);
+  const uint16_t version = kRdbVersion;
+  writeBytes(std::string_view(reinterpret_cast<const char *>(&version),
+                              2)); // Assuming little-endian system
+  const uint64_t checksum = crc64(0, buffer_);
+  writeBytes(std::string_view(reinterpret_cast<const char *>(&checksum), 8));
+  return std::exchange(buffer_, {});
+}
+
+void RDBWriter::writeEntry(const std::string &key,
+                           const ValueWithExpiry &entry,
+                           const int64_t expiryUnixMs) {
+  if (expiryUnixMs >= 0) {
+    writeByte(0xFC);
+    writeBytes(std::string_view(reinterpret_cast<const char *>(&expiryUnixMs),
+                                8)); // Assuming little-endian system
+  }
+  writeByte(valueType(entry));
+  writeString(key);
+  writeValue(entry);
+}
+
+void RDBWriter::writeValue(const ValueWithExpiry &entry) {
+  if (entry.type == ValueType::Hash) {
+    writeLength(Storage::hashLength(entry));
+    Storage::forEachField(
+        entry, [this](const std::string_view field,
+                      const std::string_view value) {
+          writeString(field);
+          writeString(value);
+        });
+    return;
+  }
+  if (entry.type == ValueType::Set) {
+    writeLength(Storage::setLength(entry));
+    Storage::forEachMember(entry, [this](const std::string_view member) {
+      writeString(member);
+    });
+    return;
+  }
+  if (entry.type == ValueType::Bloom) {
+    writeBloom(*entry.bloom);
+    return;
+  }
+
+  switch (entry.encoding) {
+  case ValueEncoding::Int:
+    writeString(std::to_string(entry.intValue));
+    break;
+  case ValueEncoding::Lzf:
+    // Already in the RDB's own compressed form; no need to round-trip it.
+    writeCompressedString(entry.value,
+                          static_cast<std::size_t>(entry.intValue));
+    break;
+  default:
+    writeString(entry.value);
+    break;
+  }
+}
+
+void RDBWriter::writeBloom(const BloomFilter &filter) {
+  const auto writeUnsigned = [this](const uint64_t value) {
+    writeByte(kModuleUint);
+    writeLength(value);
+  };
+
+  writeLength(BloomFilter::kRdbModuleId);
+  const BloomFilter::Options &options = filter.options();
+  writeByte(kModuleDouble);
+  writeBytes(std::string_view(
+      reinterpret_cast<const char *>(&options.errorRate),
+      8)); // Assuming little-endian system
+  writeUnsigned(options.capacity);
+  writeUnsigned(options.expansion);
+  writeUnsigned(filter.layers().size());
+  for (const BloomFilter::Layer &layer : filter.layers()) {
+    writeUnsigned(layer.capacity);
+    writeUnsigned(layer.count);
+    writeUnsigned(layer.hashes);
+    // A filter's bits are close to random and not worth trying to
+    // compress.
+    writeByte(kModuleString);
+    writeLength(layer.bytes().size());
+    writeBytes(layer.bytes());
+  }
+  writeByte(kModuleEof);
+}
+
+void RDBWriter::writeByte(const uint8_t byte) {
+  buffer_.push_back(static_cast<char>(byte));
+}
+
+void RDBWriter::writeBytes(const std::string_view bytes) {
+  buffer_ += bytes;
+}
+
+void RDBWriter::writeLength(const uint64_t length) {
+  if (length < (1 << 6)) {
+    writeByte(static_cast<uint8_t>(length));
+  } else if (length < (1 << 14)) {
+    writeByte(static_cast<uint8_t>(0x40 | (length >> 8)));
+    writeByte(static_cast<uint8_t>(length & 0xFF));
+  } else {
+    const bool wide = length > std::numeric_limits<uint32_t>::max();
+    writeByte(wide ? 0x81 : 0x80);
+    for (int shift = wide ? 56 : 24; shift >= 0; shift -= 8) {
+      writeByte(static_cast<uint8_t>((length >> shift) & 0xFF));
+    }
+  }
+}
+
+void RDBWriter::writeString(const std::string_view str) {
+  // Integers of up to 32 bits take at most 5 bytes; "-2147483648" is 11.
+  if (str.size() <= 11 && writeIntegerString(str)) {
+    return;
+  }
+
+  if (compression_ && str.size() > kMinCompressLength) {
+    // Like Redis, only keep the compressed form if it saves over 4 bytes.
+    const std::size_t limit = str.size() - 4;
+    if (scratch_.size() < limit) {
+      scratch_.resize(limit);
+    }
+    if (const std::size_t length = lzfCompress(str, scratch_.data(), limit);
+        length > 0) {
+      writeCompressedString(std::string_view(scratch_.data(), length),
+                            str.size());
+      return;
+    }
+  }
+
+  writeLength(str.size());
+  writeBytes(str);
+}
+
+bool RDBWriter::writeIntegerString(const std::string_view str) {
+  int64_t value = 0;
+  if (!parseInt64(str, value)) {
+    return false;
+  }
+
+  // Little-endian, as RDBParser reads them.
+  if (value >= std::numeric_limits<int8_t>::min() &&
+      value <= std::numeric_limits<int8_t>::max()) {
+    writeByte(0xC0);
+    writeByte(static_cast<uint8_t>(value));
+  } else if (value >= std::numeric_limits<int16_t>::min() &&
+             value <= std::numeric_limits<int16_t>::max()) {
+    writeByte(0xC1);
+    for (int i = 0; i < 2; i++) {
+      writeByte(static_cast<uint8_t>((value >> (8 * i)) & 0xFF));
+    }
+  } else if (value >= std::numeric_limits<int32_t>::min() &&
+             value <= std::numeric_limits<int32_t>::max()) {
+    writeByte(0xC2);
+    for (int i = 0; i < 4; i++) {
+      writeByte(static_cast<uint8_t>((value >> (8 * i)) & 0xFF));
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void RDBWriter::writeCompressedString(const std::string_view compressed,
+                                      const std::size_t rawLength) {
+  writeByte(0xC3);
+  writeLength(compressed.size());
+  writeLength(rawLength);
+  writeBytes(compressed);
+}
+
+void RDBWriter::flush() {
+  if (checksum_) {
+    crc_ = crc64(crc_, buffer_);
+  }
+  file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  buffer_.clear();
+}
+
+} // namespace redis
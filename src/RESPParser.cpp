@@ -1,9 +1,218 @@
 #include "redis/RESPParser.h"
 
+#include "redis/SharedReplies.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <sstream>
 
 namespace redis {
 
+namespace {
+
+// Lengths and integers below this are copied from a preencoded header.
+constexpr std::size_t kSmallHeaders = 64;
+
+// Largest multibulk count accepted, as in Redis. Only this many slots are
+// reserved up front; the vector grows as arguments actually arrive, so a
+// bogus count cannot make the server allocate for it.
+constexpr long long kMaxMultibulkLength = 1024 * 1024;
+constexpr std::size_t kMaxReservedArgs = 1024;
+
+struct SmallHeader {
+  std::array<char, 8> bytes{};
+  std::size_t size = 0;
+};
+
+constexpr std::array<SmallHeader, kSmallHeaders>
+makeSmallHeaders(const char prefix) {
+  std::array<SmallHeader, kSmallHeaders> headers{};
+  for (std::size_t n = 0; n < kSmallHeaders; n++) {
+    auto &header = headers[n];
+    header.bytes[header.size++] = prefix;
+    if (n >= 10) {
+      header.bytes[header.size++] = static_cast<char>('0' + n / 10);
+    }
+    header.bytes[header.size++] = static_cast<char>('0' + n % 10);
+    header.bytes[header.size++] = '\r';
+    header.bytes[header.size++] = '\n';
+  }
+  return headers;
+}
+
+constexpr auto kArrayHeaders = makeSmallHeaders('*');
+constexpr auto kBulkHeaders = makeSmallHeaders('$');
+constexpr auto kIntegerHeaders = makeSmallHeaders(':');
+
+constexpr auto kDigitPairs = [] {
+  std::array<char, 200> pairs{};
+  for (int i = 0; i < 100; i++) {
+    pairs[2 * i] = static_cast<char>('0' + i / 10);
+    pairs[2 * i + 1] = static_cast<char>('0' + i % 10);
+  }
+  return pairs;
+}();
+
+// Appends prefix, value and CRLF, e.g. "$1024\r\n".
+void appendHeader(std::string &out, const char prefix,
+                  const std::array<SmallHeader, kSmallHeaders> &small,
+                  const bool negative, uint64_t value) {
+  if (!negative && value < kSmallHeaders) {
+    out.append(small[value].bytes.data(), small[value].size);
+    return;
+  }
+
+  // Digits are produced two at a time from the back of a stack buffer.
+  std::array<char, 24> buffer;
+  char *const end = buffer.data() + buffer.size();
+  char *begin = end;
+  *--begin = '\n';
+  *--begin = '\r';
+  while (value >= 100) {
+    const auto pair = static_cast<std::size_t>(value % 100) * 2;
+    value /= 100;
+    *--begin = kDigitPairs[pair + 1];
+    *--begin = kDigitPairs[pair];
+  }
+  if (value >= 10) {
+    const auto pair = static_cast<std::size_t>(value) * 2;
+    *--begin = kDigitPairs[pair + 1];
+    *--begin = kDigitPairs[pair];
+  } else {
+    *--begin = static_cast<char>('0' + value);
+  }
+  if (negative) {
+    *--begin = '-';
+  }
+  *--begin = prefix;
+  out.append(begin, end);
+}
+
+// Reads a CRLF-terminated integer line starting at pos (just after the type
+// byte). Returns Incomplete until the whole line is buffered.
+ParseResult readIntegerLine(const std::string_view data, std::size_t &pos,
+                            long long &value) {
+  const std::size_t end = data.find("\r\n", pos);
+  if (end == std::string_view::npos) {
+    return ParseResult::Incomplete;
+  }
+
+  const auto [ptr, ec] =
+      std::from_chars(data.data() + pos, data.data() + end, value);
+  if (ec != std::errc() || ptr != data.data() + end) {
+    return ParseResult::Error;
+  }
+
+  pos = end + 2;
+  return ParseResult::Ok;
+}
+
+// Stores arg as the argc-th element of command, reusing the capacity of the
+// string already in that slot from an earlier request.
+void assignArg(std::vector<std::string> &command, const std::size_t argc,
+               const std::string_view arg) {
+  if (argc < command.size()) {
+    command[argc].assign(arg);
+  } else {
+    command.emplace_back(arg);
+  }
+}
+
+ParseResult parseInline(const std::string_view data, std::size_t &pos,
+                        std::vector<std::string> &command) {
+  const std::size_t end = data.find('\n', pos);
+  if (end == std::string_view::npos) {
+    return ParseResult::Incomplete;
+  }
+
+  std::string_view line = data.substr(pos, end - pos);
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+
+  std::size_t argc = 0;
+  std::size_t start = 0;
+  while (start < line.size()) {
+    if (line[start] == ' ' || line[start] == '\t') {
+      start++;
+      continue;
+    }
+    std::size_t stop = line.find_first_of(" \t", start);
+    if (stop == std::string_view::npos) {
+      stop = line.size();
+    }
+    assignArg(command, argc++, line.substr(start, stop - start));
+    start = stop;
+  }
+  command.resize(argc);
+
+  pos = end + 1;
+  return ParseResult::Ok;
+}
+
+} // namespace
+
+ParseResult RESPParser::parseCommand(const std::string_view data,
+                                     std::size_t &pos,
+                                     std::vector<std::string> &command) {
+  if (pos >= data.size()) {
+    return ParseResult::Incomplete;
+  }
+
+  if (data[pos] != '*') {
+    return parseInline(data, pos, command);
+  }
+
+  std::size_t cursor = pos + 1;
+  long long numElements = 0;
+  if (const auto result = readIntegerLine(data, cursor, numElements);
+      result != ParseResult::Ok) {
+    return result;
+  }
+  if (numElements < 0) {
+    command.clear();
+    pos = cursor;
+    return ParseResult::Ok;
+  }
+  if (numElements > kMaxMultibulkLength) {
+    return ParseResult::Error;
+  }
+
+  const auto argc = static_cast<std::size_t>(numElements);
+  command.reserve(std::min(argc, kMaxReservedArgs));
+  for (std::size_t i = 0; i < argc; i++) {
+    if (cursor >= data.size()) {
+      return ParseResult::Incomplete;
+    }
+    if (data[cursor] != '$') {
+      return ParseResult::Error;
+    }
+
+    cursor++;
+    long long length = 0;
+    if (const auto result = readIntegerLine(data, cursor, length);
+        result != ParseResult::Ok) {
+      return result;
+    }
+    if (length < 0) {
+      return ParseResult::Error;
+    }
+
+    const auto size = static_cast<std::size_t>(length);
+    if (data.size() - cursor < size + 2) {
+      return ParseResult::Incomplete;
+    }
+
+    assignArg(command, i, data.substr(cursor, size));
+    cursor += size + 2;
+  }
+  command.resize(argc);
+
+  pos = cursor;
+  return ParseResult::Ok;
+}
+
 std::vector<std::string> RESPParser::parseArray(const std::string &data) {
   std::vector<std::string> result;
   std::istringstream iss(data);
@@ -65,26 +274,89 @@ std::string RESPParser::parseSimpleString(const std::string &data) {
   return data.substr(1, end - 1);
 }
 
-std::string RESPParser::encodeSimpleString(const std::string &str) {
-  return "+" + str + "\r\n";
+std::string RESPParser::encodeSimpleString(const std::string_view str) {
+  std::string result;
+  result.reserve(str.size() + 3);
+  appendSimpleString(result, str);
+  return result;
 }
 
-std::string RESPParser::encodeBulkString(const std::string &str) {
-  return "$" + std::to_string(str.size()) + "\r\n" + str + "\r\n";
+std::string RESPParser::encodeBulkString(const std::string_view str) {
+  std::string result;
+  result.reserve(str.size() + 24);
+  appendBulkString(result, str);
+  return result;
 }
 
 std::string RESPParser::encodeArray(const std::vector<std::string> &items) {
-  std::string result = "*" + std::to_string(items.size()) + "\r\n";
+  std::size_t size = 24;
   for (const auto &item : items) {
-    result += encodeBulkString(item);
+    size += item.size() + 24;
   }
+
+  std::string result;
+  result.reserve(size);
+  appendArray(result, items);
   return result;
 }
 
-std::string RESPParser::encodeError(const std::string &error) {
-  return "-" + error + "\r\n";
+std::string RESPParser::encodeError(const std::string_view error) {
+  std::string result;
+  result.reserve(error.size() + 3);
+  appendError(result, error);
+  return result;
+}
+
+std::string RESPParser::encodeInteger(const int64_t value) {
+  std::string result;
+  appendInteger(result, value);
+  return result;
+}
+
+std::string RESPParser::encodeNull() { return std::string(shared::kNullBulk); }
+
+std::string RESPParser::encodeNullArray() {
+  return std::string(shared::kNullArray);
+}
+
+void RESPParser::appendSimpleString(std::string &out,
+                                    const std::string_view str) {
+  out += '+';
+  out += str;
+  out += "\r\n";
+}
+
+void RESPParser::appendBulkString(std::string &out,
+                                  const std::string_view str) {
+  appendHeader(out, '$', kBulkHeaders, false, str.size());
+  out += str;
+  out += "\r\n";
+}
+
+void RESPParser::appendArrayHeader(std::string &out, const std::size_t count) {
+  appendHeader(out, '*', kArrayHeaders, false, count);
+}
+
+void RESPParser::appendArray(std::string &out,
+                             const std::vector<std::string> &items) {
+  appendArrayHeader(out, items.size());
+  for (const auto &item : items) {
+    appendBulkString(out, item);
+  }
 }
 
-std::string RESPParser::encodeNull() { return "$-1\r\n"; }
+void RESPParser::appendError(std::string &out, const std::string_view error) {
+  out += '-';
+  out += error;
+  out += "\r\n";
+}
+
+void RESPParser::appendInteger(std::string &out, const int64_t value) {
+  // Negate in unsigned arithmetic so INT64_MIN doesn't overflow.
+  const bool negative = value < 0;
+  const uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(value)
+                                      : static_cast<uint64_t>(value);
+  appendHeader(out, ':', kIntegerHeaders, negative, magnitude);
+}
 
 } // namespace redis
\ No newline at end of file
@@ -1,14 +1,28 @@
 #include "redis/RedisServer.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <string_view>
+#include <vector>
 
+#include "redis/Client.h"
+#include "redis/ClientRegistry.h"
 #include "redis/CommandHandler.h"
 #include "redis/Config.h"
+#include "redis/IOThreads.h"
+#include "redis/LazyFree.h"
+#include "redis/Metrics.h"
+#include "redis/PubSub.h"
 #include "redis/RDBParser.h"
 #include "redis/RESPParser.h"
+#include "redis/ServerClock.h"
+#include "redis/SharedReplies.h"
 #include "redis/Storage.h"
+#include "redis/Tracking.h"
 
 #ifdef _WIN32
 #define CLOSE_SOCKET(s) closesocket(s)
@@ -16,12 +30,281 @@
 #define CLOSE_SOCKET(s) close(s)
 #endif
 
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
 namespace redis {
 
+// What the read phase, which may run on an I/O thread, hands over to command
+// execution on the main thread.
+struct ReadResult {
+  bool closed = false; // EOF or a socket error
+  std::size_t bytes = 0;
+  ParseResult firstRequest = ParseResult::Incomplete; // parsed into argv
+  std::size_t parsePos = 0;
+};
+
+namespace {
+
+bool setNonBlocking(const socket_t fd) {
+#ifdef _WIN32
+  u_long mode = 1;
+  return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+  const int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// Connections accepted per readiness event of a listening socket. Draining
+// the backlog keeps a reconnect storm from costing one event-loop iteration
+// per client; the cap keeps it from starving clients already connected.
+constexpr int kMaxAcceptsPerTick = 1000;
+
+// Applies the configured options to an accepted TCP connection. They are
+// best effort: the connection works without them.
+void tuneTcpConnection(const socket_t fd, const Config &config) {
+  constexpr int yes = 1;
+  if (config.getTcpNoDelay()) {
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+               reinterpret_cast<const char *>(&yes), sizeof(yes));
+  }
+
+  if (const int idle = config.getTcpKeepAlive(); idle > 0) {
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,
+               reinterpret_cast<const char *>(&yes), sizeof(yes));
+    // As in Redis: the first probe after idle seconds, then one every idle/3
+    // seconds, dropping the peer after three unanswered probes.
+#ifdef TCP_KEEPIDLE
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE,
+               reinterpret_cast<const char *>(&idle), sizeof(idle));
+#endif
+#ifdef TCP_KEEPINTVL
+    const int interval = std::max(idle / 3, 1);
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL,
+               reinterpret_cast<const char *>(&interval), sizeof(interval));
+#endif
+#ifdef TCP_KEEPCNT
+    constexpr int probes = 3;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT,
+               reinterpret_cast<const char *>(&probes), sizeof(probes));
+#endif
+  }
+}
+
+// Formats a peer address as CLIENT LIST shows it: "ip:port", with IPv4
+// clients of a dual-stack listener shown as plain IPv4.
+std::string formatPeerAddress(const sockaddr_storage &addr) {
+  char ip[INET6_ADDRSTRLEN] = {};
+  uint16_t port = 0;
+  if (addr.ss_family == AF_INET6) {
+    const auto &v6 = reinterpret_cast<const sockaddr_in6 &>(addr);
+    if (IN6_IS_ADDR_V4MAPPED(&v6.sin6_addr)) {
+      inet_ntop(AF_INET, &v6.sin6_addr.s6_addr[12], ip, sizeof(ip));
+    } else {
+      inet_ntop(AF_INET6, &v6.sin6_addr, ip, sizeof(ip));
+    }
+    port = ntohs(v6.sin6_port);
+  } else {
+    const auto &v4 = reinterpret_cast<const sockaddr_in &>(addr);
+    inet_ntop(AF_INET, &v4.sin_addr, ip, sizeof(ip));
+    port = ntohs(v4.sin_port);
+  }
+  return std::string(ip) + ":" + std::to_string(port);
+}
+
+// Longest select may sleep, so that timers are serviced while idle.
+constexpr long kCronIntervalMs = 100;
+
+// Output buffers larger than this are released once drained rather than
+// kept around for the connection's lifetime.
+constexpr std::size_t kMaxRetainedOutputBuffer = 64 * 1024;
+
+// Calls write with the buffer a reply should be encoded into: the client's
+// reusable output buffer, or a new chunk when shared chunks are already
+// queued and the reply has to follow them.
+template <typename Fn> void writeReply(Client &client, Fn &&write) {
+  if (client.outputQueue.empty()) {
+    write(client.outputBuffer);
+    return;
+  }
+
+  std::string reply;
+  write(reply);
+  client.queueOutput(std::make_shared<const std::string>(std::move(reply)));
+}
+
+bool lastErrorWouldBlock() {
+#ifdef _WIN32
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+// Bytes read from a client socket per readiness event, as in Redis.
+constexpr std::size_t kReadChunkSize = 16 * 1024;
+
+// Most output chunks gathered into a single send.
+constexpr std::size_t kMaxWriteChunks = 16;
+
+// Reads what the client sent and parses its first complete request into
+// client.argv; the main thread executes it and parses the rest. Touches
+// nothing but the client, so it is safe on an I/O thread.
+ReadResult readFromClient(Client &client) {
+  char buffer[kReadChunkSize];
+  ReadResult result;
+  const auto bytesRead = recv(client.fd, buffer, sizeof(buffer), 0);
+  if (bytesRead < 0 && lastErrorWouldBlock()) {
+    return result;
+  }
+  if (bytesRead <= 0) {
+    result.closed = true;
+    return result;
+  }
+
+  result.bytes = static_cast<std::size_t>(bytesRead);
+  client.lastInteractionMs = ServerClock::monotonicMs();
+  client.inputBuffer.append(buffer, result.bytes);
+  result.firstRequest = RESPParser::parseCommand(
+      client.inputBuffer, result.parsePos, client.argv);
+  return result;
+}
+
+// Sends chunks with a single gathering system call.
+long sendChunks(const socket_t fd, const std::string_view *chunks,
+                const std::size_t count) {
+#ifdef _WIN32
+  WSABUF buffers[kMaxWriteChunks];
+  for (std::size_t i = 0; i < count; i++) {
+    buffers[i].buf = const_cast<char *>(chunks[i].data());
+    buffers[i].len = static_cast<ULONG>(chunks[i].size());
+  }
+  DWORD sent = 0;
+  if (WSASend(fd, buffers, static_cast<DWORD>(count), &sent, 0, nullptr,
+              nullptr) == SOCKET_ERROR) {
+    return -1;
+  }
+  return static_cast<long>(sent);
+#else
+  iovec buffers[kMaxWriteChunks];
+  for (std::size_t i = 0; i < count; i++) {
+    buffers[i].iov_base = const_cast<char *>(chunks[i].data());
+    buffers[i].iov_len = chunks[i].size();
+  }
+  // sendmsg rather than writev, which cannot pass MSG_NOSIGNAL.
+  msghdr message{};
+  message.msg_iov = buffers;
+  message.msg_iovlen = count;
+  return static_cast<long>(sendmsg(fd, &message, SEND_FLAGS));
+#endif
+}
+
+// Marks sent bytes of the pending output as written.
+void consumeOutput(Client &client, std::size_t sent) {
+  if (client.outputBufferSent < client.outputBuffer.size()) {
+    const std::size_t fromBuffer = std::min(
+        sent, client.outputBuffer.size() - client.outputBufferSent);
+    client.outputBufferSent += fromBuffer;
+    sent -= fromBuffer;
+    if (client.outputBufferSent < client.outputBuffer.size()) {
+      return;
+    }
+
+    // Keep the buffer for the next replies, unless one huge reply grew it.
+    if (client.outputBuffer.capacity() > kMaxRetainedOutputBuffer) {
+      std::string().swap(client.outputBuffer);
+    } else {
+      client.outputBuffer.clear();
+    }
+    client.outputBufferSent = 0;
+  }
+
+  while (sent > 0) {
+    const std::size_t chunkSize = client.outputQueue.front()->size();
+    const std::size_t left = chunkSize - client.outputOffset;
+    if (sent < left) {
+      client.outputOffset += sent;
+      return;
+    }
+    sent -= left;
+    client.outputQueueBytes -= chunkSize;
+    client.outputQueue.pop_front();
+    client.outputOffset = 0;
+  }
+}
+
+// Writes as much pending output as the socket accepts, the output buffer
+// first and then the queued chunks, gathered into as few system calls as
+// possible. Returns false if the connection failed. Touches nothing but the
+// client, so it is safe on an I/O thread.
+bool writeToClient(Client &client, std::size_t &written) {
+  written = 0;
+  while (client.hasPendingOutput()) {
+    std::string_view chunks[kMaxWriteChunks];
+    std::size_t count = 0;
+    std::size_t total = 0;
+    if (client.outputBufferSent < client.outputBuffer.size()) {
+      chunks[count++] = std::string_view(client.outputBuffer)
+                            .substr(client.outputBufferSent);
+    }
+    for (std::size_t i = 0;
+         i < client.outputQueue.size() && count < kMaxWriteChunks; i++) {
+      chunks[count++] = std::string_view(*client.outputQueue[i])
+                            .substr(i == 0 ? client.outputOffset : 0);
+    }
+    for (std::size_t i = 0; i < count; i++) {
+      total += chunks[i].size();
+    }
+
+    const long sent = sendChunks(client.fd, chunks, count);
+    if (sent < 0) {
+      return lastErrorWouldBlock();
+    }
+    written += static_cast<std::size_t>(sent);
+    consumeOutput(client, static_cast<std::size_t>(sent));
+    if (static_cast<std::size_t>(sent) < total) {
+      return true; // the socket buffer is full
+    }
+  }
+  return true;
+}
+
+} // namespace
+
 RedisServer::RedisServer(const std::shared_ptr<Config> &config)
     : config_(config), storage_(std::make_shared<Storage>()),
-      commandHandler_(std::make_shared<CommandHandler>(config, storage_)),
-      serverFd_(INVALID_SOCKET_VAL), masterFd_(INVALID_SOCKET_VAL) {
+      pubsub_(std::make_shared<PubSub>()),
+      registry_(std::make_shared<ClientRegistry>()),
+      tracking_(std::make_shared<Tracking>(registry_,
+                                           config->getTrackingTableMaxKeys())),
+      metrics_(std::make_shared<Metrics>(*config)),
+      commandHandler_(std::make_shared<CommandHandler>(
+          config, storage_, pubsub_, registry_, tracking_, metrics_)),
+      serverFd_(INVALID_SOCKET_VAL), unixFd_(INVALID_SOCKET_VAL),
+      masterFd_(INVALID_SOCKET_VAL) {
+  storage_->setLazyFree(std::make_shared<LazyFree>(),
+                        {config->getLazyfreeLazyExpire(),
+                         config->getLazyfreeLazyServerDel(),
+                         config->getLazyfreeThreshold()});
+  if (config->getValueCompression()) {
+    storage_->setValueCompression(config->getValueCompressionThreshold());
+  }
+  storage_->setEncodingLimits({config->getHashMaxListpackEntries(),
+                               config->getHashMaxListpackValue(),
+                               config->getSetMaxIntsetEntries()});
+
+  if (config->getIoThreads() > 1) {
+    ioThreads_ = std::make_unique<IOThreads>(config->getIoThreads());
+  }
+
+  storage_->setKeyExpiredListener([this](const std::string &key) {
+    tracking_->invalidateKey(key, nullptr);
+  });
+
 #ifdef _WIN32
   WSADATA wsaData;
   if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
@@ -31,12 +314,18 @@ RedisServer::RedisServer(const std::shared_ptr<Config> &config)
 }
 
 RedisServer::~RedisServer() {
-  for (const auto fd : clientFds_) {
+  for (const auto &[fd, client] : clients_) {
     CLOSE_SOCKET(fd);
   }
   if (serverFd_ != INVALID_SOCKET_VAL) {
     CLOSE_SOCKET(serverFd_);
   }
+#ifndef _WIN32
+  if (unixFd_ != INVALID_SOCKET_VAL) {
+    CLOSE_SOCKET(unixFd_);
+    unlink(config_->getUnixSocket().c_str());
+  }
+#endif
   if (masterFd_ != INVALID_SOCKET_VAL) {
     CLOSE_SOCKET(masterFd_);
   }
@@ -46,7 +335,47 @@ RedisServer::~RedisServer() {
 }
 
 bool RedisServer::createServerSocket() {
-  serverFd_ = socket(AF_INET, SOCK_STREAM, 0);
+  const std::string &bindAddress = config_->getBindAddress();
+  const uint16_t port = htons(static_cast<uint16_t>(config_->getPort()));
+
+  sockaddr_storage addr{};
+  auto &v4 = reinterpret_cast<sockaddr_in &>(addr);
+  auto &v6 = reinterpret_cast<sockaddr_in6 &>(addr);
+  socklen_t addrLen = 0;
+  bool dualStack = false;
+
+  if (bindAddress.empty() || bindAddress == "*") {
+    // Every interface: over IPv6 with IPv4 clients arriving as mapped
+    // addresses, or plain IPv4 on hosts without IPv6.
+    serverFd_ = socket(AF_INET6, SOCK_STREAM, 0);
+    if (serverFd_ != INVALID_SOCKET_VAL) {
+      v6.sin6_family = AF_INET6;
+      v6.sin6_addr = in6addr_any;
+      v6.sin6_port = port;
+      addrLen = sizeof(v6);
+      dualStack = true;
+    } else {
+      v4.sin_family = AF_INET;
+      v4.sin_addr.s_addr = htonl(INADDR_ANY);
+      v4.sin_port = port;
+      addrLen = sizeof(v4);
+    }
+  } else if (inet_pton(AF_INET6, bindAddress.c_str(), &v6.sin6_addr) == 1) {
+    v6.sin6_family = AF_INET6;
+    v6.sin6_port = port;
+    addrLen = sizeof(v6);
+  } else if (inet_pton(AF_INET, bindAddress.c_str(), &v4.sin_addr) == 1) {
+    v4.sin_family = AF_INET;
+    v4.sin_port = port;
+    addrLen = sizeof(v4);
+  } else {
+    std::cerr << "Invalid bind address: " << bindAddress << std::endl;
+    return false;
+  }
+
+  if (serverFd_ == INVALID_SOCKET_VAL) {
+    serverFd_ = socket(addr.ss_family, SOCK_STREAM, 0);
+  }
   if (serverFd_ == INVALID_SOCKET_VAL) {
     std::cerr << "Failed to create server socket\n";
     return false;
@@ -59,28 +388,88 @@ bool RedisServer::createServerSocket() {
     return false;
   }
 
-  struct sockaddr_in server_addr{};
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(config_->getPort());
+  if (dualStack) {
+    constexpr int v6Only = 0;
+    setsockopt(serverFd_, IPPROTO_IPV6, IPV6_V6ONLY,
+               reinterpret_cast<const char *>(&v6Only), sizeof(v6Only));
+  }
+
+  // Set before listen so that accepted connections inherit it and the TCP
+  // window scale is negotiated for the larger buffer.
+  if (const int rcvBuf = config_->getTcpRcvBuf(); rcvBuf > 0) {
+    setsockopt(serverFd_, SOL_SOCKET, SO_RCVBUF,
+               reinterpret_cast<const char *>(&rcvBuf), sizeof(rcvBuf));
+  }
 
-  if (bind(serverFd_, reinterpret_cast<struct sockaddr *>(&server_addr),
-           sizeof(server_addr)) != 0) {
+  if (bind(serverFd_, reinterpret_cast<struct sockaddr *>(&addr), addrLen) !=
+      0) {
     std::cerr << "Failed to bind to port " << config_->getPort() << std::endl;
     return false;
   }
 
-  if (constexpr int connection_backlog = 5;
-      listen(serverFd_, connection_backlog) != 0) {
+  if (listen(serverFd_, config_->getTcpBacklog()) != 0) {
     std::cerr << "listen failed" << std::endl;
     return false;
   }
 
+  // The accept loop drains the backlog until it would block.
+  if (!setNonBlocking(serverFd_)) {
+    std::cerr << "Failed to make server socket non-blocking" << std::endl;
+    return false;
+  }
+
   std::cout << "Server listening on port " << config_->getPort() << "..."
             << std::endl;
   return true;
 }
 
+bool RedisServer::createUnixSocket() {
+  const std::string &path = config_->getUnixSocket();
+  if (path.empty()) {
+    return true;
+  }
+
+#ifdef _WIN32
+  std::cerr << "Unix domain sockets are not supported on this platform\n";
+  return false;
+#else
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Unix socket path too long: " << path << std::endl;
+    return false;
+  }
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  unixFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (unixFd_ == INVALID_SOCKET_VAL) {
+    std::cerr << "Failed to create unix socket\n";
+    return false;
+  }
+
+  // A socket file left behind by a previous run would make bind fail.
+  unlink(path.c_str());
+  if (bind(unixFd_, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) != 0) {
+    std::cerr << "Failed to bind unix socket " << path << std::endl;
+    return false;
+  }
+
+  if (const unsigned perm = config_->getUnixSocketPerm(); perm != 0) {
+    chmod(path.c_str(), static_cast<mode_t>(perm));
+  }
+
+  if (listen(unixFd_, config_->getTcpBacklog()) != 0 ||
+      !setNonBlocking(unixFd_)) {
+    std::cerr << "listen failed on unix socket " << path << std::endl;
+    return false;
+  }
+
+  std::cout << "Server listening on unix socket " << path << std::endl;
+  return true;
+#endif
+}
+
 bool RedisServer::connectToMaster() {
   masterFd_ = socket(AF_INET, SOCK_STREAM, 0);
   if (masterFd_ == INVALID_SOCKET_VAL) {
@@ -264,7 +653,15 @@ bool RedisServer::connectToMaster() {
 }
 
 void RedisServer::run() {
-  if (!createServerSocket()) {
+  const auto loadStart = ServerClock::update();
+  loadRDBFile();
+  metrics_->latencyMonitor().record(
+      LatencyEvent::RdbLoad,
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - loadStart)
+          .count());
+
+  if (!createServerSocket() || !createUnixSocket()) {
     return;
   }
 
@@ -280,25 +677,39 @@ void RedisServer::run() {
 
   while (true) {
     fd_set readFds;
+    fd_set writeFds;
     FD_ZERO(&readFds);
+    FD_ZERO(&writeFds);
     FD_SET(serverFd_, &readFds);
+    // Wake up periodically even when idle, for the idle timeout.
+    timeval timeout{0, kCronIntervalMs * 1000};
+    if (unixFd_ != INVALID_SOCKET_VAL) {
+      FD_SET(unixFd_, &readFds);
+    }
 
 #ifdef _WIN32
     socket_t maxFd = serverFd_;
-    for (const socket_t clientFd : clientFds_) {
+    for (const auto &[clientFd, client] : clients_) {
       FD_SET(clientFd, &readFds);
+      if (client->hasPendingOutput()) {
+        FD_SET(clientFd, &writeFds);
+      }
       maxFd = (std::max)(maxFd, clientFd);
     }
 
-    const int activity = select(0, &readFds, nullptr, nullptr, nullptr);
+    const int activity = select(0, &readFds, &writeFds, nullptr, &timeout);
 #else
-    int maxFd = serverFd_;
-    for (const int clientFd : clientFds_) {
+    int maxFd = std::max(serverFd_, unixFd_);
+    for (const auto &[clientFd, client] : clients_) {
       FD_SET(clientFd, &readFds);
+      if (client->hasPendingOutput()) {
+        FD_SET(clientFd, &writeFds);
+      }
       maxFd = std::max(maxFd, clientFd);
     }
 
-    const int activity = select(maxFd + 1, &readFds, nullptr, nullptr, nullptr);
+    const int activity =
+        select(maxFd + 1, &readFds, &writeFds, nullptr, &timeout);
 #endif
 
     if (activity < 0) {
@@ -306,59 +717,314 @@ void RedisServer::run() {
       break;
     }
 
+    // Time the work done for this iteration, excluding the wait in select.
+    const auto iterationStart = ServerClock::update();
+
     if (FD_ISSET(serverFd_, &readFds)) {
-      handleNewConnection();
+      acceptConnections(serverFd_);
+    }
+    if (unixFd_ != INVALID_SOCKET_VAL && FD_ISSET(unixFd_, &readFds)) {
+      acceptConnections(unixFd_);
+    }
+
+    std::vector<Client *> readyClients;
+    for (const auto &[clientFd, client] : clients_) {
+      if (FD_ISSET(clientFd, &readFds) && !client->closeAsap) {
+        readyClients.push_back(client.get());
+      }
+    }
+    handleReadyClients(readyClients);
+
+    closeIdleClients();
+    keyspaceCron();
+
+    // Commands may have queued output on clients other than the sender (for
+    // example PUBLISH), so flush every client with pending replies.
+    std::vector<Client *> pendingClients;
+    for (const auto &[clientFd, client] : clients_) {
+      if (!client->closeAsap && client->hasPendingOutput()) {
+        pendingClients.push_back(client.get());
+      }
     }
+    writeToClients(pendingClients);
 
-    for (auto clientFdsSnapshot = clientFds_;
-         const socket_t clientFd : clientFdsSnapshot) {
-      if (FD_ISSET(clientFd, &readFds)) {
-        handleClientData(clientFd);
+    // Whatever could not be written counts against the client's output
+    // buffer limit.
+    std::vector<socket_t> closingFds;
+    for (const auto &[clientFd, client] : clients_) {
+      if (!client->closeAsap && client->hasPendingOutput() &&
+          outputLimitReached(*client)) {
+        std::cout << "Closing client over its output buffer limit (fd: "
+                  << clientFd << ")" << std::endl;
+        client->closeAsap = true;
+      }
+      if (client->closeAfterReply && !client->hasPendingOutput()) {
+        client->closeAsap = true;
+      }
+      if (client->closeAsap) {
+        closingFds.push_back(clientFd);
       }
     }
+    for (const socket_t clientFd : closingFds) {
+      closeClient(clientFd);
+    }
+
+    metrics_->latencyMonitor().record(
+        LatencyEvent::EventLoop,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - iterationStart)
+            .count());
   }
 }
 
-void RedisServer::handleNewConnection() {
-  struct sockaddr_in client_addr{};
+void RedisServer::acceptConnections(const socket_t listenFd) {
+  const bool isUnix = listenFd == unixFd_;
+  for (int accepted = 0; accepted < kMaxAcceptsPerTick; accepted++) {
+    sockaddr_storage clientAddr{};
+#ifdef _WIN32
+    int clientAddrLen = sizeof(clientAddr);
+#else
+    socklen_t clientAddrLen = sizeof(clientAddr);
+#endif
+
+    // Replies are written as the socket drains, so a slow reader cannot
+    // stall the event loop; accept4 makes the socket non-blocking without
+    // two more system calls.
+#ifdef __linux__
+    const socket_t clientFd =
+        accept4(listenFd, reinterpret_cast<struct sockaddr *>(&clientAddr),
+                &clientAddrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    const socket_t clientFd =
+        accept(listenFd, reinterpret_cast<struct sockaddr *>(&clientAddr),
+               &clientAddrLen);
+#endif
+
+    if (clientFd == INVALID_SOCKET_VAL) {
+      if (!lastErrorWouldBlock()) {
+        std::cerr << "Failed to accept client connection" << std::endl;
+      }
+      return;
+    }
+
+#ifndef __linux__
+    if (!setNonBlocking(clientFd)) {
+      std::cerr << "Failed to make client socket non-blocking" << std::endl;
+      CLOSE_SOCKET(clientFd);
+      continue;
+    }
+#endif
+
+    // select cannot watch descriptors past FD_SETSIZE.
 #ifdef _WIN32
-  int client_addr_len = sizeof(client_addr);
+    const bool fits = true;
 #else
-  socklen_t client_addr_len = sizeof(client_addr);
+    const bool fits = clientFd < FD_SETSIZE;
 #endif
-  const socket_t clientFd =
-      accept(serverFd_, reinterpret_cast<struct sockaddr *>(&client_addr),
-             &client_addr_len);
+    if (clients_.size() >= config_->getMaxClients() || !fits) {
+      rejectConnection(clientFd);
+      continue;
+    }
 
-  if (clientFd == INVALID_SOCKET_VAL) {
-    std::cerr << "Failed to accept client connection" << std::endl;
+    auto client = std::make_unique<Client>(clientFd);
+    if (isUnix) {
+      client->address = config_->getUnixSocket() + ":0";
+    } else {
+      tuneTcpConnection(clientFd, *config_);
+      client->address = formatPeerAddress(clientAddr);
+    }
+    client->createdMs = ServerClock::monotonicMs();
+    client->lastInteractionMs = client->createdMs;
+    registry_->add(*client);
+    if (const int64_t timeout = config_->getTimeout(); timeout > 0) {
+      idleTimers_.schedule(client->id, client->createdMs + timeout * 1000);
+    }
+    metrics_->recordConnection();
+    clients_.emplace(clientFd, std::move(client));
+    std::cout << "New client connected (fd: " << clientFd << ")" << std::endl;
+  }
+}
+
+void RedisServer::rejectConnection(const socket_t clientFd) {
+  // Best effort: the socket is non-blocking and about to be closed.
+  constexpr std::string_view error = "-ERR max number of clients reached\r\n";
+  send(clientFd, error.data(), static_cast<int>(error.size()), SEND_FLAGS);
+  CLOSE_SOCKET(clientFd);
+  metrics_->recordRejectedConnection();
+}
+
+void RedisServer::closeIdleClients() {
+  const int64_t timeoutMs = config_->getTimeout() * 1000;
+  if (timeoutMs <= 0) {
+    return;
+  }
+
+  const int64_t now = ServerClock::monotonicMs();
+  idleTimers_.advance(now, [&](const uint64_t id) {
+    Client *client = registry_->find(id);
+    if (client == nullptr) {
+      return; // disconnected since
+    }
+
+    // Replicas and subscribers are expected to sit idle.
+    if (client->clientClass() != ClientClass::Normal) {
+      idleTimers_.schedule(id, now + timeoutMs);
+      return;
+    }
+    if (const int64_t deadline = client->lastInteractionMs + timeoutMs;
+        deadline > now) {
+      idleTimers_.schedule(id, deadline);
+      return;
+    }
+
+    std::cout << "Closing idle client (fd: " << client->fd << ")" << std::endl;
+    client->closeAsap = true;
+  });
+}
+
+void RedisServer::keyspaceCron() {
+  const int64_t now = ServerClock::monotonicMs();
+  if (now < nextKeyspaceCronMs_) {
     return;
   }
+  nextKeyspaceCronMs_ = now + kCronIntervalMs;
 
-  clientFds_.insert(clientFd);
-  std::cout << "New client connected (fd: " << clientFd << ")" << std::endl;
+  metrics_->hotKeys().decay(now);
+  metrics_->bigKeys().step(*storage_);
 }
 
-void RedisServer::handleClientData(const socket_t clientFd) {
-  char buffer[1024];
-  const int bytesRead = recv(clientFd, buffer, sizeof(buffer), 0);
+bool RedisServer::outputLimitReached(Client &client) const {
+  const OutputBufferLimit &limit =
+      config_->getOutputBufferLimit(client.clientClass());
+  const std::size_t pending = client.pendingOutputBytes();
 
-  if (bytesRead <= 0) {
-    closeClient(clientFd);
+  if (limit.hardBytes > 0 && pending >= limit.hardBytes) {
+    return true;
+  }
+  if (limit.softBytes == 0 || pending < limit.softBytes) {
+    client.softLimitSinceMs = 0;
+    return false;
+  }
+
+  const int64_t now = ServerClock::monotonicMs();
+  if (client.softLimitSinceMs == 0) {
+    client.softLimitSinceMs = now;
+  }
+  return now - client.softLimitSinceMs > limit.softSeconds * 1000;
+}
+
+bool RedisServer::useIoThreads(const std::size_t clients) const {
+  // As in Redis, handing a handful of clients to other threads costs more
+  // than it saves.
+  return ioThreads_ != nullptr && clients >= 2 * ioThreads_->size();
+}
+
+void RedisServer::handleReadyClients(const std::vector<Client *> &clients) {
+  std::vector<ReadResult> results(clients.size());
+  const auto read = [&](const std::size_t i) {
+    results[i] = readFromClient(*clients[i]);
+  };
+  if (config_->getIoThreadsDoReads() && useIoThreads(clients.size())) {
+    ioThreads_->parallelFor(clients.size(), read);
+    metrics_->recordThreadedReads(clients.size());
+  } else {
+    for (std::size_t i = 0; i < clients.size(); i++) {
+      read(i);
+    }
+  }
+
+  // Commands always run here, on the main thread.
+  for (std::size_t i = 0; i < clients.size(); i++) {
+    processInput(*clients[i], results[i]);
+  }
+}
+
+void RedisServer::processInput(Client &client, const ReadResult &read) {
+  if (read.closed) {
+    closeClient(client.fd);
     return;
   }
+  if (read.bytes == 0) {
+    return;
+  }
+  metrics_->recordInputBytes(read.bytes);
 
-  const std::string data(buffer, bytesRead);
+  // Execute every complete request in the buffer so pipelined commands (such
+  // as a whole MULTI ... EXEC block) are answered in one write. The first
+  // one was parsed by the read phase.
+  std::vector<std::string> &command = client.argv;
+  std::size_t pos = read.parsePos;
+  ParseResult result = read.firstRequest;
+  bool protocolError = false;
+  while (result != ParseResult::Incomplete) {
+    if (result == ParseResult::Error) {
+      writeReply(client, [](std::string &out) {
+        out += shared::kProtocolError;
+      });
+      protocolError = true;
+      break;
+    }
+    if (!command.empty()) {
+      writeReply(client, [&](std::string &out) {
+        commandHandler_->handleCommand(client, command, out);
+      });
+    }
+    result = RESPParser::parseCommand(client.inputBuffer, pos, command);
+  }
+  client.inputBuffer.erase(0, pos);
+  client.arena.reset();
 
-  if (const auto command = RESPParser::parseArray(data); !command.empty()) {
-    const std::string response = commandHandler_->handleCommand(command);
-    send(clientFd, response.c_str(), static_cast<int>(response.size()), 0);
+  if (protocolError) {
+    flushOutput(client);
+    closeClient(client.fd);
   }
 }
 
+void RedisServer::writeToClients(const std::vector<Client *> &clients) {
+  if (!useIoThreads(clients.size())) {
+    for (Client *client : clients) {
+      if (!flushOutput(*client)) {
+        client->closeAsap = true;
+      }
+    }
+    return;
+  }
+
+  struct WriteResult {
+    bool ok = true;
+    std::size_t bytes = 0;
+  };
+  std::vector<WriteResult> results(clients.size());
+  ioThreads_->parallelFor(clients.size(), [&](const std::size_t i) {
+    results[i].ok = writeToClient(*clients[i], results[i].bytes);
+  });
+  metrics_->recordThreadedWrites(clients.size());
+
+  for (std::size_t i = 0; i < clients.size(); i++) {
+    metrics_->recordOutputBytes(results[i].bytes);
+    if (!results[i].ok) {
+      clients[i]->closeAsap = true;
+    }
+  }
+}
+
+bool RedisServer::flushOutput(Client &client) {
+  std::size_t written = 0;
+  const bool ok = writeToClient(client, written);
+  metrics_->recordOutputBytes(written);
+  return ok;
+}
+
 void RedisServer::closeClient(const socket_t clientFd) {
+  if (const auto it = clients_.find(clientFd); it != clients_.end()) {
+    pubsub_->unsubscribeAll(*it->second);
+    tracking_->disable(*it->second);
+    commandHandler_->unwatchAll(*it->second);
+    registry_->remove(*it->second);
+    metrics_->recordDisconnection();
+  }
   CLOSE_SOCKET(clientFd);
-  clientFds_.erase(clientFd);
+  clients_.erase(clientFd);
   std::cout << "Client disconnected (fd: " << clientFd << ")" << std::endl;
 }
 
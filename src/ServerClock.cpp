@@ -0,0 +1,32 @@
+#include "redis/ServerClock.h"
+
+namespace redis {
+
+namespace {
+
+int64_t readMonotonicNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t readUnixMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+// Seeded at startup so that readers never observe an unset clock.
+std::atomic<int64_t> ServerClock::monotonicNanos_{readMonotonicNanos()};
+std::atomic<int64_t> ServerClock::unixMicros_{readUnixMicros()};
+
+ServerClock::TimePoint ServerClock::update() {
+  const int64_t nanos = readMonotonicNanos();
+  monotonicNanos_.store(nanos, std::memory_order_relaxed);
+  unixMicros_.store(readUnixMicros(), std::memory_order_relaxed);
+  return TimePoint(std::chrono::nanoseconds(nanos));
+}
+
+} // namespace redis
@@ -0,0 +1,82 @@
+#include "redis/SlowLog.h"
+
+#include "redis/ServerClock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace redis {
+
+SlowLog::SlowLog(const int64_t slowerThanUsec, const std::size_t maxLen)
+    : ring_(maxLen), slowerThanUsec_(slowerThanUsec) {}
+
+void SlowLog::record(const std::span<const std::string> command,
+                     const uint64_t durationUsec,
+                     const std::string &clientAddress,
+                     const std::string &clientName) {
+  if (ring_.empty()) {
+    return;
+  }
+
+  SlowLogEntry &entry = ring_[next_];
+  entry.id = nextId_++;
+  entry.timestamp = ServerClock::unixTime();
+  entry.durationUsec = durationUsec;
+  entry.clientAddress.assign(clientAddress);
+  entry.clientName.assign(clientName);
+
+  const std::size_t argc = std::min(command.size(), kMaxArgs);
+  entry.args.resize(argc);
+  for (std::size_t i = 0; i < argc; i++) {
+    std::string &arg = entry.args[i];
+    if (i == kMaxArgs - 1 && command.size() > kMaxArgs) {
+      arg.assign("... (");
+      arg.append(std::to_string(command.size() - kMaxArgs + 1));
+      arg.append(" more arguments)");
+    } else if (command[i].size() > kMaxArgLength) {
+      arg.assign(command[i], 0, kMaxArgLength);
+      arg.append("... (");
+      arg.append(std::to_string(command[i].size() - kMaxArgLength));
+      arg.append(" more bytes)");
+    } else {
+      arg.assign(command[i]);
+    }
+  }
+
+  next_ = (next_ + 1) % ring_.size();
+  size_ = std::min(size_ + 1, ring_.size());
+}
+
+std::vector<const SlowLogEntry *> SlowLog::latest(const int64_t count) const {
+  const std::size_t n =
+      count < 0 ? size_ : std::min(size_, static_cast<std::size_t>(count));
+
+  std::vector<const SlowLogEntry *> entries;
+  entries.reserve(n);
+  for (std::size_t i = 0; i < n; i++) {
+    const std::size_t slot = (next_ + ring_.size() - 1 - i) % ring_.size();
+    entries.push_back(&ring_[slot]);
+  }
+  return entries;
+}
+
+void SlowLog::reset() {
+  next_ = 0;
+  size_ = 0;
+}
+
+void SlowLog::setMaxLen(const std::size_t maxLen) {
+  // Keep the newest entries that still fit, oldest first.
+  auto kept = latest(static_cast<int64_t>(std::min(maxLen, size_)));
+  std::vector<SlowLogEntry> ring(maxLen);
+  for (std::size_t i = 0; i < kept.size(); i++) {
+    ring[kept.size() - 1 - i] = *kept[i];
+  }
+
+  ring_ = std::move(ring);
+  size_ = kept.size();
+  next_ = maxLen == 0 ? 0 : size_ % maxLen;
+}
+
+} // namespace redis
@@ -1,22 +1,347 @@
 #include "redis/Storage.h"
 
+#include "redis/Arena.h"
+#include "redis/IntSet.h"
+#include "redis/LazyFree.h"
+#include "redis/Listpack.h"
+#include "redis/Lzf.h"
+#include "redis/ServerClock.h"
+#include "redis/StringUtils.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <utility>
+
 namespace redis {
 
+namespace {
+
+using DataMap = std::unordered_map<std::string, ValueWithExpiry>;
+
+// How many keys ahead of the current one to prefetch: far enough to cover a
+// memory access, near enough that the line is still cached when reached.
+constexpr std::size_t kPrefetchDistance = 8;
+
+// The buckets a snapshot walk visits per acquisition of the lock.
+constexpr std::size_t kSnapshotChunkBuckets = 1024;
+
+// The preserved entries a snapshot walk visits between calls to afterChunk.
+constexpr std::size_t kSnapshotChunkEntries = 1024;
+
+// The load factor that keeps the keyspace from rehashing while a snapshot
+// walk is in progress; chains grow instead, until the walk is done. Any
+// value past what a table can hold would do, short of overflowing the size
+// at which libstdc++ next checks for growth.
+constexpr float kPinnedLoadFactor = 1e6F;
+
+void prefetch(const void *addr) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(addr);
+#else
+  (void)addr;
+#endif
+}
+
+// Resolves every key to its entry (or nullptr) and hands it to fn in order.
+// Bucket indices are computed in a first pass; the lookups then walk those
+// buckets directly instead of hashing each key a second time.
+template <typename Fn>
+void forEachEntry(DataMap &data, const std::span<const std::string> keys,
+                  Fn &&fn) {
+  if (data.empty()) {
+    for (std::size_t i = 0; i < keys.size(); i++) {
+      fn(i, static_cast<DataMap::value_type *>(nullptr));
+    }
+    return;
+  }
+
+  Arena<1024> scratch;
+  std::pmr::vector<std::size_t> buckets(keys.size(), scratch.resource());
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    buckets[i] = data.bucket(keys[i]);
+  }
+
+  const auto prefetchBucket = [&](const std::size_t i) {
+    if (const auto it = data.begin(buckets[i]); it != data.end(buckets[i])) {
+      prefetch(&*it);
+    }
+  };
+  for (std::size_t i = 0; i < std::min(kPrefetchDistance, keys.size()); i++) {
+    prefetchBucket(i);
+  }
+
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    if (i + kPrefetchDistance < keys.size()) {
+      prefetchBucket(i + kPrefetchDistance);
+    }
+
+    DataMap::value_type *entry = nullptr;
+    for (auto it = data.begin(buckets[i]); it != data.end(buckets[i]); ++it) {
+      if (it->first == keys[i]) {
+        entry = &*it;
+        break;
+      }
+    }
+    fn(i, entry);
+  }
+}
+
+bool isExpired(const ValueWithExpiry &entry,
+               const std::chrono::steady_clock::time_point now) {
+  return entry.hasExpiry && now >= entry.expiryTime;
+}
+
+// Heap bytes behind a string; short ones are stored inline.
+std::size_t allocatedBytes(const std::string &str) {
+  static const std::size_t inlineCapacity = std::string().capacity();
+  return str.capacity() > inlineCapacity ? str.capacity() + 1 : 0;
+}
+
+// A node holds the element, the next pointer and the cached hash, and the
+// table a bucket pointer per node at a load factor of 1.
+template <typename Table>
+constexpr std::size_t kNodeBytes = sizeof(typename Table::value_type) +
+                                   2 * sizeof(void *) + sizeof(std::size_t);
+
+std::size_t elementBytes(const HashTable::value_type &field) {
+  return allocatedBytes(field.first) + allocatedBytes(field.second);
+}
+
+std::size_t elementBytes(const std::string &member) {
+  return allocatedBytes(member);
+}
+
+// Estimated bytes behind a hash or set table; the elements past the first
+// samples (all of them if samples is 0) are assumed to be of the average
+// size.
+template <typename Table>
+std::size_t tableBytes(const Table &table, const std::size_t samples) {
+  std::size_t sampled = 0;
+  std::size_t bytes = 0;
+  for (const auto &element : table) {
+    if (samples != 0 && sampled == samples) {
+      break;
+    }
+    bytes += kNodeBytes<Table> + elementBytes(element);
+    sampled++;
+  }
+  if (sampled > 0 && sampled < table.size()) {
+    bytes = bytes / sampled * table.size();
+  }
+  return sizeof(Table) + bytes;
+}
+
+int intSetWidth(const ValueWithExpiry &entry) {
+  return static_cast<int>(entry.intValue);
+}
+
+bool setContains(const ValueWithExpiry &entry, const std::string_view member) {
+  if (entry.encoding == ValueEncoding::IntSet) {
+    int64_t value = 0;
+    return parseInt64(member, value) &&
+           IntSet::contains(entry.value, intSetWidth(entry), value);
+  }
+  return entry.set->contains(member);
+}
+
+std::string decodeValue(const ValueWithExpiry &entry) {
+  switch (entry.encoding) {
+  case ValueEncoding::Int:
+    return std::to_string(entry.intValue);
+  case ValueEncoding::Lzf: {
+    std::string value;
+    value.resize_and_overwrite(
+        static_cast<std::size_t>(entry.intValue),
+        [&](char *out, const std::size_t length) {
+          return lzfDecompress(entry.value, out, length) ? length : 0;
+        });
+    return value;
+  }
+  default:
+    return entry.value;
+  }
+}
+
+// A deep copy of entry, tables and filters included.
+ValueWithExpiry copyEntry(const ValueWithExpiry &entry) {
+  ValueWithExpiry copy;
+  copy.value = entry.value;
+  copy.intValue = entry.intValue;
+  if (entry.hash) {
+    copy.hash = std::make_unique<HashTable>(*entry.hash);
+  }
+  if (entry.set) {
+    copy.set = std::make_unique<SetTable>(*entry.set);
+  }
+  if (entry.bloom) {
+    copy.bloom = std::make_unique<BloomFilter>(*entry.bloom);
+  }
+  copy.type = entry.type;
+  copy.encoding = entry.encoding;
+  copy.expiryTime = entry.expiryTime;
+  copy.hasExpiry = entry.hasExpiry;
+  copy.version = entry.version;
+  return copy;
+}
+
+} // namespace
+
+void Storage::encodeValue(ValueWithExpiry &entry) {
+  // Only short values can be integers; skip the parse for everything else.
+  if (entry.value.size() <= 20 && parseInt64(entry.value, entry.intValue)) {
+    entry.encoding = ValueEncoding::Int;
+    entry.value.clear();
+  } else if (compressionThreshold_ > 0 &&
+             entry.value.size() >= compressionThreshold_) {
+    compressValue(entry);
+  }
+}
+
+void Storage::compressValue(ValueWithExpiry &entry) {
+  // Every read pays for a decompression, so the value stays raw unless LZF
+  // saves at least an eighth of it.
+  const std::size_t limit = entry.value.size() - entry.value.size() / 8;
+  const auto buffer = std::make_unique_for_overwrite<char[]>(limit);
+  const std::size_t length = lzfCompress(entry.value, buffer.get(), limit);
+  if (length == 0) {
+    return;
+  }
+
+  entry.intValue = static_cast<int64_t>(entry.value.size());
+  // Assigning a fresh string releases the raw value's allocation.
+  entry.value = std::string(buffer.get(), length);
+  entry.encoding = ValueEncoding::Lzf;
+
+  compressionStats_.values++;
+  compressionStats_.rawBytes += static_cast<std::size_t>(entry.intValue);
+  compressionStats_.compressedBytes += length;
+}
+
+void Storage::setValueCompression(const std::size_t thresholdBytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  compressionThreshold_ = thresholdBytes;
+}
+
+CompressionStats Storage::compressionStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return compressionStats_;
+}
+
+void Storage::setLazyFree(std::shared_ptr<LazyFree> lazyFree,
+                          const LazyFreePolicy policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lazyFree_ = std::move(lazyFree);
+  lazyFreePolicy_ = policy;
+}
+
+void Storage::setEncodingLimits(const EncodingLimits limits) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  encodingLimits_ = limits;
+}
+
+void Storage::releaseValue(ValueWithExpiry &entry, const bool async) {
+  if (entry.encoding == ValueEncoding::Lzf) {
+    compressionStats_.values--;
+    compressionStats_.rawBytes -= static_cast<std::size_t>(entry.intValue);
+    compressionStats_.compressedBytes -= entry.value.size();
+  }
+  if (!async || !lazyFree_) {
+    return;
+  }
+  if (entry.value.capacity() >= lazyFreePolicy_.thresholdBytes) {
+    lazyFree_->free(std::move(entry.value));
+  }
+  // Freeing a table costs a free per element; only the node count matters,
+  // so the estimate needs no sampling.
+  if (entry.hash && entry.hash->size() * kNodeBytes<HashTable> >=
+                        lazyFreePolicy_.thresholdBytes) {
+    lazyFree_->free(std::move(entry.hash));
+  }
+  if (entry.set && entry.set->size() * kNodeBytes<SetTable> >=
+                       lazyFreePolicy_.thresholdBytes) {
+    lazyFree_->free(std::move(entry.set));
+  }
+}
+
+void Storage::erase(const DataMap::iterator it, const bool async) {
+  touchWatched(it->first);
+  retireValue(it->first, it->second, async);
+  data_.erase(it);
+}
+
+void Storage::touchWatched(const std::string &key) {
+  if (watched_.empty()) {
+    return;
+  }
+  if (const auto it = watched_.find(key); it != watched_.end()) {
+    it->second.deletedVersion = ++nextVersion_;
+  }
+}
+
+bool Storage::snapshotNeeds(const std::string &key,
+                            const ValueWithExpiry &entry) const {
+  // Entries of version 0 were just inserted, and later versions were
+  // written after the snapshot began.
+  return snapshot_ && snapshot_->keyspace == &data_ && entry.version != 0 &&
+         entry.version <= snapshot_->version &&
+         data_.bucket(key) >= snapshot_->cursor &&
+         !snapshot_->preserved.contains(key);
+}
+
+void Storage::retireValue(const std::string &key, ValueWithExpiry &entry,
+                          const bool async) {
+  if (!snapshotNeeds(key, entry)) {
+    releaseValue(entry, async);
+    return;
+  }
+  // The value is leaving the keyspace either way, so the walk takes it
+  // whole; the compression stats only cover the keyspace.
+  releaseValue(entry, false);
+  snapshot_->bytes += memoryUsage(key, entry, kMemorySamples);
+  snapshot_->preserved.emplace(key, std::move(entry));
+}
+
+void Storage::preserveForSnapshot(const std::string &key,
+                                  const ValueWithExpiry &entry) {
+  if (snapshotNeeds(key, entry)) {
+    snapshot_->bytes += memoryUsage(key, entry, kMemorySamples);
+    snapshot_->preserved.emplace(key, copyEntry(entry));
+  }
+}
+
 void Storage::set(const std::string &key, const std::string &value) {
   std::lock_guard<std::mutex> lock(mutex_);
-  data_[key] = ValueWithExpiry(value);
+  auto &slot = data_[key];
+  retireValue(key, slot, lazyFreePolicy_.onOverwrite);
+  auto &entry = slot = ValueWithExpiry(value);
+  encodeValue(entry);
+  entry.version = ++nextVersion_;
 }
 
 void Storage::setWithExpiry(const std::string &key, const std::string &value,
                             const int64_t expiryMs) {
   std::lock_guard<std::mutex> lock(mutex_);
   const auto expiryTime =
-      std::chrono::steady_clock::now() + std::chrono::milliseconds(expiryMs);
-  data_[key] = ValueWithExpiry(value, expiryTime);
+      ServerClock::now() + std::chrono::milliseconds(expiryMs);
+  auto &slot = data_[key];
+  retireValue(key, slot, lazyFreePolicy_.onOverwrite);
+  auto &entry = slot = ValueWithExpiry(value, expiryTime);
+  encodeValue(entry);
+  entry.version = ++nextVersion_;
 }
 
 std::optional<std::string> Storage::get(const std::string &key) {
+  bool wrongType = false;
+  return get(key, wrongType);
+}
+
+std::optional<std::string> Storage::get(const std::string &key,
+                                        bool &wrongType) {
   std::lock_guard<std::mutex> lock(mutex_);
+  wrongType = false;
 
   const auto it = data_.find(key);
   if (it == data_.end()) {
@@ -24,35 +349,1160 @@ std::optional<std::string> Storage::get(const std::string &key) {
   }
 
   if (it->second.hasExpiry) {
-    if (const auto now = std::chrono::steady_clock::now();
+    if (const auto now = ServerClock::now();
         now >= it->second.expiryTime) {
-      data_.erase(it);
+      erase(it, lazyFreePolicy_.onExpire);
+      notifyExpired(key);
       return std::nullopt;
     }
   }
 
-  return it->second.value;
+  if (it->second.type != ValueType::String) {
+    wrongType = true;
+    return std::nullopt;
+  }
+  return decodeValue(it->second);
+}
+
+std::optional<ValueType> Storage::type(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return std::nullopt;
+  }
+  return it->second.type;
+}
+
+std::vector<std::optional<std::string>>
+Storage::getMany(const std::span<const std::string> keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::optional<std::string>> values(keys.size());
+  Arena<256> scratch;
+  std::pmr::vector<std::size_t> expired(scratch.resource());
+
+  const auto now = ServerClock::now();
+  forEachEntry(data_, keys, [&](const std::size_t i, const auto *entry) {
+    if (entry == nullptr) {
+      return;
+    }
+    if (isExpired(entry->second, now)) {
+      expired.push_back(i);
+      return;
+    }
+    if (entry->second.type == ValueType::String) {
+      values[i] = decodeValue(entry->second);
+    }
+  });
+
+  // Erase after the batch so the lookups never walk a modified bucket.
+  for (const std::size_t i : expired) {
+    if (const auto it = data_.find(keys[i]); it != data_.end()) {
+      erase(it, lazyFreePolicy_.onExpire);
+      notifyExpired(keys[i]);
+    }
+  }
+  return values;
+}
+
+void Storage::setMany(const std::span<const std::string> keyValues) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Grow once up front instead of rehashing part-way through the batch,
+  // unless a snapshot walk has the table's buckets pinned.
+  if (!snapshot_) {
+    data_.reserve(data_.size() + keyValues.size() / 2);
+  }
+  for (std::size_t i = 0; i + 1 < keyValues.size(); i += 2) {
+    auto &slot = data_[keyValues[i]];
+    retireValue(keyValues[i], slot, lazyFreePolicy_.onOverwrite);
+    auto &entry = slot = ValueWithExpiry(keyValues[i + 1]);
+    encodeValue(entry);
+    entry.version = ++nextVersion_;
+  }
+}
+
+std::size_t Storage::remove(const std::span<const std::string> keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return removeKeys(keys, false);
+}
+
+std::size_t Storage::unlink(const std::span<const std::string> keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return removeKeys(keys, true);
+}
+
+std::size_t Storage::removeKeys(const std::span<const std::string> keys,
+                                const bool async) {
+  Arena<1024> scratch;
+  // key index, still live
+  std::pmr::vector<std::pair<std::size_t, bool>> found(scratch.resource());
+
+  const auto now = ServerClock::now();
+  forEachEntry(data_, keys, [&](const std::size_t i, const auto *entry) {
+    if (entry != nullptr) {
+      found.emplace_back(i, !isExpired(entry->second, now));
+    }
+  });
+
+  // A key repeated in the batch is only erased, and counted, once.
+  std::size_t removed = 0;
+  for (const auto &[i, live] : found) {
+    const auto it = data_.find(keys[i]);
+    if (it == data_.end()) {
+      continue;
+    }
+    // An expired key is not counted, and only lazily freed if asked for.
+    erase(it, live ? async : lazyFreePolicy_.onExpire);
+    if (live) {
+      removed++;
+    }
+  }
+  return removed;
+}
+
+std::size_t Storage::countExisting(const std::span<const std::string> keys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto now = ServerClock::now();
+  std::size_t count = 0;
+  forEachEntry(data_, keys, [&](std::size_t, const auto *entry) {
+    if (entry != nullptr && !isExpired(entry->second, now)) {
+      count++;
+    }
+  });
+  return count;
+}
+
+IncrResult Storage::incrBy(const std::string &key, const int64_t delta,
+                          int64_t &result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  auto &entry = data_[key];
+  if (entry.version == 0) {
+    // Freshly inserted by operator[].
+    entry.encoding = ValueEncoding::Int;
+  } else if (entry.type != ValueType::String) {
+    return IncrResult::WrongType;
+  } else if (entry.encoding == ValueEncoding::Lzf) {
+    // Only values far longer than any integer are compressed.
+    return IncrResult::NotInteger;
+  } else if (entry.encoding == ValueEncoding::Raw) {
+    int64_t current = 0;
+    if (!parseInt64(entry.value, current)) {
+      return IncrResult::NotInteger;
+    }
+    entry.intValue = current;
+    entry.encoding = ValueEncoding::Int;
+    entry.value.clear();
+  }
+
+  if (__builtin_add_overflow(entry.intValue, delta, &result)) {
+    return IncrResult::Overflow;
+  }
+  preserveForSnapshot(key, entry);
+  entry.intValue = result;
+  entry.version = ++nextVersion_;
+  return IncrResult::Ok;
+}
+
+IncrResult Storage::incrByFloat(const std::string &key, const long double delta,
+                               std::string &result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  auto &entry = data_[key];
+  if (entry.type != ValueType::String) {
+    return IncrResult::WrongType;
+  }
+  long double current = 0;
+  if (entry.encoding == ValueEncoding::Int) {
+    current = static_cast<long double>(entry.intValue);
+  } else if (entry.version != 0 &&
+             !parseLongDouble(decodeValue(entry), current)) {
+    return IncrResult::NotFloat;
+  }
+
+  const long double sum = current + delta;
+  if (std::isnan(sum) || std::isinf(sum)) {
+    if (entry.version == 0) {
+      data_.erase(key);
+    }
+    return IncrResult::Overflow;
+  }
+
+  // Like Redis, the result is stored as a string so the exact textual form
+  // returned to the client is what later reads observe.
+  if (!formatLongDouble(sum, result)) {
+    if (entry.version == 0) {
+      data_.erase(key);
+    }
+    return IncrResult::NotFloat;
+  }
+  retireValue(key, entry, false);
+  entry.value = result;
+  entry.encoding = ValueEncoding::Raw;
+  encodeValue(entry);
+  entry.version = ++nextVersion_;
+  return IncrResult::Ok;
+}
+
+bool Storage::loadHll(ValueWithExpiry &entry) {
+  if (entry.type != ValueType::String ||
+      entry.encoding == ValueEncoding::Int) {
+    return false;
+  }
+  if (entry.encoding == ValueEncoding::Lzf) {
+    // Sketches are updated in place, so one that was stored compressed with
+    // SET is expanded for good.
+    std::string value = decodeValue(entry);
+    if (!HyperLogLog::isValid(value)) {
+      return false;
+    }
+    releaseValue(entry, false);
+    entry.value = std::move(value);
+    entry.encoding = ValueEncoding::Raw;
+    return true;
+  }
+  return HyperLogLog::isValid(entry.value);
+}
+
+HllResult Storage::mergeHlls(const std::span<const std::string> keys,
+                             HyperLogLog::Registers &registers) {
+  for (const auto &key : keys) {
+    removeExpiredKey(key);
+    const auto it = data_.find(key);
+    if (it == data_.end()) {
+      continue;
+    }
+    if (!loadHll(it->second)) {
+      return HllResult::NotHll;
+    }
+    if (!HyperLogLog::mergeInto(it->second.value, registers)) {
+      return HllResult::Corrupt;
+    }
+  }
+  return HllResult::Ok;
+}
+
+HllResult Storage::pfAdd(const std::string &key,
+                         const std::span<const std::string> elements,
+                         const std::size_t sparseMaxBytes, bool &changed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  auto &entry = data_[key];
+  changed = entry.version == 0;
+  if (changed) {
+    // Freshly inserted by operator[].
+    entry.value = HyperLogLog::create();
+  } else if (!loadHll(entry)) {
+    return HllResult::NotHll;
+  }
+
+  // Registers are updated in place, so a sketch the snapshot walk still
+  // needs is copied even if no register grows.
+  preserveForSnapshot(key, entry);
+  for (const auto &element : elements) {
+    if (!HyperLogLog::add(entry.value, element, sparseMaxBytes, changed)) {
+      return HllResult::Corrupt;
+    }
+  }
+  if (changed) {
+    entry.version = ++nextVersion_;
+  }
+  return HllResult::Ok;
+}
+
+HllResult Storage::pfCount(const std::span<const std::string> keys,
+                           uint64_t &count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  count = 0;
+
+  if (keys.size() == 1) {
+    removeExpiredKey(keys[0]);
+    const auto it = data_.find(keys[0]);
+    if (it == data_.end()) {
+      return HllResult::Ok;
+    }
+    if (!loadHll(it->second)) {
+      return HllResult::NotHll;
+    }
+    return HyperLogLog::count(it->second.value, count) ? HllResult::Ok
+                                                       : HllResult::Corrupt;
+  }
+
+  // A union is estimated from the merged registers and is not cached.
+  HyperLogLog::Registers registers{};
+  const HllResult result = mergeHlls(keys, registers);
+  if (result == HllResult::Ok) {
+    count = HyperLogLog::estimate(registers);
+  }
+  return result;
+}
+
+HllResult Storage::pfMerge(const std::string &destKey,
+                           const std::span<const std::string> sourceKeys) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  HyperLogLog::Registers registers{};
+  HllResult result = mergeHlls(std::span(&destKey, 1), registers);
+  if (result == HllResult::Ok) {
+    result = mergeHlls(sourceKeys, registers);
+  }
+  if (result != HllResult::Ok) {
+    return result;
+  }
+
+  auto &entry = data_[destKey];
+  retireValue(destKey, entry, lazyFreePolicy_.onOverwrite);
+  entry.value = HyperLogLog::fromRegisters(registers);
+  entry.encoding = ValueEncoding::Raw;
+  entry.version = ++nextVersion_;
+  return HllResult::Ok;
+}
+
+void Storage::convertToHashTable(ValueWithExpiry &entry) {
+  auto hash = std::make_unique<HashTable>();
+  hash->reserve(static_cast<std::size_t>(entry.intValue));
+  forEachField(entry, [&](const std::string_view field,
+                          const std::string_view value) {
+    hash->emplace(field, value);
+  });
+  entry.hash = std::move(hash);
+  // Swapping with an empty string releases the listpack's allocation.
+  std::string().swap(entry.value);
+  entry.intValue = 0;
+  entry.encoding = ValueEncoding::HashTable;
+}
+
+bool Storage::hset(const std::string &key,
+                   const std::span<const std::string> fieldValues,
+                   std::size_t &added) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  added = 0;
+
+  auto &entry = data_[key];
+  if (entry.version == 0) {
+    // Freshly inserted by operator[].
+    entry.type = ValueType::Hash;
+    entry.encoding = ValueEncoding::Listpack;
+  } else if (entry.type != ValueType::Hash) {
+    return false;
+  }
+  preserveForSnapshot(key, entry);
+
+  if (entry.encoding == ValueEncoding::Listpack &&
+      std::ranges::any_of(fieldValues, [&](const std::string &str) {
+        return str.size() > encodingLimits_.hashMaxValueBytes;
+      })) {
+    convertToHashTable(entry);
+  }
+
+  for (std::size_t i = 0; i + 1 < fieldValues.size(); i += 2) {
+    if (entry.encoding == ValueEncoding::HashTable) {
+      if (entry.hash->insert_or_assign(fieldValues[i], fieldValues[i + 1])
+              .second) {
+        added++;
+      }
+    } else if (Listpack::set(entry.value, fieldValues[i],
+                             fieldValues[i + 1])) {
+      added++;
+      if (static_cast<std::size_t>(++entry.intValue) >
+          encodingLimits_.hashMaxEntries) {
+        convertToHashTable(entry);
+      }
+    }
+  }
+  entry.version = ++nextVersion_;
+  return true;
+}
+
+bool Storage::hget(const std::string &key, const std::string &field,
+                   std::optional<std::string> &value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  value.reset();
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  const ValueWithExpiry &entry = it->second;
+  if (entry.type != ValueType::Hash) {
+    return false;
+  }
+
+  if (entry.encoding == ValueEncoding::Listpack) {
+    if (const auto found = Listpack::find(entry.value, field)) {
+      value.emplace(*found);
+    }
+  } else if (const auto found = entry.hash->find(field);
+             found != entry.hash->end()) {
+    value = found->second;
+  }
+  return true;
+}
+
+bool Storage::hdel(const std::string &key,
+                   const std::span<const std::string> fields,
+                   std::size_t &removed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  removed = 0;
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  ValueWithExpiry &entry = it->second;
+  if (entry.type != ValueType::Hash) {
+    return false;
+  }
+  preserveForSnapshot(key, entry);
+
+  for (const auto &field : fields) {
+    if (entry.encoding == ValueEncoding::Listpack) {
+      if (Listpack::erase(entry.value, field)) {
+        entry.intValue--;
+        removed++;
+      }
+    } else {
+      removed += entry.hash->erase(field);
+    }
+  }
+  if (removed > 0) {
+    entry.version = ++nextVersion_;
+    if (hashLength(entry) == 0) {
+      erase(it, false);
+    }
+  }
+  return true;
+}
+
+bool Storage::hlen(const std::string &key, std::size_t &length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  length = 0;
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  if (it->second.type != ValueType::Hash) {
+    return false;
+  }
+  length = hashLength(it->second);
+  return true;
+}
+
+bool Storage::hgetall(
+    const std::string &key,
+    const std::function<void(std::size_t)> &begin,
+    const std::function<void(std::string_view, std::string_view)> &fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  if (it->second.type != ValueType::Hash) {
+    return false;
+  }
+  begin(hashLength(it->second));
+  forEachField(it->second, fn);
+  return true;
+}
+
+std::size_t Storage::hashLength(const ValueWithExpiry &entry) {
+  return entry.encoding == ValueEncoding::Listpack
+             ? static_cast<std::size_t>(entry.intValue)
+             : entry.hash->size();
+}
+
+void Storage::forEachField(
+    const ValueWithExpiry &entry,
+    const std::function<void(std::string_view, std::string_view)> &fn) {
+  if (entry.encoding == ValueEncoding::HashTable) {
+    for (const auto &[field, value] : *entry.hash) {
+      fn(field, value);
+    }
+    return;
+  }
+
+  // Elements alternate field and value.
+  std::string_view field;
+  bool isValue = false;
+  Listpack::forEach(entry.value, [&](const std::string_view element) {
+    if (isValue) {
+      fn(field, element);
+    } else {
+      field = element;
+    }
+    isValue = !isValue;
+    return true;
+  });
+}
+
+void Storage::convertToSetTable(ValueWithExpiry &entry) {
+  auto set = std::make_unique<SetTable>();
+  set->reserve(setLength(entry));
+  forEachMember(entry,
+                [&](const std::string_view member) { set->emplace(member); });
+  entry.set = std::move(set);
+  std::string().swap(entry.value);
+  entry.intValue = 0;
+  entry.encoding = ValueEncoding::SetTable;
+}
+
+bool Storage::sadd(const std::string &key,
+                   const std::span<const std::string> members,
+                   std::size_t &added) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  added = 0;
+
+  auto &entry = data_[key];
+  if (entry.version == 0) {
+    // Freshly inserted by operator[]: an empty intset of the narrowest
+    // width.
+    entry.type = ValueType::Set;
+    entry.encoding = ValueEncoding::IntSet;
+    entry.intValue = 2;
+  } else if (entry.type != ValueType::Set) {
+    return false;
+  }
+  preserveForSnapshot(key, entry);
+
+  for (const auto &member : members) {
+    if (entry.encoding == ValueEncoding::IntSet) {
+      int64_t value = 0;
+      if (parseInt64(member, value)) {
+        int width = intSetWidth(entry);
+        if (IntSet::add(entry.value, width, value)) {
+          added++;
+          entry.intValue = width;
+          if (IntSet::size(entry.value, width) >
+              encodingLimits_.setMaxIntsetEntries) {
+            convertToSetTable(entry);
+          }
+        }
+        continue;
+      }
+      convertToSetTable(entry);
+    }
+    if (entry.set->insert(member).second) {
+      added++;
+    }
+  }
+  entry.version = ++nextVersion_;
+  return true;
+}
+
+bool Storage::srem(const std::string &key,
+                   const std::span<const std::string> members,
+                   std::size_t &removed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  removed = 0;
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  ValueWithExpiry &entry = it->second;
+  if (entry.type != ValueType::Set) {
+    return false;
+  }
+  preserveForSnapshot(key, entry);
+
+  for (const auto &member : members) {
+    if (entry.encoding == ValueEncoding::IntSet) {
+      int64_t value = 0;
+      if (parseInt64(member, value) &&
+          IntSet::remove(entry.value, intSetWidth(entry), value)) {
+        removed++;
+      }
+    } else if (const auto found = entry.set->find(member);
+               found != entry.set->end()) {
+      entry.set->erase(found);
+      removed++;
+    }
+  }
+  if (removed > 0) {
+    entry.version = ++nextVersion_;
+    if (setLength(entry) == 0) {
+      erase(it, false);
+    }
+  }
+  return true;
+}
+
+bool Storage::sismember(const std::string &key, const std::string &member,
+                        bool &found) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  found = false;
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  if (it->second.type != ValueType::Set) {
+    return false;
+  }
+  found = setContains(it->second, member);
+  return true;
+}
+
+bool Storage::scard(const std::string &key, std::size_t &length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  length = 0;
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  if (it->second.type != ValueType::Set) {
+    return false;
+  }
+  length = setLength(it->second);
+  return true;
+}
+
+bool Storage::smembers(const std::string &key,
+                       const std::function<void(std::size_t)> &begin,
+                       const std::function<void(std::string_view)> &fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  if (it->second.type != ValueType::Set) {
+    return false;
+  }
+  begin(setLength(it->second));
+  forEachMember(it->second, fn);
+  return true;
+}
+
+bool Storage::lookupSets(const std::span<const std::string> keys,
+                         std::vector<const ValueWithExpiry *> &sets) {
+  sets.reserve(keys.size());
+  for (const auto &key : keys) {
+    removeExpiredKey(key);
+    const auto it = data_.find(key);
+    if (it == data_.end()) {
+      sets.push_back(nullptr);
+    } else if (it->second.type != ValueType::Set) {
+      return false;
+    } else {
+      sets.push_back(&it->second);
+    }
+  }
+  return true;
+}
+
+bool Storage::sinter(const std::span<const std::string> keys,
+                     SetMembers &result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  result = {};
+
+  std::vector<const ValueWithExpiry *> sets;
+  if (!lookupSets(keys, sets)) {
+    return false;
+  }
+  if (std::ranges::find(sets, nullptr) != sets.end()) {
+    return true;
+  }
+
+  // The result only shrinks, and each step costs in proportion to it, so
+  // start from the smallest set.
+  std::ranges::sort(sets, {}, [](const ValueWithExpiry *entry) {
+    return setLength(*entry);
+  });
+
+  if (std::ranges::all_of(sets, [](const ValueWithExpiry *entry) {
+        return entry->encoding == ValueEncoding::IntSet;
+      })) {
+    IntSet::decode(sets[0]->value, intSetWidth(*sets[0]), result.ints);
+    for (std::size_t i = 1; i < sets.size() && !result.ints.empty(); i++) {
+      IntSet::intersect(result.ints, sets[i]->value, intSetWidth(*sets[i]));
+    }
+    return true;
+  }
+
+  forEachMember(*sets[0], [&](const std::string_view member) {
+    if (std::all_of(sets.begin() + 1, sets.end(),
+                    [&](const ValueWithExpiry *entry) {
+                      return setContains(*entry, member);
+                    })) {
+      result.strings.emplace_back(member);
+    }
+  });
+  return true;
+}
+
+bool Storage::sunion(const std::span<const std::string> keys,
+                     SetMembers &result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  result = {};
+
+  std::vector<const ValueWithExpiry *> sets;
+  if (!lookupSets(keys, sets)) {
+    return false;
+  }
+  std::erase(sets, nullptr);
+
+  if (std::ranges::all_of(sets, [](const ValueWithExpiry *entry) {
+        return entry->encoding == ValueEncoding::IntSet;
+      })) {
+    // Merge the sorted members set by set.
+    std::vector<int64_t> members;
+    std::vector<int64_t> merged;
+    for (const ValueWithExpiry *entry : sets) {
+      members.clear();
+      IntSet::decode(entry->value, intSetWidth(*entry), members);
+      merged.clear();
+      std::ranges::set_union(result.ints, members, std::back_inserter(merged));
+      result.ints.swap(merged);
+    }
+    return true;
+  }
+
+  SetTable members;
+  for (const ValueWithExpiry *entry : sets) {
+    forEachMember(*entry, [&](const std::string_view member) {
+      members.emplace(member);
+    });
+  }
+  result.strings.reserve(members.size());
+  while (!members.empty()) {
+    result.strings.push_back(
+        std::move(members.extract(members.begin()).value()));
+  }
+  return true;
+}
+
+bool Storage::sdiff(const std::span<const std::string> keys,
+                    SetMembers &result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  result = {};
+
+  std::vector<const ValueWithExpiry *> sets;
+  if (!lookupSets(keys, sets)) {
+    return false;
+  }
+  const ValueWithExpiry *first = sets[0];
+  if (first == nullptr) {
+    return true;
+  }
+  std::erase(sets, nullptr);
+  const auto others = std::span(sets).subspan(1);
+
+  if (std::ranges::all_of(sets, [](const ValueWithExpiry *entry) {
+        return entry->encoding == ValueEncoding::IntSet;
+      })) {
+    IntSet::decode(first->value, intSetWidth(*first), result.ints);
+    for (const ValueWithExpiry *entry : others) {
+      std::erase_if(result.ints, [&](const int64_t value) {
+        return IntSet::contains(entry->value, intSetWidth(*entry), value);
+      });
+    }
+    return true;
+  }
+
+  forEachMember(*first, [&](const std::string_view member) {
+    if (std::ranges::none_of(others, [&](const ValueWithExpiry *entry) {
+          return setContains(*entry, member);
+        })) {
+      result.strings.emplace_back(member);
+    }
+  });
+  return true;
+}
+
+std::size_t Storage::setLength(const ValueWithExpiry &entry) {
+  return entry.encoding == ValueEncoding::IntSet
+             ? IntSet::size(entry.value, intSetWidth(entry))
+             : entry.set->size();
+}
+
+void Storage::forEachMember(
+    const ValueWithExpiry &entry,
+    const std::function<void(std::string_view)> &fn) {
+  if (entry.encoding == ValueEncoding::SetTable) {
+    for (const auto &member : *entry.set) {
+      fn(member);
+    }
+    return;
+  }
+
+  const int width = intSetWidth(entry);
+  char buffer[20];
+  for (std::size_t i = 0; i < IntSet::size(entry.value, width); i++) {
+    const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer),
+                                         IntSet::get(entry.value, width, i));
+    fn(std::string_view(buffer, end));
+  }
+}
+
+bool Storage::bfReserve(const std::string &key,
+                        const BloomFilter::Options &options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto [it, inserted] = data_.try_emplace(key);
+  if (!inserted) {
+    return false;
+  }
+  ValueWithExpiry &entry = it->second;
+  entry.bloom = std::make_unique<BloomFilter>(options);
+  entry.type = ValueType::Bloom;
+  entry.encoding = ValueEncoding::Bloom;
+  entry.version = ++nextVersion_;
+  return true;
+}
+
+bool Storage::bfAdd(const std::string &key,
+                    const std::span<const std::string> items,
+                    const BloomFilter::Options &options,
+                    std::vector<BloomFilter::AddResult> &results) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  auto &entry = data_[key];
+  if (entry.version == 0) {
+    // Freshly inserted by operator[].
+    entry.bloom = std::make_unique<BloomFilter>(options);
+    entry.type = ValueType::Bloom;
+    entry.encoding = ValueEncoding::Bloom;
+  } else if (entry.type != ValueType::Bloom) {
+    return false;
+  }
+  preserveForSnapshot(key, entry);
+
+  const std::size_t first = results.size();
+  entry.bloom->add(items, results);
+  // Items already present leave the filter as it was.
+  if (entry.version == 0 ||
+      std::find(results.begin() + static_cast<std::ptrdiff_t>(first),
+                results.end(),
+                BloomFilter::AddResult::Added) != results.end()) {
+    entry.version = ++nextVersion_;
+  }
+  return true;
+}
+
+bool Storage::bfExists(const std::string &key,
+                       const std::span<const std::string> items,
+                       std::vector<bool> &found) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    found.insert(found.end(), items.size(), false);
+    return true;
+  }
+  if (it->second.type != ValueType::Bloom) {
+    return false;
+  }
+  it->second.bloom->contains(items, found);
+  return true;
+}
+
+bool Storage::bfInfo(const std::string &key, std::optional<BloomInfo> &info) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+  info.reset();
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return true;
+  }
+  if (it->second.type != ValueType::Bloom) {
+    return false;
+  }
+  const BloomFilter &filter = *it->second.bloom;
+  info = BloomInfo{.capacity = filter.capacity(),
+                   .bytes = filter.bytes(),
+                   .filters = filter.layers().size(),
+                   .items = filter.items(),
+                   .expansion = filter.options().expansion};
+  return true;
+}
+
+bool Storage::restoreBloom(const std::string &key,
+                           std::unique_ptr<BloomFilter> filter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto [it, inserted] = data_.try_emplace(key);
+  if (!inserted) {
+    return false;
+  }
+  it->second.bloom = std::move(filter);
+  it->second.type = ValueType::Bloom;
+  it->second.encoding = ValueEncoding::Bloom;
+  it->second.version = ++nextVersion_;
+  return true;
+}
+
+bool Storage::withEntry(
+    const std::string &key,
+    const std::function<void(const ValueWithExpiry &entry)> &fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return false;
+  }
+  fn(it->second);
+  return true;
+}
+
+uint64_t Storage::getVersion(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  if (const auto it = data_.find(key); it != data_.end()) {
+    return it->second.version;
+  }
+  const auto it = watched_.find(key);
+  return it == watched_.end() ? 0 : it->second.deletedVersion;
+}
+
+uint64_t Storage::watch(const std::string &key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_[key].watchers++;
+  }
+  return getVersion(key);
+}
+
+void Storage::unwatch(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (const auto it = watched_.find(key);
+      it != watched_.end() && --it->second.watchers == 0) {
+    watched_.erase(it);
+  }
+}
+
+int64_t Storage::pttl(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return -2;
+  }
+  if (!it->second.hasExpiry) {
+    return -1;
+  }
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             it->second.expiryTime - ServerClock::now())
+      .count();
+}
+
+bool Storage::pexpire(const std::string &key, const int64_t expiryMs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return false;
+  }
+  preserveForSnapshot(key, it->second);
+  it->second.expiryTime =
+      ServerClock::now() + std::chrono::milliseconds(expiryMs);
+  it->second.hasExpiry = true;
+  it->second.version = ++nextVersion_;
+  return true;
+}
+
+void Storage::forEach(
+    const std::function<void(const std::string &, const ValueWithExpiry &)>
+        &fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &[key, entry] : data_) {
+    fn(key, entry);
+  }
+}
+
+std::size_t Storage::scan(
+    const std::size_t cursor, const std::size_t buckets,
+    const std::function<void(const std::string &, const ValueWithExpiry &)>
+        &fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::size_t end = std::min(cursor + buckets, data_.bucket_count());
+  const auto now = ServerClock::now();
+  for (std::size_t bucket = cursor; bucket < end; bucket++) {
+    for (auto it = data_.cbegin(bucket); it != data_.cend(bucket); ++it) {
+      if (!isExpired(it->second, now)) {
+        fn(it->first, it->second);
+      }
+    }
+  }
+  return end == data_.bucket_count() ? 0 : end;
+}
+
+bool Storage::forEachInSnapshot(
+    const std::function<void(const std::string &, const ValueWithExpiry &)>
+        &fn,
+    const std::function<void()> &afterChunk) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (snapshot_) {
+      return false;
+    }
+    snapshot_ = std::make_unique<Snapshot>();
+    snapshot_->version = nextVersion_;
+    snapshot_->keyspace = &data_;
+    snapshot_->maxLoadFactor = data_.max_load_factor();
+    data_.max_load_factor(kPinnedLoadFactor);
+  }
+
+  for (bool done = false; !done;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Snapshot &snapshot = *snapshot_;
+      const DataMap &keyspace = *snapshot.keyspace;
+      const std::size_t end = std::min(
+          snapshot.cursor + kSnapshotChunkBuckets, keyspace.bucket_count());
+      for (std::size_t bucket = snapshot.cursor; bucket < end; bucket++) {
+        for (auto it = keyspace.cbegin(bucket); it != keyspace.cend(bucket);
+             ++it) {
+          const ValueWithExpiry &entry = it->second;
+          if (entry.version != 0 && entry.version <= snapshot.version &&
+              !snapshot.preserved.contains(it->first)) {
+            fn(it->first, entry);
+          }
+        }
+      }
+      snapshot.cursor = end;
+      done = end == keyspace.bucket_count();
+    }
+    afterChunk();
+  }
+
+  // With every bucket visited, writers no longer touch preserved, so the
+  // rest of the walk needs no lock.
+  std::size_t visited = 0;
+  for (const auto &[key, entry] : snapshot_->preserved) {
+    fn(key, entry);
+    if (++visited % kSnapshotChunkEntries == 0) {
+      afterChunk();
+    }
+  }
+  afterChunk();
+
+  std::unique_ptr<Snapshot> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    data_.max_load_factor(snapshot_->maxLoadFactor);
+    lastSnapshotBytes_ = snapshot_->bytes;
+    snapshot = std::move(snapshot_);
+  }
+  // The preserved values and any detached keyspace are freed here, on the
+  // walking thread.
+  return true;
+}
+
+SnapshotStats Storage::snapshotStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {.active = snapshot_ != nullptr,
+          .bytes = snapshot_ ? snapshot_->bytes : 0,
+          .lastBytes = lastSnapshotBytes_};
+}
+
+std::optional<std::size_t> Storage::memoryUsage(const std::string &key,
+                                                const std::size_t samples) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  removeExpiredKey(key);
+
+  const auto it = data_.find(key);
+  if (it == data_.end()) {
+    return std::nullopt;
+  }
+  return memoryUsage(it->first, it->second, samples);
+}
+
+std::size_t Storage::memoryUsage(const std::string &key,
+                                 const ValueWithExpiry &entry,
+                                 const std::size_t samples) {
+  std::size_t bytes = kNodeBytes<DataMap> + allocatedBytes(key) +
+                      allocatedBytes(entry.value);
+  if (entry.hash) {
+    bytes += tableBytes(*entry.hash, samples);
+  }
+  if (entry.set) {
+    bytes += tableBytes(*entry.set, samples);
+  }
+  if (entry.bloom) {
+    bytes += entry.bloom->bytes();
+  }
+  return bytes;
+}
+
+void Storage::clear(const bool async) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &[key, watch] : watched_) {
+    if (data_.contains(key)) {
+      touchWatched(key);
+    }
+  }
+  if (snapshot_ && snapshot_->keyspace == &data_ &&
+      snapshot_->cursor < data_.bucket_count()) {
+    // The snapshot walk is not through with the keyspace: it keeps it,
+    // buckets and all, and frees it when done.
+    snapshot_->detached =
+        std::make_unique<DataMap>(std::exchange(data_, DataMap()));
+    snapshot_->keyspace = snapshot_->detached.get();
+  } else if (async && lazyFree_) {
+    lazyFree_->free(std::exchange(data_, DataMap()));
+  } else {
+    data_.clear();
+  }
+  compressionStats_ = {};
 }
 
 void Storage::removeExpiredKey(const std::string &key) {
   if (const auto it = data_.find(key);
       it != data_.end() && it->second.hasExpiry) {
-    if (const auto now = std::chrono::steady_clock::now();
+    if (const auto now = ServerClock::now();
         now >= it->second.expiryTime) {
-      data_.erase(it);
+      erase(it, lazyFreePolicy_.onExpire);
+      notifyExpired(key);
     }
   }
 }
 
+void Storage::notifyExpired(const std::string &key) const {
+  if (keyExpiredListener_) {
+    keyExpiredListener_(key);
+  }
+}
+
 std::vector<std::string> Storage::getAllKeys() {
   std::lock_guard<std::mutex> lock(mutex_);
   std::vector<std::string> keys;
 
-  const auto now = std::chrono::steady_clock::now();
+  const auto now = ServerClock::now();
 
   for (auto it = data_.begin(); it != data_.end();) {
     if (it->second.hasExpiry && now >= it->second.expiryTime) {
+      const std::string expiredKey = it->first;
+      touchWatched(expiredKey);
+      retireValue(expiredKey, it->second, lazyFreePolicy_.onExpire);
       it = data_.erase(it);
+      notifyExpired(expiredKey);
     } else {
       keys.push_back(it->first);
       ++it;
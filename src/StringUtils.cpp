@@ -0,0 +1,85 @@
+#include "redis/StringUtils.h"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace redis {
+
+namespace {
+
+// Enough for any finite long double in %.17Lf, as Redis'
+// MAX_LONG_DOUBLE_CHARS.
+constexpr std::size_t kMaxLongDoubleChars = 5 * 1024;
+
+} // namespace
+
+bool parseInt64(const std::string_view str, int64_t &value) {
+  if (str.empty() || str.size() > 20) {
+    return false;
+  }
+  if (str.size() > 1 && (str[0] == '0' || (str[0] == '-' && str[1] == '0'))) {
+    return false;
+  }
+
+  const auto [ptr, ec] =
+      std::from_chars(str.data(), str.data() + str.size(), value);
+  return ec == std::errc() && ptr == str.data() + str.size();
+}
+
+bool parseLongDouble(const std::string_view str, long double &value) {
+  if (str.empty() || std::isspace(static_cast<unsigned char>(str.front())) ||
+      std::isspace(static_cast<unsigned char>(str.back()))) {
+    return false;
+  }
+
+  const std::string buffer(str);
+  char *end = nullptr;
+  value = std::strtold(buffer.c_str(), &end);
+  return end == buffer.c_str() + buffer.size() && !std::isnan(value) &&
+         !std::isinf(value);
+}
+
+bool equalsIgnoreCase(const std::string_view a, const std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.size(); i++) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) !=
+        std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool formatLongDouble(const long double value, std::string &out) {
+  // Fixed-point, as Redis' ld2string does for INCRBYFLOAT, so integral
+  // results stay integer-parseable; the buffer fits the largest finite long
+  // double written out in full.
+  char buffer[kMaxLongDoubleChars];
+  int len = std::snprintf(buffer, sizeof(buffer), "%.17Lf", value);
+  if (len < 0 || static_cast<std::size_t>(len) >= sizeof(buffer)) {
+    return false;
+  }
+
+  if (std::memchr(buffer, '.', static_cast<std::size_t>(len)) != nullptr) {
+    while (buffer[len - 1] == '0') {
+      len--;
+    }
+    if (buffer[len - 1] == '.') {
+      len--;
+    }
+  }
+  if (len == 2 && buffer[0] == '-' && buffer[1] == '0') {
+    out = "0";
+    return true;
+  }
+  out.assign(buffer, static_cast<std::size_t>(len));
+  return true;
+}
+
+} // namespace redis
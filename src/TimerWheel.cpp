@@ -0,0 +1,16 @@
+#include "redis/TimerWheel.h"
+
+namespace redis {
+
+TimerWheel::TimerWheel(const int64_t resolutionMs, const std::size_t slots)
+    : slots_(slots), resolutionMs_(resolutionMs) {}
+
+void TimerWheel::schedule(const uint64_t id, const int64_t deadlineMs) {
+  // A deadline already in the past fires on the next advance.
+  const int64_t tick = std::max(deadlineMs / resolutionMs_, nextTick_);
+  slots_[static_cast<std::size_t>(tick) % slots_.size()].push_back(
+      {id, deadlineMs});
+  size_++;
+}
+
+} // namespace redis
@@ -0,0 +1,187 @@
+#include "redis/Tracking.h"
+
+#include "redis/Client.h"
+#include "redis/ClientRegistry.h"
+#include "redis/RESPParser.h"
+
+#include <algorithm>
+
+namespace redis {
+
+Tracking::Tracking(const std::shared_ptr<ClientRegistry> &registry,
+                   const std::size_t maxKeys)
+    : registry_(registry), maxKeys_(maxKeys) {}
+
+void Tracking::enable(Client &client, const bool bcast, const bool noLoop,
+                      const uint64_t redirect,
+                      std::vector<std::string> prefixes) {
+  disable(client);
+
+  client.tracking = true;
+  client.trackingBcast = bcast;
+  client.trackingNoLoop = noLoop;
+  client.trackingRedirect = redirect;
+
+  if (bcast) {
+    // BCAST without PREFIX means every key, i.e. the empty prefix.
+    if (prefixes.empty()) {
+      prefixes.emplace_back();
+    }
+    for (const auto &prefix : prefixes) {
+      PrefixNode *node = &prefixRoot_;
+      for (const char c : prefix) {
+        auto &child = node->children[c];
+        if (!child) {
+          child = std::make_unique<PrefixNode>();
+        }
+        node = child.get();
+      }
+      node->clients.push_back(client.id);
+    }
+    client.trackingPrefixes = std::move(prefixes);
+  }
+}
+
+void Tracking::disable(Client &client) {
+  if (!client.tracking) {
+    return;
+  }
+
+  // Entries in the default-mode table are dropped lazily: IDs of clients
+  // that stopped tracking are skipped when the key is invalidated.
+  for (const auto &prefix : client.trackingPrefixes) {
+    removePrefix(client.id, prefix);
+  }
+  client.tracking = false;
+  client.trackingBcast = false;
+  client.trackingNoLoop = false;
+  client.trackingRedirect = 0;
+  client.trackingPrefixes.clear();
+}
+
+void Tracking::rememberKey(const Client &client, const std::string &key) {
+  if (!client.tracking || client.trackingBcast) {
+    return;
+  }
+
+  if (auto &ids = table_[key]; std::ranges::find(ids, client.id) == ids.end()) {
+    ids.push_back(client.id);
+  }
+
+  // Keep the table bounded: evicting a key invalidates it for everyone who
+  // had it cached, exactly as if it had been written.
+  while (table_.size() > maxKeys_) {
+    auto victim = table_.begin();
+    if (victim->first == key && std::next(victim) != table_.end()) {
+      ++victim;
+    }
+    const std::string victimKey = victim->first;
+    invalidateKey(victimKey, nullptr);
+  }
+}
+
+void Tracking::invalidateKey(const std::string &key, const Client *origin) {
+  Frames frames{key, nullptr, nullptr};
+
+  if (const auto it = table_.find(key); it != table_.end()) {
+    const auto ids = std::move(it->second);
+    table_.erase(it);
+    for (const uint64_t id : ids) {
+      if (Client *client = registry_->find(id);
+          client != nullptr && client->tracking && !client->trackingBcast) {
+        notify(*client, frames, origin);
+      }
+    }
+  }
+
+  // Every node on the key's path through the trie is a matching prefix.
+  // CLIENT TRACKING rejects overlapping prefixes, so a client is on at most
+  // one of them.
+  const PrefixNode *node = &prefixRoot_;
+  for (std::size_t depth = 0; node != nullptr; depth++) {
+    for (const uint64_t id : node->clients) {
+      if (Client *client = registry_->find(id); client != nullptr) {
+        notify(*client, frames, origin);
+      }
+    }
+
+    if (depth == key.size()) {
+      break;
+    }
+    const auto child = node->children.find(key[depth]);
+    node = child == node->children.end() ? nullptr : child->second.get();
+  }
+}
+
+void Tracking::invalidateAll(const Client *origin) {
+  static const std::string noKey;
+  Frames frames{
+      noKey,
+      std::make_shared<const std::string>(">2\r\n$10\r\ninvalidate\r\n_\r\n"),
+      std::make_shared<const std::string>(
+          "*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n*-1\r\n")};
+
+  table_.clear();
+  for (const auto &[id, client] : registry_->clients()) {
+    if (client->tracking) {
+      notify(*client, frames, origin);
+    }
+  }
+}
+
+void Tracking::notify(Client &client, Frames &frames,
+                      const Client *origin) const {
+  if (client.trackingNoLoop && &client == origin) {
+    return;
+  }
+
+  Client *target = client.trackingRedirect != 0
+                       ? registry_->find(client.trackingRedirect)
+                       : &client;
+  if (target == nullptr) {
+    return;
+  }
+
+  if (target->protocolVersion >= 3) {
+    if (!frames.push) {
+      frames.push = std::make_shared<const std::string>(
+          ">2\r\n$10\r\ninvalidate\r\n*1\r\n" +
+          RESPParser::encodeBulkString(frames.key));
+    }
+    target->queueOutput(frames.push);
+  } else if (client.trackingRedirect != 0 &&
+             target->channels.contains("__redis__:invalidate")) {
+    // RESP2 connections receive invalidations as pub/sub messages on the
+    // client they redirected to.
+    if (!frames.message) {
+      frames.message = std::make_shared<const std::string>(
+          "*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n*1\r\n" +
+          RESPParser::encodeBulkString(frames.key));
+    }
+    target->queueOutput(frames.message);
+  }
+}
+
+void Tracking::removePrefix(const uint64_t clientId,
+                            const std::string &prefix) {
+  std::vector<PrefixNode *> path{&prefixRoot_};
+  for (const char c : prefix) {
+    const auto it = path.back()->children.find(c);
+    if (it == path.back()->children.end()) {
+      return;
+    }
+    path.push_back(it->second.get());
+  }
+
+  std::erase(path.back()->clients, clientId);
+
+  for (std::size_t depth = prefix.size(); depth > 0; depth--) {
+    const PrefixNode *node = path[depth];
+    if (!node->clients.empty() || !node->children.empty()) {
+      break;
+    }
+    path[depth - 1]->children.erase(prefix[depth - 1]);
+  }
+}
+
+} // namespace redis
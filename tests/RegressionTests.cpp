@@ -0,0 +1,275 @@
+// Regression tests for bugs reached through client input. Each test drives
+// CommandHandler the way a connection would and checks the encoded reply;
+// the process exits non-zero on the first failed check.
+
+#include "redis/Client.h"
+#include "redis/ClientRegistry.h"
+#include "redis/CommandHandler.h"
+#include "redis/Config.h"
+#include "redis/Metrics.h"
+#include "redis/PubSub.h"
+#include "redis/RDBParser.h"
+#include "redis/RDBWriter.h"
+#include "redis/ServerClock.h"
+#include "redis/RESPParser.h"
+#include "redis/Storage.h"
+#include "redis/Tracking.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(const bool condition, const std::string_view what,
+           const std::string_view detail = {}) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what;
+    if (!detail.empty()) {
+      std::cerr << " (got " << detail << ")";
+    }
+    std::cerr << '\n';
+    failures++;
+  }
+}
+
+struct HandlerFixture {
+  std::shared_ptr<redis::Config> config = std::make_shared<redis::Config>();
+  std::shared_ptr<redis::Storage> storage = std::make_shared<redis::Storage>();
+  std::shared_ptr<redis::PubSub> pubsub = std::make_shared<redis::PubSub>();
+  std::shared_ptr<redis::ClientRegistry> registry =
+      std::make_shared<redis::ClientRegistry>();
+  std::shared_ptr<redis::Tracking> tracking =
+      std::make_shared<redis::Tracking>(registry,
+                                        config->getTrackingTableMaxKeys());
+  std::shared_ptr<redis::Metrics> metrics =
+      std::make_shared<redis::Metrics>(*config);
+  redis::CommandHandler handler{config,   storage,  pubsub,
+                                registry, tracking, metrics};
+  redis::Client client{INVALID_SOCKET_VAL};
+
+  std::string execute(const std::vector<std::string> &command) {
+    return execute(client, command);
+  }
+
+  std::string execute(redis::Client &as,
+                      const std::vector<std::string> &command) {
+    std::string reply;
+    handler.handleCommand(as, command, reply);
+    as.arena.reset();
+    return reply;
+  }
+};
+
+void testIncrByFloatHugeValue() {
+  HandlerFixture fixture;
+  const std::string reply = fixture.execute({"INCRBYFLOAT", "k", "1e400"});
+  // 401 integral digits, with no exponent and no fractional part.
+  check(reply.starts_with("$401\r\n1000000000000000") &&
+            reply.find_first_of(".e") == std::string::npos,
+        "INCRBYFLOAT 1e400 reply", reply.substr(0, 32));
+  check(fixture.execute({"GET", "k"}) == reply,
+        "INCRBYFLOAT 1e400 stored value");
+}
+
+void testIncrByFloatTinyValue() {
+  HandlerFixture fixture;
+  // Below the 17th decimal, as in Redis.
+  const std::string reply = fixture.execute({"INCRBYFLOAT", "k", "1e-20"});
+  check(reply == "$1\r\n0\r\n", "INCRBYFLOAT 1e-20 reply", reply);
+  const std::string negative =
+      fixture.execute({"INCRBYFLOAT", "n", "-1e-20"});
+  check(negative == "$1\r\n0\r\n", "INCRBYFLOAT -1e-20 reply", negative);
+}
+
+void testIncrByFloatIntegralStaysInteger() {
+  HandlerFixture fixture;
+  const std::string reply = fixture.execute({"INCRBYFLOAT", "k", "1e17"});
+  check(reply == "$18\r\n100000000000000000\r\n", "INCRBYFLOAT 1e17 reply",
+        reply);
+  const std::string incr = fixture.execute({"INCR", "k"});
+  check(incr == ":100000000000000001\r\n", "INCR after INCRBYFLOAT", incr);
+}
+
+void testIncrByFloatTrimsZeros() {
+  HandlerFixture fixture;
+  fixture.execute({"SET", "k", "10.5"});
+  const std::string reply = fixture.execute({"INCRBYFLOAT", "k", "0.1"});
+  check(reply == "$4\r\n10.6\r\n", "INCRBYFLOAT 10.5+0.1 reply", reply);
+}
+
+void testHugeMultibulkCountRejected() {
+  std::vector<std::string> command;
+  std::size_t pos = 0;
+  const auto result =
+      redis::RESPParser::parseCommand("*100000000000\r\n", pos, command);
+  check(result == redis::ParseResult::Error, "oversized multibulk count");
+}
+
+void testLargeMultibulkCountWaitsForArguments() {
+  std::vector<std::string> command;
+  std::size_t pos = 0;
+  const auto result = redis::RESPParser::parseCommand(
+      "*1048576\r\n$3\r\nSET\r\n", pos, command);
+  check(result == redis::ParseResult::Incomplete,
+        "multibulk count at the limit");
+  check(command.capacity() < 1048576, "multibulk reserve is capped");
+}
+
+void testBfReserveOversizedCapacity() {
+  HandlerFixture fixture;
+  const std::string reply =
+      fixture.execute({"BF.RESERVE", "x", "0.1", "99999999999999"});
+  check(reply.starts_with("-ERR"), "BF.RESERVE oversized capacity", reply);
+  const std::string expansion = fixture.execute(
+      {"BF.RESERVE", "x", "0.1", "100", "EXPANSION", "4294967295"});
+  check(expansion.starts_with("-ERR"), "BF.RESERVE oversized expansion",
+        expansion);
+  check(fixture.execute({"PING"}) == "+PONG\r\n",
+        "server answers after oversized BF.RESERVE");
+}
+
+void testBfScalesWithLargestExpansion() {
+  HandlerFixture fixture;
+  fixture.execute({"BF.RESERVE", "x", "0.01", "1", "EXPANSION", "32768"});
+  check(fixture.execute({"BF.MADD", "x", "a", "b", "c"}) ==
+            "*3\r\n:1\r\n:1\r\n:1\r\n",
+        "BF.MADD across sub-filters");
+  check(fixture.execute({"BF.EXISTS", "x", "c"}) == ":1\r\n",
+        "BF.EXISTS after scaling");
+}
+
+// What MIGRATE sends for key: the value in the DUMP format.
+std::string dumpKey(HandlerFixture &fixture, const std::string &key) {
+  redis::RDBWriter writer(true, false);
+  std::string payload;
+  fixture.storage->withEntry(key, [&](const redis::ValueWithExpiry &entry) {
+    payload = writer.dumpValue(entry);
+  });
+  return payload;
+}
+
+void testRestoreAskingEveryType() {
+  HandlerFixture source;
+  source.execute({"SET", "s", std::string(100, 'x')});
+  source.execute({"HSET", "h", "f", "v"});
+  source.execute({"SADD", "set", "1", "2", "three"});
+  source.execute({"BF.ADD", "bf", "item"});
+
+  HandlerFixture target;
+  for (const std::string key : {"s", "h", "set", "bf"}) {
+    const std::string reply =
+        target.execute({"RESTORE-ASKING", key, "0", dumpKey(source, key)});
+    check(reply == "+OK\r\n", "RESTORE-ASKING " + key, reply);
+  }
+  check(target.execute({"GET", "s"}) == source.execute({"GET", "s"}),
+        "restored string");
+  check(target.execute({"HGET", "h", "f"}) == "$1\r\nv\r\n",
+        "restored hash");
+  check(target.execute({"SCARD", "set"}) == ":3\r\n", "restored set");
+  check(target.execute({"BF.EXISTS", "bf", "item"}) == ":1\r\n",
+        "restored bloom filter");
+
+  std::string corrupt = dumpKey(source, "h");
+  corrupt[1] ^= 1;
+  const std::string reply =
+      target.execute({"RESTORE-ASKING", "h2", "0", corrupt});
+  check(reply.starts_with("-ERR"), "RESTORE-ASKING bad checksum", reply);
+}
+
+void testRdbHugeLzfLengthRejected() {
+  // A string whose LZF header claims close to 2^64 bytes of output.
+  const std::string file =
+      std::string("REDIS0011\xFE\x00\x00\x01k\xC3\x01\x81", 17) +
+      std::string(8, '\xFF') + std::string("\x00\xFF", 2) +
+      std::string(8, '\0');
+  const auto path =
+      std::filesystem::temp_directory_path() / "redis-tests-lzf.rdb";
+  std::ofstream(path, std::ios::binary) << file;
+
+  redis::Storage storage;
+  redis::RDBParser parser;
+  check(!parser.parseFile(path.string(), storage),
+        "RDB with an oversized LZF length");
+  check(storage.getAllKeys().empty(), "nothing kept from a corrupt RDB");
+  std::filesystem::remove(path);
+}
+
+void testWatchMissingKeyCreatedAndDeleted() {
+  HandlerFixture fixture;
+  redis::Client other{INVALID_SOCKET_VAL};
+  fixture.execute({"WATCH", "k"});
+  fixture.execute(other, {"SET", "k", "1"});
+  fixture.execute(other, {"DEL", "k"});
+  fixture.execute({"MULTI"});
+  fixture.execute({"SET", "k", "2"});
+  const std::string reply = fixture.execute({"EXEC"});
+  check(reply == "*-1\r\n", "EXEC after a watched key came and went", reply);
+  check(fixture.execute({"EXISTS", "k"}) == ":0\r\n",
+        "aborted transaction did not run");
+
+  // An untouched missing key still lets the transaction run.
+  fixture.execute({"WATCH", "k"});
+  fixture.execute({"MULTI"});
+  fixture.execute({"SET", "k", "2"});
+  check(fixture.execute({"EXEC"}) == "*1\r\n+OK\r\n",
+        "EXEC with an untouched missing key");
+}
+
+void testDirtyExecRepliesNullInResp3() {
+  HandlerFixture fixture;
+  fixture.client.protocolVersion = 3;
+  fixture.execute({"WATCH", "k"});
+  redis::Client other{INVALID_SOCKET_VAL};
+  fixture.execute(other, {"SET", "k", "1"});
+  fixture.execute({"MULTI"});
+  fixture.execute({"GET", "k"});
+  const std::string reply = fixture.execute({"EXEC"});
+  check(reply == "_\r\n", "dirty EXEC over RESP3", reply);
+}
+
+void testExpiryAfterSlowWorkInOneIteration() {
+  HandlerFixture fixture;
+  redis::ServerClock::update();
+  fixture.execute({"SET", "k", "v", "PX", "20"});
+  // Stands in for a slow command earlier in the same event-loop iteration,
+  // with no refresh of the cached clock in between.
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  const std::string reply = fixture.execute({"GET", "k"});
+  check(reply == "$-1\r\n", "key expired during slow work is not served",
+        reply);
+}
+
+} // namespace
+
+int main() {
+  testIncrByFloatHugeValue();
+  testIncrByFloatTinyValue();
+  testIncrByFloatIntegralStaysInteger();
+  testIncrByFloatTrimsZeros();
+  testHugeMultibulkCountRejected();
+  testLargeMultibulkCountWaitsForArguments();
+  testBfReserveOversizedCapacity();
+  testBfScalesWithLargestExpansion();
+  testRestoreAskingEveryType();
+  testRdbHugeLzfLengthRejected();
+  testWatchMissingKeyCreatedAndDeleted();
+  testDirtyExecRepliesNullInResp3();
+  testExpiryAfterSlowWorkInOneIteration();
+
+  if (failures != 0) {
+    std::cerr << failures << " check(s) failed\n";
+    return EXIT_FAILURE;
+  }
+  std::cout << "all checks passed\n";
+  return EXIT_SUCCESS;
+}